@@ -0,0 +1,1293 @@
+/*
+ * bench_loop.cpp
+ *
+ * Loop-latency benchmark for the host build of the Stethoscope sketch.
+ *
+ * Runs setup() once, then replays one or more scenarios.  A scenario is a list
+ * of timed events: bytes that arrive on the Bluetooth UART (Serial1) at a
+ * given offset, plus a couple of host-only actions.  The audio graph is fed a
+ * synthetic heart sound (or a raw file given with -a) and updated every 128
+ * samples of virtual time.  Every loop() call is timed and binned by the mode
+ * the sketch was in when the iteration started; the report lists latency
+ * percentiles per mode, then what the audio interrupt cost in each mode.
+ *
+ * Scenario / script format, one event per line:
+ *
+ *   # comment
+ *   <ms>  <byte> [<byte> ...]     hex bytes (0x31 or 31) and "quoted text"
+ *   <ms>  play <FILE>             start playback directly (mode 2)
+ *   <ms>  get <FILE> [corrupt]    fetch a file with GETFILE through the built-in
+ *                                 receiver (which checks every chunk, acknowledges
+ *                                 it 20 ms later and compares the result with the
+ *                                 file); "corrupt" damages one chunk on the way
+ *   <ms>  prealloc <bytes>        bytes preallocated per recording from now on
+ *                                 ( 0: the sketch's RECORD_PREALLOC )
+ *   <ms>  wav <FILE> <bytes>      check a recording on the card: the RIFF and
+ *                                 data sizes match the file, with at least
+ *                                 <bytes> of samples
+ *   <ms>  decode <FILE> <dB>      once the scenario has run, decode a recording
+ *                                 with decodeRecording.py and compare it with
+ *                                 the samples that went into the codec: the
+ *                                 signal to error ratio must reach <dB>, or
+ *                                 every sample must match with "exact"
+ *   <ms>  end                     end of the scenario
+ *
+ * usage: bench_loop [-s scenario] [-f script] [-a audio.raw] [-d sdroot] [-F flash.img] [-o file] [-v] [-r] [-G]
+ *   -s   boot | record | overflow | ulaw | adpcm | rice | lowrate | interleave | play | monitor | telemetry | stream |
+ *        blend | switch | transfer | all
+ *        (default all)
+ *   -f   run a script file instead of the built-in scenarios
+ *   -a   mono 16 bit 44.1 kHz raw file used as microphone input (looped)
+ *   -d   directory standing in for the SD card (default ./sdcard)
+ *   -F   file standing in for the SPI flash, kept between runs (default: an
+ *        erased flash every run, so the sound library is copied again)
+ *   -o   copy what the sketch sends over bluetooth to a file or tty as it is
+ *        sent ( stream_loopback.py reads it from a pseudo-tty )
+ *   -v   echo the sketch's USB serial console to stderr
+ *   -r   compare the heart-rate detectors instead (cost per update and per
+ *        estimate, accuracy with murmur and noise, at the full rate and
+ *        decimated by 8), then the decimator's cost and response at each
+ *        ratio; the sketch is not run
+ *   -G   keep the whole audio graph connected in every mode, as it was
+ *        before AudioGraph.h, to compare the audio cost per mode with
+ *
+ * Exits with 1 when a check fails: a transfer that does not verify, a
+ * recording that does not decode back to what was recorded, or telemetry
+ * frames and stream packets that do not decode the way they were sent ( a CRC
+ * error, a malformed frame, fewer decoded than the sketch sent ).
+ */
+
+#include "Arduino.h"
+#include "AudioStream.h"
+#include "Audio.h"
+#include "HostSim.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+
+extern int hostSketchMode( void );
+extern int hostSketchSoundCount( void );
+extern const char * hostSketchSound( int index );
+extern void hostSketchStartPlaying( const char * name );
+extern float hostSketchHeartRate( void );
+extern uint32_t hostSketchSoundStarts( int source, uint32_t * mean, uint32_t * max, int * inFlash );
+extern uint32_t hostSketchBootAt( int phase, const char ** name );
+extern uint32_t hostSketchHeap( uint32_t * usedPeak, uint32_t * fragmented );
+extern int hostSketchAudioLoad( int * pool, uint32_t * overruns, uint32_t * late );
+extern uint32_t hostSketchTelemetry( uint32_t * frames, uint32_t * dropped );
+extern uint32_t hostSketchStream( uint32_t * dropped );
+extern uint32_t hostSketchCodecStats( uint32_t * cyclesMax, uint32_t * blocks, double * ratio );
+extern void hostSketchGraphManaged( bool managed );
+extern void hostSketchRecordPrealloc( uint32_t bytes );
+extern void hostSketchRecordTap( void ( *tap )( const int16_t * src, int n ) );
+extern int hostSketchAudioActive( void );
+
+static unsigned failures = 0;                   // checks that failed, over every scenario
+
+// ==============================================================================================================
+// Built-in scenarios
+// ============================================================================================================== //
+
+struct Scenario {
+  const char * name;
+  const char * script;
+};
+
+static const Scenario scenarios[] = {
+  { "boot",                                     // ENQ straight after setup(), BOOTSTATS once the boot has finished
+    "0     05\n"
+    "1000  10\n"
+    "1500  end\n" },
+  { "record",                                   // PSTRING "BENCH", STARTCREC, 6 s of recording, RECSTATS, STOPREC
+    "0     31 \"BENCH\"\n"
+    "1500  32\n"
+    "7400  13\n"
+    "7500  17\n"
+    "8000  end\n" },
+  { "overflow",                                 // as "record", with 65000 B preallocated: past it the file system takes over
+    "0     prealloc 65000\n"
+    "0     31 \"OVER\"\n"
+    "1500  32\n"
+    "7500  17\n"
+    "7900  wav R0OVER.WAV 500000\n"
+    "7900  prealloc 0\n"
+    "8000  end\n" },
+  { "ulaw",                                     // RECCODEC 1, PSTRING "ULAW", STARTCREC, 6 s, STOPREC, RECCODEC 0, decoded to 30 dB
+    "0     37 \"1\"\n"
+    "200   31 \"ULAW\"\n"
+    "1500  32\n"
+    "7500  17\n"
+    "7600  37 \"0\"\n"
+    "7700  decode R0ULAW.WAV 30\n"
+    "8000  end\n" },
+  { "adpcm",                                    // RECCODEC 2, PSTRING "ADPCM", STARTCREC, 6 s, STOPREC, RECCODEC 0, decoded to 20 dB
+    "0     37 \"2\"\n"
+    "200   31 \"ADPCM\"\n"
+    "1500  32\n"
+    "7500  17\n"
+    "7600  37 \"0\"\n"
+    "7700  decode R0ADPCM.WAV 20\n"
+    "8000  end\n" },
+  { "rice",                                     // RECCODEC 3, PSTRING "RICE", STARTCREC, 6 s, STOPREC, RECCODEC 0, decoded exactly
+    "0     37 \"3\"\n"
+    "200   31 \"RICE\"\n"
+    "1500  32\n"
+    "7500  17\n"
+    "7600  37 \"0\"\n"
+    "7700  decode R0RICE.WAV exact\n"
+    "8000  end\n" },
+  { "lowrate",                                  // RECCODEC "2:8" ( ADPCM at 5.5 kHz ), PSTRING "LOWRT", STARTCREC, 6 s, STOPREC, RECCODEC 0, decoded to 20 dB
+    "0     37 \"2:8\"\n"
+    "200   31 \"LOWRT\"\n"
+    "1500  32\n"
+    "7500  17\n"
+    "7600  37 \"0\"\n"
+    "7700  decode R0LOWRT.WAV 20\n"
+    "8000  end\n" },
+  { "interleave",                               // RECMODE 2, PSTRING "BENCH", STARTCREC, 6 s, STOPREC
+    "0     41 \"2\"\n"
+    "200   31 \"BENCH\"\n"
+    "1500  32\n"
+    "7500  17\n"
+    "8000  end\n" },
+  { "play",                                     // playback of the first library sound, STOPPLAY
+    "0     play AORSTE.RAW\n"
+    "4000  19\n"
+    "4500  end\n" },
+  { "monitor",                                  // STARTHBMONITOR, 6 s, STOPHBMONITOR
+    "0     1B\n"
+    "6000  1C\n"
+    "6500  end\n" },
+  { "telemetry",                                // STARTHBMONITOR, STARTTELEM at 50 Hz, 6 s, STOPTELEM, STOPHBMONITOR
+    "0     1B\n"
+    "100   22 \"50\"\n"
+    "6100  23\n"
+    "6200  1C\n"
+    "6500  end\n" },
+  { "stream",                                   // STARTSTREAM ADPCM at 5.5 kHz, then mu-law at 7.4 kHz, 4 s each
+    "0     24 \"2\"\n"
+    "4000  25\n"
+    "4500  24 \"1:6\"\n"
+    "8500  25\n"
+    "9000  end\n" },
+  { "blend",                                    // blend byte 60 (first sound), STOPBLEND, fade out
+    "0     3C\n"
+    "6000  20\n"
+    "9000  end\n" },
+  { "switch",                                   // blend sound switches: three before the flash sync is done, eight after
+    "0     3C\n"
+    "600   3D\n"
+    "1200  3E\n"
+    "12000 3F\n"
+    "12600 40\n"
+    "13200 3C\n"
+    "13800 42\n"
+    "14400 43\n"
+    "15000 44\n"
+    "15600 45\n"
+    "16200 46\n"
+    "16800 20\n"
+    "19800 end\n" },
+  { "transfer",                                 // GETFILE of a 40000 byte file, then again with a damaged chunk
+    "0     get XFER.RAW\n"
+    "5000  get XFER.RAW corrupt\n"
+    "10000 end\n" },
+};
+
+// ==============================================================================================================
+// Latency histogram
+//
+// Log-linear buckets: 32 sub-buckets per power of two, so a reported
+// percentile is within ~3% of the true value without storing every sample.
+// ============================================================================================================== //
+
+#define SUB_BITS  5
+#define SUBS      (1 << SUB_BITS)
+#define NBUCKETS  (64 * SUBS)
+
+struct Histogram {
+  uint64_t count;
+  uint64_t total_ns;
+  uint64_t max_ns;
+  uint64_t bucket[NBUCKETS];
+};
+
+static Histogram modeHist[8];
+
+// Audio interrupt cost per mode, sampled after every update: host cycles of
+// the whole graph, blocks still held from the pool, and objects it ran
+struct AudioCost {
+  uint64_t updates;
+  uint64_t cycles;
+  uint64_t cyclesMax;
+  uint64_t blocks;
+  uint64_t blocksMax;
+  uint64_t active;
+};
+
+static AudioCost modeAudio[8];
+
+static void audioSample( void ) {
+  AudioCost & a = modeAudio[hostSketchMode() & 7];
+  uint64_t cycles = AudioStream::cpu_cycles_total * 16ULL;
+  a.updates++;
+  a.cycles += cycles;
+  if ( cycles > a.cyclesMax ) a.cyclesMax = cycles;
+  a.blocks += AudioMemoryUsage();
+  if ( AudioMemoryUsage() > a.blocksMax ) a.blocksMax = AudioMemoryUsage();
+  a.active += hostSketchAudioActive();
+}
+
+static unsigned int bucketOf( uint64_t ns ) {
+  if ( ns < SUBS ) return ns;
+  int msb = 63 - __builtin_clzll( ns );
+  unsigned int sub = ( ns >> ( msb - SUB_BITS ) ) & ( SUBS - 1 );
+  return ( msb - SUB_BITS + 1 ) * SUBS + sub;
+}
+
+static uint64_t bucketTop( unsigned int b ) {
+  if ( b < SUBS ) return b;
+  unsigned int msb = b / SUBS + SUB_BITS - 1;
+  uint64_t sub = b % SUBS;
+  return ( ( (uint64_t)SUBS + sub + 1 ) << ( msb - SUB_BITS ) ) - 1;
+}
+
+static void record( Histogram & h, uint64_t ns ) {
+  h.count++;
+  h.total_ns += ns;
+  if ( ns > h.max_ns ) h.max_ns = ns;
+  h.bucket[bucketOf( ns )]++;
+}
+
+static double percentileUs( const Histogram & h, double p ) {
+  uint64_t target = (uint64_t)( p * h.count );
+  if ( target >= h.count ) target = h.count - 1;
+  uint64_t seen = 0;
+  for ( unsigned int b = 0; b < NBUCKETS; b++ ) {
+    seen += h.bucket[b];
+    if ( seen > target ) {
+      uint64_t top = bucketTop( b );
+      return ( top > h.max_ns ? h.max_ns : top ) / 1000.0;
+    }
+  }
+  return h.max_ns / 1000.0;
+}
+
+// ==============================================================================================================
+// Audio sources
+// ============================================================================================================== //
+
+// Synthetic heart sound: S1/S2 bursts (decaying 40-60 Hz tones) at 72 bpm over
+// a low noise floor, optionally with a systolic murmur (crescendo-decrescendo
+// noise between S1 and S2).  Deterministic, so runs are comparable.
+struct HeartSound {
+  double   t;
+  double   bpm;
+  uint32_t seed;
+  double   noise;
+  double   murmur;
+};
+
+static int16_t heartSample( HeartSound & hs ) {
+  double period = 60.0 / hs.bpm;
+  double phase  = fmod( hs.t, period );
+  double s      = 0.0;
+  if ( phase < 0.10 )                               // S1
+    s += 0.55 * exp( -phase * 40.0 ) * sin( 2 * M_PI * 45.0 * phase );
+  if ( phase > 0.30 && phase < 0.38 )               // S2
+    s += 0.35 * exp( -( phase - 0.30 ) * 50.0 ) * sin( 2 * M_PI * 60.0 * ( phase - 0.30 ) );
+  hs.seed = hs.seed * 1664525 + 1013904223;
+  double white = ( (int32_t)( hs.seed >> 16 ) - 32768 ) / 32768.0;
+  s += white * hs.noise;
+  if ( phase > 0.10 && phase < 0.30 )               // murmur, loudest mid-systole
+    s += white * hs.murmur * ( 1.0 - fabs( phase - 0.20 ) / 0.10 );
+  hs.t += 1.0 / AUDIO_SAMPLE_RATE_EXACT;
+  return (int16_t)( s * 32767.0 );
+}
+
+static void heartSource( int16_t * left, int16_t * right, void * arg ) {
+  HeartSound * hs = (HeartSound *)arg;
+  for ( int i = 0; i < AUDIO_BLOCK_SAMPLES; i++ ) left[i] = right[i] = heartSample( *hs );
+}
+
+struct RawSource {
+  int16_t * data;
+  size_t    len;
+  size_t    pos;
+};
+
+static void rawSource( int16_t * left, int16_t * right, void * arg ) {
+  RawSource * rs = (RawSource *)arg;
+  for ( int i = 0; i < AUDIO_BLOCK_SAMPLES; i++ ) {
+    left[i] = right[i] = rs->data[rs->pos];
+    if ( ++rs->pos >= rs->len ) rs->pos = 0;
+  }
+}
+
+// Populate the SD stand-in with the sketch's default sounds (3 s each) so that
+// the catalog built by setup() has something to index, and playback and
+// blending something to read.
+static void prepareSoundLibrary( void ) {
+  for ( int i = 0; i < hostSketchSoundCount(); i++ ) {
+    char path[512];
+    host_sd_path( hostSketchSound( i ), path, sizeof( path ) );
+    if ( access( path, F_OK ) == 0 ) continue;
+    FILE * fp = fopen( path, "wb" );
+    if ( !fp ) continue;
+    HeartSound hs = { 0.0, 60.0 + 6 * i, 12345u + i, 0.01, 0.0 };
+    for ( int n = 0; n < 3 * 44100; n++ ) {
+      int16_t s = heartSample( hs );
+      fwrite( &s, 2, 1, fp );
+    }
+    fclose( fp );
+  }
+}
+
+// ==============================================================================================================
+// Heart-rate detector comparison
+//
+// Feeds the same synthetic heart sound to each detector, outside the sketch,
+// and times every update() with the cycle counter.  The peak meter is the
+// front end of waveAmplitudePeaks() and waveAmplitudePeaks2(), whose loop()
+// side costs next to nothing; it makes no estimate of its own.  The "/8" rows
+// are the same detectors behind an AudioEffectDecimate of 8, whose own cost is
+// the decimate/8 row; every row is per input block.
+//
+// Then the decimator alone at each ratio: cost per input block, the gain of
+// tones it should keep, and how far a tone that would alias onto 200 Hz is
+// pushed down.
+// ============================================================================================================== //
+
+#define COMPARE_SECONDS 60
+#define COMPARE_WARMUP  6                       // seconds before estimates are scored
+#define TONE_BLOCKS     4000                    // per tone, 11.6 s
+
+class BenchSource : public AudioStream {
+public:
+  BenchSource( void ) : AudioStream( 0, NULL ), hs( NULL ), tone( 0.0 ), t( 0.0 ) {}
+  virtual void update( void ) {
+    audio_block_t * block = allocate();
+    if ( !block ) return;
+    for ( int i = 0; i < AUDIO_BLOCK_SAMPLES; i++ ) {
+      if ( tone > 0.0 ) {
+        block->data[i] = (int16_t)( 16384.0 * sin( 2 * M_PI * tone * t ) );
+        t += 1.0 / AUDIO_SAMPLE_RATE_EXACT;
+      } else {
+        block->data[i] = heartSample( *hs );
+      }
+    }
+    transmit( block );
+    release( block );
+  }
+  HeartSound * hs;
+  double       tone;                            // Hz, half scale, instead of the heart sound when not 0
+  double       t;
+};
+
+struct DetectorStats {
+  uint64_t   cycles;
+  uint32_t * perUpdate;                         // every update, for the 99.9th percentile
+  uint32_t   updates;
+  uint32_t   estimates;
+  uint32_t   scored;
+  uint32_t   good;                              // within 5% of the true rate
+  double     confidence;
+  float      last;
+};
+
+template <class T> static void timedUpdate( T & obj, DetectorStats & st ) {
+  uint32_t c0 = host_cycles();
+  obj.update();
+  uint32_t c  = host_cycles() - c0;
+  st.cycles += c;
+  st.perUpdate[st.updates++] = c;
+}
+
+static int compareCycles( const void * a, const void * b ) {
+  uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+  return x < y ? -1 : x > y;
+}
+
+// The worst updates on the host are preemptions, not work: the 99.9th
+// percentile still catches the FFT steps (2 in every 256 updates).
+static uint32_t highCycles( DetectorStats & st ) {
+  qsort( st.perUpdate, st.updates, sizeof( uint32_t ), compareCycles );
+  return st.perUpdate[st.updates * 999 / 1000];
+}
+
+static void score( DetectorStats & st, float bpm, double truth, bool warm ) {
+  st.estimates++;
+  st.last = bpm;
+  if ( !warm ) return;
+  st.scored++;
+  if ( fabs( bpm - truth ) <= 0.05 * truth ) st.good++;
+}
+
+static void compareDetectors( void ) {
+  static const struct {
+    const char * name;
+    double       bpm, noise, murmur;
+  } conditions[] = {
+    { "clean",   72.0, 0.01, 0.00 },
+    { "murmur",  72.0, 0.01, 0.40 },
+    { "noisy",   72.0, 0.15, 0.00 },
+    { "fast",   150.0, 0.01, 0.00 },
+  };
+  static const char * names[] = { "peak", "heartbeat", "heartrate", "decimate/8", "heartbeat/8", "heartrate/8" };
+  const int           nDetectors = sizeof( names ) / sizeof( names[0] );
+
+  AudioMemory( 8 );
+  static BenchSource           source;
+  static AudioAnalyzePeak      peak;
+  static AudioAnalyzeHeartBeat beat;
+  static AudioAnalyzeHeartRate rate;
+  static AudioEffectDecimate   decimate;
+  static AudioAnalyzeHeartBeat beat8;
+  static AudioAnalyzeHeartRate rate8;
+  static AudioConnection       cord1( source, peak );
+  static AudioConnection       cord2( source, beat );
+  static AudioConnection       cord3( source, rate );
+  static AudioConnection       cord4( source, decimate );
+  static AudioConnection       cord5( decimate, beat8 );
+  static AudioConnection       cord6( decimate, rate8 );
+
+  uint32_t blocks = COMPARE_SECONDS * AUDIO_SAMPLE_RATE_EXACT / AUDIO_BLOCK_SAMPLES;
+  uint32_t warmup = COMPARE_WARMUP * AUDIO_SAMPLE_RATE_EXACT / AUDIO_BLOCK_SAMPLES;
+
+  printf( "%d s per condition, host cycles\n\n", COMPARE_SECONDS );
+  printf( "%-8s %-11s %11s %12s %10s %14s %10s %10s %8s\n", "signal", "detector", "mean/update",
+          "p99.9/update", "estimates", "per estimate", "within 5%", "last bpm", "conf" );
+  for ( unsigned int c = 0; c < sizeof( conditions ) / sizeof( conditions[0] ); c++ ) {
+    HeartSound hs = { 0.0, conditions[c].bpm, 1u, conditions[c].noise, conditions[c].murmur };
+    DetectorStats st[nDetectors];
+    memset( st, 0, sizeof( st ) );
+    for ( int d = 0; d < nDetectors; d++ ) st[d].perUpdate = (uint32_t *)malloc( blocks * sizeof( uint32_t ) );
+    source.hs = &hs;
+    beat.reset();
+    rate.reset();
+    decimate.factor( 8 );
+    beat8.decimation( 8 );
+    rate8.decimation( 8 );
+
+    for ( uint32_t b = 0; b < blocks; b++ ) {
+      bool warm = b >= warmup;
+      source.update();
+      timedUpdate( peak, st[0] );
+      if ( peak.available() ) peak.read();
+      timedUpdate( beat, st[1] );
+      if ( beat.available() ) score( st[1], beat.read(), hs.bpm, warm );
+      timedUpdate( rate, st[2] );
+      if ( rate.available() ) {
+        score( st[2], rate.read(), hs.bpm, warm );
+        if ( warm ) st[2].confidence += rate.confidence();
+      }
+      timedUpdate( decimate, st[3] );
+      timedUpdate( beat8, st[4] );
+      if ( beat8.available() ) score( st[4], beat8.read(), hs.bpm, warm );
+      timedUpdate( rate8, st[5] );
+      if ( rate8.available() ) {
+        score( st[5], rate8.read(), hs.bpm, warm );
+        if ( warm ) st[5].confidence += rate8.confidence();
+      }
+    }
+
+    for ( int d = 0; d < nDetectors; d++ ) {
+      printf( "%-8s %-11s %11.0f %12u", conditions[c].name, names[d],
+              (double)st[d].cycles / blocks, (unsigned)highCycles( st[d] ) );
+      if ( d == 0 || d == 3 ) {
+        printf( " %10s %14s %10s %10s %8s\n", "-", "-", "-", "-", "-" );
+        continue;
+      }
+      printf( " %10u %14.0f %9.0f%% %10.1f", (unsigned)st[d].estimates,
+              st[d].estimates ? (double)st[d].cycles / st[d].estimates : 0.0,
+              st[d].scored ? 100.0 * st[d].good / st[d].scored : 0.0, st[d].last );
+      if ( ( d == 2 || d == 5 ) && st[d].scored ) printf( " %8.2f\n", st[d].confidence / st[d].scored );
+      else printf( " %8s\n", "-" );
+    }
+    for ( int d = 0; d < nDetectors; d++ ) free( st[d].perUpdate );
+  }
+
+  // The decimator alone, fed tones, its output taken from a record queue
+  static const int     ratios[] = { 4, 8, 10 };
+  static AudioRecordQueue queue;
+  static AudioConnection  cord7( decimate, queue );
+  static uint32_t         perUpdate[TONE_BLOCKS];
+  DetectorStats           st;
+
+  printf( "\n%-8s %12s %12s %14s %10s %10s %10s\n", "ratio", "mean/update", "p99.9/update", "out rate Hz",
+          "200 Hz dB", "1 kHz dB", "alias dB" );
+  for ( unsigned int r = 0; r < sizeof( ratios ) / sizeof( ratios[0] ); r++ ) {
+    double outRate = AUDIO_SAMPLE_RATE_EXACT / ratios[r];
+    double tones[] = { 200.0, 1000.0, outRate - 200.0 };
+    double gainDb[3];
+    memset( &st, 0, sizeof( st ) );
+    st.perUpdate = perUpdate;
+    for ( int k = 0; k < 3; k++ ) {
+      decimate.factor( ratios[r] );
+      queue.decimation( ratios[r] );
+      queue.begin();
+      source.tone = tones[k];
+      source.t    = 0.0;
+      double   power = 0.0;
+      uint32_t n     = 0;
+      for ( int b = 0; b < TONE_BLOCKS; b++ ) {
+        source.update();
+        if ( k == 0 ) timedUpdate( decimate, st );
+        else decimate.update();
+        queue.update();
+        while ( queue.available() > 0 ) {
+          const int16_t * p = queue.readBuffer();
+          if ( b >= TONE_BLOCKS / 4 ) {                 // past the filter's start
+            for ( int i = 0; i < AUDIO_BLOCK_SAMPLES; i++ ) power += (double)p[i] * p[i];
+            n += AUDIO_BLOCK_SAMPLES;
+          }
+          queue.freeBuffer();
+        }
+      }
+      queue.end();
+      gainDb[k] = n && power > 0.0 ? 10.0 * log10( power / n / ( 16384.0 * 16384.0 / 2 ) ) : -200.0;
+    }
+    printf( "%-8d %12.0f %12u %14.1f %10.2f %10.2f %10.1f\n", ratios[r], (double)st.cycles / TONE_BLOCKS,
+            (unsigned)highCycles( st ), outRate, gainDb[0], gainDb[1], gainDb[2] );
+  }
+  source.tone = 0.0;
+}
+
+// ==============================================================================================================
+// File transfer receiver
+//
+// The host side of GETFILE: parses the chunk stream the sketch writes to the
+// Bluetooth UART, checks sequence numbers and CRCs, and answers with FILEACK /
+// FILENAK the way the tablet application would, after a fixed link latency.
+// ============================================================================================================== //
+
+#define XFER_FILE_SIZE  40000
+#define XFER_LATENCY_US 20000
+
+struct Receiver {
+  bool      active;
+  bool      corrupt;                            // damage chunk 3 once
+  char      file[32];
+  uint8_t   buf[1024];
+  size_t    have;
+  bool      header;                             // ACK + size + offset seen
+  uint32_t  size;
+  uint32_t  expected;                           // next chunk in sequence
+  uint32_t  nakFor;                             // chunk last asked for with FILENAK
+  uint8_t * data;
+  size_t    got;
+  uint32_t  started;
+  unsigned  crcErrors, naks, duplicates;
+};
+
+static Receiver rx;
+
+static uint32_t crc32Host( const uint8_t * p, size_t n ) {
+  uint32_t crc = 0xFFFFFFFF;
+  while ( n-- ) {
+    crc ^= *p++;
+    for ( int k = 0; k < 8; k++ ) crc = ( crc >> 1 ) ^ ( 0xEDB88320 & -( crc & 1 ) );
+  }
+  return ~crc;
+}
+
+static uint32_t getLE( const uint8_t * p, int n ) {
+  uint32_t v = 0;
+  for ( int i = n - 1; i >= 0; i-- ) v = ( v << 8 ) | p[i];
+  return v;
+}
+
+static void receiverReply( uint8_t opcode, uint32_t seq ) {
+  char msg[16];
+  int n = snprintf( msg, sizeof( msg ), "%c%u\n", opcode, (unsigned)seq );
+  Serial1.inject( (const uint8_t *)msg, n, micros() + XFER_LATENCY_US );
+}
+
+static void receiverStart( const char * file, bool corrupt ) {
+  char path[512];
+  host_sd_path( file, path, sizeof( path ) );
+  if ( access( path, F_OK ) != 0 ) {
+    FILE * fp = fopen( path, "wb" );
+    uint32_t seed = 7;
+    for ( int i = 0; fp && i < XFER_FILE_SIZE; i++ ) {
+      seed = seed * 1664525 + 1013904223;
+      fputc( seed >> 24, fp );
+    }
+    if ( fp ) fclose( fp );
+  }
+  uint8_t stale[64];
+  while ( Serial1.takeOutput( stale, sizeof( stale ) ) ) ;
+  free( rx.data );
+  memset( &rx, 0, sizeof( rx ) );
+  rx.active  = true;
+  rx.corrupt = corrupt;
+  rx.nakFor  = 0xFFFFFFFF;
+  rx.started = micros();
+  snprintf( rx.file, sizeof( rx.file ), "%s", file );
+
+  uint8_t cmd[40];
+  int n = snprintf( (char *)cmd, sizeof( cmd ), "%c%s\n", 0x34, file );
+  Serial1.inject( cmd, n, micros() );
+}
+
+static void receiverFinish( bool ok ) {
+  char path[512];
+  host_sd_path( rx.file, path, sizeof( path ) );
+  FILE * fp = fopen( path, "rb" );
+  uint8_t * ref = (uint8_t *)malloc( rx.size + 1 );
+  bool same = fp && fread( ref, 1, rx.size, fp ) == rx.size && rx.got == rx.size && memcmp( ref, rx.data, rx.size ) == 0;
+  if ( fp ) fclose( fp );
+  free( ref );
+  double secs = ( micros() - rx.started ) / 1e6;
+  printf( "\n  transfer %s: %s, %u B in %.2f s (%.1f kB/s), crc errors %u, naks %u, duplicates %u",
+          rx.file, ok && same ? "verified" : "FAILED", (unsigned)rx.got, secs,
+          rx.got / secs / 1000.0, rx.crcErrors, rx.naks, rx.duplicates );
+  if ( !( ok && same ) ) failures++;
+  rx.active = false;
+}
+
+// Consume whatever the sketch has transmitted since the last call
+static void receiverPoll( void ) {
+  while ( rx.active ) {
+    size_t n = Serial1.takeOutput( rx.buf + rx.have, sizeof( rx.buf ) - rx.have );
+    rx.have += n;
+    if ( !rx.have ) return;
+
+    size_t used = 0;
+    if ( !rx.header ) {
+      if ( rx.buf[0] == 0x15 ) {                // NAK: no such file
+        receiverFinish( false );
+        return;
+      }
+      if ( rx.buf[0] != 0x06 ) used = 1;
+      else if ( rx.have >= 9 ) {
+        rx.size   = getLE( rx.buf + 1, 4 ) - getLE( rx.buf + 5, 4 );
+        rx.data   = (uint8_t *)malloc( rx.size + 1 );
+        rx.header = true;
+        used      = 9;
+      }
+    } else if ( rx.buf[0] == 0x04 ) {           // EOT
+      receiverFinish( true );
+      return;
+    } else if ( rx.buf[0] != 0x01 ) {           // not at a frame: resynchronise on SOH
+      used = 1;
+    } else if ( rx.have >= 7 ) {
+      uint32_t seq = getLE( rx.buf + 1, 4 );
+      uint32_t len = getLE( rx.buf + 5, 2 );
+      if ( len > 512 ) used = 1;
+      else if ( rx.have >= 7 + len + 4 ) {
+        used = 7 + len + 4;
+        if ( rx.corrupt && seq == 3 ) {
+          rx.buf[7] ^= 0xFF;
+          rx.corrupt = false;
+        }
+        bool good = crc32Host( rx.buf + 1, 6 + len ) == getLE( rx.buf + 7 + len, 4 );
+        if ( !good ) rx.crcErrors++;
+        if ( good && seq == rx.expected && (size_t)seq * 512 + len <= rx.size ) {
+          memcpy( rx.data + seq * 512, rx.buf + 7, len );
+          rx.got += len;
+          rx.expected++;
+          receiverReply( 0x35, seq );
+        } else if ( good && seq < rx.expected ) {
+          rx.duplicates++;
+        } else if ( rx.nakFor != rx.expected ) {    // ask once for the missing chunk
+          rx.nakFor = rx.expected;
+          rx.naks++;
+          receiverReply( 0x36, rx.expected );
+        }
+      }
+    }
+    if ( !used ) {
+      if ( n == 0 ) return;                     // incomplete, wait for more
+      continue;
+    }
+    rx.have -= used;
+    memmove( rx.buf, rx.buf + used, rx.have );
+  }
+}
+
+// ==============================================================================================================
+// Telemetry check
+//
+// Finds the telemetry frames ( see Telemetry.h ) in what the sketch sent over
+// bluetooth, checks their CRC and walks every record, the way the viewer does.
+// ============================================================================================================== //
+
+struct TelemetryCheck {
+  unsigned frames, records, crcErrors, bad, gaps;
+  unsigned long bytes;
+};
+
+static TelemetryCheck telemetryCheck( const uint8_t * p, size_t n ) {
+  TelemetryCheck tc;
+  memset( &tc, 0, sizeof( tc ) );
+  int    seq = -1;
+  size_t i   = 0;
+  while ( i + 12 + 4 <= n ) {
+    size_t len = getLE( p + i + 10, 2 );
+    if ( p[i] != 0x02 || i + 12 + len + 4 > n ) {
+      i++;
+      continue;
+    }
+    if ( crc32Host( p + i + 1, 11 + len ) != getLE( p + i + 12 + len, 4 ) ) {
+      tc.crcErrors++;
+      i++;
+      continue;
+    }
+    const uint8_t * r   = p + i + 12;
+    const uint8_t * end = r + len;
+    unsigned count = p[i + 9];
+    for ( unsigned k = 0; k < count && r + 2 <= end; k++ ) {
+      unsigned mask = getLE( r, 2 );
+      r += 2;
+      for ( ; mask; mask &= mask - 1 ) {
+        while ( r < end && *r & 0x80 ) r++;
+        r++;
+      }
+      tc.records++;
+    }
+    if ( r != end ) tc.bad++;
+    int s = getLE( p + i + 1, 2 );
+    if ( seq >= 0 && s != ( ( seq + 1 ) & 0xFFFF ) ) tc.gaps++;
+    seq = s;
+    tc.frames++;
+    tc.bytes += 12 + len + 4;
+    i += 12 + len + 4;
+  }
+  return tc;
+}
+
+// ==============================================================================================================
+// Recording check
+//
+// A recording on the card, after STOPREC: the RIFF size and the data chunk's
+// size must agree with the file's length, which recordClose() sets.
+// ============================================================================================================== //
+
+static void wavCheck( const char * file, uint32_t minBytes ) {
+  char path[512];
+  host_sd_path( file, path, sizeof( path ) );
+  FILE *   fp   = fopen( path, "rb" );
+  uint8_t  head[4096];
+  size_t   n    = fp ? fread( head, 1, sizeof( head ), fp ) : 0;
+  long     size = 0;
+  if ( fp ) {
+    fseek( fp, 0, SEEK_END );
+    size = ftell( fp );
+    fclose( fp );
+  }
+  uint32_t riff = n >= 12 && memcmp( head, "RIFF", 4 ) == 0 ? getLE( head + 4, 4 ) + 8 : 0;
+  uint32_t data = 0, at = 0;
+  for ( size_t i = 12; i + 8 <= n; i += 8 + getLE( head + i + 4, 4 ) ) {
+    if ( memcmp( head + i, "data", 4 ) == 0 ) {
+      data = getLE( head + i + 4, 4 );
+      at   = i + 8;
+      break;
+    }
+  }
+  bool ok = riff == (uint32_t)size && at && at + data == (uint32_t)size && data >= minBytes;
+  printf( "\n  wav %s: %s, %ld B, RIFF %u B, %u B of data at %u", file, ok ? "consistent" : "FAILED", size,
+          (unsigned)riff, (unsigned)data, (unsigned)at );
+  if ( !ok ) failures++;
+}
+
+// ==============================================================================================================
+// Codec check
+//
+// Every sample the sketch hands a recording's codec is kept ( see recordTap,
+// FileSD.h ).  Once the scenario has run, the recording is decoded with the
+// Python decoder and compared with them: lossless must match exactly, the
+// lossy codecs must keep the error a given number of dB below the signal.
+// Paths are relative to HostSim, like the default sdcard.
+// ============================================================================================================== //
+
+#define DECODE_RECORDING  "../../Python/Stethoscope/decodeRecording.py"
+#define DECODE_EXACT      0xFFFFFFFF
+
+static int16_t * tapped    = NULL;
+static size_t    tappedLen = 0;
+static size_t    tappedCap = 0;
+
+static void tapSamples( const int16_t * src, int n ) {
+  if ( tappedLen + n > tappedCap ) {
+    tappedCap = ( tappedLen + n ) * 2;
+    tapped    = (int16_t *)realloc( tapped, tappedCap * sizeof( int16_t ) );
+  }
+  memcpy( tapped + tappedLen, src, n * sizeof( int16_t ) );
+  tappedLen += n;
+}
+
+static void decodeCheck( const char * file, uint32_t minDb ) {
+  char path[512], pcm[64], cmd[1200];
+  host_sd_path( file, path, sizeof( path ) );
+  snprintf( pcm, sizeof( pcm ), "/tmp/bench_loop_%d.wav", (int)getpid() );
+  snprintf( cmd, sizeof( cmd ), "python3 %s '%s' %s > /dev/null", DECODE_RECORDING, path, pcm );
+  bool decoded = system( cmd ) == 0;
+
+  // the decoder writes a plain 44 byte header
+  FILE *    fp  = decoded ? fopen( pcm, "rb" ) : NULL;
+  int16_t * out = NULL;
+  size_t    n   = 0;
+  if ( fp ) {
+    fseek( fp, 0, SEEK_END );
+    long len = ftell( fp ) - 44;
+    fseek( fp, 44, SEEK_SET );
+    out = (int16_t *)malloc( len > 0 ? len : 2 );
+    n   = len > 0 ? fread( out, 2, len / 2, fp ) : 0;
+    fclose( fp );
+  }
+  unlink( pcm );
+
+  double   signal = 0.0, error = 0.0;
+  unsigned differ = 0;
+  for ( size_t i = 0; i < n && i < tappedLen; i++ ) {
+    double d = (double)out[i] - tapped[i];
+    signal += (double)tapped[i] * tapped[i];
+    error  += d * d;
+    if ( d != 0.0 ) differ++;
+  }
+  double db = error > 0.0 ? 10.0 * log10( signal / error ) : 999.0;
+  bool   ok = decoded && n == tappedLen && n > 0 &&
+              ( minDb == DECODE_EXACT ? differ == 0 : db >= (double)minDb );
+  printf( "\n  decode %s: %s, %u of %u samples, %u differ, %.1f dB", file, ok ? "matches" : "FAILED",
+          (unsigned)n, (unsigned)tappedLen, differ, db );
+  if ( !ok ) failures++;
+  free( out );
+}
+
+// ==============================================================================================================
+// Stream check
+//
+// Finds the live audio packets ( see LiveStream.h ) in what the sketch sent and
+// checks their CRC; a SYN only starts a packet when its header is plausible.
+// ============================================================================================================== //
+
+struct StreamCheck {
+  unsigned packets, crcErrors, gaps;
+};
+
+static StreamCheck streamCheck( const uint8_t * p, size_t n ) {
+  StreamCheck sc;
+  memset( &sc, 0, sizeof( sc ) );
+  int    seq = -1;
+  size_t i   = 0;
+  while ( i + 9 + 4 <= n ) {
+    size_t len    = getLE( p + i + 7, 2 );
+    int    codec  = p[i + 3];
+    int    factor = p[i + 4];
+    if ( p[i] != 0x16 || ( codec != 1 && codec != 2 ) || factor < 6 || factor > 11 || len > 256 ||
+         i + 9 + len + 4 > n ) {
+      i++;
+      continue;
+    }
+    if ( crc32Host( p + i + 1, 8 + len ) != getLE( p + i + 9 + len, 4 ) ) {
+      sc.crcErrors++;
+      i++;
+      continue;
+    }
+    int s = getLE( p + i + 1, 2 );
+    if ( seq >= 0 && s != 0 && s != ( ( seq + 1 ) & 0xFFFF ) ) sc.gaps++;       // 0: a new STARTSTREAM
+    seq = s;
+    sc.packets++;
+    i += 9 + len + 4;
+  }
+  return sc;
+}
+
+// ==============================================================================================================
+// Script replay
+// ============================================================================================================== //
+
+struct Action {
+  uint32_t at_ms;
+  char     what;                                // 'p' play, 'g' get, 'a' prealloc, 'w' wav, 'd' decode
+  bool     corrupt;
+  uint32_t bytes;
+  char     file[32];
+};
+
+static uint32_t codecCyclesSeen = 0;
+static float    heartRateSeen   = 0;
+static uint32_t soundStartsSeen = 0;
+static bool     bootSeen        = false;
+static uint32_t heapSeen        = 0;
+static uint32_t telemetrySeen   = 0;
+static uint32_t streamSeen      = 0;
+static int      btCopy          = -1;           // -o
+
+// Rate of the host cycle counter behind ARM_DWT_CYCCNT, measured once
+static double hostCyclesPerSecond( void ) {
+  static double rate = 0.0;
+  if ( rate == 0.0 ) {
+    struct timespec t0, t1;
+    clock_gettime( CLOCK_MONOTONIC, &t0 );
+    uint32_t c0 = host_cycles();
+    do clock_gettime( CLOCK_MONOTONIC, &t1 );
+    while ( ( t1.tv_sec - t0.tv_sec ) * 1000000000LL + ( t1.tv_nsec - t0.tv_nsec ) < 20000000LL );
+    uint32_t c1 = host_cycles();
+    rate = ( c1 - c0 ) / ( ( t1.tv_sec - t0.tv_sec ) + ( t1.tv_nsec - t0.tv_nsec ) / 1e9 );
+  }
+  return rate;
+}
+
+static bool runScript( const char * name, const char * script ) {
+  uint32_t base      = micros();
+  uint32_t end_ms    = 0;
+  Action   acts[16];
+  int      nacts     = 0;
+
+  // Schedule every event relative to the start of the scenario
+  const char * line = script;
+  while ( *line ) {
+    const char * eol = strchr( line, '\n' );
+    size_t len = eol ? (size_t)( eol - line ) : strlen( line );
+    char buf[256];
+    if ( len >= sizeof( buf ) ) len = sizeof( buf ) - 1;
+    memcpy( buf, line, len );
+    buf[len] = 0;
+    line += eol ? len + 1 : len;
+
+    char * p = buf;
+    while ( isspace( (unsigned char)*p ) ) p++;
+    if ( *p == '#' || *p == 0 ) continue;
+    uint32_t at = strtoul( p, &p, 10 );
+    while ( isspace( (unsigned char)*p ) ) p++;
+    if ( strncmp( p, "end", 3 ) == 0 ) {
+      end_ms = at;
+      continue;
+    }
+    if ( strncmp( p, "play", 4 ) == 0 || strncmp( p, "get", 3 ) == 0 || strncmp( p, "prealloc", 8 ) == 0 ||
+         strncmp( p, "wav", 3 ) == 0 || strncmp( p, "decode", 6 ) == 0 ) {
+      if ( nacts < 16 ) {
+        Action & a = acts[nacts++];
+        a.at_ms   = at;
+        a.what    = p[1] == 'r' ? 'a' : p[0];
+        a.corrupt = strstr( p, "corrupt" ) != NULL;
+        a.bytes   = 0;
+        a.file[0] = 0;
+        while ( *p && !isspace( (unsigned char)*p ) ) p++;
+        if ( a.what == 'a' ) a.bytes = strtoul( p, NULL, 10 );
+        else if ( a.what == 'd' ) {
+          char db[16] = "";
+          sscanf( p, " %31s %15s", a.file, db );
+          a.bytes = strcmp( db, "exact" ) == 0 ? DECODE_EXACT : strtoul( db, NULL, 10 );
+        }
+        else sscanf( p, " %31s %u", a.file, &a.bytes );
+      }
+      if ( at > end_ms ) end_ms = at;
+      continue;
+    }
+    uint8_t bytes[256];
+    size_t n = 0;
+    while ( *p && n < sizeof( bytes ) ) {
+      if ( *p == '"' ) {
+        p++;
+        while ( *p && *p != '"' && n < sizeof( bytes ) ) bytes[n++] = *p++;
+        if ( *p == '"' ) p++;
+      } else if ( isxdigit( (unsigned char)*p ) ) {
+        bytes[n++] = strtoul( p, &p, 16 );
+      } else {
+        p++;
+      }
+    }
+    Serial1.inject( bytes, n, base + at * 1000 );
+    if ( at > end_ms ) end_ms = at;
+  }
+
+  printf( "scenario %-10s %6u ms ...", name, end_ms );
+  fflush( stdout );
+
+  uint64_t blocked  = host_blocked_us();
+  uint32_t updates  = host_audio_updates();
+  unsigned long con = Serial.bytes_written;
+  unsigned long bt  = Serial1.bytes_written;
+  int      next     = 0;
+  uint64_t skipped  = 0;
+
+  while ( (int32_t)( micros() - ( base + end_ms * 1000 ) ) < 0 ) {
+    host_service();
+    while ( next < nacts && (int32_t)( micros() - ( base + acts[next].at_ms * 1000 ) ) >= 0 ) {
+      const Action & a = acts[next++];
+      if ( a.what == 'g' ) receiverStart( a.file, a.corrupt );
+      else if ( a.what == 'p' ) hostSketchStartPlaying( a.file );
+      else if ( a.what == 'a' ) hostSketchRecordPrealloc( a.bytes );
+      else if ( a.what == 'w' ) wavCheck( a.file, a.bytes );
+    }
+    receiverPoll();
+    if ( btCopy >= 0 && !rx.active ) {
+      uint8_t copy[256];
+      size_t  n;
+      while ( ( n = Serial1.takeOutput( copy, sizeof( copy ) ) ) > 0 ) {
+        if ( write( btCopy, copy, n ) != (ssize_t)n ) break;
+      }
+    }
+
+    int m = hostSketchMode();
+    uint64_t t0 = host_nanos();
+    loop();
+    uint64_t dt = host_nanos() - t0;
+    record( modeHist[m & 7], dt );
+
+    // Nothing to do while idle: skip ahead to the next scripted event, in
+    // steps of at most 1 ms so that the sketch's own timeouts still see time
+    // passing.  Skipped time is not counted as blocked.  With -o the reader
+    // on the other side keeps real time, so the wait is slept instead.
+    if ( hostSketchMode() == 0 && Serial1.available() == 0 ) {
+      uint32_t now  = micros();
+      uint32_t wake = now + 1000;
+      uint32_t rx   = Serial1.nextArrival();
+      if ( rx && (int32_t)( rx - wake ) < 0 ) wake = rx;
+      if ( (int32_t)( wake - now ) > 0 && btCopy >= 0 ) {
+        usleep( wake - now );
+      } else if ( (int32_t)( wake - now ) > 0 ) {
+        host_advance_us( wake - now );
+        skipped += wake - now;
+      }
+    }
+  }
+
+  if ( rx.active ) receiverFinish( false );
+  for ( int i = 0; i < nacts; i++ ) {
+    if ( acts[i].what == 'd' ) decodeCheck( acts[i].file, acts[i].bytes );
+  }
+  tappedLen = 0;
+  static uint8_t out[65536];
+  size_t         sent = Serial1.takeOutput( out, sizeof( out ) );
+
+  printf( " blocked %7.1f ms, %5u audio updates, console %7lu B, bt %5lu B\n",
+          ( host_blocked_us() - blocked - skipped ) / 1000.0,
+          host_audio_updates() - updates,
+          Serial.bytes_written - con,
+          Serial1.bytes_written - bt );
+
+  // Boot phase times, from the sketch's own marks ( see Boot.h ), once all are in
+  const char * phase;
+  int          phases = 0;
+  while ( hostSketchBootAt( phases, &phase ) ) phases++;
+  if ( !bootSeen && !phase ) {
+    printf( "  boot:" );
+    for ( int i = 0; i < phases; i++ ) {
+      hostSketchBootAt( i, &phase );
+      printf( "%s %s %.1f ms", i ? "," : "", phase, hostSketchBootAt( i, &phase ) / 1000.0 );
+    }
+    printf( "\n" );
+    bootSeen = true;
+  }
+
+  // Telemetry frames, decoded from the bytes the sketch sent
+  uint32_t frames, dropped;
+  uint32_t records = hostSketchTelemetry( &frames, &dropped );
+  if ( records != telemetrySeen ) {
+    TelemetryCheck tc = telemetryCheck( out, sent );
+    printf( "  telemetry: %u records in %u frames, %u dropped; decoded %u records in %u frames, %u crc errors, "
+            "%u malformed, %u gaps, %.1f B per record\n",
+            (unsigned)records, (unsigned)frames, (unsigned)dropped, tc.records, tc.frames, tc.crcErrors, tc.bad,
+            tc.gaps, tc.records ? (double)tc.bytes / tc.records : 0.0 );
+    failures += tc.crcErrors + tc.bad;
+    if ( btCopy < 0 && tc.frames != frames ) failures++;      // with -o the frames went to the file
+  }
+  telemetrySeen = records;
+
+  // Live audio packets
+  uint32_t streamDropped;
+  uint32_t packets = hostSketchStream( &streamDropped );
+  if ( packets != streamSeen ) {
+    StreamCheck sc = streamCheck( out, sent );
+    printf( "  stream: %u packets, %u dropped; decoded %u packets, %u crc errors, %u gaps\n",
+            (unsigned)packets, (unsigned)streamDropped, sc.packets, sc.crcErrors, sc.gaps );
+    failures += sc.crcErrors;
+    if ( btCopy < 0 && sc.packets < packets ) failures++;        // the sketch counts from its last STARTSTREAM
+  }
+  streamSeen = packets;
+
+  // Audio block pool high-water mark and interrupt overruns during the scenario ( see AUDIOSTATS )
+  int      pool;
+  uint32_t overruns, late;
+  int      poolMax = hostSketchAudioLoad( &pool, &overruns, &late );
+  printf( "  audio: %d of %d blocks at most, %u overruns, %u late passes\n",
+          poolMax, pool, (unsigned)overruns, (unsigned)late );
+
+  // Heap in use, from the sketch's heap monitor ( whole process on the host ), when it has moved
+  uint32_t usedPeak, fragmented;
+  uint32_t used = hostSketchHeap( &usedPeak, &fragmented );
+  if ( used != heapSeen ) {
+    printf( "  heap: used %u (%+d), peak %u, fragmented %u bytes\n",
+            (unsigned)used, heapSeen ? (int)( used - heapSeen ) : 0, (unsigned)usedPeak, (unsigned)fragmented );
+  }
+  heapSeen = used;
+
+  // Recording codec cost, per audio block, from the sketch's own counters
+  uint32_t cyclesMax, blocks;
+  double   ratio;
+  uint32_t cycles = hostSketchCodecStats( &cyclesMax, &blocks, &ratio );
+  if ( blocks && cycles != codecCyclesSeen ) {
+    printf( "  encode: %u blocks, mean %u, max %u host cycles per block, %.0f blocks/s, ratio %.2f:1\n",
+            (unsigned)blocks, (unsigned)( cycles / blocks ), (unsigned)cyclesMax,
+            cycles ? (double)blocks * hostCyclesPerSecond() / cycles : 0.0, ratio );
+  }
+  codecCyclesSeen = cycles;
+
+  // Sound start times, from the sketch's own counters ( SD card, then flash )
+  uint32_t mean[2], max[2], starts[2];
+  int      inFlash;
+  for ( int k = 0; k < 2; k++ ) starts[k] = hostSketchSoundStarts( k, &mean[k], &max[k], &inFlash );
+  if ( starts[0] + starts[1] != soundStartsSeen ) {
+    printf( "  sound starts since boot: sd %u (mean %u, max %u us), flash %u (mean %u, max %u us), %d sounds in flash\n",
+            (unsigned)starts[0], (unsigned)mean[0], (unsigned)max[0],
+            (unsigned)starts[1], (unsigned)mean[1], (unsigned)max[1], inFlash );
+  }
+  soundStartsSeen = starts[0] + starts[1];
+
+  if ( hostSketchHeartRate() != heartRateSeen ) {
+    heartRateSeen = hostSketchHeartRate();
+    printf( "  heart rate: %.1f bpm\n", heartRateSeen );
+  }
+  return true;
+}
+
+static char * readFile( const char * path ) {
+  FILE * fp = fopen( path, "rb" );
+  if ( !fp ) return NULL;
+  fseek( fp, 0, SEEK_END );
+  long len = ftell( fp );
+  fseek( fp, 0, SEEK_SET );
+  char * buf = (char *)malloc( len + 1 );
+  if ( fread( buf, 1, len, fp ) != (size_t)len ) len = 0;
+  buf[len] = 0;
+  fclose( fp );
+  return buf;
+}
+
+static void report( void ) {
+  static const char * names[] = { "idle", "record", "play", "monitor", "thru", "blend", "xfer", "7" };
+  printf( "\n%-8s %10s %10s %10s %10s %10s %10s %10s\n",
+          "mode", "iters", "mean us", "p50 us", "p90 us", "p99 us", "p99.9 us", "max us" );
+  for ( int m = 0; m < 8; m++ ) {
+    const Histogram & h = modeHist[m];
+    if ( !h.count ) continue;
+    printf( "%d %-6s %10llu %10.2f %10.2f %10.2f %10.2f %10.2f %10.2f\n",
+            m, names[m], (unsigned long long)h.count,
+            h.total_ns / 1000.0 / h.count,
+            percentileUs( h, 0.50 ), percentileUs( h, 0.90 ),
+            percentileUs( h, 0.99 ), percentileUs( h, 0.999 ),
+            h.max_ns / 1000.0 );
+  }
+
+  printf( "\n%-8s %10s %10s %10s %10s %10s %10s\n",
+          "audio", "updates", "objects", "mean cyc", "max cyc", "blocks", "max blk" );
+  for ( int m = 0; m < 8; m++ ) {
+    const AudioCost & a = modeAudio[m];
+    if ( !a.updates ) continue;
+    printf( "%d %-6s %10llu %10.1f %10.0f %10llu %10.2f %10llu\n",
+            m, names[m], (unsigned long long)a.updates,
+            (double)a.active / a.updates, (double)a.cycles / a.updates,
+            (unsigned long long)a.cyclesMax, (double)a.blocks / a.updates,
+            (unsigned long long)a.blocksMax );
+  }
+}
+
+// ==============================================================================================================
+// Main
+// ============================================================================================================== //
+
+int main( int argc, char ** argv ) {
+  const char * which  = "all";
+  const char * script = NULL;
+  const char * audio  = NULL;
+  const char * sdroot = "sdcard";
+  const char * flash  = NULL;
+  bool         detect = false;
+  bool         whole  = false;
+  int c;
+
+  while ( ( c = getopt( argc, argv, "s:f:a:d:F:o:vrG" ) ) != -1 ) {
+    switch ( c ) {
+      case 's': which  = optarg; break;
+      case 'f': script = optarg; break;
+      case 'a': audio  = optarg; break;
+      case 'd': sdroot = optarg; break;
+      case 'F': flash  = optarg; break;
+      case 'o':
+        btCopy = open( optarg, O_WRONLY | O_CREAT | O_TRUNC | O_NOCTTY, 0644 );
+        if ( btCopy < 0 ) {
+          fprintf( stderr, "cannot open %s\n", optarg );
+          return 1;
+        }
+        break;
+      case 'v': Serial.echo = true; break;
+      case 'r': detect = true; break;
+      case 'G': whole  = true; break;
+      default:
+        fprintf( stderr, "usage: %s [-s scenario] [-f script] [-a audio.raw] [-d sdroot] [-F flash.img] [-o file] [-v] [-r] [-G]\n", argv[0] );
+        return 1;
+    }
+  }
+
+  if ( detect ) {
+    compareDetectors();
+    return 0;
+  }
+
+  host_sd_root( sdroot );
+  if ( flash ) host_flash_image( flash );
+
+  static HeartSound hs = { 0.0, 72.0, 1u, 0.01, 0.0 };
+  static RawSource  rs = { NULL, 0, 0 };
+  if ( audio ) {
+    FILE * fp = fopen( audio, "rb" );
+    if ( !fp ) {
+      fprintf( stderr, "cannot open %s\n", audio );
+      return 1;
+    }
+    fseek( fp, 0, SEEK_END );
+    rs.len  = ftell( fp ) / 2;
+    fseek( fp, 0, SEEK_SET );
+    rs.data = (int16_t *)malloc( rs.len * 2 + 2 );
+    rs.len  = fread( rs.data, 2, rs.len, fp );
+    fclose( fp );
+    if ( !rs.len ) rs.data[rs.len++] = 0;
+    host_set_audio_source( rawSource, &rs );
+  } else {
+    host_set_audio_source( heartSource, &hs );
+  }
+
+  prepareSoundLibrary();
+  if ( whole ) hostSketchGraphManaged( false );
+  setup();
+  memset( modeHist, 0, sizeof( modeHist ) );
+  host_on_update( audioSample );
+  hostSketchRecordTap( tapSamples );
+
+  if ( script ) {
+    char * text = readFile( script );
+    if ( !text ) {
+      fprintf( stderr, "cannot read %s\n", script );
+      return 1;
+    }
+    runScript( script, text );
+    free( text );
+  } else {
+    bool any = false;
+    for ( unsigned int i = 0; i < sizeof( scenarios ) / sizeof( scenarios[0] ); i++ ) {
+      if ( strcmp( which, "all" ) && strcmp( which, scenarios[i].name ) ) continue;
+      runScript( scenarios[i].name, scenarios[i].script );
+      any = true;
+    }
+    if ( !any ) {
+      fprintf( stderr, "unknown scenario '%s'\n", which );
+      return 1;
+    }
+  }
+
+  report();
+  if ( failures ) {
+    printf( "\n%u checks failed\n", failures );
+    return 1;
+  }
+  return 0;
+}
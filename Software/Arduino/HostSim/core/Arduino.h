@@ -0,0 +1,83 @@
+/*
+ * Arduino.h (host simulation)
+ *
+ * Minimal stand-in for the Teensyduino core so that the Stethoscope sketch and
+ * the parts of the Teensy Audio library it uses can be compiled and profiled on
+ * a Linux host.  Only the subset of the core that the sketch touches is here.
+ *
+ * Time is virtual: micros()/millis() follow the host monotonic clock, while
+ * delay() and Stream timeouts advance the clock without sleeping.  Whenever the
+ * clock moves, the simulated audio interrupt is serviced (see HostSim.h).
+ */
+
+#ifndef Arduino_h
+#define Arduino_h
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <ctype.h>
+
+#ifndef F_CPU
+#define F_CPU 96000000
+#endif
+#ifndef TEENSYDUINO
+#define TEENSYDUINO 141
+#endif
+
+typedef uint8_t  byte;
+typedef bool     boolean;
+
+#define HIGH 1
+#define LOW  0
+#define INPUT  0
+#define OUTPUT 1
+
+#define DEC 10
+#define HEX 16
+#define OCT 8
+#define BIN 2
+
+#define DMAMEM
+#define FASTRUN
+#define PROGMEM
+#define IRQ_SOFTWARE 70
+
+// The audio "interrupt" only ever runs from the simulation scheduler, which
+// is itself driven from the main thread, so masking is a no-op here.
+#define __disable_irq() do { } while (0)
+#define __enable_irq()  do { } while (0)
+#define NVIC_DISABLE_IRQ(n) do { } while (0)
+#define NVIC_ENABLE_IRQ(n)  do { } while (0)
+
+uint32_t millis(void);
+uint32_t micros(void);
+
+// Cycle counter: the host's time-stamp counter on x86, nanoseconds elsewhere.
+// Counts are host cycles, not Cortex-M4 cycles.
+uint32_t host_cycles(void);
+#define ARM_DWT_CYCCNT host_cycles()
+void delay(uint32_t msec);
+void delayMicroseconds(uint32_t usec);
+void yield(void);
+
+void setup(void);
+void loop(void);
+
+static inline void pinMode(uint8_t pin, uint8_t mode) { (void)pin; (void)mode; }
+static inline void digitalWrite(uint8_t pin, uint8_t val) { (void)pin; (void)val; }
+static inline int digitalRead(uint8_t pin) { (void)pin; return LOW; }
+
+static inline boolean isDigit(int c) { return isdigit(c) != 0; }
+#define PI 3.1415926535897932384626433832795
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+
+#include "WString.h"
+#include "Print.h"
+#include "Stream.h"
+#include "HardwareSerial.h"
+#include "elapsedMillis.h"
+
+#endif
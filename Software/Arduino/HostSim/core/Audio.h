@@ -0,0 +1,34 @@
+/*
+ * Audio.h (host simulation)
+ *
+ * Replaces the library's umbrella header.  The objects the sketch uses are
+ * built from the real Audio library sources; only the I2S input and output,
+ * which are DMA driven on the Teensy, are host stand-ins (input_i2s.h and
+ * output_i2s.h in this directory).
+ */
+
+#ifndef Audio_h_
+#define Audio_h_
+
+#define AudioNoInterrupts() do { } while (0)
+#define AudioInterrupts()   do { } while (0)
+
+#include "analyze_heartbeat.h"
+#include "analyze_heartrate.h"
+#include "analyze_peak.h"
+#include "analyze_rms.h"
+#include "analyze_load.h"
+#include "control_sgtl5000.h"
+#include "effect_autogain.h"
+#include "effect_crossfade.h"
+#include "effect_decimate.h"
+#include "effect_rmsmatch.h"
+#include "filter_variable.h"
+#include "input_i2s.h"
+#include "mixer.h"
+#include "output_i2s.h"
+#include "play_sd_raw.h"
+#include "play_serialflash_raw.h"
+#include "record_queue.h"
+
+#endif
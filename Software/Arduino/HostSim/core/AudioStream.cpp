@@ -0,0 +1,222 @@
+/*
+ * AudioStream.cpp (host simulation)
+ *
+ * Port of the Teensyduino core implementation.  update_all() runs the update
+ * list directly; on the Teensy it is the body of the software interrupt.
+ */
+
+#include "Arduino.h"
+#include "AudioStream.h"
+#include "HostSim.h"
+
+#define MAX_AUDIO_MEMORY 229376
+#define NUM_MASKS  (((MAX_AUDIO_MEMORY / AUDIO_BLOCK_SAMPLES / 2) + 31) / 32)
+
+audio_block_t * AudioStream::memory_pool;
+uint32_t AudioStream::memory_pool_available_mask[NUM_MASKS];
+uint16_t AudioStream::memory_pool_first_mask;
+
+uint16_t AudioStream::cpu_cycles_total = 0;
+uint16_t AudioStream::cpu_cycles_total_max = 0;
+uint16_t AudioStream::memory_used = 0;
+uint16_t AudioStream::memory_used_max = 0;
+AudioStream * AudioStream::first_update = NULL;
+
+// host nanoseconds expressed as F_CPU clock cycles
+static inline uint32_t cycle_counter(void)
+{
+	return (uint32_t)(host_nanos() * (F_CPU / 1000000) / 1000);
+}
+
+void AudioStream::initialize_memory(audio_block_t *data, unsigned int num)
+{
+	unsigned int i;
+	unsigned int maxnum = MAX_AUDIO_MEMORY / AUDIO_BLOCK_SAMPLES / 2;
+
+	if (num > maxnum) num = maxnum;
+	memory_pool = data;
+	memory_pool_first_mask = 0;
+	for (i=0; i < NUM_MASKS; i++) {
+		memory_pool_available_mask[i] = 0;
+	}
+	for (i=0; i < num; i++) {
+		memory_pool_available_mask[i >> 5] |= (1 << (i & 0x1F));
+	}
+	for (i=0; i < num; i++) {
+		data[i].memory_pool_index = i;
+	}
+}
+
+audio_block_t * AudioStream::allocate(void)
+{
+	uint32_t n, index, avail;
+	uint32_t *p, *end;
+	audio_block_t *block;
+	uint32_t used;
+
+	p = memory_pool_available_mask;
+	end = p + NUM_MASKS;
+	index = memory_pool_first_mask;
+	p += index;
+	while (1) {
+		if (p >= end) return NULL;
+		avail = *p;
+		if (avail) break;
+		index++;
+		p++;
+	}
+	n = __builtin_clz(avail);
+	avail &= ~(0x80000000 >> n);
+	*p = avail;
+	if (!avail) index++;
+	memory_pool_first_mask = index;
+	used = memory_used + 1;
+	memory_used = used;
+	index = p - memory_pool_available_mask;
+	block = memory_pool + ((index << 5) + (31 - n));
+	block->ref_count = 1;
+	if (used > memory_used_max) memory_used_max = used;
+	return block;
+}
+
+void AudioStream::release(audio_block_t *block)
+{
+	uint32_t mask = (0x80000000 >> (31 - (block->memory_pool_index & 0x1F)));
+	uint32_t index = block->memory_pool_index >> 5;
+
+	if (block->ref_count > 1) {
+		block->ref_count--;
+	} else {
+		memory_pool_available_mask[index] |= mask;
+		if (index < memory_pool_first_mask) memory_pool_first_mask = index;
+		memory_used--;
+	}
+}
+
+void AudioStream::transmit(audio_block_t *block, unsigned char index)
+{
+	for (AudioConnection *c = destination_list; c != NULL; c = c->next_dest) {
+		if (c->src_index == index) {
+			if (c->dst.inputQueue[c->dest_index] == NULL) {
+				c->dst.inputQueue[c->dest_index] = block;
+				block->ref_count++;
+			}
+		}
+	}
+}
+
+audio_block_t * AudioStream::receiveReadOnly(unsigned int index)
+{
+	audio_block_t *in;
+
+	if (index >= num_inputs) return NULL;
+	in = inputQueue[index];
+	inputQueue[index] = NULL;
+	return in;
+}
+
+audio_block_t * AudioStream::receiveWritable(unsigned int index)
+{
+	audio_block_t *in, *p;
+
+	if (index >= num_inputs) return NULL;
+	in = inputQueue[index];
+	inputQueue[index] = NULL;
+	if (in && in->ref_count > 1) {
+		p = allocate();
+		if (p) memcpy(p->data, in->data, sizeof(p->data));
+		in->ref_count--;
+		in = p;
+	}
+	return in;
+}
+
+void AudioConnection::connect(void)
+{
+	AudioConnection *p;
+
+	if (isConnected) return;
+	if (dest_index > dst.num_inputs) return;
+	p = src.destination_list;
+	if (p == NULL) {
+		src.destination_list = this;
+	} else {
+		while (p->next_dest) {
+			if (&p->src == &this->src && &p->dst == &this->dst
+				&& p->src_index == this->src_index && p->dest_index == this->dest_index) {
+				//Source and destination already connected through another connection, abort
+				return;
+			}
+			p = p->next_dest;
+		}
+		p->next_dest = this;
+	}
+	this->next_dest = NULL;
+	src.numConnections++;
+	src.active = true;
+
+	dst.numConnections++;
+	dst.active = true;
+
+	isConnected = true;
+}
+
+void AudioConnection::disconnect(void)
+{
+	AudioConnection *p;
+
+	if (!isConnected) return;
+	if (dest_index > dst.num_inputs) return;
+	p = src.destination_list;
+	if (p == NULL) {
+		return;
+	} else if (p == this) {
+		src.destination_list = next_dest;
+	} else {
+		while (p->next_dest && p->next_dest != this) p = p->next_dest;
+		if (p->next_dest == this) p->next_dest = next_dest;
+	}
+	next_dest = NULL;
+
+	//Remove possible pending src block from destination
+	if (dst.inputQueue[dest_index] != NULL) {
+		AudioStream::release(dst.inputQueue[dest_index]);
+		dst.inputQueue[dest_index] = NULL;
+	}
+
+	//Check if the disconnected AudioStream objects should still be active
+	src.numConnections--;
+	if (src.numConnections == 0) {
+		src.active = false;
+	}
+
+	dst.numConnections--;
+	if (dst.numConnections == 0) {
+		dst.active = false;
+	}
+
+	isConnected = false;
+}
+
+void AudioStream::update_all(void)
+{
+	AudioStream *p;
+	uint32_t totalcycles;
+
+	totalcycles = cycle_counter();
+	for (p = AudioStream::first_update; p; p = p->next_update) {
+		if (p->active) {
+			uint32_t cycles = cycle_counter();
+			p->update();
+			// TODO: traverse inputQueueArray and release
+			// any input blocks that weren't consumed?
+			cycles = (cycle_counter() - cycles) >> 4;
+			p->cpu_cycles = cycles;
+			if (cycles > p->cpu_cycles_max) p->cpu_cycles_max = cycles;
+		}
+	}
+	totalcycles = (cycle_counter() - totalcycles) >> 4;
+	AudioStream::cpu_cycles_total = totalcycles;
+	if (totalcycles > AudioStream::cpu_cycles_total_max)
+		AudioStream::cpu_cycles_total_max = totalcycles;
+}
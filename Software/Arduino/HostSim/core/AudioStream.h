@@ -0,0 +1,133 @@
+/*
+ * AudioStream.h (host simulation)
+ *
+ * Mirrors the Teensyduino core AudioStream: same block pool, connection
+ * list and per-object cycle accounting, so Audio library objects compile and
+ * behave unchanged.  The cycle counter is derived from the host clock and
+ * scaled to F_CPU, which keeps processorUsage() in the familiar units.
+ */
+
+#ifndef AudioStream_h
+#define AudioStream_h
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define AUDIO_BLOCK_SAMPLES  128
+#define AUDIO_SAMPLE_RATE    44117.64706
+#define AUDIO_SAMPLE_RATE_EXACT 44117.64706
+
+class AudioStream;
+class AudioConnection;
+
+typedef struct audio_block_struct {
+	uint8_t  ref_count;
+	uint8_t  reserved1;
+	uint16_t memory_pool_index;
+	int16_t  data[AUDIO_BLOCK_SAMPLES];
+} audio_block_t;
+
+class AudioConnection
+{
+public:
+	AudioConnection(AudioStream &source, AudioStream &destination) :
+		src(source), dst(destination), src_index(0), dest_index(0),
+		next_dest(NULL)
+		{ isConnected = false;
+		  connect(); }
+	AudioConnection(AudioStream &source, unsigned char sourceOutput,
+		AudioStream &destination, unsigned char destinationInput) :
+		src(source), dst(destination),
+		src_index(sourceOutput), dest_index(destinationInput),
+		next_dest(NULL)
+		{ isConnected = false;
+		  connect(); }
+	friend class AudioStream;
+	~AudioConnection() {
+		disconnect();
+	}
+	void disconnect(void);
+	void connect(void);
+protected:
+	AudioStream &src;
+	AudioStream &dst;
+	unsigned char src_index;
+	unsigned char dest_index;
+	AudioConnection *next_dest;
+	bool isConnected;
+};
+
+#define AudioMemory(num) ({ \
+	static DMAMEM audio_block_t data[num]; \
+	AudioStream::initialize_memory(data, num); \
+})
+
+#define CYCLE_COUNTER_APPROX_PERCENT(n) (((n) + (F_CPU / 32 / AUDIO_SAMPLE_RATE * AUDIO_BLOCK_SAMPLES / 100)) / (F_CPU / 16 / AUDIO_SAMPLE_RATE * AUDIO_BLOCK_SAMPLES / 100))
+
+#define AudioProcessorUsage() (CYCLE_COUNTER_APPROX_PERCENT(AudioStream::cpu_cycles_total))
+#define AudioProcessorUsageMax() (CYCLE_COUNTER_APPROX_PERCENT(AudioStream::cpu_cycles_total_max))
+#define AudioProcessorUsageMaxReset() (AudioStream::cpu_cycles_total_max = AudioStream::cpu_cycles_total)
+#define AudioMemoryUsage() (AudioStream::memory_used)
+#define AudioMemoryUsageMax() (AudioStream::memory_used_max)
+#define AudioMemoryUsageMaxReset() (AudioStream::memory_used_max = AudioStream::memory_used)
+
+class AudioStream
+{
+public:
+	AudioStream(unsigned char ninput, audio_block_t **iqueue) :
+		num_inputs(ninput), inputQueue(iqueue) {
+			active = false;
+			destination_list = NULL;
+			for (int i=0; i < num_inputs; i++) {
+				inputQueue[i] = NULL;
+			}
+			// add to a simple list, for update_all
+			if (first_update == NULL) {
+				first_update = this;
+			} else {
+				AudioStream *p;
+				for (p=first_update; p->next_update; p = p->next_update) ;
+				p->next_update = this;
+			}
+			next_update = NULL;
+			cpu_cycles = 0;
+			cpu_cycles_max = 0;
+			numConnections = 0;
+		}
+	virtual ~AudioStream() {}
+	static void initialize_memory(audio_block_t *data, unsigned int num);
+	int processorUsage(void) { return CYCLE_COUNTER_APPROX_PERCENT(cpu_cycles); }
+	int processorUsageMax(void) { return CYCLE_COUNTER_APPROX_PERCENT(cpu_cycles_max); }
+	void processorUsageMaxReset(void) { cpu_cycles_max = cpu_cycles; }
+	bool isActive(void) { return active; }
+	uint16_t cpu_cycles;
+	uint16_t cpu_cycles_max;
+	static uint16_t cpu_cycles_total;
+	static uint16_t cpu_cycles_total_max;
+	static uint16_t memory_used;
+	static uint16_t memory_used_max;
+	static void update_all(void);
+protected:
+	bool active;
+	unsigned char num_inputs;
+	static audio_block_t * allocate(void);
+	static void release(audio_block_t * block);
+	void transmit(audio_block_t *block, unsigned char index = 0);
+	audio_block_t * receiveReadOnly(unsigned int index = 0);
+	audio_block_t * receiveWritable(unsigned int index = 0);
+	static bool update_setup(void) { return true; }
+	static void update_stop(void) { }
+	friend class AudioConnection;
+	uint8_t numConnections;
+private:
+	AudioConnection *destination_list;
+	audio_block_t **inputQueue;
+	virtual void update(void) = 0;
+	static AudioStream *first_update; // for update_all
+	AudioStream *next_update; // for update_all
+	static audio_block_t *memory_pool;
+	static uint32_t memory_pool_available_mask[];
+	static uint16_t memory_pool_first_mask;
+};
+
+#endif
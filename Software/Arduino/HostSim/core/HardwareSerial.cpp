@@ -0,0 +1,114 @@
+/*
+ * HardwareSerial.cpp (host simulation)
+ */
+
+#include "Arduino.h"
+#include "HostSim.h"
+
+#include <stdio.h>
+
+usb_serial_class Serial;
+HardwareSerial Serial1;
+
+size_t usb_serial_class::write(const uint8_t *buffer, size_t size)
+{
+	bytes_written += size;
+	if (echo) fwrite(buffer, 1, size, stderr);
+	return size;
+}
+
+HardwareSerial::HardwareSerial() : baudrate(115200), bytes_written(0),
+	rx_head(0), rx_tail(0), tx_head(0), tx_tail(0), tx_busy_until(0)
+{
+}
+
+void HardwareSerial::inject(const uint8_t *data, size_t len, uint32_t when_us)
+{
+	// 10 bit times per byte (start + 8 data + stop)
+	uint32_t byte_us = 10000000UL / baudrate;
+	for (size_t i = 0; i < len; i++) {
+		uint32_t h = (rx_head + 1) % RX_SIZE;
+		if (h == rx_tail) return;
+		rx_data[rx_head] = data[i];
+		rx_time[rx_head] = when_us + i * byte_us;
+		rx_head = h;
+	}
+}
+
+uint32_t HardwareSerial::nextArrival(void)
+{
+	if (rx_head == rx_tail) return 0;
+	return rx_time[rx_tail];
+}
+
+size_t HardwareSerial::pending(void)
+{
+	return (rx_head + RX_SIZE - rx_tail) % RX_SIZE;
+}
+
+int HardwareSerial::available()
+{
+	uint32_t now = micros();
+	int n = 0;
+	for (uint32_t t = rx_tail; t != rx_head; t = (t + 1) % RX_SIZE) {
+		if ((int32_t)(rx_time[t] - now) > 0) break;
+		n++;
+	}
+	return n;
+}
+
+int HardwareSerial::peek()
+{
+	if (rx_head == rx_tail) return -1;
+	if ((int32_t)(rx_time[rx_tail] - micros()) > 0) return -1;
+	return rx_data[rx_tail];
+}
+
+int HardwareSerial::read()
+{
+	int c = peek();
+	if (c >= 0) rx_tail = (rx_tail + 1) % RX_SIZE;
+	return c;
+}
+
+// Transmission is paced like the Teensy UART: bytes drain at the baud rate and
+// write() blocks once the transmit buffer is full.
+size_t HardwareSerial::write(const uint8_t *buffer, size_t size)
+{
+	uint32_t byte_us = 10000000UL / baudrate;
+	bytes_written += size;
+	for (size_t i = 0; i < size; i++) {
+		uint32_t now = micros();
+		if ((int32_t)(tx_busy_until - now) < 0) tx_busy_until = now;
+		uint32_t backlog = tx_busy_until - now;
+		if (backlog >= TX_FIFO * byte_us) {
+			host_advance_us(backlog - (TX_FIFO - 1) * byte_us);
+		}
+		tx_busy_until += byte_us;
+		uint32_t h = (tx_head + 1) % TX_SIZE;
+		if (h == tx_tail) tx_tail = (tx_tail + 1) % TX_SIZE;
+		tx_data[tx_head] = buffer[i];
+		tx_head = h;
+	}
+	return size;
+}
+
+// room left in the transmit FIFO, i.e. how much write() takes without blocking
+int HardwareSerial::availableForWrite(void)
+{
+	uint32_t byte_us = 10000000UL / baudrate;
+	int32_t backlog = (int32_t)(tx_busy_until - micros());
+	if (backlog <= 0) return TX_FIFO - 1;
+	int queued = (backlog + byte_us - 1) / byte_us;
+	return queued >= TX_FIFO - 1 ? 0 : TX_FIFO - 1 - queued;
+}
+
+size_t HardwareSerial::takeOutput(uint8_t *buf, size_t max)
+{
+	size_t n = 0;
+	while (n < max && tx_tail != tx_head) {
+		buf[n++] = tx_data[tx_tail];
+		tx_tail = (tx_tail + 1) % TX_SIZE;
+	}
+	return n;
+}
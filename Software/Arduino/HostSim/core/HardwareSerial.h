@@ -0,0 +1,69 @@
+/*
+ * HardwareSerial.h (host simulation)
+ *
+ * Serial  - USB console.  Output is counted and, optionally, echoed to stderr.
+ * Serial1 - Bluetooth UART.  Input is a timeline of scripted bytes; a byte only
+ *           becomes available() once the virtual clock reaches its arrival
+ *           time.  Output drains at the baud rate through a 64 byte transmit
+ *           buffer and is captured so the driver can inspect responses.
+ */
+
+#ifndef HardwareSerial_h
+#define HardwareSerial_h
+
+#include "Stream.h"
+
+class usb_serial_class : public Stream
+{
+public:
+	usb_serial_class() : bytes_written(0), echo(false) {}
+	void begin(long baud) { (void)baud; }
+	virtual int available() { return 0; }
+	virtual int read() { return -1; }
+	virtual int peek() { return -1; }
+	virtual size_t write(uint8_t b) { return write(&b, 1); }
+	virtual size_t write(const uint8_t *buffer, size_t size);
+	using Print::write;
+	operator bool() { return true; }
+
+	unsigned long bytes_written;
+	bool echo;
+};
+
+class HardwareSerial : public Stream
+{
+public:
+	HardwareSerial();
+	void begin(uint32_t baud) { baudrate = baud; }
+	virtual int available();
+	virtual int read();
+	virtual int peek();
+	virtual size_t write(uint8_t b) { return write(&b, 1); }
+	virtual size_t write(const uint8_t *buffer, size_t size);
+	using Print::write;
+	virtual int availableForWrite(void);
+	operator bool() { return true; }
+
+	// simulation side: queue bytes to arrive at 'when_us' (virtual time),
+	// back to back at the configured baud rate
+	void inject(const uint8_t *data, size_t len, uint32_t when_us);
+	uint32_t nextArrival(void);      // arrival time of the next pending byte, 0 if none
+	size_t pending(void);            // bytes scripted but not yet read
+	size_t takeOutput(uint8_t *buf, size_t max);
+
+	uint32_t baudrate;
+	unsigned long bytes_written;
+private:
+	enum { RX_SIZE = 4096, TX_SIZE = 65536, TX_FIFO = 64 };
+	uint8_t rx_data[RX_SIZE];
+	uint32_t rx_time[RX_SIZE];
+	uint32_t rx_head, rx_tail;
+	uint8_t tx_data[TX_SIZE];
+	uint32_t tx_head, tx_tail;
+	uint32_t tx_busy_until;
+};
+
+extern usb_serial_class Serial;
+extern HardwareSerial Serial1;
+
+#endif
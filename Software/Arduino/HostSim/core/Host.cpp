@@ -0,0 +1,124 @@
+/*
+ * Host.cpp (host simulation)
+ *
+ * Virtual clock and audio interrupt scheduler.
+ */
+
+#include "Arduino.h"
+#include "AudioStream.h"
+#include "HostSim.h"
+
+#include <time.h>
+
+static uint64_t monotonic_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static uint64_t clock_skew_ns = 0;
+static uint64_t next_update_ns = HOST_AUDIO_BLOCK_NS;
+static uint32_t update_count = 0;
+static bool in_service = false;
+static void (*update_hook)(void) = NULL;
+
+static host_audio_source_t audio_source = NULL;
+static void *audio_source_arg = NULL;
+
+// first use may come from a global constructor (elapsedMillis), so the origin
+// is latched lazily rather than by static initialisation
+static uint64_t clock_origin(void)
+{
+	static uint64_t origin = monotonic_ns();
+	return origin;
+}
+
+uint64_t host_nanos(void)
+{
+	return monotonic_ns() - clock_origin() + clock_skew_ns;
+}
+
+uint32_t micros(void)
+{
+	return host_nanos() / 1000;
+}
+
+uint32_t millis(void)
+{
+	return host_nanos() / 1000000;
+}
+
+uint32_t host_cycles(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+	return (uint32_t)__builtin_ia32_rdtsc();
+#else
+	return (uint32_t)monotonic_ns();
+#endif
+}
+
+void host_service(void)
+{
+	if (in_service) return;
+	in_service = true;
+	while (host_nanos() >= next_update_ns) {
+		AudioStream::update_all();
+		next_update_ns += HOST_AUDIO_BLOCK_NS;
+		update_count++;
+		if (update_hook) update_hook();
+	}
+	in_service = false;
+}
+
+void host_advance_us(uint64_t us)
+{
+	clock_skew_ns += us * 1000;
+	host_service();
+}
+
+uint64_t host_blocked_us(void)
+{
+	return clock_skew_ns / 1000;
+}
+
+uint32_t host_audio_updates(void)
+{
+	return update_count;
+}
+
+void host_on_update(void (*hook)(void))
+{
+	update_hook = hook;
+}
+
+void delay(uint32_t msec)
+{
+	host_advance_us((uint64_t)msec * 1000);
+}
+
+void delayMicroseconds(uint32_t usec)
+{
+	host_advance_us(usec);
+}
+
+void yield(void)
+{
+	host_service();
+}
+
+void host_set_audio_source(host_audio_source_t source, void *arg)
+{
+	audio_source = source;
+	audio_source_arg = arg;
+}
+
+void host_audio_input(int16_t *left, int16_t *right)
+{
+	if (audio_source) {
+		audio_source(left, right, audio_source_arg);
+	} else {
+		memset(left, 0, AUDIO_BLOCK_SAMPLES * 2);
+		memset(right, 0, AUDIO_BLOCK_SAMPLES * 2);
+	}
+}
@@ -0,0 +1,43 @@
+/*
+ * HostSim.h
+ *
+ * Control surface of the host simulation, used by the benchmark driver.
+ *
+ * The virtual clock is the host monotonic clock plus a "skew" that grows every
+ * time the firmware blocks (delay(), Stream timeouts).  The audio library
+ * update, which on the Teensy is a software interrupt raised every 128
+ * samples, is run by host_service() for every block period the virtual clock
+ * has crossed.  host_service() is called when the clock is advanced and by the
+ * driver between loop() iterations.
+ */
+
+#ifndef HostSim_h
+#define HostSim_h
+
+#include <stdint.h>
+
+// audio block period, in nanoseconds (128 samples at 44117.647 Hz)
+#define HOST_AUDIO_BLOCK_NS 2901333ULL
+
+uint64_t host_nanos(void);                 // virtual time, ns
+void     host_advance_us(uint64_t us);     // block for 'us' of virtual time
+void     host_service(void);               // run any audio updates that are due
+uint64_t host_blocked_us(void);            // total virtual time spent blocked
+uint32_t host_audio_updates(void);         // number of audio updates run so far
+void     host_on_update(void (*hook)(void)); // called after every audio update
+
+// Audio input: called once per update with 128 samples per channel to fill.
+// Without a source the I2S input delivers silence.
+typedef void (*host_audio_source_t)(int16_t *left, int16_t *right, void *arg);
+void host_set_audio_source(host_audio_source_t source, void *arg);
+void host_audio_input(int16_t *left, int16_t *right);
+
+// Root directory that stands in for the SD card.
+void        host_sd_root(const char *path);
+const char *host_sd_path(const char *filename, char *buf, unsigned int size);
+
+// File that stands in for the SPI flash, kept from run to run; call before
+// setup().  Without one the flash starts erased every run.
+void        host_flash_image(const char *path);
+
+#endif
@@ -0,0 +1,58 @@
+/*
+ * Print.cpp (host simulation)
+ */
+
+#include "Arduino.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+
+size_t Print::write(const uint8_t *buffer, size_t size)
+{
+	size_t count = 0;
+	while (size--) count += write(*buffer++);
+	return count;
+}
+
+size_t Print::printNumber(long n, int base, int sign)
+{
+	char buf[66];
+	if (base == 16) {
+		snprintf(buf, sizeof(buf), "%lX", (unsigned long)n);
+	} else if (base == 8) {
+		snprintf(buf, sizeof(buf), "%lo", (unsigned long)n);
+	} else if (base == 2) {
+		unsigned long u = n;
+		char *p = buf + sizeof(buf) - 1;
+		*p = 0;
+		do {
+			*--p = '0' + (u & 1);
+			u >>= 1;
+		} while (u);
+		return write(p);
+	} else if (sign) {
+		snprintf(buf, sizeof(buf), "%ld", n);
+	} else {
+		snprintf(buf, sizeof(buf), "%lu", (unsigned long)n);
+	}
+	return write(buf);
+}
+
+size_t Print::print(double n, int digits)
+{
+	char buf[64];
+	snprintf(buf, sizeof(buf), "%.*f", digits, n);
+	return write(buf);
+}
+
+int Print::printf(const char *format, ...)
+{
+	char buf[256];
+	va_list args;
+	va_start(args, format);
+	int n = vsnprintf(buf, sizeof(buf), format, args);
+	va_end(args);
+	if (n < 0) return n;
+	if (n >= (int)sizeof(buf)) n = sizeof(buf) - 1;
+	return write((const uint8_t *)buf, n);
+}
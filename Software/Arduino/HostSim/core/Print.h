@@ -0,0 +1,50 @@
+/*
+ * Print.h (host simulation)
+ */
+
+#ifndef Print_h
+#define Print_h
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include "WString.h"
+
+class Print
+{
+public:
+	Print() : write_error(0) {}
+	virtual ~Print() {}
+	virtual size_t write(uint8_t b) = 0;
+	virtual size_t write(const uint8_t *buffer, size_t size);
+	size_t write(const char *str) { return write((const uint8_t *)str, strlen(str)); }
+	size_t write(const char *buffer, size_t size) { return write((const uint8_t *)buffer, size); }
+
+	size_t print(const String &s) { return write((const uint8_t *)s.c_str(), s.length()); }
+	size_t print(char c) { return write((uint8_t)c); }
+	size_t print(const char s[]) { return write(s); }
+	size_t print(uint8_t b, int base = 10) { return printNumber(b, base, 0); }
+	size_t print(int n, int base = 10) { return printNumber(n, base, 1); }
+	size_t print(unsigned int n, int base = 10) { return printNumber(n, base, 0); }
+	size_t print(long n, int base = 10) { return printNumber(n, base, 1); }
+	size_t print(unsigned long n, int base = 10) { return printNumber(n, base, 0); }
+	size_t print(double n, int digits = 2);
+
+	size_t println(void) { return write((const uint8_t *)"\r\n", 2); }
+	template <typename T> size_t println(T arg) { size_t n = print(arg); return n + println(); }
+	template <typename T> size_t println(T arg, int fmt) { size_t n = print(arg, fmt); return n + println(); }
+
+	int printf(const char *format, ...) __attribute__((format(printf, 2, 3)));
+
+	int getWriteError() { return write_error; }
+	void clearWriteError() { write_error = 0; }
+
+protected:
+	void setWriteError(int err = 1) { write_error = err; }
+
+private:
+	size_t printNumber(long n, int base, int sign);
+	int write_error;
+};
+
+#endif
@@ -0,0 +1,356 @@
+/*
+ * SD.cpp (host simulation)
+ */
+
+#include "SD.h"
+#include "HostSim.h"
+
+#include <dirent.h>
+#include <limits.h>
+#include <stdio.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+SDClass SD;
+
+static char sd_root[PATH_MAX] = "sdcard";
+
+struct HostFile {
+	int refs;
+	FILE *fp;
+	DIR *dir;
+	char name[13];
+	char path[PATH_MAX];
+	uint32_t bgn_block;	// contiguous files only, 0 otherwise
+	uint32_t end_block;
+};
+
+// open contiguous files, searched by writeBlocks()
+#define MAX_CONTIGUOUS 8
+static HostFile *contiguous[MAX_CONTIGUOUS];
+static uint32_t next_block = 0x10000;
+
+#define BLOCKS_PER_CLUSTER 64	// 32 kB clusters, as on a large FAT32 card
+
+void host_sd_root(const char *path)
+{
+	snprintf(sd_root, sizeof(sd_root), "%s", path);
+	::mkdir(sd_root, 0755);
+}
+
+const char *host_sd_path(const char *filename, char *buf, unsigned int size)
+{
+	while (*filename == '/') filename++;
+	snprintf(buf, size, "%s/%s", sd_root, filename);
+	return buf;
+}
+
+static HostFile *hostfile_new(const char *path)
+{
+	HostFile *f = new HostFile();
+	f->refs = 1;
+	f->fp = NULL;
+	f->dir = NULL;
+	f->bgn_block = f->end_block = 0;
+	snprintf(f->path, sizeof(f->path), "%s", path);
+	const char *base = strrchr(path, '/');
+	base = base ? base + 1 : path;
+	snprintf(f->name, sizeof(f->name), "%s", base);
+	return f;
+}
+
+File::File(void) : _file(NULL) {}
+
+File::File(const File &f) : Stream(), _file(f._file)
+{
+	if (_file) _file->refs++;
+}
+
+File & File::operator = (const File &f)
+{
+	if (f._file) f._file->refs++;
+	if (_file && --_file->refs == 0) {
+		close();
+		delete _file;
+	}
+	_file = f._file;
+	return *this;
+}
+
+File::~File(void)
+{
+	if (_file && --_file->refs == 0) {
+		close();
+		delete _file;
+	}
+}
+
+size_t File::write(uint8_t b)
+{
+	return write(&b, 1);
+}
+
+size_t File::write(const uint8_t *buf, size_t size)
+{
+	if (!_file || !_file->fp) {
+		setWriteError();
+		return 0;
+	}
+	return fwrite(buf, 1, size, _file->fp);
+}
+
+int File::read()
+{
+	if (!_file || !_file->fp) return -1;
+	return fgetc(_file->fp);
+}
+
+int File::peek()
+{
+	if (!_file || !_file->fp) return -1;
+	int c = fgetc(_file->fp);
+	if (c >= 0) ungetc(c, _file->fp);
+	return c;
+}
+
+int File::available()
+{
+	if (!_file || !_file->fp) return 0;
+	uint32_t n = size() - position();
+	return n > 0x7FFF ? 0x7FFF : n;
+}
+
+void File::flush()
+{
+	if (_file && _file->fp) fflush(_file->fp);
+}
+
+int File::read(void *buf, uint16_t nbyte)
+{
+	if (!_file || !_file->fp) return -1;
+	return fread(buf, 1, nbyte, _file->fp);
+}
+
+// like SdFile::seekSet and the t3 File::seek: not past the end of the file
+boolean File::seek(uint32_t pos)
+{
+	if (!_file || !_file->fp || pos > size()) return false;
+	return fseek(_file->fp, pos, SEEK_SET) == 0;
+}
+
+uint32_t File::position()
+{
+	if (!_file || !_file->fp) return 0;
+	return ftell(_file->fp);
+}
+
+uint32_t File::size()
+{
+	if (!_file || !_file->fp) return 0;
+	struct stat st;
+	fflush(_file->fp);
+	if (fstat(fileno(_file->fp), &st) != 0) return 0;
+	return st.st_size;
+}
+
+void File::close()
+{
+	if (!_file) return;
+	for (int i = 0; i < MAX_CONTIGUOUS; i++) {
+		if (contiguous[i] == _file) contiguous[i] = NULL;
+	}
+	if (_file->fp) fclose(_file->fp);
+	if (_file->dir) closedir(_file->dir);
+	_file->fp = NULL;
+	_file->dir = NULL;
+}
+
+boolean File::contiguousRange(uint32_t *bgnBlock, uint32_t *endBlock)
+{
+	if (!_file || !_file->fp || !_file->bgn_block) return false;
+	*bgnBlock = _file->bgn_block;
+	*endBlock = _file->end_block;
+	return true;
+}
+
+boolean File::truncate(uint32_t length)
+{
+	if (!_file || !_file->fp || length > size()) return false;
+	fflush(_file->fp);
+	if (ftruncate(fileno(_file->fp), length) != 0) return false;
+	if (position() > length) seek(length);
+	return true;
+}
+
+// no FAT here: the inode stands in for the first cluster, it changes when a
+// file is replaced
+uint32_t File::firstCluster(void)
+{
+	if (!_file || !_file->fp) return 0;
+	struct stat st;
+	if (fstat(fileno(_file->fp), &st) != 0 || st.st_size == 0) return 0;
+	return (uint32_t)st.st_ino;
+}
+
+File::operator bool()
+{
+	return _file && (_file->fp || _file->dir);
+}
+
+char * File::name()
+{
+	return _file ? _file->name : (char *)"";
+}
+
+boolean File::isDirectory(void)
+{
+	return _file && _file->dir;
+}
+
+File File::openNextFile(uint8_t mode)
+{
+	File f;
+	if (!_file || !_file->dir) return f;
+	struct dirent *de;
+	while ((de = readdir(_file->dir)) != NULL) {
+		if (de->d_name[0] == '.') continue;
+		char path[PATH_MAX];
+		snprintf(path, sizeof(path), "%s/%s", _file->path, de->d_name);
+		f._file = hostfile_new(path);
+		struct stat st;
+		if (stat(path, &st) == 0 && S_ISDIR(st.st_mode)) {
+			f._file->dir = opendir(path);
+		} else {
+			f._file->fp = fopen(path, (mode & O_WRITE) ? "r+b" : "rb");
+		}
+		break;
+	}
+	return f;
+}
+
+void File::rewindDirectory(void)
+{
+	if (_file && _file->dir) rewinddir(_file->dir);
+}
+
+boolean SDClass::begin(uint8_t csPin)
+{
+	(void)csPin;
+	::mkdir(sd_root, 0755);
+	return true;
+}
+
+File SDClass::open(const char *filename, uint8_t mode)
+{
+	char path[PATH_MAX];
+	File f;
+	host_sd_path(filename, path, sizeof(path));
+	struct stat st;
+	bool exists = stat(path, &st) == 0;
+	if (exists && S_ISDIR(st.st_mode)) {
+		f._file = hostfile_new(path);
+		f._file->dir = opendir(path);
+		return f;
+	}
+	FILE *fp = NULL;
+	if (mode & O_WRITE) {
+		if (!exists && !(mode & O_CREAT)) return f;
+		fp = fopen(path, exists && !(mode & O_TRUNC) ? "r+b" : "w+b");
+		if (fp) fseek(fp, 0, SEEK_END);
+	} else if (exists) {
+		fp = fopen(path, "rb");
+	}
+	if (!fp) return f;
+	f._file = hostfile_new(path);
+	f._file->fp = fp;
+	return f;
+}
+
+boolean SDClass::exists(const char *filepath)
+{
+	char path[PATH_MAX];
+	struct stat st;
+	return stat(host_sd_path(filepath, path, sizeof(path)), &st) == 0;
+}
+
+boolean SDClass::mkdir(const char *filepath)
+{
+	char path[PATH_MAX];
+	return ::mkdir(host_sd_path(filepath, path, sizeof(path)), 0755) == 0;
+}
+
+boolean SDClass::remove(const char *filepath)
+{
+	char path[PATH_MAX];
+	return unlink(host_sd_path(filepath, path, sizeof(path))) == 0;
+}
+
+boolean SDClass::rmdir(const char *filepath)
+{
+	char path[PATH_MAX];
+	return ::rmdir(host_sd_path(filepath, path, sizeof(path))) == 0;
+}
+
+boolean Sd2Card::init(uint8_t sckRateID, uint8_t chipSelectPin)
+{
+	(void)sckRateID;
+	(void)chipSelectPin;
+	type_ = SD_CARD_TYPE_SDHC;
+	return true;
+}
+
+boolean SdVolume::init(Sd2Card &dev, uint8_t part)
+{
+	(void)part;
+	if (!dev.type()) return false;
+	blocksPerCluster_ = BLOCKS_PER_CLUSTER;
+	clusterCount_ = 65536;
+	return true;
+}
+
+File SDClass::createContiguous(const char *filepath, uint32_t size)
+{
+	char path[PATH_MAX];
+	File f;
+	struct stat st;
+	host_sd_path(filepath, path, sizeof(path));
+	if (size == 0 || stat(path, &st) == 0) return f;
+	int slot = 0;
+	while (slot < MAX_CONTIGUOUS && contiguous[slot]) slot++;
+	if (slot == MAX_CONTIGUOUS) return f;
+	FILE *fp = fopen(path, "w+b");
+	if (!fp) return f;
+	if (ftruncate(fileno(fp), size) != 0) {
+		fclose(fp);
+		unlink(path);
+		return f;
+	}
+	f._file = hostfile_new(path);
+	f._file->fp = fp;
+	f._file->bgn_block = next_block;
+	// the range runs to the end of the last cluster, as on a card; the
+	// file's length stays as asked
+	uint32_t clusters = ((size + 511) / 512 + BLOCKS_PER_CLUSTER - 1) / BLOCKS_PER_CLUSTER;
+	f._file->end_block = next_block + clusters * BLOCKS_PER_CLUSTER - 1;
+	next_block = f._file->end_block + 1;
+	contiguous[slot] = f._file;
+	return f;
+}
+
+boolean SDClass::writeBlocks(uint32_t block, const uint8_t *src, uint16_t count)
+{
+	for (int i = 0; i < MAX_CONTIGUOUS; i++) {
+		HostFile *f = contiguous[i];
+		if (!f || block < f->bgn_block || block + count - 1 > f->end_block) continue;
+		// blocks in the cluster tail, past the file's length, are written
+		// but are not part of the file
+		off_t offset = (off_t)(block - f->bgn_block) * 512;
+		struct stat st;
+		fflush(f->fp);
+		if (fstat(fileno(f->fp), &st) != 0) return false;
+		off_t len = 512 * count;
+		if (offset + len > st.st_size) len = offset < st.st_size ? st.st_size - offset : 0;
+		return pwrite(fileno(f->fp), src, len, offset) == len;
+	}
+	return false;
+}
@@ -0,0 +1,112 @@
+/*
+ * SD.h (host simulation)
+ *
+ * SD card stand-in backed by a host directory (see host_sd_root()).  File
+ * handles share their underlying descriptor the way the Arduino SD library's
+ * File shares its SdFile, so copies of a File refer to the same open file.
+ */
+
+#ifndef __SD_H__
+#define __SD_H__
+
+#include <Arduino.h>
+
+#define O_READ   0x01
+#define O_RDONLY O_READ
+#define O_WRITE  0x02
+#define O_WRONLY O_WRITE
+#define O_RDWR   (O_READ | O_WRITE)
+#define O_APPEND 0x04
+#define O_CREAT  0x10
+#define O_TRUNC  0x40
+
+#define FILE_READ O_READ
+#define FILE_WRITE (O_READ | O_WRITE | O_CREAT)
+
+#define SPI_FULL_SPEED    0
+#define SPI_HALF_SPEED    1
+#define SPI_QUARTER_SPEED 2
+
+#define SD_CARD_TYPE_SD1  1
+#define SD_CARD_TYPE_SD2  2
+#define SD_CARD_TYPE_SDHC 3
+
+#define SD_CHIP_SELECT_PIN 10
+
+struct HostFile;
+
+class File : public Stream {
+public:
+	File(void);
+	File(const File &f);
+	File & operator = (const File &f);
+	~File(void);
+	virtual size_t write(uint8_t);
+	virtual size_t write(const uint8_t *buf, size_t size);
+	virtual int read();
+	virtual int peek();
+	virtual int available();
+	virtual void flush();
+	int read(void *buf, uint16_t nbyte);
+	boolean seek(uint32_t pos);
+	uint32_t position();
+	uint32_t size();
+	void close();
+	operator bool();
+	char * name();
+
+	boolean isDirectory(void);
+	File openNextFile(uint8_t mode = O_RDONLY);
+	void rewindDirectory(void);
+
+	boolean contiguousRange(uint32_t *bgnBlock, uint32_t *endBlock);
+	boolean truncate(uint32_t length);
+	uint32_t firstCluster(void);
+
+	using Print::write;
+
+private:
+	friend class SDClass;
+	HostFile *_file;
+};
+
+class SDClass {
+public:
+	boolean begin(uint8_t csPin = SD_CHIP_SELECT_PIN);
+	File open(const char *filename, uint8_t mode = FILE_READ);
+	boolean exists(const char *filepath);
+	boolean mkdir(const char *filepath);
+	boolean remove(const char *filepath);
+	boolean rmdir(const char *filepath);
+
+	// Contiguous files get a private range of fake block numbers;
+	// writeBlocks() maps blocks in a range back to offsets in that file.
+	File createContiguous(const char *filepath, uint32_t size);
+	boolean writeBlocks(uint32_t block, const uint8_t *src, uint16_t count);
+};
+
+extern SDClass SD;
+
+// Raw card and volume, as used by the sketch's card check.  The host card is
+// always present and reports a 2 GB FAT16 volume.
+class Sd2Card {
+public:
+	Sd2Card(void) : type_(0) {}
+	boolean init(uint8_t sckRateID = SPI_FULL_SPEED, uint8_t chipSelectPin = SD_CHIP_SELECT_PIN);
+	uint8_t type(void) const { return type_; }
+private:
+	uint8_t type_;
+};
+
+class SdVolume {
+public:
+	SdVolume(void) : blocksPerCluster_(0), clusterCount_(0) {}
+	boolean init(Sd2Card &dev, uint8_t part = 1);
+	uint8_t blocksPerCluster(void) const { return blocksPerCluster_; }
+	uint32_t clusterCount(void) const { return clusterCount_; }
+private:
+	uint8_t blocksPerCluster_;
+	uint32_t clusterCount_;
+};
+
+#endif
@@ -0,0 +1,46 @@
+/*
+ * SPI.h (host simulation)
+ */
+
+#ifndef _SPI_H_INCLUDED
+#define _SPI_H_INCLUDED
+
+#include <Arduino.h>
+
+#define SPI_HAS_TRANSACTION 1
+#define SPI_HAS_NOTUSINGINTERRUPT 1
+
+#define SPI_MODE0 0x00
+#define SPI_MODE1 0x04
+#define SPI_MODE2 0x08
+#define SPI_MODE3 0x0C
+#define MSBFIRST 1
+#define LSBFIRST 0
+
+class SPISettings {
+public:
+	SPISettings(uint32_t clock, uint8_t bitOrder, uint8_t dataMode) {
+		(void)clock; (void)bitOrder; (void)dataMode;
+	}
+	SPISettings() {}
+};
+
+class SPIClass {
+public:
+	static void begin() {}
+	static void end() {}
+	static void usingInterrupt(uint8_t n) { (void)n; }
+	static void notUsingInterrupt(uint8_t n) { (void)n; }
+	static void beginTransaction(SPISettings settings) { (void)settings; }
+	static void endTransaction(void) {}
+	static uint8_t transfer(uint8_t data) { (void)data; return 0xFF; }
+	static uint16_t transfer16(uint16_t data) { (void)data; return 0xFFFF; }
+	static void transfer(void *buf, size_t count) { memset(buf, 0xFF, count); }
+	static void setMOSI(uint8_t pin) { (void)pin; }
+	static void setMISO(uint8_t pin) { (void)pin; }
+	static void setSCK(uint8_t pin) { (void)pin; }
+};
+
+extern SPIClass SPI;
+
+#endif
@@ -0,0 +1,170 @@
+/*
+ * SerialFlash.cpp (host simulation)
+ *
+ * The chip half of the SerialFlash library: a 16 Mbyte NOR flash (W25Q128)
+ * in memory, or mapped from an image file so that its contents survive from
+ * one run to the next.  Programming only clears bits, erasing sets them.  A
+ * page program keeps the chip busy for HOST_FLASH_PAGE_US and an erase for
+ * its own time; programming a busy chip waits (blocked virtual time), reading
+ * doesn't, the way the library suspends a program or erase to read.  The
+ * directory half (SerialFlashDirectory.cpp) is the library's own.
+ */
+
+#include "SerialFlash.h"
+#include "HostSim.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#define HOST_FLASH_SIZE      (16UL * 1024 * 1024)
+#define HOST_FLASH_BLOCK     65536
+#define HOST_FLASH_PAGE_US   700
+#define HOST_FLASH_BLOCK_US  150000
+#define HOST_FLASH_CHIP_US   40000000ULL
+
+uint16_t SerialFlashChip::dirindex = 0;
+uint8_t SerialFlashChip::flags = 0;
+uint8_t SerialFlashChip::busy = 0;
+
+SerialFlashChip SerialFlash;
+
+static const char *flash_path = NULL;
+static uint8_t *flash = NULL;
+static uint64_t busy_until_ns = 0;
+
+void host_flash_image(const char *path)
+{
+	flash_path = path;
+}
+
+static bool flash_map(void)
+{
+	if (flash) return true;
+	void *p = MAP_FAILED;
+	if (flash_path) {
+		int fd = ::open(flash_path, O_RDWR | O_CREAT, 0644);
+		if (fd < 0) return false;
+		off_t len = lseek(fd, 0, SEEK_END);
+		if (len != (off_t)HOST_FLASH_SIZE && ftruncate(fd, HOST_FLASH_SIZE) == 0) {
+			p = mmap(NULL, HOST_FLASH_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+			if (p != MAP_FAILED) memset(p, 0xFF, HOST_FLASH_SIZE);   // a new chip is erased
+		} else {
+			p = mmap(NULL, HOST_FLASH_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		}
+		::close(fd);
+	} else {
+		p = mmap(NULL, HOST_FLASH_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (p != MAP_FAILED) memset(p, 0xFF, HOST_FLASH_SIZE);
+	}
+	if (p == MAP_FAILED) return false;
+	flash = (uint8_t *)p;
+	return true;
+}
+
+static void busy_for(uint64_t us)
+{
+	busy_until_ns = host_nanos() + us * 1000;
+}
+
+bool SerialFlashChip::begin(SPIClass& device, uint8_t pin)
+{
+	(void)device;
+	(void)pin;
+	return flash_map();
+}
+
+bool SerialFlashChip::begin(uint8_t pin)
+{
+	return begin(SPI, pin);
+}
+
+uint32_t SerialFlashChip::capacity(const uint8_t *id)
+{
+	(void)id;
+	return HOST_FLASH_SIZE;
+}
+
+uint32_t SerialFlashChip::blockSize()
+{
+	return HOST_FLASH_BLOCK;
+}
+
+void SerialFlashChip::sleep()
+{
+}
+
+void SerialFlashChip::wakeup()
+{
+}
+
+void SerialFlashChip::readID(uint8_t *buf)
+{
+	buf[0] = 0xEF;
+	buf[1] = 0x40;
+	buf[2] = 0x18;
+	buf[3] = buf[4] = 0;
+}
+
+void SerialFlashChip::readSerialNumber(uint8_t *buf)
+{
+	memset(buf, 0, 8);
+}
+
+void SerialFlashChip::read(uint32_t addr, void *buf, uint32_t len)
+{
+	if (!flash || addr >= HOST_FLASH_SIZE) {
+		memset(buf, 0xFF, len);
+		return;
+	}
+	if (len > HOST_FLASH_SIZE - addr) len = HOST_FLASH_SIZE - addr;
+	memcpy(buf, flash + addr, len);
+}
+
+bool SerialFlashChip::ready()
+{
+	return host_nanos() >= busy_until_ns;
+}
+
+void SerialFlashChip::wait()
+{
+	uint64_t now = host_nanos();
+	if (now < busy_until_ns) host_advance_us((busy_until_ns - now + 999) / 1000);
+}
+
+void SerialFlashChip::write(uint32_t addr, const void *buf, uint32_t len)
+{
+	const uint8_t *p = (const uint8_t *)buf;
+	if (!flash) return;
+	while (len > 0) {
+		wait();
+		uint32_t max = 256 - (addr & 0xFF);
+		uint32_t pagelen = len <= max ? len : max;
+		for (uint32_t i = 0; i < pagelen && addr + i < HOST_FLASH_SIZE; i++) {
+			flash[addr + i] &= p[i];
+		}
+		addr += pagelen;
+		p += pagelen;
+		len -= pagelen;
+		busy_for(HOST_FLASH_PAGE_US);
+	}
+}
+
+void SerialFlashChip::eraseAll()
+{
+	if (!flash) return;
+	wait();
+	memset(flash, 0xFF, HOST_FLASH_SIZE);
+	busy_for(HOST_FLASH_CHIP_US);
+}
+
+void SerialFlashChip::eraseBlock(uint32_t addr)
+{
+	if (!flash) return;
+	wait();
+	addr &= ~(uint32_t)(HOST_FLASH_BLOCK - 1);
+	if (addr < HOST_FLASH_SIZE) memset(flash + addr, 0xFF, HOST_FLASH_BLOCK);
+	busy_for(HOST_FLASH_BLOCK_US);
+}
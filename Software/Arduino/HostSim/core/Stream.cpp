@@ -0,0 +1,53 @@
+/*
+ * Stream.cpp (host simulation)
+ */
+
+#include "Arduino.h"
+#include "HostSim.h"
+
+// Waits for a byte like the Arduino core does.  Rather than spin, the virtual
+// clock jumps straight to the next scripted arrival or to the timeout,
+// whichever comes first; audio updates due in between are run on the way.
+int Stream::timedRead()
+{
+	uint32_t start = millis();
+	while (1) {
+		int c = read();
+		if (c >= 0) return c;
+		uint32_t waited = millis() - start;
+		if (waited >= _timeout) return -1;
+		uint64_t step = (uint64_t)(_timeout - waited) * 1000;
+		uint32_t next = Serial1.nextArrival();
+		if (this == &Serial1 && next) {
+			uint32_t now = micros();
+			if ((int32_t)(next - now) <= 0) continue;
+			if (next - now < step) step = next - now;
+		}
+		host_advance_us(step);
+	}
+}
+
+size_t Stream::readBytes(char *buffer, size_t length)
+{
+	size_t count = 0;
+	while (count < length) {
+		int c = timedRead();
+		if (c < 0) break;
+		*buffer++ = (char)c;
+		count++;
+	}
+	return count;
+}
+
+String Stream::readString(size_t max)
+{
+	String str;
+	size_t length = 0;
+	while (length < max) {
+		int c = timedRead();
+		if (c < 0) break;
+		str += (char)c;
+		length++;
+	}
+	return str;
+}
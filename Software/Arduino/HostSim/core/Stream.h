@@ -0,0 +1,32 @@
+/*
+ * Stream.h (host simulation)
+ *
+ * Same blocking semantics as the Arduino core: timedRead() waits up to
+ * setTimeout() milliseconds (1000 by default) for the next byte.  On the host
+ * the wait advances the virtual clock instead of spinning.
+ */
+
+#ifndef Stream_h
+#define Stream_h
+
+#include "Print.h"
+
+class Stream : public Print
+{
+public:
+	Stream() : _timeout(1000) {}
+	virtual int available() = 0;
+	virtual int read() = 0;
+	virtual int peek() = 0;
+	virtual void flush() {}
+
+	void setTimeout(unsigned long timeout) { _timeout = timeout; }
+	size_t readBytes(char *buffer, size_t length);
+	String readString(size_t max = 120);
+
+protected:
+	int timedRead();
+	unsigned long _timeout;
+};
+
+#endif
@@ -0,0 +1,126 @@
+/*
+ * WString.h (host simulation)
+ *
+ * Heap-backed String with the same allocation behaviour as the Arduino core
+ * (one malloc'd buffer per instance, grown with realloc), so that command
+ * handling exercises the allocator the way it does on the Teensy.
+ */
+
+#ifndef String_class_h
+#define String_class_h
+
+#include <stdint.h>
+#include <stddef.h>
+
+class StringSumHelper;
+
+class String
+{
+	// Same "safe bool" idiom as the Arduino core: lets a String be used in a
+	// boolean context (including being returned from a boolean function).
+	typedef void (String::*StringIfHelperType)() const;
+	void StringIfHelper() const {}
+
+public:
+	String(const char *cstr = "");
+	String(const String &str);
+	explicit String(char c);
+	explicit String(unsigned char value, unsigned char base = 10);
+	explicit String(int value, unsigned char base = 10);
+	explicit String(unsigned int value, unsigned char base = 10);
+	explicit String(long value, unsigned char base = 10);
+	explicit String(unsigned long value, unsigned char base = 10);
+	explicit String(float value, unsigned char decimalPlaces = 2);
+	explicit String(double value, unsigned char decimalPlaces = 2);
+	~String(void);
+
+	unsigned char reserve(unsigned int size);
+	unsigned int length(void) const { return len; }
+
+	String & operator = (const String &rhs);
+	String & operator = (const char *cstr);
+
+	unsigned char concat(const String &str);
+	unsigned char concat(const char *cstr);
+	unsigned char concat(const char *cstr, unsigned int length);
+	unsigned char concat(char c);
+	unsigned char concat(unsigned char num);
+	unsigned char concat(int num);
+	unsigned char concat(unsigned int num);
+	unsigned char concat(long num);
+	unsigned char concat(unsigned long num);
+	unsigned char concat(float num);
+	unsigned char concat(double num);
+
+	template <typename T> String & operator += (T rhs) { concat(rhs); return *this; }
+
+	friend StringSumHelper & operator + (const StringSumHelper &lhs, const String &rhs);
+	friend StringSumHelper & operator + (const StringSumHelper &lhs, const char *cstr);
+	friend StringSumHelper & operator + (const StringSumHelper &lhs, char c);
+	friend StringSumHelper & operator + (const StringSumHelper &lhs, unsigned char num);
+	friend StringSumHelper & operator + (const StringSumHelper &lhs, int num);
+	friend StringSumHelper & operator + (const StringSumHelper &lhs, unsigned int num);
+	friend StringSumHelper & operator + (const StringSumHelper &lhs, long num);
+	friend StringSumHelper & operator + (const StringSumHelper &lhs, unsigned long num);
+	friend StringSumHelper & operator + (const StringSumHelper &lhs, float num);
+	friend StringSumHelper & operator + (const StringSumHelper &lhs, double num);
+
+	operator StringIfHelperType() const { return buffer ? &String::StringIfHelper : 0; }
+
+	int compareTo(const String &s) const;
+	unsigned char equals(const String &s) const;
+	unsigned char equals(const char *cstr) const;
+	unsigned char operator == (const String &rhs) const { return equals(rhs); }
+	unsigned char operator == (const char *cstr) const { return equals(cstr); }
+	unsigned char operator != (const String &rhs) const { return !equals(rhs); }
+	unsigned char operator != (const char *cstr) const { return !equals(cstr); }
+	unsigned char startsWith(const String &prefix) const;
+	unsigned char endsWith(const String &suffix) const;
+
+	char charAt(unsigned int index) const;
+	char operator [] (unsigned int index) const;
+	char & operator [] (unsigned int index);
+	void getBytes(unsigned char *buf, unsigned int bufsize, unsigned int index = 0) const;
+	void toCharArray(char *buf, unsigned int bufsize, unsigned int index = 0) const
+		{ getBytes((unsigned char *)buf, bufsize, index); }
+	const char * c_str() const { return buffer; }
+
+	int indexOf(char ch) const;
+	int indexOf(char ch, unsigned int fromIndex) const;
+	int indexOf(const String &str) const;
+	int indexOf(const String &str, unsigned int fromIndex) const;
+	String substring(unsigned int beginIndex) const { return substring(beginIndex, len); }
+	String substring(unsigned int beginIndex, unsigned int endIndex) const;
+
+	void toUpperCase(void);
+	void trim(void);
+	long toInt(void) const;
+	float toFloat(void) const;
+
+protected:
+	char *buffer;
+	unsigned int capacity;
+	unsigned int len;
+
+	void init(void);
+	void invalidate(void);
+	unsigned char changeBuffer(unsigned int maxStrLen);
+	String & copy(const char *cstr, unsigned int length);
+};
+
+class StringSumHelper : public String
+{
+public:
+	StringSumHelper(const String &s) : String(s) {}
+	StringSumHelper(const char *p) : String(p) {}
+	StringSumHelper(char c) : String(c) {}
+	StringSumHelper(unsigned char num) : String(num) {}
+	StringSumHelper(int num) : String(num) {}
+	StringSumHelper(unsigned int num) : String(num) {}
+	StringSumHelper(long num) : String(num) {}
+	StringSumHelper(unsigned long num) : String(num) {}
+	StringSumHelper(float num) : String(num) {}
+	StringSumHelper(double num) : String(num) {}
+};
+
+#endif
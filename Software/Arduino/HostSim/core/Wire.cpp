@@ -0,0 +1,41 @@
+/*
+ * Wire.cpp (host simulation)
+ */
+
+#include "Wire.h"
+#include "SPI.h"
+
+TwoWire Wire;
+SPIClass SPI;
+
+size_t TwoWire::write(uint8_t data)
+{
+	if (tx_len < sizeof(tx_buf)) tx_buf[tx_len++] = data;
+	return 1;
+}
+
+size_t TwoWire::write(const uint8_t *data, size_t quantity)
+{
+	for (size_t i = 0; i < quantity; i++) write(data[i]);
+	return quantity;
+}
+
+uint8_t TwoWire::endTransmission(uint8_t sendStop)
+{
+	(void)sendStop;
+	if (tx_len >= 2) reg_addr = (tx_buf[0] << 8) | tx_buf[1];
+	if (tx_len >= 4) regs[(reg_addr >> 1) & 0x1FF] = (tx_buf[2] << 8) | tx_buf[3];
+	tx_len = 0;
+	return 0;
+}
+
+uint8_t TwoWire::requestFrom(uint8_t address, uint8_t quantity)
+{
+	(void)address;
+	uint16_t val = regs[(reg_addr >> 1) & 0x1FF];
+	rx_buf[0] = val >> 8;
+	rx_buf[1] = val;
+	rx_len = quantity < 2 ? quantity : 2;
+	rx_pos = 0;
+	return rx_len;
+}
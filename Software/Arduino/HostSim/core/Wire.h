@@ -0,0 +1,46 @@
+/*
+ * Wire.h (host simulation)
+ *
+ * I2C stand-in that behaves like a bank of 16 bit registers addressed the way
+ * the SGTL5000 codec is (16 bit register address, 16 bit value), which is all
+ * the sketch talks to.  Reads return the last value written.
+ */
+
+#ifndef TwoWire_h
+#define TwoWire_h
+
+#include <Arduino.h>
+
+class TwoWire : public Stream
+{
+public:
+	TwoWire() : tx_len(0), rx_len(0), rx_pos(0) { memset(regs, 0, sizeof(regs)); }
+	void begin() {}
+	void beginTransmission(uint8_t address) { (void)address; tx_len = 0; }
+	void beginTransmission(int address) { beginTransmission((uint8_t)address); }
+	uint8_t endTransmission(uint8_t sendStop);
+	uint8_t endTransmission(void) { return endTransmission(1); }
+	uint8_t requestFrom(uint8_t address, uint8_t quantity);
+	uint8_t requestFrom(int address, int quantity) { return requestFrom((uint8_t)address, (uint8_t)quantity); }
+	virtual size_t write(uint8_t data);
+	virtual size_t write(const uint8_t *data, size_t quantity);
+	virtual int available(void) { return rx_len - rx_pos; }
+	virtual int read(void) { return rx_pos < rx_len ? rx_buf[rx_pos++] : -1; }
+	virtual int peek(void) { return rx_pos < rx_len ? rx_buf[rx_pos] : -1; }
+	using Print::write;
+
+	// simulation side: current value of a codec register
+	uint16_t reg(uint16_t address) const { return regs[(address >> 1) & 0x1FF]; }
+
+private:
+	uint16_t regs[512];
+	uint16_t reg_addr;
+	uint8_t tx_buf[8];
+	uint8_t tx_len;
+	uint8_t rx_buf[8];
+	uint8_t rx_len, rx_pos;
+};
+
+extern TwoWire Wire;
+
+#endif
@@ -0,0 +1,71 @@
+/*
+ * arm_math.cpp (host simulation)
+ */
+
+#include "arm_math.h"
+
+#include <math.h>
+
+arm_status arm_cfft_radix4_init_q15(arm_cfft_radix4_instance_q15 *S,
+	uint16_t fftLen, uint8_t ifftFlag, uint8_t bitReverseFlag)
+{
+	// radix 4 lengths only, as on the Teensy
+	if (fftLen != 16 && fftLen != 64 && fftLen != 256 && fftLen != 1024) {
+		return ARM_MATH_ARGUMENT_ERROR;
+	}
+	S->fftLen = fftLen;
+	S->ifftFlag = ifftFlag;
+	S->bitReverseFlag = bitReverseFlag;
+	return ARM_MATH_SUCCESS;
+}
+
+// q15 twiddles for the largest length, cos and sin of -2 pi k / 1024
+static int16_t twiddle[2 * 512];
+
+static void make_twiddles(void)
+{
+	if (twiddle[0]) return;
+	for (int k = 0; k < 512; k++) {
+		twiddle[2 * k] = lround(cos(-2.0 * M_PI * k / 1024) * 32767.0);
+		twiddle[2 * k + 1] = lround(sin(-2.0 * M_PI * k / 1024) * 32767.0);
+	}
+}
+
+// decimation in frequency, halving every stage: log2(N) halvings divide the
+// result by N, like the 1/4 per radix-4 stage of the CMSIS version
+void arm_cfft_radix4_q15(const arm_cfft_radix4_instance_q15 *S, q15_t *pSrc)
+{
+	const int n = S->fftLen;
+	const int32_t sign = S->ifftFlag ? -1 : 1;
+
+	make_twiddles();
+	for (int half = n / 2; half >= 1; half /= 2) {
+		int stride = 512 / half;
+		for (int k = 0; k < half; k++) {
+			int32_t wr = twiddle[2 * k * stride];
+			int32_t wi = sign * twiddle[2 * k * stride + 1];
+			for (int i = k; i < n; i += 2 * half) {
+				q15_t *a = pSrc + 2 * i;
+				q15_t *b = pSrc + 2 * (i + half);
+				int32_t dr = a[0] - b[0], di = a[1] - b[1];
+				a[0] = (a[0] + b[0]) >> 1;
+				a[1] = (a[1] + b[1]) >> 1;
+				b[0] = ((int64_t)dr * wr - (int64_t)di * wi) >> 16;
+				b[1] = ((int64_t)dr * wi + (int64_t)di * wr) >> 16;
+			}
+		}
+	}
+	if (!S->bitReverseFlag) return;
+	for (int i = 1, j = 0; i < n; i++) {
+		int bit = n >> 1;
+		for (; j & bit; bit >>= 1) j ^= bit;
+		j |= bit;
+		if (i < j) {
+			q15_t r = pSrc[2 * i], m = pSrc[2 * i + 1];
+			pSrc[2 * i] = pSrc[2 * j];
+			pSrc[2 * i + 1] = pSrc[2 * j + 1];
+			pSrc[2 * j] = r;
+			pSrc[2 * j + 1] = m;
+		}
+	}
+}
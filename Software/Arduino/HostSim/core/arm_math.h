@@ -0,0 +1,34 @@
+/*
+ * arm_math.h (host simulation)
+ *
+ * The part of CMSIS-DSP the Audio library objects built here use: the q15
+ * radix-4 complex FFT.  Same interface and scaling as the Cortex-M4 library
+ * (the result is divided by the FFT length, in place, natural order when
+ * bitReverseFlag is set); the arithmetic is a plain radix-2 transform, so
+ * results agree to within a few LSB rather than bit for bit.
+ */
+
+#ifndef arm_math_h_
+#define arm_math_h_
+
+#include <stdint.h>
+
+typedef int16_t q15_t;
+typedef int32_t q31_t;
+
+typedef enum {
+	ARM_MATH_SUCCESS = 0,
+	ARM_MATH_ARGUMENT_ERROR = -1
+} arm_status;
+
+typedef struct {
+	uint16_t fftLen;
+	uint8_t ifftFlag;
+	uint8_t bitReverseFlag;
+} arm_cfft_radix4_instance_q15;
+
+arm_status arm_cfft_radix4_init_q15(arm_cfft_radix4_instance_q15 *S,
+	uint16_t fftLen, uint8_t ifftFlag, uint8_t bitReverseFlag);
+void arm_cfft_radix4_q15(const arm_cfft_radix4_instance_q15 *S, q15_t *pSrc);
+
+#endif
@@ -0,0 +1,200 @@
+/*
+ * dspinst_host.h (host simulation)
+ *
+ * Portable C equivalents of the Cortex-M4 DSP instruction wrappers in the
+ * Audio library's utility/dspinst.h, selected there when the library is built
+ * with AUDIO_HOST_SIMULATION.  Results are bit-identical to the instructions.
+ */
+
+#ifndef dspinst_host_h_
+#define dspinst_host_h_
+
+#include <stdint.h>
+
+static inline int32_t host_ssat(int64_t val, int bits)
+{
+	int64_t max = ((int64_t)1 << (bits - 1)) - 1;
+	int64_t min = -((int64_t)1 << (bits - 1));
+	if (val > max) return (int32_t)max;
+	if (val < min) return (int32_t)min;
+	return (int32_t)val;
+}
+
+static inline int16_t host_lo16(uint32_t a) { return (int16_t)(a & 0xFFFF); }
+static inline int16_t host_hi16(uint32_t a) { return (int16_t)(a >> 16); }
+
+// computes limit((val >> rshift), 2**bits)
+static inline int32_t signed_saturate_rshift(int32_t val, int bits, int rshift)
+{
+	return host_ssat(val >> rshift, bits);
+}
+
+// computes limit(val, 2**bits)
+static inline int16_t saturate16(int32_t val)
+{
+	return (int16_t)host_ssat(val, 16);
+}
+
+// computes ((a[31:0] * b[15:0]) >> 16)
+static inline int32_t signed_multiply_32x16b(int32_t a, uint32_t b)
+{
+	return ((int64_t)a * host_lo16(b)) >> 16;
+}
+
+// computes ((a[31:0] * b[31:16]) >> 16)
+static inline int32_t signed_multiply_32x16t(int32_t a, uint32_t b)
+{
+	return ((int64_t)a * host_hi16(b)) >> 16;
+}
+
+// computes (((int64_t)a[31:0] * (int64_t)b[31:0]) >> 32)
+static inline int32_t multiply_32x32_rshift32(int32_t a, int32_t b)
+{
+	return ((int64_t)a * b) >> 32;
+}
+
+// computes (((int64_t)a[31:0] * (int64_t)b[31:0] + 0x8000000) >> 32)
+static inline int32_t multiply_32x32_rshift32_rounded(int32_t a, int32_t b)
+{
+	return ((int64_t)a * b + 0x80000000LL) >> 32;
+}
+
+// computes sum + (((int64_t)a[31:0] * (int64_t)b[31:0] + 0x8000000) >> 32)
+static inline int32_t multiply_accumulate_32x32_rshift32_rounded(int32_t sum, int32_t a, int32_t b)
+{
+	return (((int64_t)sum << 32) + (int64_t)a * b + 0x80000000LL) >> 32;
+}
+
+// computes sum - (((int64_t)a[31:0] * (int64_t)b[31:0] + 0x8000000) >> 32)
+static inline int32_t multiply_subtract_32x32_rshift32_rounded(int32_t sum, int32_t a, int32_t b)
+{
+	return (((int64_t)sum << 32) - (int64_t)a * b + 0x80000000LL) >> 32;
+}
+
+// computes (a[31:16] | (b[31:16] >> 16))
+static inline uint32_t pack_16t_16t(int32_t a, int32_t b)
+{
+	return ((uint32_t)a & 0xFFFF0000) | ((uint32_t)b >> 16);
+}
+
+// computes (a[31:16] | b[15:0])
+static inline uint32_t pack_16t_16b(int32_t a, int32_t b)
+{
+	return ((uint32_t)a & 0xFFFF0000) | ((uint32_t)b & 0x0000FFFF);
+}
+
+// computes ((a[15:0] << 16) | b[15:0])
+static inline uint32_t pack_16b_16b(int32_t a, int32_t b)
+{
+	return ((uint32_t)a << 16) | ((uint32_t)b & 0x0000FFFF);
+}
+
+// computes (((a[31:16] + b[31:16]) << 16) | (a[15:0 + b[15:0]))  (saturates)
+static inline uint32_t signed_add_16_and_16(uint32_t a, uint32_t b)
+{
+	uint32_t lo = (uint16_t)host_ssat((int32_t)host_lo16(a) + host_lo16(b), 16);
+	uint32_t hi = (uint16_t)host_ssat((int32_t)host_hi16(a) + host_hi16(b), 16);
+	return (hi << 16) | lo;
+}
+
+// computes (((a[31:16] - b[31:16]) << 16) | (a[15:0 - b[15:0]))  (saturates)
+static inline int32_t signed_subtract_16_and_16(int32_t a, int32_t b)
+{
+	uint32_t lo = (uint16_t)host_ssat((int32_t)host_lo16(a) - host_lo16(b), 16);
+	uint32_t hi = (uint16_t)host_ssat((int32_t)host_hi16(a) - host_hi16(b), 16);
+	return (int32_t)((hi << 16) | lo);
+}
+
+// computes out = (((a[31:16]+b[31:16])/2) <<16) | ((a[15:0]+b[15:0])/2)
+static inline int32_t signed_halving_add_16_and_16(int32_t a, int32_t b)
+{
+	uint32_t lo = (uint16_t)(((int32_t)host_lo16(a) + host_lo16(b)) >> 1);
+	uint32_t hi = (uint16_t)(((int32_t)host_hi16(a) + host_hi16(b)) >> 1);
+	return (int32_t)((hi << 16) | lo);
+}
+
+// computes out = (((a[31:16]-b[31:16])/2) <<16) | ((a[15:0]-b[15:0])/2)
+static inline int32_t signed_halving_subtract_16_and_16(int32_t a, int32_t b)
+{
+	uint32_t lo = (uint16_t)(((int32_t)host_lo16(a) - host_lo16(b)) >> 1);
+	uint32_t hi = (uint16_t)(((int32_t)host_hi16(a) - host_hi16(b)) >> 1);
+	return (int32_t)((hi << 16) | lo);
+}
+
+// computes (sum + ((a[31:0] * b[15:0]) >> 16))
+static inline int32_t signed_multiply_accumulate_32x16b(int32_t sum, int32_t a, uint32_t b)
+{
+	return sum + (int32_t)(((int64_t)a * host_lo16(b)) >> 16);
+}
+
+// computes (sum + ((a[31:0] * b[31:16]) >> 16))
+static inline int32_t signed_multiply_accumulate_32x16t(int32_t sum, int32_t a, uint32_t b)
+{
+	return sum + (int32_t)(((int64_t)a * host_hi16(b)) >> 16);
+}
+
+// computes logical and
+static inline uint32_t logical_and(uint32_t a, uint32_t b)
+{
+	return a & b;
+}
+
+// computes ((a[15:0] * b[15:0]) + (a[31:16] * b[31:16]))
+static inline int32_t multiply_16tx16t_add_16bx16b(uint32_t a, uint32_t b)
+{
+	return (int32_t)host_lo16(a) * host_lo16(b) + (int32_t)host_hi16(a) * host_hi16(b);
+}
+
+// computes ((a[15:0] * b[31:16]) + (a[31:16] * b[15:0]))
+static inline int32_t multiply_16tx16b_add_16bx16t(uint32_t a, uint32_t b)
+{
+	return (int32_t)host_lo16(a) * host_hi16(b) + (int32_t)host_hi16(a) * host_lo16(b);
+}
+
+// computes sum += ((a[15:0] * b[15:0]) + (a[31:16] * b[31:16]))
+static inline int64_t multiply_accumulate_16tx16t_add_16bx16b(int64_t sum, uint32_t a, uint32_t b)
+{
+	return sum + (int64_t)host_lo16(a) * host_lo16(b) + (int64_t)host_hi16(a) * host_hi16(b);
+}
+
+// computes sum += ((a[15:0] * b[31:16]) + (a[31:16] * b[15:0]))
+static inline int64_t multiply_accumulate_16tx16b_add_16bx16t(int64_t sum, uint32_t a, uint32_t b)
+{
+	return sum + (int64_t)host_lo16(a) * host_hi16(b) + (int64_t)host_hi16(a) * host_lo16(b);
+}
+
+// computes ((a[15:0] * b[15:0])
+static inline int32_t multiply_16bx16b(uint32_t a, uint32_t b)
+{
+	return (int32_t)host_lo16(a) * host_lo16(b);
+}
+
+// computes ((a[15:0] * b[31:16])
+static inline int32_t multiply_16bx16t(uint32_t a, uint32_t b)
+{
+	return (int32_t)host_lo16(a) * host_hi16(b);
+}
+
+// computes ((a[31:16] * b[15:0])
+static inline int32_t multiply_16tx16b(uint32_t a, uint32_t b)
+{
+	return (int32_t)host_hi16(a) * host_lo16(b);
+}
+
+// computes ((a[31:16] * b[31:16])
+static inline int32_t multiply_16tx16t(uint32_t a, uint32_t b)
+{
+	return (int32_t)host_hi16(a) * host_hi16(b);
+}
+
+// computes (a - b), result saturated to 32 bit integer range
+static inline int32_t substract_32_saturate(uint32_t a, uint32_t b)
+{
+	return host_ssat((int64_t)(int32_t)a - (int32_t)b, 32);
+}
+
+// the host has no sticky saturation flag
+static inline uint32_t get_q_psr(void) { return 0; }
+static inline void clr_q_psr(void) { }
+
+#endif
@@ -0,0 +1,70 @@
+/*
+ * i2s.cpp (host simulation)
+ */
+
+#include "input_i2s.h"
+#include "output_i2s.h"
+#include "HostSim.h"
+#include "Wire.h"
+
+#include <math.h>
+
+// The audio source stands for the microphone at the sketch's default mic gain
+// (micGain(25) programs 24.5 dB); other settings of the codec's mic preamp and
+// ADC gain registers scale it, and clip it, the way the real input would.
+#define MIC_REFERENCE_DB 24.5f
+
+static int32_t mic_gain_q16(void)
+{
+	static const float preamp_db[4] = { 0.0f, 20.0f, 30.0f, 40.0f };
+	uint16_t mic = Wire.reg(0x002A);        // CHIP_MIC_CTRL
+	uint16_t adc = Wire.reg(0x0020);        // CHIP_ANA_ADC_CTRL
+	if (!mic && !adc) return 65536;         // codec not set up yet
+	float db = preamp_db[mic & 3] + (adc & 0x0F) * 1.5f;
+	return powf(10.0f, (db - MIC_REFERENCE_DB) / 20.0f) * 65536.0f;
+}
+
+static void apply_mic_gain(int16_t *data, int32_t gain)
+{
+	for (int i = 0; i < AUDIO_BLOCK_SAMPLES; i++) {
+		int32_t val = (int32_t)(((int64_t)data[i] * gain) >> 16);
+		data[i] = val > 32767 ? 32767 : (val < -32768 ? -32768 : val);
+	}
+}
+
+void AudioInputI2S::update(void)
+{
+	audio_block_t *left, *right;
+
+	left = allocate();
+	if (!left) return;
+	right = allocate();
+	if (!right) {
+		release(left);
+		return;
+	}
+	host_audio_input(left->data, right->data);
+	int32_t gain = mic_gain_q16();
+	if (gain != 65536) {
+		apply_mic_gain(left->data, gain);
+		apply_mic_gain(right->data, gain);
+	}
+	transmit(left, 0);
+	release(left);
+	transmit(right, 1);
+	release(right);
+}
+
+void AudioOutputI2S::update(void)
+{
+	audio_block_t *block;
+
+	for (int ch = 0; ch < 2; ch++) {
+		block = receiveReadOnly(ch);
+		if (block) {
+			memcpy(last[ch], block->data, sizeof(last[ch]));
+			release(block);
+			blocks++;
+		}
+	}
+}
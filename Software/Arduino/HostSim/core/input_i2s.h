@@ -0,0 +1,22 @@
+/*
+ * input_i2s.h (host simulation)
+ *
+ * Delivers one block per channel each update from host_audio_input(), scaled
+ * by the mic gain programmed into the codec.
+ */
+
+#ifndef _input_i2s_h_
+#define _input_i2s_h_
+
+#include "Arduino.h"
+#include "AudioStream.h"
+
+class AudioInputI2S : public AudioStream
+{
+public:
+	AudioInputI2S(void) : AudioStream(0, NULL) { begin(); }
+	virtual void update(void);
+	void begin(void) {}
+};
+
+#endif
@@ -0,0 +1,34 @@
+/*
+ * malloc.h (host simulation)
+ *
+ * newlib's mallinfo(), which the sketch's heap monitor reads on the Teensy,
+ * from glibc's mallinfo2() (glibc's own mallinfo() is deprecated and its int
+ * fields overflow).  The figures cover the whole process, simulator included;
+ * what matters is whether they move once the sketch is running.
+ */
+
+#ifndef host_malloc_h
+#define host_malloc_h
+
+#include_next <malloc.h>
+
+static inline struct mallinfo host_mallinfo(void)
+{
+	struct mallinfo2 m = mallinfo2();
+	struct mallinfo r;
+	r.arena = m.arena;
+	r.ordblks = m.ordblks;
+	r.smblks = m.smblks;
+	r.hblks = m.hblks;
+	r.hblkhd = m.hblkhd;
+	r.usmblks = m.usmblks;
+	r.fsmblks = m.fsmblks;
+	r.uordblks = m.uordblks;
+	r.fordblks = m.fordblks;
+	r.keepcost = m.keepcost;
+	return r;
+}
+
+#define mallinfo() host_mallinfo()
+
+#endif
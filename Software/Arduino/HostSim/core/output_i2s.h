@@ -0,0 +1,25 @@
+/*
+ * output_i2s.h (host simulation)
+ *
+ * Consumes the blocks sent to the codec and keeps the last one per channel.
+ */
+
+#ifndef output_i2s_h_
+#define output_i2s_h_
+
+#include "Arduino.h"
+#include "AudioStream.h"
+
+class AudioOutputI2S : public AudioStream
+{
+public:
+	AudioOutputI2S(void) : AudioStream(2, inputQueueArray) { begin(); }
+	virtual void update(void);
+	void begin(void) { memset(last, 0, sizeof(last)); blocks = 0; }
+	int16_t last[2][AUDIO_BLOCK_SAMPLES];
+	uint32_t blocks;
+private:
+	audio_block_t *inputQueueArray[2];
+};
+
+#endif
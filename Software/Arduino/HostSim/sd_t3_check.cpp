@@ -0,0 +1,356 @@
+/*
+ * sd_t3_check.cpp
+ *
+ * Host check of the Teensy 3 optimized SD library ( the _t3 files of
+ * libraries/SD, under the USE_TEENSY3_OPTIMIZED_CODE switch ), which the
+ * sketch doesn't build with yet.
+ *
+ * The library is compiled with the switch on, over a card layer that reads and
+ * writes a FAT image in memory.  The check writes, appends, truncates and
+ * removes files, writes two files at once while a third is read, fills a
+ * directory past its first cluster, records into a contiguous file the way
+ * FileSD.h does, and has a cache write-back fail.  Every file is read back and
+ * compared as it goes, and again after a remount.  The image is saved, and the
+ * expected contents of every file are written to a directory, for
+ * sd_t3_fsck.py to check the FAT copies, the cluster chains and the files
+ * independently.
+ *
+ * usage: sd_t3_check <image> <image out> <expected dir>
+ *   ( make sdcheck builds FAT16 and FAT32 images with sd_t3_mkfat.py and runs
+ *   both )
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <Arduino.h>
+#include <AudioStream.h>
+#include <SPI.h>
+
+// No pins: the card layer below replaces the SPI card access
+#define _SD_t3_ioreg_h_
+#define IO_REG_TYPE uint8_t
+#define PIN_TO_BASEREG(pin) ((volatile uint8_t *)0)
+#define PIN_TO_BITMASK(pin) (1)
+#define DIRECT_WRITE_HIGH(base, mask)
+#define DIRECT_WRITE_LOW(base, mask)
+#define SS 10
+static uint32_t rtc_get(void) { return 1539780000; }
+
+#define private public                                                  // the cache is checked from the inside
+#define __arm__ 1
+#define USE_TEENSY3_OPTIMIZED_CODE
+#include "SD_t3.h"
+#include "cache_t3.cpp"
+#include "fat_t3.cpp"
+#include "file_t3.cpp"
+#include "dir_t3.cpp"
+#include "init_t3.cpp"
+#undef private
+
+void AudioStream::update_all(void) {}
+
+// ==============================================================================================================
+// Card
+// An SDHC card holding the image; a write to fail_lba fails
+// ============================================================================================================== //
+static uint8_t  *img;
+static size_t   imgsize;
+static uint32_t writes, reads, multi_lba, multi_left;
+static uint32_t fail_lba = 0xFFFFFFFF;
+
+volatile uint8_t * SDClass::csreg;
+uint8_t SDClass::csmask;
+uint8_t SDClass::card_type;
+
+uint8_t SDClass::sd_cmd0() { return 1; }
+uint32_t SDClass::sd_cmd8() { return 0x1AA; }
+uint8_t SDClass::sd_acmd41(uint32_t) { return 0; }
+uint32_t SDClass::sd_cmd58() { return 0xC0000000; }
+
+bool SDClass::sd_read(uint32_t lba, void *data)
+{
+	if ((lba + 1) * 512 > imgsize) return false;
+	reads++;
+	memcpy(data, img + lba * 512, 512);
+	return true;
+}
+
+bool SDClass::sd_write(uint32_t lba, const void *data)
+{
+	if ((lba + 1) * 512 > imgsize || lba == fail_lba) return false;
+	writes++;
+	memcpy(img + lba * 512, data, 512);
+	return true;
+}
+
+bool SDClass::sd_write_start(uint32_t lba, uint32_t count) { multi_lba = lba; multi_left = count; return true; }
+bool SDClass::sd_write_data(const void *data) { if (!multi_left) return false; multi_left--; return sd_write(multi_lba++, data); }
+bool SDClass::sd_write_stop() { return true; }
+
+bool SDClass::writeBlocks(uint32_t lba, const uint8_t *src, uint16_t count)
+{
+	SDCache::invalidate(lba, count);
+	SPI.beginTransaction(SD_SPI_SPEED);
+	bool ret = sd_write_start(lba, count);
+	if (ret) {
+		for (uint16_t i=0; i < count; i++) {
+			if (!sd_write_data(src)) {
+				ret = false;
+				break;
+			}
+			src += 512;
+		}
+		ret = sd_write_stop() && ret;
+	}
+	SPI.endTransaction();
+	return ret;
+}
+
+// ==============================================================================================================
+// Files
+// Every file holds a pattern of its name and position
+// ============================================================================================================== //
+static const char *expectDir;
+static int        fails;
+
+#define CHECK(x) do { if (!(x)) { printf("FAIL line %d: %s\n", __LINE__, #x); fails++; } } while (0)
+
+static uint8_t pattern(const char *name, uint32_t i)
+{
+	return (uint8_t)(i * 7 + name[0] * 13 + (i >> 9) * 3);
+}
+
+static void expect(const char *name, uint32_t len)                      // for sd_t3_fsck.py
+{
+	char path[256];
+	snprintf(path, sizeof path, "%s/%s", expectDir, name);
+	FILE *f = fopen(path, "wb");
+	if (!f) return;
+	for (uint32_t i = 0; i < len; i++) fputc(pattern(name, i), f);
+	fclose(f);
+}
+
+static bool verify(const char *name, uint32_t len)
+{
+	File f = SD.open(name);
+	if (!f || f.size() != len) {
+		printf("%s: size %u, expected %u\n", name, f ? f.size() : 0, len);
+		return false;
+	}
+	uint8_t buf[1500];
+	uint32_t pos = 0;
+	while (pos < len) {
+		int got = f.read(buf, 1 + rand() % sizeof buf);
+		if (got <= 0) {
+			printf("%s: reading stops at %u\n", name, pos);
+			return false;
+		}
+		for (int i = 0; i < got; i++) {
+			if (buf[i] != pattern(name, pos + i)) {
+				printf("%s: wrong at %u\n", name, pos + i);
+				return false;
+			}
+		}
+		pos += got;
+	}
+	CHECK(f.read(buf, 10) == 0);
+	for (int k = 0; k < 50 && len; k++) {
+		uint32_t at = rand() % len;
+		CHECK(f.seek(at));
+		int b = f.read();
+		if (b != pattern(name, at)) {
+			printf("%s: seek to %u reads %d\n", name, at, b);
+			return false;
+		}
+	}
+	CHECK(f.seek(len));
+	CHECK(f.read() == -1);
+	return true;
+}
+
+static uint32_t writePattern(File &f, const char *name, uint32_t from, uint32_t len)
+{
+	uint8_t buf[2000];
+	uint32_t pos = from, end = from + len;
+	while (pos < end) {
+		uint32_t n = 1 + rand() % sizeof buf;
+		if (rand() & 1) n = (rand() & 1) ? 512 : 256;                  // whole and half sectors too
+		if (n > end - pos) n = end - pos;
+		for (uint32_t i = 0; i < n; i++) buf[i] = pattern(name, pos + i);
+		if (f.write(buf, n) != n) {
+			printf("%s: short write at %u\n", name, pos);
+			return pos;
+		}
+		pos += n;
+	}
+	return pos;
+}
+
+// ==============================================================================================================
+// Main
+// ============================================================================================================== //
+int main(int argc, char **argv)
+{
+	if (argc < 4) {
+		fprintf(stderr, "usage: %s <image> <image out> <expected dir>\n", argv[0]);
+		return 2;
+	}
+	FILE *fi = fopen(argv[1], "rb");
+	if (!fi) {
+		fprintf(stderr, "cannot read %s\n", argv[1]);
+		return 2;
+	}
+	fseek(fi, 0, SEEK_END);
+	imgsize = ftell(fi);
+	rewind(fi);
+	img = (uint8_t *)malloc(imgsize);
+	if (fread(img, 1, imgsize, fi) != imgsize) return 2;
+	fclose(fi);
+	expectDir = argv[3];
+	srand(1);
+	CHECK(SD.begin());
+
+	// 1: a new file, written in chunks of every size
+	File a = SD.open("A.TXT", FILE_WRITE);
+	CHECK(a);
+	writePattern(a, "A.TXT", 0, 100000);
+	a.close();
+	CHECK(verify("A.TXT", 100000));
+
+	// 2: appending, up to a cluster boundary and past it
+	a = SD.open("A.TXT", FILE_WRITE);
+	CHECK(a.position() == 100000);
+	uint32_t csize = 512u << SDClass::sector2cluster;
+	uint32_t end = (100000 / csize + 3) * csize;
+	writePattern(a, "A.TXT", 100000, end - 100000);
+	a.close();
+	CHECK(verify("A.TXT", end));
+	a = SD.open("A.TXT", FILE_WRITE);
+	writePattern(a, "A.TXT", end, 777);
+	a.close();
+	CHECK(verify("A.TXT", end + 777));
+	expect("A.TXT", end + 777);
+
+	// 3: two files written at once while a third is read
+	File b = SD.open("B.RAW", FILE_WRITE), c = SD.open("C.RAW", FILE_WRITE), r = SD.open("A.TXT");
+	uint32_t pb = 0, pc = 0;
+	uint8_t rb[300];
+	for (int k = 0; k < 400; k++) {
+		pb = writePattern(b, "B.RAW", pb, 1 + rand() % 700);
+		pc = writePattern(c, "C.RAW", pc, 1 + rand() % 700);
+		if (r.read(rb, sizeof rb) <= 0) r.seek(0);
+		if (k % 97 == 0) b.flush();
+	}
+	b.close();
+	c.close();
+	r.close();
+	CHECK(verify("B.RAW", pb));
+	CHECK(verify("C.RAW", pc));
+	expect("B.RAW", pb);
+	expect("C.RAW", pc);
+
+	// 4: more files than the first directory cluster holds, half removed
+	char name[16];
+	for (int i = 0; i < 40; i++) {
+		snprintf(name, sizeof name, "F%02d.DAT", i);
+		File f = SD.open(name, FILE_WRITE);
+		CHECK(f);
+		writePattern(f, name, 0, i * 100);
+		f.close();
+	}
+	for (int i = 0; i < 40; i++) {
+		snprintf(name, sizeof name, "F%02d.DAT", i);
+		CHECK(verify(name, i * 100));
+	}
+	for (int i = 0; i < 40; i += 2) {
+		snprintf(name, sizeof name, "F%02d.DAT", i);
+		CHECK(SD.remove(name));
+		CHECK(!SD.exists(name));
+	}
+	for (int i = 1; i < 40; i += 2) {
+		snprintf(name, sizeof name, "F%02d.DAT", i);
+		expect(name, i * 100);
+	}
+	CHECK(!SD.remove("NONE.DAT"));
+
+	// 5: a contiguous recording, as FileSD.h makes one, read while written
+	File rec = SD.createContiguous("REC.WAV", 1000000);
+	CHECK(rec);
+	CHECK(rec.size() == 1000000);
+	CHECK(!SD.createContiguous("REC.WAV", 1000));
+	uint32_t first, last;
+	CHECK(rec.contiguousRange(&first, &last));
+	CHECK(last - first + 1 >= 1000000 / 512);
+	uint8_t blocks[8 * 512];
+	uint32_t lba = first, recsize = 123456;
+	File peek = SD.open("REC.WAV");
+	uint8_t tmp[600];
+	CHECK(peek.read(tmp, 600) == 600);                                  // its first sectors in the cache
+	for (uint32_t pos = 0; pos < recsize; pos += sizeof blocks) {
+		for (uint32_t i = 0; i < sizeof blocks; i++) blocks[i] = pattern("REC.WAV", pos + i);
+		CHECK(SD.writeBlocks(lba, blocks, 8));
+		lba += 8;
+	}
+	CHECK(rec.seek(0));
+	uint8_t hdr[100];
+	for (int i = 0; i < 100; i++) hdr[i] = pattern("REC.WAV", i);
+	CHECK(rec.write(hdr, 100) == 100);
+	CHECK(rec.truncate(recsize));
+	rec.close();
+	peek.close();
+	CHECK(verify("REC.WAV", recsize));
+	expect("REC.WAV", recsize);
+	File t = SD.open("T.BIN", FILE_WRITE);
+	writePattern(t, "T.BIN", 0, 5000);
+	CHECK(t.truncate(0));
+	t.close();
+	CHECK(verify("T.BIN", 0));
+	expect("T.BIN", 0);
+
+	// 6: every cache entry dirty, and the oldest cannot be written back: it
+	// must stay dirty, holding its sector, rather than be reused ( sectors at
+	// the end of the card, which no file uses )
+	CHECK(SDCache::flush_all());
+	uint32_t scratch = imgsize / 512 - 2 * SD_CACHE_SIZE;
+	for (int i = 0; i < SD_CACHE_SIZE; i++) {
+		SDCache sc;
+		SDClass::sector_t *s = sc.alloc(scratch + i);
+		CHECK(s);
+		if (!s) break;
+		memset(s, 0xA0 + i, 512);
+		sc.item->flags |= CACHE_FLAG_IS_DIRTY;                          // not dirty(), which would write back the oldest
+	}
+	fail_lba = scratch;
+	{
+		SDCache sc;
+		CHECK(sc.read(scratch + SD_CACHE_SIZE) == NULL);
+	}
+	int held = 0;
+	for (int i = 0; i < SD_CACHE_SIZE; i++) {
+		if (SDCache::cache[i].lba == scratch && (SDCache::cache[i].flags & CACHE_FLAG_IS_DIRTY)) held++;
+	}
+	CHECK(held == 1);
+	CHECK(!SDCache::flush_all());
+	fail_lba = 0xFFFFFFFF;
+	{
+		SDCache sc;
+		CHECK(sc.read(scratch + SD_CACHE_SIZE) != NULL);                // written back, then reused
+	}
+	CHECK(SDCache::flush_all());
+	for (int i = 0; i < SD_CACHE_SIZE; i++) CHECK(img[(scratch + i) * 512] == 0xA0 + i);
+
+	// and again after a remount, with nothing cached
+	SDCache::init();
+	CHECK(SD.begin());
+	CHECK(verify("A.TXT", end + 777));
+	CHECK(verify("REC.WAV", recsize));
+	CHECK(verify("C.RAW", pc));
+
+	FILE *fo = fopen(argv[2], "wb");
+	if (!fo || fwrite(img, 1, imgsize, fo) != imgsize) return 2;
+	fclose(fo);
+	printf("%s: %d failures, %u sector writes, %u reads\n", argv[1], fails, writes, reads);
+	return fails != 0;
+}
@@ -0,0 +1,87 @@
+"""
+sd_t3_fsck.py
+
+Checks a card image written by sd_t3_check, without the SD library: the two
+FAT copies match, no cluster is lost or in two chains, every file has as many
+clusters as its size needs, the FAT32 free count is right or unknown, and,
+given the expected directory, every file holds what it should. Exits non-zero
+on any error.
+
+usage: sd_t3_fsck.py <image> [<expected dir>]
+"""
+import struct, sys, os, hashlib
+
+img = open(sys.argv[1], 'rb').read()
+part = struct.unpack_from('<I', img, 446 + 8)[0] * 512
+bps, spc, rsv, nf, rootent, tot16, _, fsz16 = struct.unpack_from('<HBHBHHBH', img, part + 11)
+tot32 = struct.unpack_from('<I', img, part + 32)[0]
+fsz = fsz16 or struct.unpack_from('<I', img, part + 36)[0]
+total = tot16 or tot32
+rootsec = rootent * 32 // 512
+fat1 = part + rsv * 512
+fat2 = fat1 + fsz * 512
+data = fat2 + fsz * 512 + rootsec * 512
+clusters = (total - rsv - rootsec - 2 * fsz) // spc
+fat32 = clusters >= 65525
+errors = []
+if img[fat1:fat1 + fsz * 512] != img[fat2:fat2 + fsz * 512]:
+    errors.append('FAT copies differ')
+def fat(c):
+    if fat32: return struct.unpack_from('<I', img, fat1 + 4 * c)[0] & 0x0FFFFFFF
+    return struct.unpack_from('<H', img, fat1 + 2 * c)[0]
+EOC = 0x0FFFFFF8 if fat32 else 0xFFF8
+csize = spc * 512
+def chain(c):
+    out = []
+    while 2 <= c <= clusters + 1:
+        if c in out: errors.append('loop'); break
+        out.append(c); c = fat(c)
+    if c < EOC and out: errors.append('chain ends with %x' % c)
+    return out
+def cdata(c): o = data + (c - 2) * csize; return img[o:o + csize]
+used = {}
+files = {}
+def walk(entries_bytes, path, owner):
+    for i in range(0, len(entries_bytes), 32):
+        e = entries_bytes[i:i + 32]
+        if e[0] == 0: break
+        if e[0] == 0xE5 or e[11] == 0x0F: continue
+        name = (e[0:8].decode().rstrip() + ('.' + e[8:11].decode().rstrip() if e[8:11].strip() else ''))
+        if name in ('.', '..'): continue
+        if e[11] & 8: continue
+        cl = (struct.unpack_from('<H', e, 20)[0] << 16) | struct.unpack_from('<H', e, 26)[0]
+        size = struct.unpack_from('<I', e, 28)[0]
+        ch = chain(cl) if cl else []
+        for c in ch:
+            if c in used: errors.append('crosslink %s %s' % (name, used[c]))
+            used[c] = path + name
+        if e[11] & 0x10:
+            walk(b''.join(cdata(c) for c in ch), path + name + '/', name)
+        else:
+            need = (size + csize - 1) // csize
+            if need != len(ch): errors.append('%s size %d clusters %d' % (name, size, len(ch)))
+            files[path + name] = b''.join(cdata(c) for c in ch)[:size]
+if fat32:
+    rc = struct.unpack_from('<I', img, part + 44)[0]
+    rch = chain(rc)
+    for c in rch: used[c] = '/'
+    walk(b''.join(cdata(c) for c in rch), '', '/')
+else:
+    walk(img[fat2 + fsz * 512: data], '', '/')
+lost = [c for c in range(2, clusters + 2) if fat(c) != 0 and c not in used]
+if lost: errors.append('%d lost clusters' % len(lost))
+if fat32:
+    fi = part + struct.unpack_from('<H', img, part + 48)[0] * 512
+    free = struct.unpack_from('<I', img, fi + 488)[0]
+    real = sum(1 for c in range(2, clusters + 2) if fat(c) == 0)
+    if free != 0xFFFFFFFF and free != real: errors.append('fsinfo free %d real %d' % (free, real))
+print('fat32' if fat32 else 'fat16', len(files), 'files', 'ERRORS: ' + '; '.join(errors) if errors else 'clean')
+if len(sys.argv) > 2:
+    for n in sorted(files): print(n, len(files[n]), hashlib.md5(files[n]).hexdigest()[:8])
+if len(sys.argv) > 2 and os.path.isdir(sys.argv[2]):
+    names = sorted(os.listdir(sys.argv[2]))
+    bad = [n for n in names if files.get(n) != open(os.path.join(sys.argv[2], n), 'rb').read()]
+    extra = sorted(set(files) - set(names))
+    print('content mismatches:', bad, 'unexpected files:', extra)
+    if bad or extra: errors.append('contents')
+sys.exit(1 if errors else 0)
@@ -0,0 +1,54 @@
+"""
+sd_t3_mkfat.py
+
+An empty FAT16 or FAT32 card image for sd_t3_check: a partition table, one
+partition and two FATs.
+
+usage: sd_t3_mkfat.py <image> fat16|fat32
+"""
+import struct, sys
+
+def mk(path, kind):
+    part_lba = 63
+    if kind == 'fat32':
+        spc, clusters, rsv = 1, 70000, 32
+        ent = 4
+    else:
+        spc, clusters, rsv = 4, 20000, 4
+        ent = 2
+    fat_sectors = ((clusters + 2) * ent + 511) // 512
+    root_entries = 0 if kind == 'fat32' else 512
+    root_sectors = root_entries * 32 // 512
+    total = rsv + 2 * fat_sectors + root_sectors + clusters * spc
+    img = bytearray((part_lba + total) * 512)
+    # MBR
+    ptype = 0x0C if kind == 'fat32' else 0x06
+    img[446:462] = struct.pack('<B3sB3sII', 0, b'\0\0\0', ptype, b'\0\0\0', part_lba, total)
+    img[510:512] = b'\x55\xaa'
+    b = bytearray(512)
+    b[0:3] = b'\xeb\x58\x90'; b[3:11] = b'MSWIN4.1'
+    struct.pack_into('<HBHBHHBHHHII', b, 11, 512, spc, rsv, 2, root_entries,
+                     0 if total > 65535 else total, 0xF8, fat_sectors if kind == 'fat16' else 0, 63, 255, part_lba, total if total > 65535 else 0)
+    if kind == 'fat32':
+        struct.pack_into('<IHHIHH', b, 36, fat_sectors, 0, 0, 2, 1, 6)
+        b[82:90] = b'FAT32   '
+    else:
+        b[54:62] = b'FAT16   '
+    b[510:512] = b'\x55\xaa'
+    base = part_lba * 512
+    img[base:base + 512] = b
+    if kind == 'fat32':
+        fi = bytearray(512)
+        struct.pack_into('<I', fi, 0, 0x41615252)
+        struct.pack_into('<III', fi, 484, 0x61417272, clusters - 1, 3)
+        fi[510:512] = b'\x55\xaa'
+        img[base + 512:base + 1024] = fi
+    for f in range(2):
+        off = base + (rsv + f * fat_sectors) * 512
+        if kind == 'fat32':
+            struct.pack_into('<III', img, off, 0x0FFFFFF8, 0x0FFFFFFF, 0x0FFFFFFF)  # root in cluster 2
+        else:
+            struct.pack_into('<HH', img, off, 0xFFF8, 0xFFFF)
+    open(path, 'wb').write(img)
+
+mk(sys.argv[1], sys.argv[2])
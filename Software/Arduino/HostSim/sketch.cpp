@@ -0,0 +1,128 @@
+/*
+ * sketch.cpp
+ *
+ * Builds Stethoscope.ino for the host, the way the Arduino IDE would (the
+ * sketch is included after Arduino.h), and adds the few accessors the
+ * benchmark driver needs to reach sketch globals from its own translation
+ * unit.
+ */
+
+#include <Arduino.h>
+#include "Stethoscope.ino"
+
+int hostSketchMode( void ) {
+  return mode;
+}
+
+// The default sound set ( Config.h ); the driver writes these to the card
+// before setup() so that the catalog finds them at boot.
+int hostSketchSoundCount( void ) {
+  return lenDefaultSounds;
+}
+
+const char * hostSketchSound( int index ) {
+  if ( index < 0 || index >= lenDefaultSounds ) return NULL;
+  return defaultSounds[index];
+}
+
+// Playback (mode 2) has no opcode of its own -- STARTPLAY is stubbed out in
+// parseBtByte() -- so the driver starts it directly.
+void hostSketchStartPlaying( const char * name ) {
+  startPlaying( name );
+}
+
+// Encode cost of the last recording ( see RecordCodec.h )
+uint32_t hostSketchCodecStats( uint32_t * cyclesMax, uint32_t * blocks, double * ratio ) {
+  *ratio     = codecBytes ? 2.0 * codecSamples / codecBytes : 0.0;
+  *cyclesMax = codecCyclesMax;
+  *blocks    = codecBlocks;
+  return codecCycles;
+}
+
+// Sound starts timed by soundPlay() ( source 0 SD card, 1 flash ), and the
+// number of sounds with a trusted flash copy ( see SoundLibrary.h )
+uint32_t hostSketchSoundStarts( int source, uint32_t * mean, uint32_t * max, int * inFlash ) {
+  const SoundStats & st = soundStats[source];
+  *mean    = st.count ? st.total / st.count : 0;
+  *max     = st.max;
+  *inFlash = 0;
+  for ( int i = 0; i < SOUND_MAX; i++ ) if ( sounds[i].inFlash ) ( *inFlash )++;
+  return st.count;
+}
+
+// Time [us] at which boot phase <phase> finished ( see Boot.h ), 0 if it has
+// not yet; <name> is NULL past the last phase
+uint32_t hostSketchBootAt( int phase, const char ** name ) {
+  if ( phase < 0 || phase >= BOOT_PHASES ) {
+    *name = NULL;
+    return 0;
+  }
+  *name = bootPhaseName[phase];
+  return bootAt[phase];
+}
+
+// Heap in use at the last sample of the heap monitor ( see HeapMonitor.h )
+uint32_t hostSketchHeap( uint32_t * usedPeak, uint32_t * fragmented ) {
+  heapSample();
+  *usedPeak   = heapStats.usedPeak;
+  *fragmented = heapStats.fragmented;
+  return heapStats.used;
+}
+
+// Most audio blocks in use ( of <pool> ), overruns and late passes of the
+// audio interrupt since the last call; starts the counts again, as AUDIOSTATS
+// does
+int hostSketchAudioLoad( int * pool, uint32_t * overruns, uint32_t * late ) {
+  int blocksMax = AudioMemoryUsageMax();
+  *pool     = AUDIO_BLOCKS;
+  *overruns = audioLoad.overruns();
+  *late     = audioLoad.late();
+  AudioMemoryUsageMaxReset();
+  audioLoad.reset();
+  return blocksMax;
+}
+
+// Telemetry records sampled since STARTTELEM, frames sent and dropped
+// ( see Telemetry.h )
+uint32_t hostSketchTelemetry( uint32_t * frames, uint32_t * dropped ) {
+  *frames  = telem.frames;
+  *dropped = telem.dropped;
+  return telem.records;
+}
+
+// Live audio packets sent since STARTSTREAM, and dropped ( see LiveStream.h )
+uint32_t hostSketchStream( uint32_t * dropped ) {
+  *dropped = live.dropped;
+  return live.packets;
+}
+
+// Heart rate of the last beat reported while monitoring
+float hostSketchHeartRate( void ) {
+  return hr;
+}
+
+// Keep the whole audio graph connected ( false ), as it was before
+// AudioGraph.h, or connect only what the mode needs ( true, the default )
+void hostSketchGraphManaged( bool managed ) {
+  graphManaged = managed;
+  graphUpdate();
+}
+
+// Objects of the audio graph the interrupt runs ( see AudioGraph.h )
+int hostSketchAudioActive( void ) {
+  int active = 0;
+  for ( int i = 0; i < lenAudioObjects; i++ ) if ( audioObjects[i].stream->isActive() ) active++;
+  return active;
+}
+
+// Bytes preallocated per recording ( FileSD.h ), 0 for RECORD_PREALLOC; a small
+// one makes recordings run past it into the file system fallback
+void hostSketchRecordPrealloc( uint32_t bytes ) {
+  recordPrealloc = bytes ? bytes : RECORD_PREALLOC;
+}
+
+// Called with every block a recording takes, before its codec ( FileSD.h ), so
+// the driver can compare the decoded file with what went in
+void hostSketchRecordTap( void ( *tap )( const int16_t * src, int n ) ) {
+  recordTap = tap;
+}
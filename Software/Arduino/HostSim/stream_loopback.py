@@ -0,0 +1,141 @@
+"""
+stream_loopback.py
+
+Loopback test of the live audio stream ( Stethoscope/LiveStream.h ) through a
+pseudo-tty. bench_loop runs the "stream" scenario, ADPCM at 5.5 kHz then
+mu-law at 7.4 kHz, and writes what the sketch sends over bluetooth into the
+pty as it is sent; Python/Stethoscope/streamReceiver.py reads the other side
+in real time, through its jitter buffer, as it would the BT serial port. One
+byte in DAMAGE_EVERY is damaged on the way.
+
+Passes when
+    every packet arrived, or was lost to a damaged byte, or was dropped by
+    the sketch because the one before was still going out
+    only the missing packets were concealed; none came late or was skipped
+    both streams are heard at their own rate
+    each stream is the bench's 72 bpm heart sound ( envelope autocorrelation )
+
+usage: python3 stream_loopback.py          ( or make loopback, after make )
+"""
+
+# Import Libraries and/or Modules
+import  os, re, select, subprocess, sys, time, tty
+
+sys.path.insert( 0, os.path.join( os.path.dirname( os.path.abspath( __file__ ) ), "../../Python/Stethoscope" ) )
+import  streamReceiver
+
+DAMAGE_EVERY    = 9000                      # bytes
+BPM             = 72.0                      # bench_loop's synthetic heart sound
+ENVELOPE_RATE   = 100                       # Hz
+
+# The master side of the pty, read like a serial port, damaging a byte now and then
+class PtyLink:
+    def __init__( self, fd ):
+        self.fd      = fd
+        self.count   = 0
+        self.damaged = 0
+
+    def read( self, n ):
+        ready, _, _ = select.select( [ self.fd ], [], [], 0.02 )
+        if not ready:
+            return b""
+        try:
+            data = bytearray( os.read( self.fd, n ) )
+        except OSError:                                                 # bench_loop has closed the pty
+            return b""
+        for i in range( len( data ) ):
+            self.count += 1
+            if self.count % DAMAGE_EVERY == 0:
+                data[ i ] ^= 0x5A
+                self.damaged += 1
+        return bytes( data )
+
+# Heart rate of a stretch of audio, from the autocorrelation of its envelope
+def heartRate( samples, rate ):
+    step     = int( rate / ENVELOPE_RATE )
+    envelope = [ sum( abs( s ) for s in samples[ i:i + step ] ) for i in range( 0, len( samples ) - step, step ) ]
+    mean     = sum( envelope ) / len( envelope )
+    envelope = [ e - mean for e in envelope ]
+    best     = max( range( ENVELOPE_RATE // 2, int( ENVELOPE_RATE * 1.5 ) ),
+                    key = lambda lag: sum( envelope[i] * envelope[ i + lag ] for i in range( len( envelope ) - lag ) ) )
+    return 60.0 * ENVELOPE_RATE / best
+
+def main():
+    here          = os.path.dirname( os.path.abspath( __file__ ) )
+    master, slave = os.openpty()
+    tty.setraw( slave )
+    bench   = subprocess.Popen( [ os.path.join( here, "bench_loop" ), "-s", "stream", "-v", "-o", os.ttyname( slave ) ],
+                                cwd = here, stdout = subprocess.PIPE, stderr = subprocess.STDOUT, universal_newlines = True )
+    link    = PtyLink( master )
+    reader  = streamReceiver.PacketReader()
+    jitter  = streamReceiver.JitterBuffer()
+    heard   = []                                                        # [ rate, samples ] per stream
+    streams = []                                                        # packet numbers decoded, per stream
+    done    = []
+
+    def sink( samples ):
+        if not samples:
+            return
+        if not heard or heard[-1][0] != jitter.rate:
+            heard.append( [ jitter.rate, [] ] )
+        heard[-1][1].extend( samples )
+
+    def stop():
+        if not done and bench.poll() is not None:
+            done.append( time.time() )
+        return done and time.time() - done[0] > 1.0                     # let the jitter buffer play out
+
+    class Counting:                                                     # notes what the parser finds
+        def feed( self, data ):
+            found = reader.feed( data )
+            for p in found:
+                if not streams or p.seq < streams[-1][-1]:
+                    streams.append( [] )
+                streams[-1].append( p.seq )
+            return found
+
+    streamReceiver.receive( link, Counting(), jitter, stop, sink )
+    output = bench.stdout.read()
+    os.close( master )
+    os.close( slave )
+
+    sent     = [ ( int( n ), int( d ) ) for n, d in re.findall( r"Stream: (\d+) packets, (\d+) dropped", output ) ]
+    decoded  = sum( len( s ) for s in streams )
+    missing  = sum( s[-1] + 1 - len( s ) for s in streams )
+    dropped  = sum( d for n, d in sent )
+    print( "\n".join( l for l in output.splitlines() if " blocked " in l or l.startswith( "  " ) ) )     # not the console echo
+    print( "loopback: %d bytes, %d damaged; %d packets decoded, %d missing, %d dropped by the sketch, %d crc errors; "
+           "concealed %d, underruns %d, late %d, skipped %d" % ( link.count, link.damaged, decoded, missing, dropped,
+           reader.crcErrors, jitter.concealed, jitter.underruns, jitter.late, jitter.skipped ) )
+
+    failures = []
+    rates    = [ round( r ) for r, s in heard ]
+    print( "loopback: heard %s" % ", ".join( "%.2f s at %d Hz" % ( len( s ) / r, r ) for r, s in heard ) )
+    if rates != [ 5515, 7353 ]:
+        failures.append( "streams heard at %s Hz, not 5515 then 7353" % rates )
+    for r, s in heard:
+        bpm = heartRate( s, r )
+        print( "loopback: %d Hz stream, heart rate %.1f bpm" % ( round( r ), bpm ) )
+        if abs( bpm - BPM ) > 3.0:
+            failures.append( "%d Hz stream: heart rate %.1f bpm, not %.0f" % ( round( r ), bpm, BPM ) )
+    numbered = [ s[-1] + 1 for s in streams ]
+    if numbered != [ n + d for n, d in sent ]:
+        failures.append( "streams of %s packets received, %s numbered by the sketch" % ( numbered, [ n + d for n, d in sent ] ) )
+    if missing - dropped > link.damaged:
+        failures.append( "%d packets lost for %d damaged bytes" % ( missing - dropped, link.damaged ) )
+    if jitter.concealed != missing:
+        failures.append( "%d packets concealed for %d missing" % ( jitter.concealed, missing ) )
+    if link.damaged and reader.crcErrors == 0:
+        failures.append( "damaged bytes went unnoticed" )
+    if jitter.late or jitter.skipped:
+        failures.append( "%d packets late, %d skipped" % ( jitter.late, jitter.skipped ) )
+    if bench.returncode != 0:
+        failures.append( "bench_loop failed" )
+
+    for f in failures:
+        print( "FAIL: " + f )
+    print( "loopback: " + ( "FAILED" if failures else "passed" ) )
+    return 1 if failures else 0
+
+if __name__ == "__main__":
+    sys.exit( main() )
@@ -0,0 +1,110 @@
+/*
+ * AudioGraph.h
+ *
+ * Connects only the part of the audio graph ( TeensyAudio.h ) that is in use. The patch cords are all made when the
+ * sketch starts; from then on every cord carries a set of needs, and it stays connected only while all of them are
+ * asked for: by the mode ( graphModeNeeds[] ), or by a feature that runs across modes ( graphUse(): telemetry, live
+ * audio, multi-channel recording ). An object left without connections is inactive, so the audio interrupt skips it,
+ * and a cord being disconnected releases the block waiting on it. The mic to the speaker is always connected.
+ *
+ * AUDIOSTATS shows which objects are active, and what they cost.
+ */
+
+// ==============================================================================================================
+// Variables
+// ============================================================================================================== //
+#define   GRAPH_PLAYBACK      0x01                                                                                // sound players, level matching, into the blend and the mic/SD mixer
+#define   GRAPH_RECORD        0x02                                                                                // record queues
+#define   GRAPH_HEART         0x04                                                                                // heartBeat, heartRate and peak_QrsMeter
+#define   GRAPH_LEVELS        0x08                                                                                // peak and RMS meters, for telemetry
+#define   GRAPH_STREAM        0x10                                                                                // live audio queue
+#define   GRAPH_FILTERED      0x20                                                                                // filter_LowPass_2 into the speaker mixer ( testFilters() )
+#define   GRAPH_ALL           0xFF
+
+struct GraphCord {
+  AudioConnection *cord;
+  uint8_t          needs;                                                                                         // all of these, 0 for always
+};
+
+const GraphCord graphCords[] = {
+  { &patchCord1,   GRAPH_FILTERED                   },                                                            // i2s_mic           -> filter_LowPass_2
+  { &patchCord2,   0                                },                                                            // i2s_mic           -> rms_mic_mixer
+  { &patchCord3,   GRAPH_FILTERED                   },                                                            // i2s_mic           -> filter_LowPass_2
+  { &patchCord4,   0                                },                                                            // i2s_mic           -> rms_mic_mixer
+  { &patchCord5,   GRAPH_PLAYBACK                   },                                                            // playRaw_sd        -> rms_playRaw_mixer
+  { &patchCord6,   0                                },                                                            // micAgc            -> blendFader
+  { &patchCord7,   GRAPH_LEVELS                     },                                                            // micAgc            -> mic_peaks
+  { &patchCord8,   GRAPH_LEVELS                     },                                                            // micAgc            -> mic_rms
+  { &patchCord9,   GRAPH_PLAYBACK                   },                                                            // playRawMatch      -> mixer_mic_Sd
+  { &patchCord10,  GRAPH_PLAYBACK | GRAPH_LEVELS    },                                                            // rms_playRaw_mixer -> playRaw_rms
+  { &patchCord11,  GRAPH_PLAYBACK | GRAPH_LEVELS    },                                                            // rms_playRaw_mixer -> playRaw_peaks
+  { &patchCord12,  0                                },                                                            // mixer_mic_Sd      -> filter_LowPass_1
+  { &patchCord13,  GRAPH_FILTERED                   },                                                            // filter_LowPass_2  -> mixer_allToSpk
+  { &patchCord14,  GRAPH_RECORD                     },                                                            // filter_LowPass_1  -> decimate_recMic
+  { &patchCord15,  0                                },                                                            // filter_LowPass_1  -> mixer_allToSpk
+  { &patchCord16,  GRAPH_HEART                      },                                                            // mixer_allToSpk    -> peak_QrsMeter
+  { &patchCord17,  0                                },                                                            // mixer_allToSpk    -> i2s_speaker
+  { &patchCord18,  0                                },                                                            // mixer_allToSpk    -> i2s_speaker
+  { &patchCord19,  GRAPH_RECORD                     },                                                            // mixer_allToSpk    -> queue_recSpk
+  { &patchCord20,  GRAPH_HEART                      },                                                            // decimate_heart    -> heartBeat
+  { &patchCord21,  GRAPH_HEART                      },                                                            // decimate_heart    -> heartRate
+  { &patchCord22,  0                                },                                                            // rms_mic_mixer     -> micAgc
+  { &patchCord23,  GRAPH_PLAYBACK                   },                                                            // rms_playRaw_mixer -> playRawMatch
+  { &patchCord24,  GRAPH_PLAYBACK                   },                                                            // micAgc            -> playRawMatch ( level to match )
+  { &patchCord25,  GRAPH_PLAYBACK                   },                                                            // playRawMatch      -> blendFader
+  { &patchCord26,  0                                },                                                            // blendFader        -> mixer_mic_Sd
+  { &patchCord27,  GRAPH_PLAYBACK                   },                                                            // playRaw_flash     -> rms_playRaw_mixer
+  { &patchCord28,  GRAPH_STREAM                     },                                                            // filter_LowPass_1  -> queue_stream
+  { &patchCord29,  GRAPH_HEART                      },                                                            // micAgc            -> decimate_heart
+  { &patchCord30,  GRAPH_RECORD                     },                                                            // decimate_recMic   -> queue_recMic
+};
+
+const int lenGraphCords = sizeof( graphCords )/sizeof( graphCords[0] );
+
+const uint8_t graphModeNeeds[] = {                                                                                // by mode ( see states.h )
+  0,                                                                                                              // 0 idle, the mic to the speaker
+  GRAPH_RECORD,                                                                                                   // 1 recording
+  GRAPH_PLAYBACK,                                                                                                 // 2 playing
+  GRAPH_HEART,                                                                                                    // 3 heart beat monitoring
+  0,                                                                                                              // 4 pass-through
+  GRAPH_PLAYBACK,                                                                                                 // 5 blending, until the fade out has finished
+  0,                                                                                                              // 6 file transfer
+};
+
+boolean   graphManaged    = true;                                                                                 // false keeps every cord connected, as they were made ( for comparison )
+uint8_t   graphWanted     = 0;                                                                                    // asked for with graphUse()
+uint8_t   graphConnected  = GRAPH_ALL;                                                                            // needs met by the cords connected now
+
+// ==============================================================================================================
+// Graph Update
+// Connects the cords the mode and graphUse() need, and disconnects the rest; nothing is done when that hasn't
+// changed. The heart decimator starts afresh when it is let go, so it doesn't hold on to a part-filled block.
+// Called by switchMode() and graphUse(), and once from setup().
+// ============================================================================================================== //
+void graphUpdate() {
+  uint8_t needs = graphWanted;
+  if ( mode >= 0 && mode < (int)sizeof( graphModeNeeds ) ) needs |= graphModeNeeds[ mode ];
+  if ( !graphManaged ) needs = GRAPH_ALL;
+  if ( needs == graphConnected ) return;
+
+  AudioNoInterrupts();
+  for ( int i = 0; i < lenGraphCords; i ++ ) {
+    boolean want = ( graphCords[i].needs & ~needs          ) == 0;
+    boolean have = ( graphCords[i].needs & ~graphConnected ) == 0;
+    if ( want && !have ) graphCords[i].cord->connect();
+    if ( !want && have ) graphCords[i].cord->disconnect();
+  }
+  if ( ( graphConnected & GRAPH_HEART ) && !( needs & GRAPH_HEART ) ) decimate_heart.factor( heartDecimation );
+  AudioInterrupts();
+  graphConnected = needs;
+}
+
+// ==============================================================================================================
+// Graph Use
+// A feature that runs whatever the mode asks for its part of the graph ( on ), and lets it go ( off )
+// ============================================================================================================== //
+void graphUse( uint8_t needs, boolean on ) {
+  if ( on ) graphWanted |= needs;
+  else      graphWanted &= ~needs;
+  graphUpdate();
+}
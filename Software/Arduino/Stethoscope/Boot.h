@@ -0,0 +1,95 @@
+/*
+ * Boot.h
+ *
+ * Fast boot: setup() powers up the codec, builds the audio graph and opens the BT link, then returns, so the device
+ * answers ENQ within a few milliseconds. The rest finishes from loop(), one phase per pass: the codec settings once
+ * its analog ramp is done, then the SD card mount, the sound catalog and the flash sync. A command that needs the
+ * card waits for the mount ( bootWait() ); ENQ, the monitors and the statistics answer at once. The directory is
+ * only listed by SDCHECK.
+ *
+ * The time each phase finished is kept for BOOTSTATS. Times are micros() since reset, so they include the start-up
+ * of the core before setup().
+ *
+ * With FAST_BOOT false ( Config.h ) setup() finishes every phase before it returns.
+ */
+
+// ==============================================================================================================
+// Variables
+// ============================================================================================================== //
+#define   SD_CS_PIN           10                                                                                  // Audio shield has the SD card CS on pin 10
+
+enum BootPhase
+{
+  BOOT_SETUP,                                                                                                     // setup() entered
+  BOOT_AUDIO,                                                                                                     // audio graph built, codec powering up
+  BOOT_READY,                                                                                                     // setup() returned, BT commands answered
+  BOOT_CODEC,                                                                                                     // codec ramp done, input and output set
+  BOOT_SD,                                                                                                        // SD card mounted ( or found missing )
+  BOOT_CATALOG,                                                                                                   // sound catalog loaded, blend bytes mapped
+  BOOT_LIBRARY,                                                                                                   // flash sync started
+  BOOT_PHASES,
+};
+
+const char    *bootPhaseName[ BOOT_PHASES ] = { "setup", "audio", "ready", "codec", "sd", "catalog", "library" };
+uint32_t      bootAt[ BOOT_PHASES ];                                                                              // [us] since reset, 0 = not reached
+int           bootNext        = BOOT_SD;                                                                          // next card phase for bootStep()
+
+void commandInit();                                                                                               // parseBtByte.h
+
+// ==============================================================================================================
+// Boot Mark
+// Records the end of a phase
+// ============================================================================================================== //
+void bootMark( int phase ) {
+  bootAt[ phase ] = micros();
+  Serial.print( "Boot: " );         Serial.print( bootPhaseName[ phase ] );
+  Serial.print( " at " );           Serial.print( bootAt[ phase ] / 1000.0, 1 );
+  Serial.println( " ms" );
+}
+
+// ==============================================================================================================
+// Boot Step
+// One phase of the boot, called from loop() until bootPending() is false
+// ============================================================================================================== //
+boolean bootPending() {
+  return bootNext < BOOT_PHASES || bootAt[ BOOT_CODEC ] == 0;
+}
+
+void bootStep() {
+  if ( bootAt[ BOOT_CODEC ] == 0 && sgtl5000_1.isReady() )
+  {
+    SetupCodec();
+    bootMark( BOOT_CODEC );
+  }
+
+  switch ( bootNext ) {
+    case BOOT_SD:
+      if ( !SD.begin( SD_CS_PIN ) )                                                                               // one card initialization; SDCHECK reports the details
+      {
+        Serial.println( "SD card is not connected or unusable" );
+        deviceState = NOTREADY;
+      }
+      break;
+
+    case BOOT_CATALOG:
+      catalogBegin();                                                                                             // does nothing without a card
+      commandInit();
+      break;
+
+    case BOOT_LIBRARY:
+      soundLibraryBegin();
+      break;
+
+    default:
+      return;
+  }
+  bootMark( bootNext ++ );
+} // End of bootStep()
+
+// ==============================================================================================================
+// Boot Wait
+// Finishes the card phases now, for a command that needs the card ( or a blend byte not mapped yet )
+// ============================================================================================================== //
+void bootWait() {
+  while ( bootNext < BOOT_PHASES ) bootStep();
+}
@@ -0,0 +1,276 @@
+/*
+ * Catalog.h
+ *
+ * Index of the sounds on the SD card, kept in CATALOG_FILE: every .RAW file in the root directory, and every .WAV file
+ * of 16 bit linear mono samples at 44.1 kHz, the only kind the players can play. The device's own recordings
+ * ( R<digit>... .WAV, see setRecordingFilename() ) are not sounds, and are left out.
+ *
+ * The catalog is a CatalogHeader and one fixed-width 28 byte CatalogEntry per sound: 8.3 name, size, first cluster,
+ * sample rate and where the samples start ( past the WAV header ). The header holds a CRC32 of the names, sizes and
+ * first clusters of the sound files as they were when it was written. At boot the directory is read and, if it
+ * still gives the same CRC, the catalog is loaded as it is. Otherwise the catalog is rebuilt: sounds keep their
+ * place, sounds that are gone are dropped, and new sounds are added at the end ( the default sounds, Config.h,
+ * first ).
+ *
+ * Sound <n> is selected by blend byte CATALOG_BLEND_BASE + n, looked up in parseBtByte() by table, or by BLENDSOUND
+ * with the index as payload when the catalog has more sounds than blend bytes. GETFILE "CATALOG.IDX" sends the
+ * catalog itself.
+ */
+
+// ==============================================================================================================
+// Variables
+// ============================================================================================================== //
+#ifndef   CATALOG_MAX
+#define   CATALOG_MAX         128                                                                                 // sounds the catalog can hold ( 32 bytes of RAM each )
+#endif
+#define   CATALOG_FILE        "CATALOG.IDX"
+#define   CATALOG_MAGIC       0x54414353UL                                                                        // "SCAT"
+#define   CATALOG_VERSION     2
+#define   CATALOG_BLEND_BASE  0x3C                                                                                // blend byte of sound 0
+#define   CATALOG_RATE        44100                                                                               // [Hz] the rate the players run at
+
+#define   CATALOG_WAV         0x02                                                                                // RIFF/WAVE file
+#define   CATALOG_SEEN        0x80                                                                                // still on the card ( rebuild only, never stored )
+
+struct CatalogHeader {
+  uint32_t  magic;
+  uint16_t  version;
+  uint16_t  count;
+  uint32_t  directory;                                                                                            // CRC32 of the sound files' names, sizes and clusters
+  uint32_t  crc;                                                                                                  // CRC32 of the entries
+};
+
+struct CatalogEntry {
+  char      name[ 13 ];                                                                                           // 8.3, NUL padded
+  byte      flags;
+  uint16_t  rate;                                                                                                 // [Hz]
+  uint32_t  size;                                                                                                 // [bytes]
+  uint32_t  cluster;                                                                                              // first cluster
+  uint32_t  dataOffset;                                                                                           // bytes before the first sample, where playback starts
+};
+
+CatalogEntry    catalog[ CATALOG_MAX ];
+int             catalogCount      = 0;
+uint32_t        catalogDirectory  = 0;
+
+// ==============================================================================================================
+// Catalog Lookup
+// ============================================================================================================== //
+boolean catalogReadWav( CatalogEntry &e, File &f ) {                                                              // true for 16 bit linear mono samples
+  byte      hdr[ 512 ];
+  int       len = f.read( hdr, sizeof( hdr ) );
+  uint32_t  at  = 12;
+  boolean   pcm = false;
+
+  while ( len >= 12 && at + 8 <= (uint32_t)len ) {
+    uint32_t chunk = hdr[at + 4] | ( hdr[at + 5] << 8 ) | ( (uint32_t)hdr[at + 6] << 16 ) | ( (uint32_t)hdr[at + 7] << 24 );
+    if ( memcmp( hdr + at, "fmt ", 4 ) == 0 && at + 24 <= (uint32_t)len )
+    {
+      uint16_t format   = hdr[at + 8]  | ( hdr[at + 9]  << 8 );
+      uint16_t channels = hdr[at + 10] | ( hdr[at + 11] << 8 );
+      uint16_t bits     = hdr[at + 22] | ( hdr[at + 23] << 8 );
+      e.rate = hdr[at + 12] | ( hdr[at + 13] << 8 );
+      pcm    = format == 1 && channels == 1 && bits == 16;
+    }
+    if ( memcmp( hdr + at, "data", 4 ) == 0 )
+    {
+      e.dataOffset = at + 8;
+      return pcm;
+    }
+    at += 8 + chunk + ( chunk & 1 );
+  }
+  return false;                                                                                                   // no samples found
+}
+
+boolean catalogSoundFile( File &entry, CatalogEntry &e ) {                                                        // a sound the catalog lists, described in e
+  const char  *name = entry.name();
+  const char  *dot  = strrchr( name, '.' );
+
+  if ( entry.isDirectory() || !dot || strlen( name ) > 12 ) return false;
+  if ( toupper( name[0] ) == 'R' && isdigit( name[1] ) ) return false;                                           // a recording
+  memset( &e, 0, sizeof( e ) );
+  strcpy( e.name, name );
+  e.size    = entry.size();
+  e.cluster = entry.firstCluster();
+  e.rate    = CATALOG_RATE;
+  if ( strcasecmp( dot, ".RAW" ) == 0 ) return true;
+  if ( strcasecmp( dot, ".WAV" ) != 0 ) return false;
+  e.flags   = CATALOG_WAV;
+  return catalogReadWav( e, entry ) && e.rate == CATALOG_RATE;
+}
+
+int catalogFind( const char *name ) {
+  for ( int i = 0; i < catalogCount; i ++ ) {
+    if ( strcmp( catalog[i].name, name ) == 0 ) return i;
+  }
+  return -1;
+}
+
+int catalogBlendByte( int index ) {                                                                               // -1 past the last byte
+  int blendByte = CATALOG_BLEND_BASE + index;
+  return blendByte <= 0xFF ? blendByte : -1;
+}
+
+int catalogDefaultRank( const char *name ) {
+  for ( int i = 0; i < lenDefaultSounds; i ++ ) {
+    if ( strcmp( defaultSounds[i], name ) == 0 ) return i;
+  }
+  return lenDefaultSounds;
+}
+
+// ==============================================================================================================
+// Catalog Directory
+// CRC32 of every sound file's name, size and first cluster, in directory order; calls back with each one if asked
+// ============================================================================================================== //
+typedef void ( *CatalogVisit )( const CatalogEntry &found );
+
+uint32_t catalogScan( CatalogVisit visit ) {
+  File      dir = SD.open( "/" );
+  uint32_t  crc = 0xFFFFFFFF;
+
+  while ( dir )
+  {
+    File          entry = dir.openNextFile();
+    CatalogEntry  found;
+    if ( !entry ) break;
+    if ( catalogSoundFile( entry, found ) )
+    {
+      crc = crc32Update( crc, (const byte *)found.name, sizeof( found.name ) );                                 // NUL padded
+      crc = crc32Update( crc, (const byte *)&found.size, 4 );
+      crc = crc32Update( crc, (const byte *)&found.cluster, 4 );
+      if ( visit ) visit( found );
+    }
+    entry.close();
+  }
+  dir.close();
+  return ~crc;
+}
+
+// ==============================================================================================================
+// Catalog File
+// ============================================================================================================== //
+boolean catalogLoad() {
+  CatalogHeader hdr;
+  File          f = SD.open( CATALOG_FILE );
+
+  catalogCount = 0;
+  if ( !f ) return false;
+  boolean ok = f.read( &hdr, sizeof( hdr ) ) == (int)sizeof( hdr ) && hdr.magic == CATALOG_MAGIC &&
+               hdr.version == CATALOG_VERSION && hdr.count <= CATALOG_MAX;
+  int     len = ok ? hdr.count * sizeof( CatalogEntry ) : 0;
+  ok = ok && f.read( catalog, len ) == len && crc32( (const byte *)catalog, len ) == hdr.crc;
+  f.close();
+  if ( !ok ) return false;
+  catalogCount     = hdr.count;
+  catalogDirectory = hdr.directory;
+  return true;
+}
+
+boolean catalogSave() {
+  CatalogHeader hdr;
+  int           len = catalogCount * sizeof( CatalogEntry );
+
+  hdr.magic     = CATALOG_MAGIC;
+  hdr.version   = CATALOG_VERSION;
+  hdr.count     = catalogCount;
+  hdr.directory = catalogDirectory;
+  hdr.crc       = crc32( (const byte *)catalog, len );
+  if ( SD.exists( CATALOG_FILE ) ) SD.remove( CATALOG_FILE );
+  File    f  = SD.open( CATALOG_FILE, FILE_WRITE );
+  boolean ok = f && f.write( (const byte *)&hdr, sizeof( hdr ) ) == sizeof( hdr ) &&
+               f.write( (const byte *)catalog, len ) == (size_t)len;
+  if ( f ) f.close();
+  if ( !ok ) Serial.println( "Catalog: cannot write " CATALOG_FILE );
+  return ok;
+}
+
+// ==============================================================================================================
+// Catalog Rebuild
+// Merges the directory into the loaded catalog: entries keep their order, new sounds go at the end
+// ============================================================================================================== //
+void catalogVisit( const CatalogEntry &found ) {
+  int i = catalogFind( found.name );
+  if ( i < 0 )
+  {
+    if ( catalogCount >= CATALOG_MAX )
+    {
+      Serial.print( "Catalog full, left out: " );
+      Serial.println( found.name );
+      return;
+    }
+    i = catalogCount ++;
+  }
+  catalog[i]        = found;                                                                                      // as the file is now
+  catalog[i].flags |= CATALOG_SEEN;
+}
+
+void catalogRebuild() {
+  int loaded = catalogCount;                                                                                      // new sounds are added after these
+  catalogScan( catalogVisit );
+
+  // drop the sounds that are gone, keeping the order of the rest
+  int kept  = 0;
+  int first = 0;                                                                                                  // where the new sounds start
+  for ( int i = 0; i < catalogCount; i ++ ) {
+    if ( !( catalog[i].flags & CATALOG_SEEN ) ) continue;
+    catalog[i].flags &= ~CATALOG_SEEN;
+    if ( i < loaded ) first ++;
+    catalog[ kept ++ ] = catalog[i];
+  }
+  catalogCount = kept;
+
+  // new sounds: the default ones first, in their order ( insertion sort, new sounds are few )
+  for ( int i = first + 1; i < catalogCount; i ++ ) {
+    CatalogEntry  e    = catalog[i];
+    int           rank = catalogDefaultRank( e.name );
+    int           j    = i;
+    while ( j > first && catalogDefaultRank( catalog[j - 1].name ) > rank ) {
+      catalog[j] = catalog[j - 1];
+      j --;
+    }
+    catalog[j] = e;
+  }
+}
+
+// ==============================================================================================================
+// Catalog Begin
+// Loads the catalog, rebuilding it if the sound files have changed; call once the SD card is up
+// ============================================================================================================== //
+void catalogBegin() {
+  if ( deviceState == NOTREADY )
+  {
+    Serial.println( "Catalog: no SD card" );
+    return;
+  }
+
+  uint32_t directory = catalogScan( NULL );
+  boolean  loaded    = catalogLoad();
+  if ( loaded && catalogDirectory == directory )
+  {
+    Serial.print( "Catalog: " );  Serial.print( catalogCount );  Serial.println( " sounds" );
+  }
+  else
+  {
+    catalogRebuild();
+    catalogDirectory = directory;
+    catalogSave();
+    Serial.print( "Catalog rebuilt: " );  Serial.print( catalogCount );  Serial.println( " sounds" );
+  }
+}
+
+// ==============================================================================================================
+// Catalog Print
+// ============================================================================================================== //
+void catalogPrint() {
+  Serial.println( "Sound catalog:" );
+  for ( int i = 0; i < catalogCount; i ++ ) {
+    CatalogEntry &e = catalog[i];
+    Serial.print( '\t' );  Serial.print( i );
+    Serial.print( '\t' );
+    if ( catalogBlendByte( i ) >= 0 ) Serial.print( catalogBlendByte( i ), HEX );
+    Serial.print( '\t' );  Serial.print( e.name );
+    Serial.print( '\t' );  Serial.print( e.size );
+    Serial.print( '\t' );  Serial.print( e.rate );
+    Serial.print( "\tdata at " );  Serial.println( e.dataOffset );
+  }
+}
@@ -17,17 +17,33 @@ byte STE[] = { 0x53, 0x54, 0x45, 0x00 };        // Stethoscope Device IDs
 /// BT Configuration
 #define         SPEED       115200
 #define         BTooth      Serial1
+byte            btFrameOwner    = 0x00;         // Start byte ( STX, SYN, SOH ) of the frame part-way out on BTooth, 0x00 = none
+void            btFrameFinish();                // parseBtByte.h
+void            btReply( const byte *data, int len );
+void            btReply( byte b );
+
+/// Boot
+#define         FAST_BOOT   true                // Answer BT before the codec ramp and the SD mount are done ( see Boot.h )
 
 /// ASCII Byte Codes -- used for communication protocol
 // General Commands
 #define         ENQ               0x05          // Enquiry: "Are you ready for commands?"                             [resp: ACK | NAK]
 #define         ACK               0x06          // Positive Acknowledgement: "Command/Action successful."
 #define         NAK               0x15          // Negative Acknowledgement: "Command/Action UNsuccessful."
+#define         SOH               0x01          // Start of a file transfer chunk
+#define         STX               0x02          // Start of a telemetry frame
+#define         SYN               0x16          // Start of a live audio packet ( device to tablet only )
+#define         EOT               0x04          // End of file transfer
 
 /// Device Control Commands
 //  Diagnostic Functions ============================================================================================================= //
 #define         DEVICEID          0x11          // Device Identification                                              [resp: Device Code]
 #define         SDCHECK           0x12          // System Check: "Run system check and report"                        [resp: ACK | NAK]
+#define         RECSTATS          0x13          // Record queue statistics                                            [resp: ACK + 2 x 12 bytes]
+#define         SNDSTATS          0x14          // Sound library sync and start times ( SD card, flash )              [resp: ACK + 2 + 2 x 16 bytes]
+#define         BOOTSTATS         0x10          // Boot phase times                                                   [resp: ACK + 1 + n x 4 bytes]
+#define         HEAPSTATS         0x0F          // Heap use, peaks and fragmentation                                  [resp: ACK + 6 x 4 bytes]
+#define         AUDIOSTATS        0x0E          // Audio objects' update cycles, block pool and overruns             [resp: ACK + 23 + n x 5 bytes]
 #define         SETIDLE           0x26          // Set device from any state to IDLE ( mode = 0 )
 
 //  Device-Specific Functions ======================================================================================================== //                     
@@ -43,7 +59,16 @@ byte STE[] = { 0x53, 0x54, 0x45, 0x00 };        // Stethoscope Device IDs
 #define         STOPBLEND         0x20          // Stop Blending
 #define         PSTRING           0x31          // Parse string data                                                  [resp: ACK | NAK]
 #define         RECMODE           0x41          // Parse recording mode                                               ...
+#define         RECCODEC          0x37          // Recording codec ( payload: 0 PCM, 1 mu-law, 2 ADPCM, 3 lossless; ":4", ":8" or ":10" decimates ) [resp: ACK | NAK]
 #define         SETGAINS          0x44          // Set device gains 
+#define         GETFILE           0x34          // Send file in CRC-checked chunks ( payload: "NAME" or "NAME:offset" ) [resp: ACK + size + offset, chunks, EOT | NAK]
+#define         FILEACK           0x35          // Chunks up to and including <seq> received ( payload: decimal seq )
+#define         FILENAK           0x36          // Resend from chunk <seq> ( payload: decimal seq )
+#define         BLENDSOUND        0x21          // Blend catalog sound <n> ( payload: decimal index ), for sounds past the blend bytes [resp: ACK | NAK]
+#define         STARTTELEM        0x22          // Start binary telemetry ( payload: decimal rate in Hz, may be empty ) [resp: ACK, frames | NAK]
+#define         STOPTELEM         0x23          // Stop telemetry                                                     [resp: last frame, ACK]
+#define         STARTSTREAM       0x24          // Start live audio ( payload: "codec" or "codec:factor", may be empty ) [resp: ACK + rate (2), packets | NAK]
+#define         STOPSTREAM        0x25          // Stop live audio                                                    [resp: ACK]
 
 //  Simulation Functions ============================================================================================================= //
 #define         STARTSIM          0x72
@@ -57,15 +82,22 @@ byte STE[] = { 0x53, 0x54, 0x45, 0x00 };        // Stethoscope Device IDs
 // Fluvio L Lobo Fenoglietto 05/07/2018
 // =================================================================================================================================== //
 struct Session {
-    String    fileRec;
-    String    filePly[ 11 ];
-    int       lenPly;
-    char      blendByteList[ 11 ];
-    int       lenBlendByteList;
+    FileName  fileRec;
 };
 
 Session  ses;
 
+// =================================================================================================================================== //
+// Default Sound Order
+// Teaching sounds found on a card that has no sound catalog yet ( see Catalog.h ) are listed first, in this order, so that they keep
+// the blend bytes 0x3C... the tablet application expects
+// =================================================================================================================================== //
+const char  *defaultSounds[] = {
+    "AORSTE.RAW", "S4GALL.RAW", "ESMSYN.RAW", "KOROT1.RAW", "KOROT2.RAW", "KOROT3.RAW",
+    "KOROT4.RAW", "RECAOR.RAW", "RECMIT.RAW", "RECPUL.RAW", "RECTRI.RAW",
+};
+const int   lenDefaultSounds = sizeof( defaultSounds )/sizeof( defaultSounds[0] );
+
 // =================================================================================================================================== //
 // Session Initialization
 //
@@ -74,27 +106,5 @@ Session  ses;
 // =================================================================================================================================== ///
 void SessionInit() {
     ses.fileRec     =  "RECORD.RAW";
-    ses.filePly[0]  =  "AORSTE.RAW";
-    ses.filePly[1]  =  "S4GALL.RAW";
-    ses.filePly[2]  =  "ESMSYN.RAW";
-    ses.filePly[3]  =  "KOROT1.RAW";
-    ses.filePly[4]  =  "KOROT2.RAW";
-    ses.filePly[5]  =  "KOROT3.RAW";
-    ses.filePly[6]  =  "KOROT4.RAW";
-    ses.filePly[7]  =  "RECAOR.RAW";
-    ses.filePly[8]  =  "RECMIT.RAW";
-    ses.filePly[9]  =  "RECPUL.RAW";
-    ses.filePly[10] =  "RECTRI.RAW";
-
-    ses.lenPly      = sizeof(ses.filePly)/sizeof(ses.filePly[0]);
-
-    // Generate list of blend/playback bytes ==================================================================== //
-    int blendOffset = 60;
-    for( int i = 0; i < ses.lenPly; i ++ ) {
-      ses.blendByteList[i] = (byte)(i + blendOffset);
-    }
-
-    ses.lenBlendByteList = sizeof(ses.blendByteList)/sizeof(ses.blendByteList[0]);
-     
 } // End of SessionInit()
 
@@ -12,9 +12,9 @@
 // ==============================================================================================================
 // Variables
 // ============================================================================================================== //
-File          frec;
-File          micFileRec;
-File          spkFileRec;
+RecordFile    frec;
+RecordFile    micFileRec;
+RecordFile    spkFileRec;
 File          hRate;
 
 elapsedMillis msecs;
@@ -38,21 +38,73 @@ bool          atRest        = true;
 bool          transition    = atRest;
 bool          soundTwo      = false;
 
-String        lineOut       = "";
-
 
 // ==============================================================================================================
-// Wave Amplitude Peaks
-// Amplitude Peak Detection and Heart Rate Approximation
+// Adjust Mic Level
+// Slow, hysteretic steering of the SGTL5000 analog mic gain
+//
+// The micAgc object evens out the level block by block, but it cannot add bits the ADC never captured, nor undo
+// clipping. Every MIC_STEER_MS this function looks at the peak that reached micAgc and moves the analog gain:
+// down MIC_STEP_DOWN dB at once when the ADC clipped or the peak passed MIC_PEAK_HIGH, up MIC_STEP_UP dB only
+// after MIC_QUIET_STEPS quiet periods in a row below MIC_PEAK_LOW. The band in between changes nothing, so the
+// gain settles instead of hunting. micAgc.compensate() absorbs each step, so the output level does not jump.
 //
-// The following function uses an amplitude peak detection
-// tool to approximate heart-rate
-// 
 // Michael Xynidis 11/12/2017
 // ==============================================================================================================
+#define   MIC_STEER_MS        250                                                                                 // [ms] between decisions
+#define   MIC_PEAK_HIGH       0.70                                                                                // fraction of full scale
+#define   MIC_PEAK_LOW        0.12
+#define   MIC_QUIET_STEPS     12                                                                                  // quiet periods before raising ( 3 s )
+#define   MIC_STEP_DOWN       6                                                                                   // [dB]
+#define   MIC_STEP_UP         3                                                                                   // [dB]
+#define   MIC_GAIN_MIN        0                                                                                   // [dB] SGTL5000 range
+#define   MIC_GAIN_MAX        63
+
+elapsedMillis micSteerTime;
+int           micQuiet      = 0;
+uint32_t      micClipsSeen  = 0;
+
 void adjustMicLevel() {
-  // TODO: read the peak_QrsMeter1 object and adjust sgtl5000_1.micGain()
-  // if anyone gets this working, please submit a github pull request :-)
+  if ( micSteerTime < MIC_STEER_MS ) return;
+  micSteerTime = 0;
+
+  float     peak  = micAgc.inputPeak();
+  uint32_t  clips = micAgc.inputClips();
+  int       step  = 0;
+  if ( clips != micClipsSeen || peak > MIC_PEAK_HIGH ) {
+    step      = -MIC_STEP_DOWN;
+    micQuiet  = 0;
+  } else if ( peak < MIC_PEAK_LOW ) {
+    if ( ++micQuiet >= MIC_QUIET_STEPS ) {
+      step      = MIC_STEP_UP;
+      micQuiet  = 0;
+    }
+  } else {
+    micQuiet  = 0;
+  }
+  micClipsSeen = clips;
+
+  int gain = constrain( microphoneGain + step, MIC_GAIN_MIN, MIC_GAIN_MAX );
+  if ( gain == microphoneGain ) return;
+  micAgc.compensate( gain - microphoneGain );
+  sgtl5000_1.micGain( gain );
+  Serial.print( "Mic gain " );          Serial.print( microphoneGain );
+  Serial.print( " -> " );               Serial.print( gain );
+  Serial.print( " dB | peak " );        Serial.print( peak );
+  Serial.print( " | clips in " );       Serial.print( clips );
+  Serial.print( " / out " );            Serial.println( micAgc.outputClips() );
+  microphoneGain = gain;
+} // End of adjustMicLevel()
+
+// ==============================================================================================================
+// AGC Statistics
+// Summary of the gain path, printed when a recording stops
+// ==============================================================================================================
+void agcStatsPrint() {
+  Serial.print( "Mic gain " );                Serial.print( microphoneGain );
+  Serial.print( " dB analog, " );             Serial.print( micAgc.gainDb() );
+  Serial.print( " dB digital | clips in " );  Serial.print( micAgc.inputClips() );
+  Serial.print( " / out " );                  Serial.println( micAgc.outputClips() );
 }
 
 
@@ -62,6 +114,7 @@ void adjustMicLevel() {
 //
 // The following function uses an amplitude peak detection
 // tool to approximate heart-rate
+// The levels reach the tablet in the telemetry stream ( Telemetry.h ), no longer as a bar graph
 // 
 // Michael Xynidis
 // Fluvio L. Lobo Fenoglietto 11/12/2017
@@ -74,37 +127,13 @@ bool waveAmplitudePeaks() {
       float peakNumber  = 0.0;
       peakNumber = peak_QrsMeter.read();
 
-      int   leftPeak    = peakNumber  * 30.0;
-      int   count;
-      char  fillCharL   = ' ';
-      char  fillCharR   = ' ';
-
-      Serial.print( "Threshold: " );
-      Serial.print( peakNumber );
-      Serial.print( "/" );
-      Serial.print( sigThreshold );
-      Serial.print( " Peak: " );
-      Serial.print( leftPeak );
-      Serial.print( '\t' );
-
-      for ( int i = 0; i < 30 - leftPeak; i++ ) {
-         if ( i == (30 - (sigThreshold * 30)) )
-          Serial.print( "." );
-        else
-          Serial.print( " " );
-      }
-
       if ( peakNumber >= sigThreshold ) {
-        fillCharL = '<';
-        fillCharR = '>';
         if ( atRest )                                   // If heart is at rest, then a sound is heard...
           transition  = true;                           // ....there is a 'transition',
         else                                            // otherwise...
           transition  = false;                          // ....there is no transition
         atRest        = false;                          // ....but with either event, the heart is NOT at rest.
       } else {
-        fillCharL = ' ';
-        fillCharR = ' ';
         if ( !atRest )                                  // If heart was NOT at rest, then NO sound is heard...
           transition  = true;                           // ....there is a 'transition',
         else                                            // otherwise...
@@ -147,38 +176,6 @@ bool waveAmplitudePeaks() {
         } else ndx++;
         elapsed = 0;
       }
-
-      for ( int i = 0; i < leftPeak; i++ )
-        Serial.print( fillCharL );
-
-      if ( beatHeard )
-        Serial.print( "|*|" );
-      else if ( transition )
-        Serial.print( "|.|" );
-      else if ( atRest )
-        Serial.print( "| |" );
-      else
-        Serial.print( "|-|" );
-
-      for ( count = 0; count < leftPeak; count++ )
-        Serial.print( fillCharR );
-
-      while ( count++ <= 30 ) {
-         if ( count == sigThreshold * 30 )
-          Serial.print( "." );
-        else
-          Serial.print( " " );
-      }
-
-      if ( transition ) {
-        Serial.print( "\ttime: " );
-        Serial.print( triggerTime );
-      }
-      if ( beatHeard ) {
-        Serial.print( "\tHR: " );
-        Serial.print( heartRateI );
-      }
-      Serial.println();
     }
   }
   return beatHeard;
@@ -190,6 +187,7 @@ bool waveAmplitudePeaks() {
 //
 // The following function uses an amplitude peak detection
 // tool to approximate heart-rate
+// The peak and HR reach the tablet in the telemetry stream ( Telemetry.h )
 // 
 // Fluvio L. Lobo Fenoglietto 11/13/2017
 // ==============================================================================================================
@@ -273,67 +271,15 @@ void waveAmplitudePeaks2() {
           peak_times[1]  = 1;
         } // End of time-based segmentation
       } // End of peak threshold check
-      
-     
-      // plotting amplitude data
-      for ( cnt = 0; cnt < 30 - micPeak; cnt++ ) Serial.print( " "  );
-      while ( cnt++ < 30 )                       Serial.print( "="  );
-                                                 Serial.print( "||" );
-                                                 
-      Serial.print("Mic. Peak = ");
-      Serial.print(micPeak);
-      Serial.print(" | Peak[0] = ");
-      Serial.print(peaks[0]);
-      Serial.print(" | Peak[1] = ");
-      Serial.print(peaks[1]);
-      Serial.print(" | Time[0] = ");
-      Serial.print(peak_times[0]);
-      Serial.print(" | Time[1] = ");
-      Serial.print(peak_times[1]);
-      Serial.print(" | HR = ");
-      Serial.println(hr); 
-
     } // End of peak availability()
   }
 } // End of waveAmplitudePeaks2()
 
-// ==============================================================================================================
-// RMS, Amplituide Peaks - Single
-// RMS and Amplitude Peak detection based on the input
-// microphone
-//
-// ...
-// 
-// Fluvio L. Lobo Fenoglietto 11/12/2017
-// ==============================================================================================================
-void rmsAmplitudePeaksSingle() {
-  if( fps > 24 )
-  {
-    // only the microphone
-    if (   mic_peaks.available()
-        && mic_rms.available() )
-    {
-      fps = 0;
-      uint8_t micPeak = mic_peaks.read()  * 30.0;
-      uint8_t micRMS  = 0; //mic_rms.read()    * 30.0;
-      float micRMSval = mic_rms.read();                               //... it is possible to make these values into floats
-
-      for ( cnt = 0; cnt < 30 - micPeak; cnt++ ) Serial.print( " "  );
-      while ( cnt++ < 29 && cnt < 30-micRMS )    Serial.print( "<"  );
-      while ( cnt++ < 30 )                       Serial.print( "="  );
-                                                 Serial.print( "||" );
-      Serial.printf( "       | Mic. Peak = %d", micPeak);
-      Serial.print(" | Mic. RMS = ");
-      Serial.println(micRMSval);
-    }
-  }
-} // End of rmsAmplitudePeaksSingle()
-// ==============================================================================================================
-
 // ==============================================================================================================
 // RMS, Amplituide Peaks
 // RMS and Amplitude Peak detection based on the input
 // microphone and playback data
+// The levels reach the tablet in the telemetry stream ( Telemetry.h )
 //
 // Fluvio L. Lobo Fenoglietto 11/12/2017
 // ==============================================================================================================
@@ -345,34 +291,10 @@ uint8_t rmsAmplitudePeaksDuo() {
 
   if( fps > 24 )
   {
-    // both microphone and the play_raw module
-    if (   mic_peaks.available() 
-        && mic_rms.available() 
-        && playRaw_peaks.available() 
-        && playRaw_rms.available() )
+    if ( mic_rms.available() )
     {
       fps = 0;
-      uint8_t micPeak     = mic_peaks.read()    * 30.0;
       uint8_t micRMS      = mic_rms.read()      * 30.0;
-      uint8_t playRawPeak = playRaw_peaks.read()* 30.0;
-      uint8_t playRawRMS  = playRaw_rms.read()  * 30.0;
-
-    // Print the moving waveform Serial display
-      for ( cnt = 0; cnt < 30 - micPeak; cnt++ ) Serial.print( " "  );
-      while ( cnt++ < 29 && cnt < 30 - micRMS )  Serial.print( "<"  );
-      while ( cnt++ < 30 )                       Serial.print( "="  );
-      if ( micPeak == 1 )                        Serial.print( " "  );
-                                                 Serial.print( "||" );
-      for( cnt = 0; cnt < playRawRMS; cnt++ )    Serial.print( "="  );
-      while( cnt++ < playRawPeak )               Serial.print( ">"  );
-      while( cnt++ < 30 )                        Serial.print( " "  );
-      Serial.printf( "       | Mic. Peak = %d | Mic. RMS = %d |"
-                          " playRaw Peak = %d | playRaw RMS = %d |\n",
-                      micPeak,
-                      micRMS,
-                      playRawPeak,
-                      playRawRMS
-                   );  //*/
 
       // forward mixer muting (switching)
       if ( micRMS > threshRMS )
@@ -390,78 +312,10 @@ uint8_t rmsAmplitudePeaksDuo() {
 } // End of rmsAmplitudePeaksDuo()
 // ==============================================================================================================
 
-// ==============================================================================================================
-// RMS Modulation
-// Playback RMS modulation based on the input signal RMS
-//
-// Instead of using RMS as a threshold/switch mechanism,
-// this function actively modulates the playback input
-// signal, using channel gains, to obtain the same RMS
-// of the microphone signal
-// 
-// Fluvio L. Lobo Fenoglietto 11/10/2017
-// ==============================================================================================================
-uint32_t min_count = 1;
-uint8_t rmsModulation() {
-  
-  uint8_t returnValue = 0;
-  //uint8_t threshRMS   = 0;
-
-  if( fps > 24 )
-  {
-    // both microphone and the play_raw module
-    if (   mic_peaks.available() 
-        && mic_rms.available() 
-        && playRaw_peaks.available() 
-        && playRaw_rms.available() )
-    {
-      fps = 0;
-      uint8_t micPeak     = mic_peaks.read()      * 30.0;
-      uint8_t micRMS      = mic_rms.read()        * 30.0;
-      uint8_t playRawPeak = playRaw_peaks.read()  * 30.0;
-      uint8_t playRawRMS  = playRaw_rms.read()    * 30.0;
-      //float micPeak     = mic_peaks.read();
-      //float micRMS      = mic_rms.read();
-      //float playRawPeak = playRaw_peaks.read();
-      //float playRawRMS  = playRaw_rms.read();
-
-      // RMS comparison
-      if (micRMS == playRawRMS && micRMS > 3)                                                                   // if the micRMS is greater then the playRawRMS
-      {
-        returnValue = 0;                                                                                        // do NOT change the value of the playback input gain
-      }
-      else if (micRMS > playRawRMS)                                                                             // if the micRMS is greater than the playRawRMS
-      {
-        returnValue = 1;                                                                                        // after minimum count is reached, increase the value of the playback input gain (g++)
-      }
-      else if (micRMS < playRawRMS)                                                                             // if the micRMS is smaller than the playRawRMS
-      {
-        returnValue = 2;                                                                                        // after minimum count is reached, decrease the value of the playback input gain (g--)
-      }
-      else if (micRMS < 3)
-      {
-        returnValue = 2;                                                                                        // after minimum count is reached, decrese the value of the playback input gain (g--)
-      }// End of RMS comparison...
-
-      // Print values for comparison
-      //Serial.print("micRMS = ");
-      //Serial.print(micRMS);
-      //Serial.print(" | playRawRMS = ");
-      //Serial.print(playRawRMS);
-      //Serial.print(" | Count =");
-      //Serial.print(count);
-      //Serial.print(" | returnValue = ");
-      //Serial.println(returnValue);
-     
-    } // End of availability check
-  } // End of fps check
-  return returnValue;
-} // End of rmsModulation()
-// ==============================================================================================================
-
 void switchMode( int m ) {
     Serial.print( ">    Switching Mode = "  );  Serial.print( mode );
     mode = m;                                                                                                   // Change value of operation mode for continous recording
+    graphUpdate();                                                                                              // Connect what the new mode needs ( AudioGraph.h )
     Serial.print( " -> "  );  Serial.println( mode );
 }
 
@@ -481,6 +335,7 @@ boolean setGains( int gainMode ) {
       // calls setup functions to ensure similar settings
       setupMicToSpeaker();
       setupSDToSpeaker();
+      graphUse( GRAPH_FILTERED, false );
     break;
 
     case 1:                                                                                                       // mute mic. for bpc simulation
@@ -490,37 +345,33 @@ boolean setGains( int gainMode ) {
     break;
     
   } // End of gainMode switch()
-  
+  return true;
 } // End of setGains()
 
 // ==============================================================================================================
 // Parse String over Bluetooth
-// Read information from the serial port passed
-// as a string
+// Take the payload of a PSTRING/STARTMREC frame (assembled by parseBtByte()) as a string
 //
 // Fluvio L. Lobo Fenoglietto 11/30/2017
 // ==============================================================================================================
-String inString = "";
-String parseString() {
-  if ( BTooth.available() > 0 )
-  {
-    inString = BTooth.readString();
-  }
-  if ( inString.length() > 1 )
+FileName inString;                                                                                                // base of the recording filename
+boolean parseString( const char *payload ) {
+  inString = payload;
+  if ( inString.length() > 1 && !inString.truncated() )
   {
     Serial.println( "Stethoscope received STRING" );                                                            // Function execution confirmation over USB serial
     Serial.print(   "Stethoscope received ");
-    Serial.println( inString );
+    Serial.println( inString.c_str() );
     Serial.println( "sending: ACK..." );
-    BTooth.write( ACK );                                                                                        // ACKnowledgement sent back through bluetooth serial
-    return inString;
+    btReply( ACK );                                                                                             // ACKnowledgement sent back through bluetooth serial
+    return true;
   }
   else
   {
     Serial.println( "Stethoscope did NOT receive STRING" );                                                     // Function execution confirmation over USB serial
     Serial.println( "sending: NAK..." );
-    BTooth.write( NAK );                                                                                        // ACKnowledgement sent back through bluetooth serial
-    return inString;
+    btReply( NAK );                                                                                             // ACKnowledgement sent back through bluetooth serial
+    return false;
   }
 } // End of parseString() function
 
@@ -530,24 +381,21 @@ String parseString() {
 //
 // mode   = 0   -- custom filename, uses the "inString" variable passed through serial/bluetooth com.
 //        = 1   -- multiple channel recording ( - all channels to be specific )
+//        = 2   -- multiple channel recording interleaved into a single file ( see writeInterleavedFrame() )
 //
 // Fluvio L. Lobo Fenoglietto 05/12/2017
 // ============================================================================================================== //
 int     recMode       = 0;                                                                                        // Default -- rec. mode 0 ( will be expanded later )
 int     recChannels   = 2;
-boolean setRecordingMode() {
-  if ( BTooth.available() > 0 )
-  {
-    inString = BTooth.readString();
-  }
-  if ( inString.length() == 1 )
+int setRecordingMode( const char *payload ) {
+  if ( strlen( payload ) == 1 )                                                                                   // RECMODE frame payload ( leaves inString/filename untouched )
   {
     Serial.println( "Stethoscope received RECORDING MODE" );                                                      // Function execution confirmation over USB serial
     Serial.print(   "Stethoscope received ");
-    Serial.println( inString );
+    Serial.println( payload );
     Serial.println( "sending: ACK..." );
-    BTooth.write( ACK );                                                                                          // ACKnowledgement sent back through bluetooth serial
-    recMode = inString.toInt();                                                                                   // Converting input string to integer
+    btReply( ACK );                                                                                               // ACKnowledgement sent back through bluetooth serial
+    recMode = atoi( payload );                                                                                    // Converting input string to integer
     return recMode;
   }
   else
@@ -555,22 +403,65 @@ boolean setRecordingMode() {
     Serial.println( "Stethoscope did NOT receive STRING" );                                                     // Function execution confirmation over USB serial
     Serial.println( "Setting RECORDING MODE to default (0)" );
     Serial.println( "sending: NAK..." );
-    BTooth.write( NAK );                                                                                        // ACKnowledgement sent back through bluetooth serial
+    btReply( NAK );                                                                                             // ACKnowledgement sent back through bluetooth serial
     recMode = 0;                                                                                                // ...leaving the default value
     return recMode;
   }
 } // End of setRecordingMode()
 
+// ==============================================================================================================
+// Set Recording Codec
+// Codec used by the next WAV recording ( see RecordCodec.h )
+//
+// codec  = 0   -- 16 bit PCM
+//        = 1   -- 8 bit mu-law ( 2:1 )
+//        = 2   -- 4 bit IMA-ADPCM ( ~4:1 )
+//        = 3   -- lossless, Rice-coded residuals
+//
+// An optional ":factor" decimates single channel recordings by 4, 8 or 10 ( 11.0, 5.5 or 4.4 kHz ), plenty for
+// heart sounds; storage and SD writes shrink by the same factor. Without it recordings are full rate again.
+// Interleaved recordings ( recMode 2 ) are always 16 bit PCM at the full rate, and multi-channel recordings stay
+// at the full rate so the mic and speaker files line up.
+// ============================================================================================================== //
+int     recCodec      = CODEC_PCM;
+int     recDecimation = 1;                                                                                        // 1, 4, 8 or 10
+int setRecordingCodec( const char *payload ) {
+  int         codec   = atoi( payload );
+  const char *colon   = strchr( payload, ':' );
+  int         factor  = colon ? atoi( colon + 1 ) : 1;
+  boolean     valid   = isDigit( payload[0] ) && ( payload[1] == '\0' || payload[1] == ':' ) && codec <= CODEC_RICE;
+  if ( colon ) valid  = valid && isDigit( colon[1] ) && ( factor == 4 || factor == 8 || factor == 10 );
+  if ( valid )
+  {
+    Serial.print(   "Stethoscope received RECORDING CODEC " );
+    Serial.print(   codec );
+    Serial.print(   " decimated by " );
+    Serial.println( factor );
+    Serial.println( "sending: ACK..." );
+    btReply( ACK );
+    recCodec      = codec;
+    recDecimation = factor;
+  }
+  else
+  {
+    Serial.println( "Stethoscope did NOT receive a valid RECORDING CODEC" );
+    Serial.println( "sending: NAK..." );
+    btReply( NAK );
+  }
+  return recCodec;
+} // End of setRecordingCodec()
+
 // ==============================================================================================================
 // Set Recording Filename
 // Receive text information to generate a recording filename and avoid overwriting
 //
 // Fluvio L. Lobo Fenoglietto 11/30/2017
 // ============================================================================================================== //
-String  recExtension  = ".RAW";                                                                                   // Recording file extension definition
-String  recString     = "";                                                                                       // Recording file string name definiton
-String  recStrings[]  = {"",""};                                                                                  // Default string array dpending on the rec mode
-boolean setRecordingFilename( String inString, String recExtension, int recMode ) {
+const char  *recExtension  = ".WAV";                                                                              // Recording file extension definition
+FileName    recString;                                                                                            // Recording file string name definiton
+FileName    recStrings[ 2 ];                                                                                      // Default string array dpending on the rec mode
+const char  *ilvExtension  = ".ILV";                                                                              // Interleaved (recMode 2) recording extension
+boolean setRecordingFilename( const FileName &inString, const char *recExtension, int recMode ) {
   Serial.println( "EXECUTING setRecordingFilename()" );
 
   switch( recMode )
@@ -579,11 +470,11 @@ boolean setRecordingFilename( String inString, String recExtension, int recMode
     case 0:
     {
       Serial.println( "Recording Mode 0 : " );
-      String recChannelPrefix = "R0";
-      recString = recChannelPrefix + inString + recExtension;                                                     // Concatenating extension to input filename
+      recString = "R0";
+      recString.append( inString.c_str() ).append( recExtension );                                                // Concatenating extension to input filename
       Serial.print( "Recording using filename : " );
-      Serial.println( recString );
-      return recString;
+      Serial.println( recString.c_str() );
+      return !recString.truncated();
     }
     break;
 
@@ -595,19 +486,34 @@ boolean setRecordingFilename( String inString, String recExtension, int recMode
       Serial.print( recChannels );
       Serial.println( " channels " );
 
+      boolean fits = true;
       for( int i = 0; i < recChannels; i ++ )
       {
-        String recChannelPrefix = "R";
-        String recChannelID = recChannelPrefix + i;
-        recStrings[i] = recChannelID + inString + recExtension;
-        Serial.println( "Recording using filename : " + recStrings[i] );
+        recStrings[i] = "R";
+        recStrings[i].append( i ).append( inString.c_str() ).append( recExtension );
+        Serial.print( "Recording using filename : " );
+        Serial.println( recStrings[i].c_str() );
+        fits = fits && !recStrings[i].truncated();
       }
       // add section for file existence check, otherwise it gets deleted later
-      return recStrings;
+      return fits;
+    }
+    break;
+
+    // multiple channels interleaved in one file, custom string ------------------------------------------------- //
+    case 2:
+    {
+      Serial.println( "Recording Mode 2 : " );
+      recString = "RI";
+      recString.append( inString.c_str() ).append( ilvExtension );
+      Serial.print( "Recording using filename : " );
+      Serial.println( recString.c_str() );
+      return !recString.truncated();
     }
     break;
     
   } // End of switch( recMode )
+  return false;
 } // End of setRecordingFilename() function
 
 
@@ -621,6 +527,7 @@ void setRecGains() {
   rms_mic_mixer.gain(     0,  mixerInputON  );                                                                  // Set mic input, channel 0 of mic&Sd mixer ON      (g = 1)
   rms_mic_mixer.gain(     1,  mixerInputON  );                                                                  // Set mic input, channel 1 of mic&Sd mixer ON      (g = 1)
   rms_playRaw_mixer.gain( 0,  mixerInputOFF );                                                                  // Set plaback, channel 0 of rms mixer OFF          (g = 0)
+  rms_playRaw_mixer.gain( 1,  mixerInputOFF );                                                                  // Set flash plaback, channel 1 of rms mixer OFF    (g = 0)
   mixer_mic_Sd.gain(      0,  mixerInputON  );                                                                  // Set mic input, channel 0 of mic&Sd mixer ON      (g = 1)
   mixer_mic_Sd.gain(      1,  mixerInputOFF );                                                                  // Set playback, channel 1 of mic&Sd mixer OFF      (g = 0)
   mixer_allToSpk.gain(    0,  mixerInputON  );                                                                  // Set mic input, channel 0 of speaker mixer ON     (g = 1)
@@ -629,6 +536,49 @@ void setRecGains() {
   
 } // End of setRecGains()
 
+// ==============================================================================================================
+// Write Interleaved Frame
+// recMode 2 file layout: a sequence of 520 byte frames, one per audio block period
+//   [0..1] 'I','L'   [2] channel count (2)   [3] flags   [4..7] frame number (little-endian)
+//   [8..263] microphone block ( 128 x int16 )   [264..519] speaker block ( 128 x int16 )
+// Flag bit 0 / bit 1 mark a microphone / speaker block that was missing and written as silence.
+// ============================================================================================================== //
+#define   ILV_MISSING_MIC     0x01
+#define   ILV_MISSING_SPK     0x02
+
+uint32_t  ilvFrame      = 0;                                                                                      // frames written to the current recording
+const int16_t ilvSilence[ AUDIO_BLOCK_SAMPLES ] = { 0 };
+
+void writeInterleavedFrame( RecordFile &rec, const int16_t *mic, const int16_t *spk ) {
+  byte header[8];
+  header[0] = 'I';
+  header[1] = 'L';
+  header[2] = 2;
+  header[3] = ( mic ? 0 : ILV_MISSING_MIC ) | ( spk ? 0 : ILV_MISSING_SPK );
+  for ( int n = 0; n < 4; n ++ ) header[4 + n] = ( ilvFrame >> ( n * 8 ) ) & 0xFF;
+  ilvFrame ++;
+
+  recordWrite( rec, header, sizeof( header ) );
+  recordWrite( rec, (const byte*)( mic ? mic : ilvSilence ), 256 );
+  recordWrite( rec, (const byte*)( spk ? spk : ilvSilence ), 256 );
+} // End of writeInterleavedFrame()
+
+// Write one frame from the heads of both queues; at the end of a recording ( flush ) a queue that has run dry
+// contributes silence instead of holding the other back
+boolean continueInterleaved( boolean flush ) {
+  int micReady = queue_recMic.available();
+  int spkReady = queue_recSpk.available();
+  if ( micReady == 0 && spkReady == 0 ) return false;
+  if ( !flush && ( micReady == 0 || spkReady == 0 ) ) return false;
+
+  int16_t *mic = micReady ? queue_recMic.readBuffer() : NULL;
+  int16_t *spk = spkReady ? queue_recSpk.readBuffer() : NULL;
+  writeInterleavedFrame( frec, mic, spk );
+  if ( mic ) queue_recMic.freeBuffer();
+  if ( spk ) queue_recSpk.freeBuffer();
+  return true;
+} // End of continueInterleaved()
+
 // ==============================================================================================================
 // Start Recording
 // Record audio from the input microphone line into
@@ -640,28 +590,33 @@ void setRecGains() {
 // Michael Xynidis
 // Fluvio L. Lobo Fenoglietto 11/21/2017
 // ==============================================================================================================
-boolean startRecording(String recString) {
+boolean startRecording( const char *recChar ) {
   Serial.println( "EXECUTING startRecording()" );                                                               // Identification of function executed
   setRecGains();
 
-  Serial.println( recString );
-  char  recChar[recString.length()+1];                                                                          // Conversion from string to character array
-  recString.toCharArray( recChar, sizeof( recChar ) );
+  Serial.println( recChar );
   
   if ( SD.exists( recChar ) ) SD.remove( recChar );                                                             // Check for existence of HRATE.DAT
 
-  frec = SD.open( recChar, FILE_WRITE );                                                                       // Create and open RECORD.RAW file
-  Serial.println( frec );
-
-  if (  SD.open( recChar, FILE_WRITE ) )                                                                        // Create and open HRATE.DAT file
+  int factor = recMode == 2 ? 1 : recDecimation;
+  if ( recordOpen( frec, recChar, recMode == 2 ? 0 : 1, recCodec, 44100 / factor ) )                            // Create and open the recording ( mono WAV, or interleaved )
   {
+    codecStatsReset();
+    micAgc.clearClips();
+    decimate_recMic.factor( factor );
+    queue_recMic.decimation( factor );
+    graphUse( GRAPH_RECORD, true );
+    AudioNoInterrupts();                                                                                        // both queues start on the same audio update
     queue_recMic.begin();
+    if ( recMode == 2 ) queue_recSpk.begin();                                                                   // interleaved recording also takes the speaker channel
+    AudioInterrupts();
+    ilvFrame    = 0;
     deviceState = RECORDING;
     recState    = RECORDING;
     switchMode( 1 );
     Serial.println( "Stethoscope began RECORDING" );                                                            // Function execution confirmation over USB serial
     Serial.println( "sending: ACK..." );
-    BTooth.write( ACK );                                                                                        // ACKnowledgement sent back through bluetooth serial
+    btReply( ACK );                                                                                             // ACKnowledgement sent back through bluetooth serial
     Serial.println( "continueRecording() called" );
     return true;
   }
@@ -669,7 +624,7 @@ boolean startRecording(String recString) {
   {
     Serial.println( "Stethoscope CANNOT begin RECORDING" );                                                     // Function execution failed, notification over USB serial
     Serial.println( "sending: NAK..." );
-    BTooth.write( NAK );                                                                                        // Negative AcKnowledgement sent back through bluetooth serial
+    btReply( NAK );                                                                                             // Negative AcKnowledgement sent back through bluetooth serial
     return false;
   } 
 } // End of startRecording()
@@ -686,14 +641,13 @@ boolean startRecording(String recString) {
 // Michael Xynidis
 // Fluvio L. Lobo Fenoglietto 05/09/2018
 // ============================================================================================================== //
-boolean startMultiChannelRecording( String recStrings[] ) {
+boolean startMultiChannelRecording( const FileName recStrings[] ) {
   Serial.println( "EXECUTING startRecording()" );                                                                 // Identification of function executed
   setRecGains();                                                                                                  // Set-up gains for microphone recording
 
   // microphone channel ----------------------------------------------------------------------------------------- //
-  Serial.println( recStrings[0] );
-  char  micRecChar[recStrings[0].length()+1];                                                                     // Conversion from string to character array
-  recStrings[0].toCharArray( micRecChar, sizeof( micRecChar ) );
+  const char  *micRecChar = recStrings[0].c_str();
+  Serial.println( micRecChar );
   
   if ( SD.exists( micRecChar ) )
   {
@@ -702,13 +656,11 @@ boolean startMultiChannelRecording( String recStrings[] ) {
     SD.remove( micRecChar );
   }
   
-  micFileRec = SD.open( micRecChar, FILE_WRITE );
-  //Serial.println( micFileRec );
+  boolean micOpen = recordOpen( micFileRec, micRecChar, 1, recCodec );
   
   // speaker channel -------------------------------------------------------------------------------------------- //
-  Serial.println( recStrings[1] );
-  char  spkRecChar[recStrings[1].length()+1];                                                                     // Conversion from string to character array
-  recStrings[1].toCharArray( spkRecChar, sizeof( spkRecChar ) );
+  const char  *spkRecChar = recStrings[1].c_str();
+  Serial.println( spkRecChar );
   
   if ( SD.exists( spkRecChar ) )
   {
@@ -717,15 +669,20 @@ boolean startMultiChannelRecording( String recStrings[] ) {
     SD.remove( spkRecChar );
   }
   
-  spkFileRec = SD.open( spkRecChar, FILE_WRITE );
-  //Serial.println( spkFileRec );
+  boolean spkOpen = recordOpen( spkFileRec, spkRecChar, 1, recCodec );
   
   // confirmation ----------------------------------------------------------------------------------------------- //
-  if (  SD.open( micRecChar, FILE_WRITE ) &&                                                                      // Create and open RECORD.RAW file
-        SD.open( spkRecChar, FILE_WRITE ) )                                                                       // Create and open HRATE.DAT file
+  if ( micOpen && spkOpen )
   {
+    codecStatsReset();
+    micAgc.clearClips();
+    decimate_recMic.factor( 1 );
+    queue_recMic.decimation( 1 );
+    graphUse( GRAPH_RECORD, true );                                                                               // multi-channel recording stays out of mode 1
+    AudioNoInterrupts();                                                                                          // both queues start on the same audio update
     queue_recMic.begin();
     queue_recSpk.begin();
+    AudioInterrupts();
     deviceState = RECORDING;
     recState    = RECORDING;
     //switchMode( 1 );
@@ -733,7 +690,7 @@ boolean startMultiChannelRecording( String recStrings[] ) {
     timeStamp   = 0;
     Serial.println( "Stethoscope began MULTI RECORDING" );                                                        // Function execution confirmation over USB serial
     Serial.println( "sending: ACK..." );
-    BTooth.write( ACK );                                                                                          // ACKnowledgement sent back through bluetooth serial
+    btReply( ACK );                                                                                               // ACKnowledgement sent back through bluetooth serial
     Serial.println( "continueRecording() called" );
     return true;
   }
@@ -741,11 +698,21 @@ boolean startMultiChannelRecording( String recStrings[] ) {
   {
     Serial.println( "Stethoscope CANNOT begin MULTI RECORDING" );                                                 // Function execution failed, notification over USB serial
     Serial.println( "sending: NAK..." );
-    BTooth.write( NAK );                                                                                          // Negative AcKnowledgement sent back through bluetooth serial
+    btReply( NAK );                                                                                               // Negative AcKnowledgement sent back through bluetooth serial
     return false;
   }
 } // End of startMultiChannelRecording()
 
+boolean stopRecording();                                                                                          // below
+
+// A write that did not reach the card ends the recording: what was written is kept, and the NAK from
+// stopRecording() tells the tablet, unasked
+boolean recordingFailed() {
+  Serial.println( "Stethoscope FAILED to write the RECORDING to the card" );
+  stopRecording();
+  return false;
+} // End of recordingFailed()
+
 // ==============================================================================================================
 // Continue Recording
 // Continue recording audio to SD card
@@ -758,45 +725,37 @@ boolean continueRecording() {
   switch( recMode )
   {
     case 0:
-      if ( queue_recMic.available() >= 2 )
+      while ( queue_recMic.available() > 0 )                                                                        // Blocks are encoded, staged in frec and written RECORD_BURST sectors at a time
       {
-        byte buffer[512];                                                                                           // Fetch 2 blocks from the audio library and copy into a 512 byte buffer.
-        memcpy( buffer, queue_recMic.readBuffer(), 256 );
+        recordSamples( frec, queue_recMic.readBuffer(), AUDIO_BLOCK_SAMPLES );
         queue_recMic.freeBuffer();
-        memcpy( buffer + 256, queue_recMic.readBuffer(), 256 );
-        queue_recMic.freeBuffer();                                                                                  // write all 512 bytes to the SD card
-        frec.write( buffer, 512 );
       }
+      if ( frec.failed ) return recordingFailed();
       return true;
     break;
     case 1:
-      if ( queue_recMic.available() >= 2 )
+      while ( queue_recMic.available() > 0 )
       {
-        //Serial.println( " Recording mic out... " );
-        byte buffer[512];                                                                                           // Fetch 2 blocks from the audio library and copy into a 512 byte buffer.
-                                                                                                                    // The Arduino SD library is most efficient when full 512 byte sector size writes are used.
-        memcpy( buffer, queue_recMic.readBuffer(), 256 );
+        recordSamples( micFileRec, queue_recMic.readBuffer(), AUDIO_BLOCK_SAMPLES );
         queue_recMic.freeBuffer();
-        memcpy( buffer + 256, queue_recMic.readBuffer(), 256 );
-        queue_recMic.freeBuffer();                                                                                  // write all 512 bytes to the SD card
-        micFileRec.write( buffer, 512 );
       }
-    
-      if ( queue_recSpk.available() >= 2 )
+      while ( queue_recSpk.available() > 0 )
       {
-        //Serial.println( " Recording speaker out... " );
-        byte buffer[512];                                                                                           // Fetch 2 blocks from the audio library and copy into a 512 byte buffer.
-                                                                                                                    // The Arduino SD library is most efficient when full 512 byte sector size writes are used.
-        memcpy( buffer, queue_recSpk.readBuffer(), 256 );
+        recordSamples( spkFileRec, queue_recSpk.readBuffer(), AUDIO_BLOCK_SAMPLES );
         queue_recSpk.freeBuffer();
-        memcpy( buffer + 256, queue_recSpk.readBuffer(), 256 );
-        queue_recSpk.freeBuffer();                                                                                  // write all 512 bytes to the SD card
-        spkFileRec.write( buffer, 512 );
       }
+      if ( micFileRec.failed || spkFileRec.failed ) return recordingFailed();
+      return true;
+    break;
+    case 2:
+      while ( continueInterleaved( false ) );                                                                       // Both channels go out together, one frame per block period
+      if ( frec.failed ) return recordingFailed();
       return true;
     break;
   } // End of switch( recMode )
+  return false;
 } // End of continueRecording()
+
 // ==============================================================================================================
 
 // ==============================================================================================================
@@ -813,93 +772,105 @@ boolean stopRecording() {
   switch( recMode )
   {
     case 0:
+    case 2:
       queue_recMic.end();
+      queue_recSpk.end();
+      decimate_recMic.factor( 1 );                                                                                // back to a pass-through while idle
       if ( recState == RECORDING )
       {
         Serial.println( "Stethoscope will STOP RECORDING" );                                                        // Function execution confirmation over USB serial
-        Serial.println( "sending: ACK..." );
-        BTooth.write( ACK );
+        if ( recMode == 2 )
+        {
+          while ( continueInterleaved( true ) );                                                                    // drain both queues, pairing what is left
+        }
         while ( queue_recMic.available() > 0 )
         {
-          frec.write( (byte*)queue_recMic.readBuffer(), 256 );
+          recordSamples( frec, queue_recMic.readBuffer(), AUDIO_BLOCK_SAMPLES );
           queue_recMic.freeBuffer();
         }
-        frec.close();
+        boolean ok = recordClose( frec );
+        graphUse( GRAPH_RECORD, false );
+        codecStatsPrint();
+        agcStatsPrint();
         hRate.close();
         deviceState = READY;
         recState = READY;
         switchMode( 0 );
-        return true;
+        Serial.println( ok ? "sending: ACK..." : "sending: NAK... ( card write failed )" );
+        btReply( ok ? ACK : NAK );                                                                                  // the recording is only acknowledged once it is all on the card
+        return ok;
       }
       else
         Serial.println( "Stethoscope CANNOT STOP RECORDING" );                                                      // Function execution confirmation over USB serial
         Serial.println( "sending: NAK..." );
-        BTooth.write( NAK );                                                                                        // Negative AcKnowledgement sent back through bluetooth serial
+        btReply( NAK );                                                                                             // Negative AcKnowledgement sent back through bluetooth serial
         return false;
 
     case 1:
       Serial.println( " Closing Recording Files " );
       queue_recMic.end();
       queue_recSpk.end();
+      decimate_recMic.factor( 1 );                                                                                // back to a pass-through while idle
       if ( recState == RECORDING )
       {
         Serial.println( "Stethoscope will STOP MULTI RECORDING" );                                                 // Function execution confirmation over USB serial
-        Serial.println( "sending: ACK..." );
-        BTooth.write( ACK );
-        
-        while ( queue_recMic.available() > 0 && queue_recSpk.available() > 0  )
+        while ( queue_recMic.available() > 0 )
         {
-          micFileRec.write( (byte*)queue_recMic.readBuffer(), 256 );
+          recordSamples( micFileRec, queue_recMic.readBuffer(), AUDIO_BLOCK_SAMPLES );
           queue_recMic.freeBuffer();
-
-          spkFileRec.write( (byte*)queue_recSpk.readBuffer(), 256 );
+        }
+        while ( queue_recSpk.available() > 0 )
+        {
+          recordSamples( spkFileRec, queue_recSpk.readBuffer(), AUDIO_BLOCK_SAMPLES );
           queue_recSpk.freeBuffer();
         }
-        micFileRec.close();
-        spkFileRec.close();
+        boolean ok = recordClose( micFileRec );
+        ok = recordClose( spkFileRec ) && ok;
+        graphUse( GRAPH_RECORD, false );
+        codecStatsPrint();
+        agcStatsPrint();
         deviceState = READY;
         recState    = READY;
         //switchMode( 0 );
-        return true;
+        Serial.println( ok ? "sending: ACK..." : "sending: NAK... ( card write failed )" );
+        btReply( ok ? ACK : NAK );
+        return ok;
       }
       else
       {
         Serial.println( "Stethoscope CANNOT STOP RECORDING" );                                                      // Function execution confirmation over USB serial
         Serial.println( "sending: NAK..." );
-        BTooth.write( NAK );                                                                                        // Negative AcKnowledgement sent back through bluetooth serial
+        btReply( NAK );                                                                                             // Negative AcKnowledgement sent back through bluetooth serial
         return false;
       }
   } // End of switch( recMode )
+  return false;
 } // End of stopRecording()
 // ==============================================================================================================
 
 //
 // *** Start Playing
 //
-boolean startPlaying( String fileName ) {
+boolean startPlaying( const char *fileName ) {
   Serial.println( "EXECUTING startPlaying()" );                                                                 // Identification of function executed
 
   mixer_mic_Sd.gain( 0, mixerInputOFF );                                                                        // Set the microphone channel 0 to mute (gain value = 0)
   mixer_mic_Sd.gain( 1, mixerInputON );                                                                         // Set the microphone channel 1 to mute (gain value = 0)
   //mixer_mic_Sd.gain( 2, mixerInputON  );                                                                      // Set the gain of the playback audio signal
 
-  char  filePly[fileName.length()+1];                                                                           // Conversion from string to character array
-  fileName.toCharArray( filePly, sizeof( filePly ) );
-  
-  if ( SD.exists( filePly ) )
+  if ( soundPlay( fileName, false ) )                                                                           // play the file once, from flash if it has a copy
   {
-    playRaw_sdHeartSound.play( filePly );
     deviceState = PLAYING;
     switchMode( 2 );
     Serial.println( "Stethoscope began PLAYING" );                                                              // Function execution confirmation over USB serial
     Serial.println( "sending: ACK..." );
-    BTooth.write( ACK );                                                                                        // ACKnowledgement sent back through bluetooth serial
+    btReply( ACK );                                                                                             // ACKnowledgement sent back through bluetooth serial
     return true;
   }
   else
     Serial.println( "Stethoscope CANNOT begin PLAYING" );                                                       // Function execution confirmation over USB serial
     Serial.println( "sending: NAK..." );
-    BTooth.write( NAK );                                                                                        // Negative AcKnowledgement sent back through bluetooth serial
+    btReply( NAK );                                                                                             // Negative AcKnowledgement sent back through bluetooth serial
     return false;
 }
 
@@ -908,9 +879,9 @@ boolean startPlaying( String fileName ) {
 // *** Continue Playing
 //
 void continuePlaying() {
-  if ( !playRaw_sdHeartSound.isPlaying() )
+  if ( !soundIsPlaying() )
   {
-    playRaw_sdHeartSound.stop();
+    soundStop();
   }
 }
 
@@ -920,12 +891,12 @@ void continuePlaying() {
 //
 boolean stopPlaying() {
   Serial.println( "stopPlaying" );
-  if ( deviceState == PLAYING ) playRaw_sdHeartSound.stop();
+  if ( deviceState == PLAYING ) soundStop();
   deviceState = READY;
   switchMode( 4 );
   Serial.println( "Stethoscope stopping PLAY" );                                                                // Function execution confirmation over USB serial
   Serial.println( "sending: ACK..." );
-  BTooth.write( ACK );                                                                                          // ACKnowledgement sent back through bluetooth serial
+  btReply( ACK );                                                                                               // ACKnowledgement sent back through bluetooth serial
   return true;
 }
 
@@ -940,10 +911,12 @@ boolean setBlendGains() {
   //rms_mic_mixer.gain(     0,  mixerInputON  );                                                                  // Set mic input, channel 0 of mic&Sd mixer ON      (g = 1)
   //rms_mic_mixer.gain(     1,  mixerInputON  );                                                                  // Set mic input, channel 1 of mic&Sd mixer ON      (g = 1)
   rms_playRaw_mixer.gain(   0,  mixerInputON );                                                                   // Set plaback, channel 0 of rms mixer OFF          (g = 0)
+  rms_playRaw_mixer.gain(   1,  mixerInputON );                                                                   // Set flash plaback, channel 1 of rms mixer ON     (g = 1)
   mixer_mic_Sd.gain(        0,  mixerInputON  );                                                                  // Set mic input, channel 0 of mic&Sd mixer ON      (g = 1)
   mixer_mic_Sd.gain(        1,  mixerInputOFF );                                                                  // Set playback, channel 1 of mic&Sd mixer OFF      (g = 0)
   mixer_allToSpk.gain(      0,  mixerInputON  );                                                                  // Set mic input, channel 0 of speaker mixer ON     (g = 1)
   mixer_allToSpk.gain(      1,  mixerInputOFF ); 
+  return true;
 } // End of setBlendGains()
 
 // ==============================================================================================================
@@ -956,26 +929,22 @@ boolean setBlendGains() {
 //
 // Fluvio L. Lobo Fenoglietto 11/12/2017
 // ============================================================================================================== //
-boolean startBlending( String fileName ) {
+boolean startBlending( const char *fileName ) {
   Serial.println( ">    EXECUTING startBlending()" );                                                             // Identification of function executed
-  //setBlendGains();                                                                                                // Setting gains associated with the blending pathway
-  
-  char  filePly[fileName.length()+1];                                                                             // Conversion from string to character array
-  fileName.toCharArray( filePly, sizeof( filePly ) );
-  //Serial.println( filePly );
-  //Serial.println( SD.exists( filePly ) );
+  setBlendGains();                                                                                                // Setting gains associated with the blending pathway
   
-  if ( SD.exists( filePly ) ) {
+  if ( soundPlay( fileName, true ) ) {                                                                          // Start playing recorded HB, repeated seamlessly
     deviceState = BLENDING;
     blendState  = BLENDING;
     Serial.println( ">    Stethoscope will begin BLENDING" );
-    playRaw_sdHeartSound.play( filePly );                                                                       // Start playing recorded HB
-    BTooth.write( ACK );
+    playRawMatch.enable( true );                                                                                // Playback level follows the mic from the first block
+    blendFader.fade( blendFadeTo, blendFadeTime );                                                              // Fade from mic to blend, timed by the audio graph
+    btReply( ACK );
     switchMode( 5 );
     return true;    
   } else {
     Serial.println( ">    Stethoscope CANNOT begin BLENDING" );                                                 // Function execution confirmation over USB serial
-    BTooth.write( NAK );                                                                                        // Negative AcKnowledgement sent back through bluetooth serial
+    btReply( NAK );                                                                                             // Negative AcKnowledgement sent back through bluetooth serial
     return false;
   }
 } // End of startBlending()
@@ -991,84 +960,33 @@ boolean startBlending( String fileName ) {
 //
 // Fluvio L. Lobo Fenoglietto 11/10/2017
 // ==============================================================================================================
-float   mixer_lvl_ON                  = 1.0;
-float   mixer_lvl_OFF                 = 0.0;
-float   mic_mixer_lvl                 = 1.0;                                                                    // microphone mixer gain level (standard and initial)
-float   playback_mixer_lvl            = 0.0;                                                                    // playback mixer gain level (standard and initial)
-float   mic_mixer_lvl_step            = 0.0001;
-float   playback_mixer_lvl_step       = mic_mixer_lvl_step;
-float   playback_rms_mixer_lvl        = 0.25;
-float   playback_rms_mixer_lvl_step   = 0.10;                                                                   // mixer level step for rms-based amplitude manipulation
-float   mixer_lvl_max                 = 1.50;
-boolean continueBlending(String fileName) {
-  if ( !playRaw_sdHeartSound.isPlaying() ) {
+boolean continueBlending( const char *fileName ) {
+  if ( !soundIsPlaying() ) {                                                                                    // the file loops, so only after a card error
     Serial.println( ">    File NOT PLAYING... RESTARTING playback" );
-    char  filePly[fileName.length()+1];                                                                         // Conversion from string to character array
-    fileName.toCharArray( filePly, sizeof( filePly ) );
-    //Serial.println( filePly );
-    //Serial.println( SD.exists( filePly ) );
-    playRaw_sdHeartSound.play( filePly );
+    soundPlay( fileName, true );
   }
 
   // 
   // Using blending states, the function fades sound in/continously/out
   //
   if ( blendState == BLENDING ) {                                                                               // if deviceState == STARTING, begin the blending of the signals
-    if ( mic_mixer_lvl > 0.10 ) {
-      mic_mixer_lvl       = mic_mixer_lvl - mic_mixer_lvl_step;                                                 // gradually decrease mic. gain level
-      playback_mixer_lvl  = playback_mixer_lvl + playback_mixer_lvl_step;                                       // gradually increase playback gain level
-      mixer_mic_Sd.gain(0, mic_mixer_lvl);                                                                      // apply mic. gain
-      mixer_mic_Sd.gain(1, playback_mixer_lvl);                                                                 // apply playback gain
-      //Serial.print(" mic. gain = ");                                                                          // print gain values for debugging...
-      //Serial.print(mic_mixer_lvl);
-      //Serial.print(" || playback gain = ");
-      //Serial.println(playback_mixer_lvl);
-    } else {
+    if ( !blendFader.isFading() ) {                                                                             // fade in started by startBlending() has finished...
       blendState = CONTINUING;                                                                                  // Switch state to CONTINUING for dynamic blending, other...
       return true;
-    } // End of blend mixer level check
+    } // End of blend fade check
     
   } else if ( blendState == CONTINUING ) {                                                                      // if deviceState == CONTINUING, maintain or vary mixer levels using functions
-    //uint8_t rms_switch = rmsAmplitudePeaksDuo();
-    uint8_t rms_switch = rmsModulation();
-    if ( rms_switch == 0 ) {                                                                                    // RMS value of mic. and playback signal are similar
-      // nothing
-      //mixer_mic_Sd.gain(0, mic_mixer_lvl);
-      //mixer_mic_Sd.gain(1, playback_mixer_lvl);
-      
-    } else if ( rms_switch == 1 ) {                                                                             // RMS value of mic. > playback signal
-      playback_rms_mixer_lvl = playback_rms_mixer_lvl + playback_rms_mixer_lvl_step;                            // ...increase gain value
-      if ( playback_rms_mixer_lvl > mixer_lvl_max ) playback_rms_mixer_lvl = mixer_lvl_max;
-      rms_playRaw_mixer.gain(0, playback_rms_mixer_lvl);                                                        // ...apply gain value
-      
-    } else if ( rms_switch == 2 ) {                                                                             // RMS value of mic. < playback signal
-      playback_rms_mixer_lvl = playback_rms_mixer_lvl - playback_rms_mixer_lvl_step;                            // ...increase gain value
-      if ( playback_rms_mixer_lvl < 0 ) playback_rms_mixer_lvl = 0;                                             // ...sign check, gain values are taken as the absolute so anything below zero will also generate sounds
-      rms_playRaw_mixer.gain(0, playback_rms_mixer_lvl);                                                        // ...apply gain value
-    }
-    //Serial.print(" RMS Switch = ");
-    //Serial.print(rms_switch);
-    //Serial.print(" | PlayBack RMS Mixer Gain = ");
-    //Serial.println(playback_rms_mixer_lvl);
+    // the playback level follows the mic in the audio graph (playRawMatch), block by block
     return true;
     
   } else if ( blendState == READY ) {
-    if ( mic_mixer_lvl < 0.90 ) {
-      mic_mixer_lvl       = mic_mixer_lvl + mic_mixer_lvl_step;
-      playback_mixer_lvl  = playback_mixer_lvl - playback_mixer_lvl_step;    
-      mixer_mic_Sd.gain(0, mic_mixer_lvl);
-      mixer_mic_Sd.gain(1, playback_mixer_lvl);
-      //Serial.print(" mic. gain = ");
-      //Serial.print(mic_mixer_lvl);
-      //Serial.print(" || playback gain = ");
-      //Serial.println(playback_mixer_lvl);
-      
-    } else {
-      playRaw_sdHeartSound.stop();                                                                              // stop playback file
+    if ( !blendFader.isFading() ) {                                                                             // fade out started by stopBlending() has finished...
+      soundStop();                                                                                              // stop playback file
+      playRawMatch.enable( false );                                                                             // plain playback is not level matched
       //setGains(0);
       switchMode( 0 );
       // switch to pre-defined mode (preferably idle/standby)
-    } // End of blend mixer level check
+    } // End of blend fade check
   } // End of deviceState check
   return true; 
 } // End of continueBlending();
@@ -1088,8 +1006,9 @@ boolean stopBlending() {
   Serial.println( ">    EXECUTING stopBlending()" );
   deviceState = READY;                                                                                          // This will trigger the bleding down and stopping
   blendState  = READY;
+  blendFader.fade( 0.0, blendFadeTime );                                                                        // Fade back to the mic alone
   Serial.println( ">    Stethoscope will STOP BLENDING" );                                                      // Function execution confirmation over USB serial
-  BTooth.write( ACK );                                                                                          // ACKnowledgement sent back through bluetooth serial
+  btReply( ACK );                                                                                               // ACKnowledgement sent back through bluetooth serial
   return true;
 } // End of stopBlending()
 // ==============================================================================================================
@@ -1122,20 +1041,21 @@ boolean startHeartBeatMonitoring()
     mixer_allToSpk.gain(  1, mixerInputOFF  );                                                                  // turn spk mic (fileterd) mixer channel "0" OFF (=0)
     mixer_allToSpk.gain(  2, mixerInputOFF  );                                                                  // turn spk playmem mixer channel "0" OFF (=0)
     
-    queue_recMic.begin();
+    heartBeat.reset();
+    heartRate.reset();
+    hr          = 0;
     deviceState = MONITORING;
     switchMode( 3 );
-    //sf1.StartSend( STRING, 1000 );                                                                              // Begin transmitting heartrate data as a String
     Serial.println( "Stethoscope STARTED DETECTING heartbeat from MIC audio." );                                // Function execution confirmation over USB serial
     Serial.println( "sending: ACK..." );
-    BTooth.write( ACK );                                                                                        // ACKnowledgement sent back through bluetooth serial
+    btReply( ACK );                                                                                             // ACKnowledgement sent back through bluetooth serial
     return true;
   }
   else
   {
     Serial.println( "Stethoscope CANNOT START DETECTING heartbeat from MIC audio." );                           // Function execution confirmation over USB serial
     Serial.println( "sending: NAK..." );
-    BTooth.write( NAK );                                                                                        // Negative AcKnowledgement sent back through bluetooth serial
+    btReply( NAK );                                                                                             // Negative AcKnowledgement sent back through bluetooth serial
     return false;
   }
 } // End of startMonitoring()
@@ -1144,22 +1064,37 @@ boolean startHeartBeatMonitoring()
 // ==============================================================================================================
 // Continue Heart Beat Monitoring
 // 
-// Continues heart rate monitoring/tracking using the
-// waveAmplitudePeaks() function
+// Reports the beats found by the heartBeat analyzer ( AudioAnalyzeHeartBeat ), which does its detection in the
+// audio update, so a slow loop() only delays the report, never the timing of the beat.
+// The heartRate analyzer ( AudioAnalyzeHeartRate ) adds a rhythm-based estimate with a confidence, every 0.75 s,
+// which holds up with murmurs and noisy contact.
+// waveAmplitudePeaks2() is kept for comparison.
+// With STARTTELEM both rates also go out in the telemetry stream ( Telemetry.h ).
 // 
 // Michael Xynidis
 // Fluvio L. Lobo Fenoglietto 11/12/2017
 // ==============================================================================================================
 boolean continueHeartBeatMonitoring()
 {
-    //bool beatCaptured = waveAmplitudePeaks();                                                                   // write HR and time to file at each heart beat
-    waveAmplitudePeaks2();
-    //if ( beatCaptured )
-    //{
-    //  txFr = sf1.Get();                                                                                         // get values from existing TX data frame
-    //  txFr.DataString = String( heartRateI );                                                                   // update data-string value with heartrate
-    //  sf1.Set( txFr );                                                                                          // set TX data frame with new heartate value
-    //}
+    if ( heartBeat.available() )
+    {
+      hr         = heartBeat.read();                                                                              // latches interval and S1-S2 of the same beat
+      heartRateI = (int)( hr + 0.5 );
+      Serial.print( "HR = " );
+      Serial.print( hr );
+      Serial.print( " | Interval = " );
+      Serial.print( heartBeat.intervalMs() );
+      Serial.print( " | S1-S2 = " );
+      Serial.println( heartBeat.systoleMs() );
+    }
+    if ( heartRate.available() )
+    {
+      float bpm = heartRate.read();                                                                               // latches the confidence of the same estimate
+      Serial.print( "HR (rhythm) = " );
+      Serial.print( bpm );
+      Serial.print( " | Confidence = " );
+      Serial.println( heartRate.confidence() );
+    }
   return true;
 } // End of continueMonitoring()
 // ==============================================================================================================
@@ -1180,22 +1115,23 @@ boolean stopHeartBeatMonitoring()
   {
     deviceState = READY;
     switchMode( 0 );
-    //sf1.StopSend( STRING );                                                                                     // Terminate transmitting heartrate data as a String
     Serial.println( "Stethoscope will STOP DETECTING heartbeat from MIC audio." );                              // Function execution confirmation over USB serial
     Serial.println( "sending: ACK..." );
-    BTooth.write( ACK );                                                                                        // ACKnowledgement sent back through bluetooth serial
+    btReply( ACK );                                                                                             // ACKnowledgement sent back through bluetooth serial
     return true;
   }
   else
   {
     Serial.println( "Stethoscope CANNOT STOP DETECTING heartbeat from MIC audio." );                            // Function execution confirmation over USB serial
     Serial.println( "sending: NAK..." );
-    BTooth.write( NAK );                                                                                        // Negative AcKnowledgement sent back through bluetooth serial
+    btReply( NAK );                                                                                             // Negative AcKnowledgement sent back through bluetooth serial
     return false;
   }
 } // End of stopHeartBeatMonitoring()
 // ==============================================================================================================
 
+void stopTransfer( boolean complete );                                                                            // FileTransfer.h
+
 // ==============================================================================================================
 // Device RESET
 // Based on a status enquiy, this function sets the stethoscope to an idle mode/state
@@ -1213,13 +1149,13 @@ void setToIdle()
     case READY :
       Serial.println( "Device already in IDLE and READY" );
       Serial.println( "sending: ACK..." );
-      BTooth.write( ACK );
+      btReply( ACK );
     break;
     case NOTREADY :
       Serial.println( "Device CANNOT TURN to IDLE..." );
       Serial.println( "Troubleshoot device..." );
       Serial.println( "sending: NAK..." ); 
-      BTooth.write( NAK );
+      btReply( NAK );
     break;
     case RECORDING :                                                                                               // RECORDING single/multiple audio streams ( this may be broken down later )
       Serial.println( "Device RECORDING..." );
@@ -1241,12 +1177,19 @@ void setToIdle()
       Serial.println( "Device BLENDING..." );
       stopBlending();
     break;
+    case TRANSFERRING :                                                                                            // TRANSFERRING a file ( GETFILE )
+      Serial.println( "Device TRANSFERRING..." );
+      stopTransfer( false );
+      Serial.println( "sending: ACK..." );
+      btReply( ACK );
+    break;
   }
 } // End setToIdle()
 
 // ================= //
 void testFilters()
 {
+  graphUse( GRAPH_FILTERED, true );
   // rms mic mixer ---------------------------------------------------------------------------------------------- //
   rms_mic_mixer.gain(   0, mixerInputOFF  );
   rms_mic_mixer.gain(   1, mixerInputOFF  );
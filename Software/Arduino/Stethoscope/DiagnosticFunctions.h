@@ -23,7 +23,7 @@ void deviceID( byte deviceHexCode[] )
     Serial.print( "][" );
     Serial.print( deviceHexCode[i], HEX );
     Serial.println( ']' );
-    BTooth.write( deviceHexCode[i] );
+    btReply( deviceHexCode[i] );
   } // End of for-loop
   
 } // End of deviceID()
@@ -52,12 +52,11 @@ void sdCheck()
     }
     */
     deviceState = READY;
-    BTooth.write( ACK );
-    delay( 2000 );
+    btReply( ACK );
   }
   else
   {
-    BTooth.write( NAK );
+    btReply( NAK );
     deviceState = NOTREADY;
   }
 } // End of sdCheck
@@ -79,32 +78,206 @@ void statusEnquiry()
   {
     case READY :
       Serial.println( "sending: ACK..." );
-      BTooth.write( ACK );
+      btReply( ACK );
     break;
     case NOTREADY :
       Serial.println( "sending: NAK..." ); 
-      BTooth.write( NAK );
+      btReply( NAK );
     break;
     case RECORDING :                                                                                               // RECORDING single/multiple audio streams ( this may be broken down later )
       Serial.println( "sending: STARTREC..." );
-      BTooth.write( STARTREC );
+      btReply( STARTREC );
     break;
     case PLAYING :                                                                                                 // PLAYING audio file
       Serial.println( "sending: STARTREC..." );
-      BTooth.write( STARTPLAY );
+      btReply( STARTPLAY );
     break;
     case MONITORING :                                                                                              // MONITORING heart beat ( may be paired with recording )
       Serial.println( "sending: STARTHBMONITOR..." );
-      BTooth.write( STARTHBMONITOR );
+      btReply( STARTHBMONITOR );
     break;
     case BLENDING :                                                                                                // BLENDING microphone input with audio file from SD card
       Serial.println( "sending: BLENDING..." );
-      BTooth.write( STARTBLEND );
+      btReply( STARTBLEND );
     break;
     case CONTINUING :
       Serial.println( "sending: BLENDING..." );                                                                    // Currently, blending is the only function that uses the continue state (this should be deprecated in the future)
-      BTooth.write( STARTBLEND );
+      btReply( STARTBLEND );
+    break;
+    case TRANSFERRING :
+      Serial.println( "sending: GETFILE..." );
+      btReply( GETFILE );
     break;
   }
 } // End of statusEnquiry()
 
+// ==============================================================================================================
+// Record Queue Statistics
+// Report whether the recording queues lost audio since the last recording started
+// Replies ACK followed by one 12 byte record per queue ( mic, then speaker ), little-endian:
+//   [0..3] blocks queued   [4..7] blocks dropped   [8..9] high-water mark   [10..11] longest drain interval (ms)
+// ============================================================================================================== //
+void sendUint( uint32_t value, int nBytes )
+{
+  for ( int n = 0; n < nBytes; n ++ ) btReply( (byte)( ( value >> ( n * 8 ) ) & 0xFF ) );
+}
+
+void sendQueueStats( const char *label, AudioRecordQueue &queue )
+{
+  uint32_t drainMs = ( queue.drainIntervalMax() * queue.decimation() * AUDIO_BLOCK_SAMPLES * 1000UL ) / 44100;
+
+  Serial.print( label );
+  Serial.print( " queued: " );    Serial.print( queue.blocksQueued() );
+  Serial.print( " dropped: " );   Serial.print( queue.blocksDropped() );
+  Serial.print( " high: " );      Serial.print( queue.highWaterMark() );
+  Serial.print( " drain ms: " );  Serial.println( drainMs );
+
+  sendUint( queue.blocksQueued(),  4 );
+  sendUint( queue.blocksDropped(), 4 );
+  sendUint( queue.highWaterMark(), 2 );
+  sendUint( drainMs,               2 );
+}
+
+void recordQueueStats()
+{
+  Serial.println( "received: RECSTATS..." );
+  Serial.println( "sending: ACK..." );
+  btReply( ACK );
+  sendQueueStats( "queue_recMic", queue_recMic );
+  sendQueueStats( "queue_recSpk", queue_recSpk );
+} // End of recordQueueStats()
+
+// ==============================================================================================================
+// Sound Library Statistics
+// Sounds with a trusted flash copy, whether the sync has finished, then for the SD card and for flash: starts,
+// last, longest and mean start time [us] ( see SoundLibrary.h )
+// ============================================================================================================== //
+void soundLibraryStats()
+{
+  const char  *label[ 2 ] = { "sd", "flash" };
+  int         inFlash     = 0;
+
+  for ( int i = 0; i < SOUND_MAX; i ++ ) if ( sounds[i].inFlash ) inFlash ++;
+  Serial.println( "received: SNDSTATS..." );
+  Serial.print( "sounds in flash: " );  Serial.print( inFlash );
+  Serial.println( soundSync.state == SYNC_DONE || soundSync.state == SYNC_OFF ? " ( synced )" : " ( syncing )" );
+  Serial.println( "sending: ACK..." );
+  btReply( ACK );
+  sendUint( inFlash, 1 );
+  sendUint( soundSync.state == SYNC_DONE || soundSync.state == SYNC_OFF, 1 );
+  for ( int k = 0; k < 2; k ++ )
+  {
+    SoundStats  &st   = soundStats[k];
+    uint32_t    mean  = st.count ? st.total / st.count : 0;
+
+    Serial.print( label[k] );
+    Serial.print( " starts: " );  Serial.print( st.count );
+    Serial.print( " last us: " ); Serial.print( st.last );
+    Serial.print( " max us: " );  Serial.print( st.max );
+    Serial.print( " mean us: " ); Serial.println( mean );
+
+    sendUint( st.count, 4 );
+    sendUint( st.last,  4 );
+    sendUint( st.max,   4 );
+    sendUint( mean,     4 );
+  }
+} // End of soundLibraryStats()
+
+// ==============================================================================================================
+// Boot Statistics
+// Number of boot phases, then the time each one finished [us since reset], 0 if it has not yet ( see Boot.h )
+// ============================================================================================================== //
+void bootStats()
+{
+  Serial.println( "received: BOOTSTATS..." );
+  for ( int i = 0; i < BOOT_PHASES; i ++ )
+  {
+    Serial.print( bootPhaseName[i] );  Serial.print( " at us: " );  Serial.println( bootAt[i] );
+  }
+  Serial.println( "sending: ACK..." );
+  btReply( ACK );
+  sendUint( BOOT_PHASES, 1 );
+  for ( int i = 0; i < BOOT_PHASES; i ++ ) sendUint( bootAt[i], 4 );
+} // End of bootStats()
+
+// ==============================================================================================================
+// Heap Statistics
+// Arena, peak arena, used, peak used, free and fragmented bytes ( see HeapMonitor.h )
+// ============================================================================================================== //
+void heapStatistics()
+{
+  HeapStats &h = heapStats;
+
+  heapSample();
+  Serial.println( "received: HEAPSTATS..." );
+  Serial.print( "heap arena: " );     Serial.print( h.arena );
+  Serial.print( " peak: " );          Serial.print( h.arenaPeak );
+  Serial.print( " used: " );          Serial.print( h.used );
+  Serial.print( " peak: " );          Serial.print( h.usedPeak );
+  Serial.print( " free: " );          Serial.print( h.free );
+  Serial.print( " fragmented: " );    Serial.println( h.fragmented );
+  Serial.println( "sending: ACK..." );
+  btReply( ACK );
+  sendUint( h.arena,      4 );
+  sendUint( h.arenaPeak,  4 );
+  sendUint( h.used,       4 );
+  sendUint( h.usedPeak,   4 );
+  sendUint( h.free,       4 );
+  sendUint( h.fragmented, 4 );
+} // End of heapStatistics()
+
+// ==============================================================================================================
+// Audio Statistics
+// A snapshot of the audio interrupt since the last AUDIOSTATS ( maxima and counts start again after each one ):
+//   number of objects            1 byte
+//   block pool size, in use, max 3 x 2 bytes  [blocks]
+//   all objects, last and max    2 x 2 bytes  [16 cycles]
+//   passes, overruns, late       3 x 4 bytes  ( see AudioAnalyzeLoad )
+// then for every object of audioObjects[] ( TeensyAudio.h ), in update order:
+//   active                       1 byte
+//   last and max                 2 x 2 bytes  [16 cycles]
+// ============================================================================================================== //
+void audioStatistics()
+{
+  Serial.println( "received: AUDIOSTATS..." );
+  Serial.print( "blocks: " );         Serial.print( AudioMemoryUsage() );
+  Serial.print( " max: " );           Serial.print( AudioMemoryUsageMax() );
+  Serial.print( " of " );             Serial.print( AUDIO_BLOCKS );
+  Serial.print( " cpu %: " );         Serial.print( AudioProcessorUsage() );
+  Serial.print( " max: " );           Serial.print( AudioProcessorUsageMax() );
+  Serial.print( " passes: " );        Serial.print( audioLoad.passes() );
+  Serial.print( " overruns: " );      Serial.print( audioLoad.overruns() );
+  Serial.print( " late: " );          Serial.println( audioLoad.late() );
+  for ( int i = 0; i < lenAudioObjects; i ++ )
+  {
+    AudioStream *s = audioObjects[i].stream;
+    Serial.print( audioObjects[i].name );
+    Serial.print( s->isActive() ? " cycles: " : " ( inactive ) cycles: " );
+    Serial.print( s->cpu_cycles * 16UL );
+    Serial.print( " max: " );         Serial.println( s->cpu_cycles_max * 16UL );
+  }
+
+  Serial.println( "sending: ACK..." );
+  btReply( ACK );
+  sendUint( lenAudioObjects,                    1 );
+  sendUint( AUDIO_BLOCKS,                       2 );
+  sendUint( AudioMemoryUsage(),                 2 );
+  sendUint( AudioMemoryUsageMax(),              2 );
+  sendUint( AudioStream::cpu_cycles_total,      2 );
+  sendUint( AudioStream::cpu_cycles_total_max,  2 );
+  sendUint( audioLoad.passes(),                 4 );
+  sendUint( audioLoad.overruns(),               4 );
+  sendUint( audioLoad.late(),                   4 );
+  for ( int i = 0; i < lenAudioObjects; i ++ )
+  {
+    AudioStream *s = audioObjects[i].stream;
+    sendUint( s->isActive(),      1 );
+    sendUint( s->cpu_cycles,      2 );
+    sendUint( s->cpu_cycles_max,  2 );
+    s->processorUsageMaxReset();
+  }
+
+  AudioMemoryUsageMaxReset();
+  AudioProcessorUsageMaxReset();
+  audioLoad.reset();
+} // End of audioStatistics()
@@ -82,6 +82,303 @@ boolean sdCardCheck()
   return true;
 }
 
+// ==============================================================================================================
+// CRC32
+// IEEE 802.3 polynomial, reflected, one nibble at a time ( 64 byte table )
+// Checks transfer chunks ( FileTransfer.h ) and the flash copies of the sound library ( SoundLibrary.h )
+// ============================================================================================================== //
+const uint32_t crcNibble[ 16 ] = {
+  0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+  0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C
+};
+
+uint32_t crc32Update( uint32_t crc, const byte *data, int len ) {
+  while ( len-- > 0 ) {
+    crc ^= *data++;
+    crc  = ( crc >> 4 ) ^ crcNibble[ crc & 0x0F ];
+    crc  = ( crc >> 4 ) ^ crcNibble[ crc & 0x0F ];
+  }
+  return crc;
+}
+
+uint32_t crc32( const byte *data, int len ) {
+  return ~crc32Update( 0xFFFFFFFF, data, len );
+}
+
+// ==============================================================================================================
+// WAV Header
+// Fills a RIFF/WAVE header, 44.1 kHz unless a decimated rate is given. With headerSize = 44 this is the canonical 16 bit PCM header; with
+// headerSize = WAV_HEADER_SIZE a JUNK chunk pads it so the samples start on a sector boundary. Compressed codecs
+// ( see RecordCodec.h ) add the extended fmt chunk and the fact chunk ( sample count ), so they need the padded header.
+// ============================================================================================================== //
+#define   WAV_HEADER_SIZE     512                                                                                 // header region reserved in front of recorded samples
+
+void putLE( byte *p, uint32_t value, int nBytes ) {
+  for ( int n = 0; n < nBytes; n ++ ) p[n] = ( value >> ( n * 8 ) ) & 0xFF;
+}
+
+void fillWavHeader( byte *hdr, uint32_t dataSize, int channels, int headerSize, int codec = CODEC_PCM, uint32_t samples = 0, uint32_t sampleRate = 44100 ) {
+  int      format       = 1;                                                                                      // PCM
+  int      bits         = 16;
+  int      blockAlign   = channels * 2;                                                                           // bytes in one sample, for all channels
+  uint32_t byteRate     = sampleRate * blockAlign;
+  int      fmtSize      = 16;
+  if ( codec == CODEC_ULAW )
+  {
+    format     = 7;
+    bits       = 8;
+    blockAlign = channels;
+    byteRate   = sampleRate * blockAlign;
+    fmtSize    = 18;
+  }
+  else if ( codec == CODEC_ADPCM )
+  {
+    format     = 0x11;
+    bits       = 4;
+    blockAlign = ADPCM_BLOCK * channels;
+    byteRate   = sampleRate * ADPCM_BLOCK / ADPCM_BLOCK_SAMPLES;
+    fmtSize    = 20;
+  }
+  else if ( codec == CODEC_RICE )                                                                                 // variable length blocks, decoded to 16 bit
+  {
+    format     = RICE_FORMAT_TAG;
+    blockAlign = 1;
+    fmtSize    = 20;
+  }
+
+  memcpy( hdr,      "RIFF", 4 );  putLE( hdr + 4,  headerSize - 8 + dataSize, 4 );                               // 00 - RIFF, how big is the rest of this file?
+  memcpy( hdr + 8,  "WAVE", 4 );                                                                                  // 08 - WAVE
+  memcpy( hdr + 12, "fmt ", 4 );  putLE( hdr + 16, fmtSize, 4 );                                                  // 12 - fmt, size of this chunk
+  putLE( hdr + 20, format,                    2 );                                                                // 20 - audio format, 1 for PCM
+  putLE( hdr + 22, channels,                  2 );                                                                // 22 - mono or stereo
+  putLE( hdr + 24, sampleRate,                4 );                                                                // 24 - samples per second
+  putLE( hdr + 28, byteRate,                  4 );                                                                // 28 - bytes per second
+  putLE( hdr + 32, blockAlign,                2 );                                                                // 32 - bytes in one sample ( block ), for all channels
+  putLE( hdr + 34, bits,                      2 );                                                                // 34 - bits in a sample
+  int pos = 36;
+  if ( codec != CODEC_PCM )
+  {
+    putLE( hdr + 36, fmtSize - 18,            2 );                                                                // 36 - size of the format extension
+    if ( codec == CODEC_ADPCM ) putLE( hdr + 38, ADPCM_BLOCK_SAMPLES, 2 );                                        // 38 - samples per block
+    if ( codec == CODEC_RICE  ) putLE( hdr + 38, AUDIO_BLOCK_SAMPLES, 2 );
+    pos = 20 + fmtSize;
+    memcpy( hdr + pos, "fact", 4 );  putLE( hdr + pos + 4, 4, 4 );  putLE( hdr + pos + 8, samples, 4 );           // fact - samples per channel
+    pos += 12;
+  }
+  if ( headerSize > 44 )
+  {
+    memcpy( hdr + pos, "JUNK", 4 );  putLE( hdr + pos + 4, headerSize - pos - 16, 4 );                            // padding chunk up to the data chunk
+    memset( hdr + pos + 8, 0, headerSize - pos - 16 );
+    pos = headerSize - 8;
+  }
+  memcpy( hdr + pos, "data", 4 );  putLE( hdr + pos + 4, dataSize, 4 );                                           // data chunk, samples follow
+}
+
+// ==============================================================================================================
+// Contiguous Recording File
+// Recordings are preallocated as one contiguous file when they start, filled with raw multi-block writes
+// (no FAT or directory updates while recording) and truncated to the recorded length when they stop.
+// If the card has no contiguous space left, the recording falls back to an ordinary File; so does a recording that
+// outgrows its preallocation, from there on. The block range of the file runs to the end of its last cluster, but
+// the raw writes stop at the file's length: past it the file can neither be seeked nor truncated, so the fallback
+// and recordClose() would fail. Only bytes that reached the card are counted, and the first write that
+// fails marks the recording failed: nothing more is written, and the caller stops it ( see continueRecording() ).
+// WAV recordings reserve WAV_HEADER_SIZE bytes up front; the sizes in it are patched when the recording closes.
+// recordSamples() runs audio blocks through the recording's codec on the way in. The rate only goes in the header:
+// blocks arrive already decimated ( see decimate_recMic ).
+// ============================================================================================================== //
+#define   RECORD_PREALLOC     ( ( 600UL * 44100 * 2 + 511 ) / 512 * 512 )                                         // bytes reserved per recording ( 10 min of mono 16 bit, whole blocks )
+#define   RECORD_BURST        4                                                                                   // 512 byte blocks per multi-block write
+
+uint32_t  recordPrealloc = RECORD_PREALLOC;                                                                       // smaller on the host bench, to reach the fallback
+void    ( *recordTap )( const int16_t *src, int n ) = NULL;                                                       // the host bench keeps what goes into the codec
+
+struct RecordFile {
+  File      file;
+  boolean   contiguous;                                                                                           // preallocated, truncated when it closes
+  boolean   raw;                                                                                                  // written by block number ( until the preallocation is used up )
+  boolean   failed;                                                                                               // a write did not reach the card
+  uint32_t  firstBlock;                                                                                           // first block of the preallocation
+  uint32_t  nextBlock;                                                                                            // next block to write
+  uint32_t  endBlock;                                                                                             // last block inside the file's length
+  uint32_t  size;                                                                                                 // bytes written to the card ( including any header )
+  int       fill;                                                                                                 // bytes waiting in buf
+  int       wavChannels;                                                                                          // 0 for headerless files
+  int       codec;                                                                                                // CODEC_PCM, CODEC_ULAW or CODEC_ADPCM
+  uint32_t  samples;                                                                                              // samples recorded ( per channel )
+  uint32_t  rate;                                                                                                 // [Hz] written to the WAV header
+  AdpcmState adpcm;
+  RiceState rice;
+  byte      buf[ RECORD_BURST * 512 ];
+};
+
+boolean recordOpen( RecordFile &rec, const char *name, int wavChannels, int codec = CODEC_PCM, uint32_t rate = 44100 ) {
+  rec.fill        = 0;
+  rec.size        = 0;
+  rec.failed      = false;
+  rec.wavChannels = wavChannels;
+  rec.codec       = wavChannels > 0 ? codec : CODEC_PCM;                                                          // headerless files stay linear
+  rec.samples     = 0;
+  rec.rate        = rate;
+  adpcmReset( rec.adpcm );
+  riceReset( rec.rice );
+  rec.file = SD.createContiguous( name, recordPrealloc );
+  rec.raw  = rec.file && rec.file.contiguousRange( &rec.firstBlock, &rec.endBlock ) && rec.file.size() >= 512;
+  if ( rec.raw && rec.endBlock - rec.firstBlock >= rec.file.size() / 512 )                                       // not into the cluster tail
+  {
+    rec.endBlock = rec.firstBlock + rec.file.size() / 512 - 1;
+  }
+  rec.contiguous = rec.raw;
+  rec.nextBlock  = rec.firstBlock;
+  if ( !rec.raw )
+  {
+    Serial.println( "No contiguous space, recording through the file system" );
+    if ( rec.file ) rec.file.close();
+    rec.file = SD.open( name, FILE_WRITE );
+  }
+  if ( rec.file && wavChannels > 0 )
+  {
+    fillWavHeader( rec.buf, 0, wavChannels, WAV_HEADER_SIZE, rec.codec, 0, rate );                               // sizes are patched by recordClose()
+    rec.fill = WAV_HEADER_SIZE;
+  }
+  return rec.file;
+}
+
+boolean recordFlush( RecordFile &rec ) {
+  int len = rec.fill;
+  rec.fill = 0;
+  if ( rec.failed ) return false;                                                                                 // no gaps: nothing after the first failure
+
+  if ( rec.raw )
+  {
+    int blocks = ( len + 511 ) / 512;
+    if ( rec.nextBlock + blocks - 1 <= rec.endBlock )
+    {
+      memset( rec.buf + len, 0, blocks * 512 - len );                                                             // pad the last partial block
+      rec.failed = !SD.writeBlocks( rec.nextBlock, rec.buf, blocks );
+      if ( rec.failed ) return false;
+      rec.nextBlock += blocks;
+      rec.size      += len;
+      return true;
+    }
+    Serial.println( "Preallocation used up, recording through the file system" );                               // carry on where the raw writes stopped
+    rec.raw    = false;
+    rec.failed = !rec.file.seek( rec.size );
+    if ( rec.failed ) return false;
+  }
+  rec.failed = rec.file.write( rec.buf, len ) != (size_t)len;
+  if ( rec.failed ) return false;
+  rec.size += len;
+  return true;
+}
+
+boolean recordWrite( RecordFile &rec, const byte *src, int len ) {
+  boolean ok = true;
+  while ( len > 0 )
+  {
+    int n = sizeof( rec.buf ) - rec.fill;
+    if ( n > len ) n = len;
+    memcpy( rec.buf + rec.fill, src, n );
+    rec.fill += n;
+    src      += n;
+    len      -= n;
+    if ( rec.fill == sizeof( rec.buf ) ) ok = recordFlush( rec ) && ok;
+  }
+  return ok;
+}
+
+boolean recordSamples( RecordFile &rec, const int16_t *src, int n ) {
+  uint32_t cycles = 0;                                                                                            // encode time only, SD writes are in recordFlush()
+  uint32_t start;
+  boolean  ok     = true;
+  if ( recordTap ) recordTap( src, n );
+  rec.samples += n;
+  if ( rec.codec != CODEC_PCM ) codecSamples += n;
+  switch ( rec.codec )
+  {
+    case CODEC_ULAW:
+    {
+      byte ulaw[ AUDIO_BLOCK_SAMPLES ];
+      while ( n > 0 )
+      {
+        int len = n < AUDIO_BLOCK_SAMPLES ? n : AUDIO_BLOCK_SAMPLES;
+        start   = CODEC_CYCLES();
+        ulawEncodeBlock( src, ulaw, len );
+        cycles += CODEC_CYCLES() - start;
+        ok   = recordWrite( rec, ulaw, len ) && ok;
+        codecBytes += len;
+        src += len;
+        n   -= len;
+      }
+      break;
+    }
+    case CODEC_ADPCM:
+      while ( n > 0 )
+      {
+        start    = CODEC_CYCLES();
+        int used = adpcmEncode( rec.adpcm, src, n );
+        cycles  += CODEC_CYCLES() - start;
+        src += used;
+        n   -= used;
+        if ( rec.adpcm.pos == ADPCM_BLOCK_SAMPLES )                                                               // a whole block, exactly one sector
+        {
+          ok = recordWrite( rec, rec.adpcm.block, ADPCM_BLOCK ) && ok;
+          codecBytes   += ADPCM_BLOCK;
+          rec.adpcm.pos = 0;
+        }
+      }
+      break;
+    case CODEC_RICE:
+    {
+      byte coded[ RICE_MAX_BYTES ];
+      while ( n > 0 )
+      {
+        int len  = n < AUDIO_BLOCK_SAMPLES ? n : AUDIO_BLOCK_SAMPLES;
+        start    = CODEC_CYCLES();
+        int size = riceEncodeBlock( rec.rice, src, len, coded );
+        cycles  += CODEC_CYCLES() - start;
+        ok   = recordWrite( rec, coded, size ) && ok;
+        codecBytes += size;
+        src += len;
+        n   -= len;
+      }
+      break;
+    }
+    default:
+      return recordWrite( rec, (const byte*)src, n * 2 );
+  }
+  codecBlocks ++;
+  codecCycles += cycles;
+  if ( cycles > codecCyclesMax ) codecCyclesMax = cycles;
+  return ok;
+}
+
+boolean recordClose( RecordFile &rec ) {
+  boolean ok = true;
+  if ( rec.codec == CODEC_ADPCM && rec.adpcm.pos > 0 )                                                            // last, short ADPCM block
+  {
+    ok = recordWrite( rec, rec.adpcm.block, adpcmPartial( rec.adpcm ) );
+    rec.adpcm.pos = 0;
+  }
+  if ( rec.fill > 0 ) ok = recordFlush( rec ) && ok;
+  if ( rec.wavChannels > 0 )                                                                                      // back-patch the WAV sizes
+  {
+    uint32_t dataSize = rec.size > WAV_HEADER_SIZE ? rec.size - WAV_HEADER_SIZE : 0;
+    fillWavHeader( rec.buf, dataSize, rec.wavChannels, WAV_HEADER_SIZE, rec.codec, rec.samples, rec.rate );
+    if ( rec.contiguous )                                                                                         // the first block stays where it was preallocated
+    {
+      ok = SD.writeBlocks( rec.firstBlock, rec.buf, 1 ) && ok;
+    }
+    else
+    {
+      ok = rec.file.seek( 0 ) && rec.file.write( rec.buf, WAV_HEADER_SIZE ) == WAV_HEADER_SIZE && ok;
+    }
+  }
+  if ( rec.contiguous ) ok = rec.file.truncate( rec.size ) && ok;                                                // the only directory update of the recording
+  rec.file.close();
+  return ok && !rec.failed;
+}
+
 // ==============================================================================================================
 // Print directoy
 // Print the informtion stored in the SD card
@@ -95,14 +392,13 @@ void printDirectory( File dir, int numTabs )
   while ( true )
   {
     File    entry =  dir.openNextFile();
-    String  s     = "";
 
     if ( ! entry ) 
     {
       break;
     }
-    s = entry.name();
-    if ( ( s.indexOf( "WAV" ) > -1 ) | ( s.indexOf( "RAW" ) > -1 ) )
+    const char  *s = entry.name();
+    if ( strstr( s, "WAV" ) || strstr( s, "RAW" ) )
     {
       for (uint8_t i = 0; i < numTabs; i++) {
         Serial.print('\t');
@@ -138,48 +434,6 @@ void printDirectory( File dir, int numTabs )
 }
 
 
-// ==============================================================================================================
-// Load directory
-// ...
-// 
-// Michael Xynidis --2016
-// ==============================================================================================================
-int const arrayElements = 20;
-int const lcdRows       =  4;
-int       fileCount     =  0;
-int       lcdPtr        =  1;
-int       listPtr       =  0;
-int       endPtr        =  0;
-String    fileEntry[arrayElements];
-
-
-void loadDirectory( File dir )
-{
-  while ( true )
-  {
-    File entry  =  dir.openNextFile();
-    String s    = "";
- 
-    if ( ( ! entry ) | ( fileCount >= arrayElements ) ) 
-    {
-      break;
-    }
-    s = entry.name();
-    if ( ( s.indexOf( "WAV" ) > -1 ) | ( s.indexOf( "RAW" ) > -1 ) )
-    {
-      fileEntry[fileCount] = s;
-      fileCount++;
-    }
-    endPtr = fileCount - 1;
-    entry.close();
-  }
-
-  Serial.print( "Confirm file count: [" );
-  Serial.print( fileCount );
-  Serial.println( "]" );
-  fileCount = 0;
-}
-
 // ==============================================================================================================
 // Send data through serial
 // ...
@@ -188,55 +442,21 @@ void loadDirectory( File dir )
 // ==============================================================================================================
 void sendFileSerial( File  file )
 {
-  
-  int   dataSize          = file.size();
-  int   headerSize        =    44;
-  int   dataChunkSize     = dataSize + headerSize - 8;
-
-  int   subDataChunkSize  =    16;
-  byte  format            =   0x1;                                //PCM
-  byte  channels          =   0x1;                                //mono
-  int   sampleRate        = 44100;
-  int   bytesPerSample    =     4;
-  int   bitsPerSample     =    16;
-
-  byte  b;
   bool  reading           = true;
 
-  BTooth.write( "RIFF" );                                         // 00 - RIFF
-  for( int n = 0; n < 4; ++n )
-    BTooth.write( (byte)((dataChunkSize >> (n * 8)) & 0xFF) );    // 04 - how big is the rest of this file?
-  BTooth.write( "WAVE" );                                         // 08 - WAVE
-  BTooth.write( "fmt ");                                          // 12 - fmt
-  for( int n = 0; n < 4; ++n )
-    BTooth.write( (byte)((subDataChunkSize >> (n * 8)) & 0xFF) ); // 16 - size of this chunk
-  for( int n = 0; n < 2; ++n )
-    BTooth.write( (byte)((format >> (n * 8)) & 0xFF) );           // 20 - what is the audio format? 1 for PCM = Pulse Code Modulation
-  for( int n = 0; n < 2; ++n )
-    BTooth.write( (byte)((channels >> (n * 8)) & 0xFF) );         // 22 - mono or stereo? 1 or 2? (or 5 or ???)
-  for( int n = 0; n < 4; ++n )
-    BTooth.write( (byte)((sampleRate >> (n * 8)) & 0xFF) );       // 24 - samples per second (numbers per second)
-  for( int n = 0; n < 4; ++n )
-    BTooth.write( (byte)(((sampleRate * bytesPerSample) >> (n * 8)) & 0xFF) ); // 28 - bytes per second
-  for( int n = 0; n < 2; ++n )
-    BTooth.write( (byte)(((bytesPerSample) >> (n * 8)) & 0xFF) ); // 32 - # of bytes in one sample, for all channels
-  for( int n = 0; n < 2; ++n )
-    BTooth.write( (byte)((bitsPerSample >> (n * 8)) & 0xFF) );    // 34 - how many bits in a sample(number)? usually 16 or 24
-  BTooth.write("data");                       // 36 - data
-  for( int n = 0; n < 4; ++n )
-    BTooth.write( (byte)((dataSize >> (n * 8)) & 0xFF) );         // 40 - how big is this data chunk
-
-  // 44 - the actual data itself
-  do
-  {
-    if( file.available() )
-    {
-      b = file.read();
-      BTooth.write( b );
-    }
+  if ( !strstr( file.name(), "WAV" ) )                            // headerless recording: send a WAV header first
+  {
+    byte header[44];
+    fillWavHeader( header, file.size(), 1, sizeof( header ) );
+    btReply( header, sizeof( header ) );
+  }
+
+  while( reading )
+  {
+    int n = file.read( buffer, sizeof( buffer ) );                // one sector at a time
+    if( n > 0 ) btReply( (byte*)buffer, n );
     else reading = false;
   }
-  while( reading ) ;
 
   file.close();
 }
@@ -0,0 +1,191 @@
+/*
+ * FileTransfer.h
+ *
+ * Chunked, CRC-checked transfer of SD card files over bluetooth
+ *
+ * GETFILE "NAME" or "NAME:offset"      ->  ACK, file size (4), start offset (4)      or  NAK
+ * then, for each 512 byte chunk         ->  SOH, seq (4), length (2), data, CRC32 (4)
+ * once every chunk is acknowledged      ->  EOT
+ *
+ * All numbers are little-endian. Chunk <seq> holds the bytes at offset + seq * 512; the CRC32 (IEEE) covers seq,
+ * length and data. Up to XFER_WINDOW chunks are sent ahead of the last FILEACK; FILENAK, or XFER_TIMEOUT ms
+ * without progress, rewinds to the requested / first unacknowledged chunk. A dropped transfer is resumed with
+ * GETFILE "NAME:offset".
+ */
+
+// ==============================================================================================================
+// Variables
+// ============================================================================================================== //
+#define   XFER_CHUNK          512                                                                                 // bytes of file data per chunk ( one SD sector )
+#define   XFER_WINDOW         8                                                                                   // chunks in flight before waiting for FILEACK
+#define   XFER_TIMEOUT        1000                                                                                // [ms] without an acknowledgement before resending
+#define   XFER_RETRIES        5                                                                                   // timeouts in a row before giving up
+
+File          xferFile;
+uint32_t      xferStart       = 0;                                                                                // file offset of chunk 0
+uint32_t      xferChunks      = 0;                                                                                // chunks in this transfer
+uint32_t      xferNext        = 0;                                                                                // next chunk to send
+uint32_t      xferAcked       = 0;                                                                                // chunks acknowledged ( all below this one )
+int           xferRetries     = 0;
+elapsedMillis xferSinceAck;
+
+byte          xferFrame[ 1 + 4 + 2 + XFER_CHUNK + 4 ];                                                            // chunk being sent
+int           xferFrameLen    = 0;
+int           xferFrameSent   = 0;
+
+// ==============================================================================================================
+// Start Transfer
+// ============================================================================================================== //
+boolean startTransfer( const char *payload ) {
+  Serial.println( "EXECUTING startTransfer()" );
+
+  char      name[ 32 ];
+  uint32_t  offset  = 0;
+  int       n       = 0;
+  while ( payload[n] && payload[n] != ':' && n < (int)sizeof( name ) - 1 ) {
+    name[n] = payload[n];
+    n ++;
+  }
+  name[n] = 0;
+  if ( payload[n] == ':' ) offset = strtoul( payload + n + 1, NULL, 10 );
+
+  if ( xferFile ) xferFile.close();
+  if ( mode == 0 && n > 0 && SD.exists( name ) ) xferFile = SD.open( name );
+  if ( !xferFile || offset > xferFile.size() )
+  {
+    if ( xferFile ) xferFile.close();
+    Serial.println( "Stethoscope CANNOT send FILE" );
+    Serial.println( "sending: NAK..." );
+    btReply( NAK );
+    return false;
+  }
+
+  uint32_t size = xferFile.size();
+  xferStart     = offset;
+  xferChunks    = ( size - offset + XFER_CHUNK - 1 ) / XFER_CHUNK;
+  xferNext      = 0;
+  xferAcked     = 0;
+  xferRetries   = 0;
+  xferFrameLen  = 0;
+  xferFrameSent = 0;
+  xferSinceAck  = 0;
+  xferFile.seek( offset );
+
+  Serial.print( "Sending " );     Serial.print( name );
+  Serial.print( " from " );       Serial.print( offset );
+  Serial.print( ", chunks: " );   Serial.println( xferChunks );
+  Serial.println( "sending: ACK..." );
+  btReply( ACK );
+  byte header[8];
+  putLE( header,     size,   4 );
+  putLE( header + 4, offset, 4 );
+  btReply( header, sizeof( header ) );
+
+  deviceState = TRANSFERRING;
+  switchMode( 6 );
+  return true;
+} // End of startTransfer()
+
+// ==============================================================================================================
+// Stop Transfer
+// ============================================================================================================== //
+void transferChunkFinish() {                                                                                      // the rest of the chunk going out ( btFrameFinish() )
+  BTooth.write( xferFrame + xferFrameSent, xferFrameLen - xferFrameSent );
+  xferFrameSent = xferFrameLen;
+  if ( btFrameOwner == SOH ) btFrameOwner = 0x00;
+}
+
+void transferChunkDrop() {                                                                                        // the receiver resyncs on the next SOH
+  xferFrameLen = xferFrameSent = 0;
+  if ( btFrameOwner == SOH ) btFrameOwner = 0x00;
+}
+
+void stopTransfer( boolean complete ) {
+  transferChunkFinish();                                                                                          // so a reply after it isn't read as part of it
+  transferChunkDrop();
+  xferFile.close();
+  if ( complete ) btReply( EOT );
+  Serial.println( complete ? "Transfer complete" : "Transfer abandoned" );
+  deviceState = READY;
+  switchMode( 0 );
+} // End of stopTransfer()
+
+// ==============================================================================================================
+// Transfer Acknowledgements
+// FILEACK <seq> : every chunk up to and including seq arrived intact
+// FILENAK <seq> : chunk seq was lost or corrupt, resend from there
+// ============================================================================================================== //
+void transferAck( const char *payload ) {
+  if ( mode != 6 ) return;
+  uint32_t seq = strtoul( payload, NULL, 10 );
+  if ( seq + 1 > xferAcked && seq < xferNext ) {
+    xferAcked    = seq + 1;
+    xferRetries  = 0;
+    xferSinceAck = 0;
+  }
+} // End of transferAck()
+
+void transferNak( const char *payload ) {
+  if ( mode != 6 ) return;
+  uint32_t seq = strtoul( payload, NULL, 10 );
+  if ( seq >= xferAcked && seq < xferNext ) {
+    xferAcked    = seq;
+    xferNext     = seq;                                                                                           // go back to the lost chunk
+    transferChunkDrop();                                                                                          // abandon the partly sent one
+    xferSinceAck = 0;
+  }
+} // End of transferNak()
+
+// ==============================================================================================================
+// Continue Transfer
+// Never blocks: each call only writes what the UART transmit buffer can take
+// ============================================================================================================== //
+boolean continueTransfer() {
+  if ( xferAcked >= xferChunks ) {
+    stopTransfer( true );
+    return true;
+  }
+
+  if ( xferSinceAck > XFER_TIMEOUT ) {                                                                            // no progress: resend from the first unacknowledged chunk
+    if ( ++xferRetries > XFER_RETRIES ) {
+      stopTransfer( false );
+      return false;
+    }
+    xferNext     = xferAcked;
+    transferChunkDrop();
+    xferSinceAck = 0;
+  }
+
+  // Build the next chunk when the window allows
+  if ( xferFrameSent == xferFrameLen && xferNext < xferChunks && xferNext < xferAcked + XFER_WINDOW ) {
+    uint32_t offset = xferStart + xferNext * XFER_CHUNK;
+    int      want   = xferFile.size() - offset < XFER_CHUNK ? xferFile.size() - offset : XFER_CHUNK;
+    boolean  ok     = xferFile.position() == offset || xferFile.seek( offset );
+    int      len    = ok ? xferFile.read( xferFrame + 7, want ) : -1;
+    if ( len != want ) {                                                                                          // a card error: never send a short or empty chunk for it
+      Serial.println( "Stethoscope CANNOT read the FILE" );
+      stopTransfer( false );
+      Serial.println( "sending: NAK..." );
+      btReply( NAK );
+      return false;
+    }
+    xferFrame[0] = SOH;
+    putLE( xferFrame + 1, xferNext, 4 );
+    putLE( xferFrame + 5, len,      2 );
+    putLE( xferFrame + 7 + len, crc32( xferFrame + 1, 6 + len ), 4 );
+    xferFrameLen  = 7 + len + 4;
+    xferFrameSent = 0;
+    xferNext ++;
+  }
+
+  // Hand the UART as much of the chunk as it has room for
+  int room = BTooth.availableForWrite();
+  int left = xferFrameLen - xferFrameSent;
+  if ( room > left ) room = left;
+  if ( room > 0 ) {
+    BTooth.write( xferFrame + xferFrameSent, room );
+    xferFrameSent += room;
+    btFrameOwner   = xferFrameSent < xferFrameLen ? SOH : 0x00;
+  }
+  return true;
+} // End of continueTransfer()
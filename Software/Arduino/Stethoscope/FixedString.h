@@ -0,0 +1,57 @@
+/*
+ * FixedString.h
+ *
+ * A string with its capacity fixed at compile time, for filenames and the other short strings of the command paths.
+ * It never touches the heap: text that does not fit is cut off and the string remembers it ( truncated() ), so a
+ * caller can refuse a name instead of opening the wrong file.
+ */
+
+#ifndef FIXEDSTRING_H
+#define FIXEDSTRING_H
+
+template< int N >
+class FixedString
+{
+  public:
+    FixedString()                                   { clear(); }
+    FixedString( const char *s )                    { clear(); append( s ); }
+
+    void          clear()                           { len = 0; buf[0] = 0; cut = false; }
+    FixedString & operator=( const char *s )        { clear(); return append( s ); }
+
+    FixedString & append( char c ) {
+      if ( len < N ) { buf[ len ++ ] = c; buf[ len ] = 0; }
+      else cut = true;
+      return *this;
+    }
+
+    FixedString & append( const char *s ) {
+      while ( s && *s ) append( *s ++ );
+      return *this;
+    }
+
+    FixedString & append( int n )                   { return append( (long)n ); }
+    FixedString & append( long n ) {                                                                              // decimal
+      char  digits[ 12 ];
+      int   i     = 0;
+      unsigned long u = n < 0 ? -(unsigned long)n : n;
+      do { digits[ i ++ ] = '0' + u % 10; u /= 10; } while ( u );
+      if ( n < 0 ) digits[ i ++ ] = '-';
+      while ( i > 0 ) append( digits[ -- i ] );
+      return *this;
+    }
+
+    const char *  c_str() const                     { return buf; }
+    int           length() const                    { return len; }
+    boolean       truncated() const                 { return cut; }                                               // something did not fit
+    static int    capacity()                        { return N; }
+
+  private:
+    char          buf[ N + 1 ];
+    int           len;
+    boolean       cut;
+};
+
+typedef FixedString< 12 >   FileName;                                                                             // 8.3
+
+#endif
@@ -0,0 +1,46 @@
+/*
+ * HeapMonitor.h
+ *
+ * Samples the heap from loop() ( mallinfo() ) and keeps the peaks, so that a long session shows whether anything
+ * still allocates: the arena only grows when an allocation finds no free block big enough, and free bytes below the
+ * top of the arena are fragments that a larger block cannot use. HEAPSTATS reports the figures.
+ */
+
+#include  <malloc.h>
+
+// ==============================================================================================================
+// Variables
+// ============================================================================================================== //
+#define   HEAP_SAMPLE_MS      100                                                                                 // [ms] between samples
+
+struct HeapStats {
+  uint32_t        arena;                                                                                          // bytes taken from the system for the heap
+  uint32_t        used;                                                                                           // in allocated blocks
+  uint32_t        free;                                                                                           // in free blocks
+  uint32_t        fragmented;                                                                                     // free, but not at the top of the arena
+  uint32_t        arenaPeak;
+  uint32_t        usedPeak;
+};
+
+HeapStats     heapStats;
+elapsedMillis heapSinceSample;
+
+// ==============================================================================================================
+// Heap Sample
+// ============================================================================================================== //
+void heapSample() {
+  struct mallinfo mi = mallinfo();
+  HeapStats       &h = heapStats;
+
+  h.arena       = mi.arena;
+  h.used        = mi.uordblks;
+  h.free        = mi.fordblks;
+  h.fragmented  = mi.fordblks > mi.keepcost ? mi.fordblks - mi.keepcost : 0;                                      // keepcost: the free block at the top
+  if ( h.arena > h.arenaPeak ) h.arenaPeak = h.arena;
+  if ( h.used  > h.usedPeak  ) h.usedPeak  = h.used;
+  heapSinceSample = 0;
+}
+
+void heapMonitor() {
+  if ( heapSinceSample >= HEAP_SAMPLE_MS ) heapSample();
+}
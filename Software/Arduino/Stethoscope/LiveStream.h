@@ -0,0 +1,205 @@
+/*
+ * LiveStream.h
+ *
+ * Live microphone audio over bluetooth, for remote listening. The output of filter_LowPass_1 ( 500 Hz ) is taken
+ * from queue_stream, averaged down by a factor of 6 to 11 ( 7.4 to 4.0 kHz ), coded and sent in packets of
+ * STREAM_SAMPLES samples. At the default, ADPCM at 5.5 kHz, the stream takes 3.1 kB/s of the 11.5 kB/s link;
+ * mu-law at 7.4 kHz, the most it allows, 7.7 kB/s.
+ *
+ * STARTSTREAM "codec:factor"           ->  ACK, rate [Hz] (2)  or  NAK ( codec 1 mu-law, 2 ADPCM; ADPCM and 8 when empty )
+ * then, every STREAM_SAMPLES samples    ->  SYN, seq (2), codec (1), factor (1), samples (2), length (2), data, CRC32 (4)
+ * STOPSTREAM                           ->  ACK
+ *
+ * All numbers are little-endian; the CRC32 (IEEE) covers seq to the end of the data. ADPCM data starts with the
+ * predictor (2) and step index (1) the packet was coded from, then two samples a byte, the first in the low nibble,
+ * so every packet decodes on its own. A packet that is ready while the last one is still going out is dropped, and
+ * the gap shows in seq; nothing is sent during a file transfer. Telemetry frames ( Telemetry.h ) go out between
+ * packets, never inside one ( btFrameOwner ).
+ *
+ * Python/Stethoscope/streamReceiver.py plays the stream through a jitter buffer.
+ */
+
+// ==============================================================================================================
+// Variables
+// ============================================================================================================== //
+#define   STREAM_FACTOR       8                                                                                   // decimation by default, 5.5 kHz
+#define   STREAM_FACTOR_MIN   6                                                                                   // 7.4 kHz
+#define   STREAM_FACTOR_MAX   11                                                                                  // 4.0 kHz
+#define   STREAM_SAMPLES      256                                                                                 // decimated samples per packet
+#define   STREAM_HEADER       9                                                                                   // SYN to length
+
+struct LiveStream {
+  boolean         on;
+  byte            codec;                                                                                          // CODEC_ULAW or CODEC_ADPCM ( RecordCodec.h )
+  int             factor;
+  int32_t         sum;                                                                                            // of the input samples of the next output sample
+  int             summed;
+  int16_t         pcm[ STREAM_SAMPLES ];                                                                          // decimated, waiting for the next packet
+  int             n;
+  AdpcmState      adpcm;                                                                                          // predictor and step index run on between packets
+  uint16_t        seq;                                                                                            // of the next packet
+  int             sendLen;                                                                                        // packet going out
+  int             sent;
+  uint32_t        packets;                                                                                        // since STARTSTREAM
+  uint32_t        dropped;
+};
+
+LiveStream    live;
+byte          livePacket[ STREAM_HEADER + STREAM_SAMPLES + 4 ];                                                   // mu-law is the larger
+
+// ==============================================================================================================
+// Start Stream
+// ============================================================================================================== //
+boolean startStream( const char *payload ) {
+  Serial.println( "EXECUTING startStream()" );
+  int         codec   = *payload ? atoi( payload ) : CODEC_ADPCM;
+  const char  *colon  = strchr( payload, ':' );
+  int         factor  = colon ? atoi( colon + 1 ) : STREAM_FACTOR;
+  if ( ( codec != CODEC_ULAW && codec != CODEC_ADPCM ) || factor < STREAM_FACTOR_MIN || factor > STREAM_FACTOR_MAX )
+  {
+    Serial.println( "Stethoscope CANNOT START STREAMING" );
+    Serial.println( "sending: NAK..." );
+    btReply( NAK );
+    return false;
+  }
+
+  live.on       = true;
+  live.codec    = codec;
+  live.factor   = factor;
+  live.sum      = 0;
+  live.summed   = 0;
+  live.n        = 0;
+  live.seq      = 0;
+  live.sendLen  = live.sent = 0;
+  live.packets  = live.dropped = 0;
+  adpcmReset( live.adpcm );
+  graphUse( GRAPH_STREAM, true );
+  queue_stream.begin();
+
+  uint16_t rate = AUDIO_SAMPLE_RATE_EXACT / factor + 0.5;
+  Serial.print( "Streaming " );         Serial.print( codec == CODEC_ULAW ? "mu-law" : "ADPCM" );
+  Serial.print( " at " );               Serial.print( rate );
+  Serial.println( " Hz" );
+  Serial.println( "sending: ACK..." );
+  btReply( ACK );
+  byte r[2];
+  putLE( r, rate, 2 );
+  btReply( r, 2 );
+  return true;
+} // End of startStream()
+
+// ==============================================================================================================
+// Stream Packet
+// Codes the waiting samples into livePacket, unless the last packet is still going out
+// ============================================================================================================== //
+void streamPacket() {
+  uint16_t seq = live.seq ++;
+  if ( live.sent < live.sendLen || mode == 6 )                                                                    // the UART has not kept up, or a transfer owns it
+  {
+    live.dropped ++;
+    return;
+  }
+
+  byte  *d  = livePacket + STREAM_HEADER;
+  int   len;
+  if ( live.codec == CODEC_ULAW )
+  {
+    ulawEncodeBlock( live.pcm, d, STREAM_SAMPLES );
+    len = STREAM_SAMPLES;
+  }
+  else
+  {
+    putLE( d, live.adpcm.predictor, 2 );
+    d[2] = live.adpcm.index;
+    for ( int i = 0; i < STREAM_SAMPLES; i += 2 )
+    {
+      byte lo = adpcmEncodeSample( live.adpcm, live.pcm[i]     );
+      byte hi = adpcmEncodeSample( live.adpcm, live.pcm[i + 1] );
+      d[ 3 + i / 2 ] = lo | ( hi << 4 );
+    }
+    len = 3 + STREAM_SAMPLES / 2;
+  }
+
+  livePacket[0] = SYN;
+  putLE( livePacket + 1, seq,            2 );
+  putLE( livePacket + 3, live.codec,     1 );
+  putLE( livePacket + 4, live.factor,    1 );
+  putLE( livePacket + 5, STREAM_SAMPLES, 2 );
+  putLE( livePacket + 7, len,            2 );
+  putLE( livePacket + STREAM_HEADER + len, crc32( livePacket + 1, STREAM_HEADER - 1 + len ), 4 );
+  live.sendLen = STREAM_HEADER + len + 4;
+  live.sent    = 0;
+  live.packets ++;
+} // End of streamPacket()
+
+// ==============================================================================================================
+// Stream Update
+// Called from loop(); never blocks: decimates what the queue holds, and hands the UART what it has room for
+//
+// The decimation is a box-car average rather than AudioEffectDecimate ( effect_decimate.h ): that one only divides
+// by 4, 8 or 10, and the stream offers 6 to 11. The queue is fed from filter_LowPass_1, so what would fold back
+// onto the 0-500 Hz band is already 34 dB down or more at the filter, and the average's nulls at multiples of the
+// new rate add another 17 dB or more; at the default factor of 8, 60 dB in all. An FIR of 12 taps a step would
+// cost the loop ~6 multiplies a sample for a listening stream that is coded to 4 or 8 bits anyway.
+// ============================================================================================================== //
+void streamUpdate() {
+  if ( !live.on ) return;
+
+  while ( queue_stream.available() > 0 )
+  {
+    const int16_t *s = queue_stream.readBuffer();
+    for ( int i = 0; i < AUDIO_BLOCK_SAMPLES; i ++ )
+    {
+      live.sum += s[i];
+      if ( ++ live.summed < live.factor ) continue;
+      live.pcm[ live.n ++ ] = live.sum / live.factor;                                                             // the average: nulls at multiples of the new rate
+      live.sum    = 0;
+      live.summed = 0;
+      if ( live.n == STREAM_SAMPLES )
+      {
+        streamPacket();
+        live.n = 0;
+      }
+    }
+    queue_stream.freeBuffer();
+  }
+
+  int room = BTooth.availableForWrite();
+  int left = live.sendLen - live.sent;
+  if ( room > left ) room = left;
+  if ( room > 0 && mode != 6 && ( btFrameOwner == 0x00 || btFrameOwner == SYN ) )
+  {
+    BTooth.write( livePacket + live.sent, room );
+    live.sent   += room;
+    btFrameOwner = live.sent < live.sendLen ? SYN : 0x00;
+  }
+} // End of streamUpdate()
+
+// ==============================================================================================================
+// Stop Stream
+// Finishes the packet going out; the samples of an unfinished packet are dropped
+// ============================================================================================================== //
+void streamPacketFinish() {                                                                                       // the rest of the packet going out ( btFrameFinish() )
+  BTooth.write( livePacket + live.sent, live.sendLen - live.sent );
+  live.sendLen = live.sent = 0;
+  if ( btFrameOwner == SYN ) btFrameOwner = 0x00;
+}
+
+void stopStream() {
+  Serial.println( "EXECUTING stopStream()" );
+  if ( live.on )
+  {
+    queue_stream.end();
+    queue_stream.clear();
+    graphUse( GRAPH_STREAM, false );
+    btFrameFinish();                                                                                              // a telemetry frame part-way out, or this packet
+    if ( mode != 6 ) streamPacketFinish();                                                                        // the packet waiting to go out, whole
+    live.sendLen = live.sent = 0;
+    live.on      = false;
+  }
+  Serial.print( "Stream: " );           Serial.print( live.packets );
+  Serial.print( " packets, " );         Serial.print( live.dropped );
+  Serial.println( " dropped" );
+  Serial.println( "sending: ACK..." );
+  btReply( ACK );
+} // End of stopStream()
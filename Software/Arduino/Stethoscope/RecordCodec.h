@@ -0,0 +1,288 @@
+/*
+ * RecordCodec.h
+ *
+ * Recording codecs applied between the record queues and the SD card writer
+ *
+ * CODEC_PCM    16 bit linear                                         ( WAV format 1 )
+ * CODEC_ULAW   8 bit G.711 mu-law, 2:1                               ( WAV format 7 )
+ * CODEC_ADPCM  4 bit IMA-ADPCM, ~4:1, in 512 byte blocks of 1017 samples ( WAV format 0x11 )
+ * CODEC_RICE   lossless: fixed predictor and Rice-coded residuals per audio block ( private WAV format 0x5243 )
+ *
+ * The mu-law encoder is the one in the Audio library's extras/wav2sketch/wav2sketch.c, with the segment search
+ * replaced by a 256 entry table and the bits inverted as G.711 specifies ( wav2sketch's bytes are the complement of
+ * these, decoded on the Teensy by ulaw_decode_table[] in data_ulaw.c ). ADPCM blocks are sector sized, so each one
+ * lands in exactly one SD block.
+ */
+
+// ==============================================================================================================
+// Variables
+// ============================================================================================================== //
+#define   CODEC_PCM           0
+#define   CODEC_ULAW          1
+#define   CODEC_ADPCM         2
+#define   CODEC_RICE          3
+
+#define   ADPCM_BLOCK         512                                                                                 // bytes in one ADPCM block ( WAV block align )
+#define   ADPCM_BLOCK_SAMPLES ( ( ADPCM_BLOCK - 4 ) * 2 + 1 )                                                     // header sample + two samples per byte
+
+#define   RICE_FORMAT_TAG     0x5243                                                                              // "RC", not a registered WAV format
+#define   RICE_ESCAPE         31                                                                                  // parameter value marking a verbatim block
+#define   RICE_MAX_BYTES      ( 1 + AUDIO_BLOCK_SAMPLES * 2 )                                                     // largest coded block ( verbatim )
+
+#ifdef ARM_DWT_CYCCNT
+#define   CODEC_CYCLES()      ARM_DWT_CYCCNT                                                                      // CPU cycle counter, for the encode benchmark
+#else
+#define   CODEC_CYCLES()      0
+#endif
+
+uint32_t  codecBlocks         = 0;                                                                                // audio blocks encoded since the recording started ( PCM is not counted )
+uint32_t  codecCycles         = 0;                                                                                // ...and the cycles they took
+uint32_t  codecCyclesMax      = 0;
+uint32_t  codecSamples        = 0;                                                                                // samples encoded
+uint32_t  codecBytes          = 0;                                                                                // ...and the bytes they became
+
+// ==============================================================================================================
+// Mu-law
+// ulawSegment[] holds the segment ( exponent ) of a biased magnitude, indexed by its top 8 bits
+// ============================================================================================================== //
+const uint8_t ulawSegment[ 256 ] = {
+  0, 0, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 3, 3,
+  4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
+  5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5,
+  5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5,
+  6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6,
+  6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6,
+  6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6,
+  6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6,
+  7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7,
+  7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7,
+  7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7,
+  7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7,
+  7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7,
+  7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7,
+  7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7,
+  7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7
+};
+
+inline byte ulawEncode( int16_t sample ) {
+  int32_t  mag  = sample;
+  byte     sign = 0;
+  if ( mag < 0 ) {
+    mag  = -mag;
+    sign = 0x80;
+  }
+  mag += 0x84;                                                                                                    // G.711 bias
+  if ( mag > 0x7FFF ) mag = 0x7FFF;
+  byte seg = ulawSegment[ mag >> 7 ];
+  return ~( sign | ( seg << 4 ) | ( ( mag >> ( seg + 3 ) ) & 0x0F ) );
+}
+
+void ulawEncodeBlock( const int16_t *src, byte *dst, int n ) {
+  while ( n-- > 0 ) *dst++ = ulawEncode( *src++ );
+}
+
+// ==============================================================================================================
+// IMA-ADPCM
+// Mono WAV blocks: predictor (2), step index (1), reserved (1), then 4 bit codes, first sample in the low nibble
+// ============================================================================================================== //
+const int16_t adpcmStep[ 89 ] = {
+      7,     8,     9,    10,    11,    12,    13,    14,    16,    17,    19,    21,    23,    25,    28,
+     31,    34,    37,    41,    45,    50,    55,    60,    66,    73,    80,    88,    97,   107,   118,
+    130,   143,   157,   173,   190,   209,   230,   253,   279,   307,   337,   371,   408,   449,   494,
+    544,   598,   658,   724,   796,   876,   963,  1060,  1166,  1282,  1411,  1552,  1707,  1878,  2066,
+   2272,  2499,  2749,  3024,  3327,  3660,  4026,  4428,  4871,  5358,  5894,  6484,  7132,  7845,  8630,
+   9493, 10442, 11487, 12635, 13899, 15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767
+};
+
+const int8_t adpcmIndex[ 8 ] = { -1, -1, -1, -1, 2, 4, 6, 8 };
+
+struct AdpcmState {
+  int32_t   predictor;
+  int       index;                                                                                                // into adpcmStep[]
+  int       pos;                                                                                                  // samples in the current block
+  byte      block[ ADPCM_BLOCK ];
+};
+
+void adpcmReset( AdpcmState &st ) {
+  st.predictor = 0;
+  st.index     = 0;
+  st.pos       = 0;
+}
+
+inline byte adpcmEncodeSample( AdpcmState &st, int32_t sample ) {
+  int32_t  step  = adpcmStep[ st.index ];
+  int32_t  diff  = sample - st.predictor;
+  int32_t  delta = step >> 3;
+  byte     code  = 0;
+  if ( diff < 0 ) {
+    code = 8;
+    diff = -diff;
+  }
+  if ( diff >= step ) { code |= 4; diff -= step; delta += step; }
+  step >>= 1;
+  if ( diff >= step ) { code |= 2; diff -= step; delta += step; }
+  step >>= 1;
+  if ( diff >= step ) { code |= 1;               delta += step; }
+
+  st.predictor += ( code & 8 ) ? -delta : delta;
+  if      ( st.predictor >  32767 ) st.predictor =  32767;
+  else if ( st.predictor < -32768 ) st.predictor = -32768;
+  st.index += adpcmIndex[ code & 7 ];
+  if      ( st.index <  0 ) st.index =  0;
+  else if ( st.index > 88 ) st.index = 88;
+  return code;
+}
+
+// Encodes up to n samples into st.block, stopping when the block is full ( st.pos == ADPCM_BLOCK_SAMPLES ).
+// Returns the number of samples taken from src.
+int adpcmEncode( AdpcmState &st, const int16_t *src, int n ) {
+  int used = 0;
+  if ( st.pos == 0 && n > 0 ) {                                                                                   // block header carries the first sample verbatim
+    st.predictor = src[0];
+    st.block[0]  = src[0] & 0xFF;
+    st.block[1]  = ( src[0] >> 8 ) & 0xFF;
+    st.block[2]  = st.index;
+    st.block[3]  = 0;
+    st.pos       = 1;
+    used         = 1;
+  }
+  while ( used < n && st.pos < ADPCM_BLOCK_SAMPLES ) {
+    byte code = adpcmEncodeSample( st, src[used++] );
+    byte *b   = st.block + 4 + ( ( st.pos - 1 ) >> 1 );
+    if ( st.pos & 1 ) *b = code;                                                                                  // odd positions open a byte ( low nibble )
+    else              *b |= code << 4;
+    st.pos ++;
+  }
+  return used;
+}
+
+// Bytes of the current, partly filled block ( 0 if empty )
+int adpcmPartial( AdpcmState &st ) {
+  if ( st.pos == 0 ) return 0;
+  return 4 + st.pos / 2;
+}
+
+// ==============================================================================================================
+// Rice ( lossless )
+// One coded block per audio block, byte aligned:
+//   byte 0       predictor order ( bits 7..5, 0 to 3 ) and Rice parameter k ( bits 4..0 )
+//   k < 31       residuals, zig-zag mapped, each as ( u >> k ) zeros, a one, then the low k bits of u, MSB first
+//   k = 31       the samples verbatim, 16 bit little-endian
+// Predictors are the fixed polynomials of FLAC; they run across block boundaries, so blocks decode in order.
+// ============================================================================================================== //
+struct RiceState {
+  int32_t   hist[ 3 ];                                                                                            // last three samples, newest first
+};
+
+void riceReset( RiceState &st ) {
+  st.hist[0] = st.hist[1] = st.hist[2] = 0;
+}
+
+// Encodes n ( <= AUDIO_BLOCK_SAMPLES ) samples into dst, which must hold RICE_MAX_BYTES. Returns the bytes used.
+int riceEncodeBlock( RiceState &st, const int16_t *src, int n, byte *dst ) {
+  int32_t  x[ AUDIO_BLOCK_SAMPLES + 3 ];                                                                          // samples with three of history in front
+  uint32_t u[ AUDIO_BLOCK_SAMPLES ];
+  uint32_t cost[ 4 ] = { 0, 0, 0, 0 };
+  x[0] = st.hist[2];
+  x[1] = st.hist[1];
+  x[2] = st.hist[0];
+  for ( int i = 0; i < n; i ++ ) x[ i + 3 ] = src[i];
+
+  // Pick the predictor order with the smallest residuals
+  for ( int i = 3; i < n + 3; i ++ ) {
+    int32_t e0 = x[i];
+    int32_t e1 = e0 - x[i-1];
+    int32_t e2 = e1 - ( x[i-1] - x[i-2] );
+    int32_t e3 = e2 - ( x[i-1] - 2 * x[i-2] + x[i-3] );
+    cost[0] += abs( e0 );
+    cost[1] += abs( e1 );
+    cost[2] += abs( e2 );
+    cost[3] += abs( e3 );
+  }
+  int order = 0;
+  for ( int k = 1; k < 4; k ++ ) if ( cost[k] < cost[order] ) order = k;
+
+  // Residuals of that order, zig-zag mapped, and the Rice parameter for their mean
+  uint32_t sum = 0;
+  for ( int i = 3; i < n + 3; i ++ ) {
+    int32_t e;
+    switch ( order ) {
+      case 0:  e = x[i];                                                   break;
+      case 1:  e = x[i] - x[i-1];                                          break;
+      case 2:  e = x[i] - 2 * x[i-1] + x[i-2];                             break;
+      default: e = x[i] - 3 * x[i-1] + 3 * x[i-2] - x[i-3];                break;
+    }
+    u[ i - 3 ] = ( (uint32_t)e << 1 ) ^ (uint32_t)( e >> 31 );
+    sum += u[ i - 3 ];
+  }
+  int k = 0;
+  while ( k < 24 && ( (uint32_t)n << ( k + 1 ) ) < sum ) k ++;                                                 // k + 7 pending bits fit the accumulator
+
+  uint32_t bits = n * ( k + 1 );
+  for ( int i = 0; i < n; i ++ ) bits += u[i] >> k;
+
+  st.hist[0] = x[ n + 2 ];
+  st.hist[1] = x[ n + 1 ];
+  st.hist[2] = x[ n ];
+
+  if ( bits >= (uint32_t)n * 16 ) {                                                                               // incompressible ( noise, clipping ): verbatim
+    dst[0] = RICE_ESCAPE;
+    for ( int i = 0; i < n; i ++ ) {
+      dst[ 1 + 2 * i ] = src[i] & 0xFF;
+      dst[ 2 + 2 * i ] = ( src[i] >> 8 ) & 0xFF;
+    }
+    return 1 + 2 * n;
+  }
+
+  dst[0] = ( order << 5 ) | k;
+  byte     *out  = dst + 1;
+  uint32_t  acc  = 0;                                                                                             // bit accumulator, MSB first
+  int       nacc = 0;
+  for ( int i = 0; i < n; i ++ ) {
+    uint32_t q = u[i] >> k;
+    while ( q >= 24 ) {                                                                                           // long runs of zeros, a byte at a time
+      acc  <<= 8;
+      *out++ = acc >> nacc;
+      q     -= 8;
+    }
+    acc   = ( acc << ( q + 1 ) ) | 1;                                                                             // q zeros and the stop bit
+    nacc += q + 1;
+    while ( nacc >= 8 ) { nacc -= 8; *out++ = acc >> nacc; }
+    if ( k ) {
+      acc   = ( acc << k ) | ( u[i] & ( ( 1UL << k ) - 1 ) );
+      nacc += k;
+      while ( nacc >= 8 ) { nacc -= 8; *out++ = acc >> nacc; }
+    }
+  }
+  if ( nacc > 0 ) *out++ = acc << ( 8 - nacc );
+  return out - dst;
+}
+
+// ==============================================================================================================
+// Encode Benchmark
+// Cycles spent encoding each audio block in recordSamples(), printed when a recording stops
+// ============================================================================================================== //
+void codecStatsReset() {
+#ifdef ARM_DWT_CTRL
+  ARM_DEMCR    |= ARM_DEMCR_TRCENA;                                                                               // make sure the cycle counter runs
+  ARM_DWT_CTRL |= ARM_DWT_CTRL_CYCCNTENA;
+#endif
+  codecBlocks    = 0;
+  codecCycles    = 0;
+  codecCyclesMax = 0;
+  codecSamples   = 0;
+  codecBytes     = 0;
+}
+
+void codecStatsPrint() {
+  if ( codecBlocks == 0 ) return;
+  Serial.print( "Encode cycles per block: mean " );
+  Serial.print( codecCycles / codecBlocks );
+  Serial.print( ", max " );
+  Serial.print( codecCyclesMax );
+  Serial.print( ", blocks " );
+  Serial.print( codecBlocks );
+  Serial.print( ", ratio " );
+  Serial.print( codecBytes ? 2.0 * codecSamples / codecBytes : 0.0 );
+  Serial.println( ":1" );
+}
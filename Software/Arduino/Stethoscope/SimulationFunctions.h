@@ -10,22 +10,24 @@
 
 // ==============================================================================================================
 // Blending Functions
+// Blends sound <indexPly> of the catalog ( Catalog.h )
 // 
 // Michael Xynidis
 // Fluvio L Lobo Fenoglietto 05/02/2018
 // ============================================================================================================== //
-String audioBlend( int indexPly ) {
+const char * audioBlend( int indexPly ) {
   Serial.println( ">   EXECUTING audioBlend()" );
-  if ( indexPly == -1 ) {
+  if ( indexPly < 0 || indexPly >= catalogCount ) {
     Serial.println( ">   ERR: Non-existent file cannot be played" );
-    fileName = "";
+    fileName.clear();
+    btReply( NAK );                                                                                               // Negative AcKnowledgement sent back through bluetooth serial
   } else {
-    fileName = ses.filePly[indexPly];
+    fileName = catalog[indexPly].name;
     Serial.print( ">   AOK: " );
-    Serial.print( fileName );
+    Serial.print( fileName.c_str() );
     Serial.println( " will be played" );
-    startBlending( fileName );                                                                                    // execute startBlending()
+    startBlending( fileName.c_str() );                                                                      // execute startBlending()
   }
-  return fileName;
+  return fileName.c_str();
 } // End of audioBlend()
 // ============================================================================================================== //
@@ -0,0 +1,308 @@
+/*
+ * SoundLibrary.h
+ *
+ * The first SOUND_MAX sounds of the catalog ( Catalog.h ) mirrored in the SPI flash of the audio shield, so that playback and
+ * blending start, and switch sounds, without a directory search or a cold SD card read, and without competing with
+ * the card writes of a recording
+ *
+ * After boot every sound on the SD card is checked against its flash copy by size and CRC32; only a missing or
+ * changed sound is copied. A flash copy is the sound followed by the CRC32 of the SD file. The CRC is written last,
+ * once the copy has been read back and checked, so a copy cut short by a reset is never trusted. The sync takes one
+ * step per loop() pass ( SOUND_SYNC_CHUNK bytes checksummed, or one flash page copied ) and waits while the card is
+ * recording or transferring. A full flash is erased once and the library copied again. A sound plays from the SD
+ * card until its flash copy is trusted.
+ *
+ * soundPlay() times every start, per source; SNDSTATS reports the figures.
+ */
+
+// ==============================================================================================================
+// Variables
+// ============================================================================================================== //
+#define   FLASH_CS_PIN        6                                                                                   // Audio shield has the flash CS on pin 6
+#define   SOUND_MAX           32                                                                                  // catalog sounds mirrored in flash
+#define   SOUND_SYNC_CHUNK    1024                                                                                // bytes checksummed per loop() pass
+#define   SOUND_SYNC_PAGE     256                                                                                 // bytes copied per loop() pass ( one flash page )
+
+enum SoundSyncState
+{
+  SYNC_OFF,                                                                                                       // no flash chip, everything plays from the SD card
+  SYNC_OPEN,                                                                                                      // open the next sound on the SD card
+  SYNC_CRC,                                                                                                       // checksum the SD file, then compare the flash copy
+  SYNC_COPY,                                                                                                      // copy the SD file, a page at a time
+  SYNC_VERIFY,                                                                                                    // read the copy back before trusting it
+  SYNC_ERASE,                                                                                                     // flash full: erase, then start over
+  SYNC_DONE,
+};
+
+struct Sound {
+  SerialFlashFile flash;                                                                                          // trusted flash copy, opened once
+  uint32_t        size;                                                                                           // bytes of sound ( the copy holds the CRC after them )
+  boolean         inFlash;
+};
+
+struct SoundSync {
+  SoundSyncState  state;
+  int             index;                                                                                          // sound being checked or copied
+  char            name[ 13 ];
+  File            sd;
+  SerialFlashFile flash;
+  uint32_t        size;
+  uint32_t        pos;
+  uint32_t        crc;                                                                                            // of the SD file
+  uint32_t        check;                                                                                          // of the flash copy, while verifying
+  boolean         erasing;
+  boolean         erased;                                                                                         // the flash has been erased this boot
+  int             kept;                                                                                           // sounds whose copy was up to date
+  int             copied;
+  uint32_t        started;                                                                                        // [ms]
+};
+
+struct SoundStats {                                                                                               // starts timed by soundPlay()
+  uint32_t        count;
+  uint32_t        last;                                                                                           // [us]
+  uint32_t        max;                                                                                            // [us]
+  uint64_t        total;                                                                                          // [us]
+};
+
+Sound         sounds[ SOUND_MAX ];
+SoundSync     soundSync;
+SoundStats    soundStats[ 2 ];                                                                                    // [0] SD card, [1] flash
+byte          soundBuf[ SOUND_SYNC_CHUNK ];
+
+// ==============================================================================================================
+// Sound Library Begin
+// Finds the flash chip and starts the sync; call after the SD card is up
+// ============================================================================================================== //
+void soundLibraryBegin() {
+  for ( int i = 0; i < SOUND_MAX; i ++ ) sounds[i].inFlash = false;
+  memset( soundStats, 0, sizeof( soundStats ) );
+  soundSync.index   = 0;
+  soundSync.erasing = false;
+  soundSync.erased  = false;
+  soundSync.kept    = 0;
+  soundSync.copied  = 0;
+  soundSync.started = millis();
+  if ( SerialFlash.begin( FLASH_CS_PIN ) )
+  {
+    soundSync.state = SYNC_OPEN;
+  }
+  else
+  {
+    Serial.println( "No SPI flash, sounds play from the SD card" );
+    soundSync.state = SYNC_OFF;
+  }
+}
+
+// ==============================================================================================================
+// Sound Library Sync
+// One step of the sync, called from loop()
+// ============================================================================================================== //
+uint32_t soundSyncLen( uint32_t most ) {                                                                        // bytes for this step
+  uint32_t left = soundSync.size - soundSync.pos;
+  return left < most ? left : most;
+}
+
+void soundSyncNext() {
+  soundSync.sd.close();
+  soundSync.index ++;
+  soundSync.state = SYNC_OPEN;
+}
+
+void soundSyncTrust() {
+  Sound &snd  = sounds[ soundSync.index ];
+  snd.flash   = soundSync.flash;
+  snd.size    = soundSync.size;
+  snd.inFlash = true;
+  soundSyncNext();
+}
+
+// The SD file is checksummed: keep an up to date copy, replace anything else
+void soundSyncCompare() {
+  SoundSync &s = soundSync;
+  byte      tail[ 4 ];
+  byte      want[ 4 ];
+
+  putLE( want, s.crc, 4 );
+  s.flash = SerialFlash.open( s.name );
+  if ( s.flash && s.flash.size() == s.size + 4 )
+  {
+    s.flash.seek( s.size );
+    if ( s.flash.read( tail, 4 ) == 4 && memcmp( tail, want, 4 ) == 0 )
+    {
+      s.kept ++;
+      soundSyncTrust();
+      return;
+    }
+  }
+  if ( s.flash ) SerialFlash.remove( s.flash );                                                                   // stale copy, its space comes back with the next erase
+  if ( !SerialFlash.create( s.name, s.size + 4 ) )
+  {
+    if ( s.erased )
+    {
+      Serial.print( "Sound library: no room in flash for " );                                                    // even an empty chip is too small
+      Serial.println( s.name );
+      soundSyncNext();
+    }
+    else s.state = SYNC_ERASE;
+    return;
+  }
+  s.flash = SerialFlash.open( s.name );
+  s.sd.seek( 0 );
+  s.pos   = 0;
+  s.state = SYNC_COPY;
+}
+
+void soundLibrarySync() {
+  SoundSync &s = soundSync;
+  int       n;
+
+  if ( mode == 1 || mode == 6 ) return;                                                                           // the card is busy recording or transferring
+
+  switch ( s.state ) {
+    case SYNC_OPEN:
+      if ( s.index >= catalogCount || s.index >= SOUND_MAX )
+      {
+        s.state = SYNC_DONE;
+        Serial.print( "Sound library: " );  Serial.print( s.kept );
+        Serial.print( " in flash, " );      Serial.print( s.copied );
+        Serial.print( " copied, " );        Serial.print( millis() - s.started );
+        Serial.println( " ms" );
+        break;
+      }
+      strcpy( s.name, catalog[ s.index ].name );
+      s.sd = SD.open( s.name );
+      if ( !s.sd || s.sd.size() == 0 )
+      {
+        soundSyncNext();                                                                                          // nothing to copy, plays from the card ( if at all )
+        break;
+      }
+      s.size  = s.sd.size();
+      s.pos   = 0;
+      s.crc   = 0xFFFFFFFF;
+      s.state = SYNC_CRC;
+      break;
+
+    case SYNC_CRC:
+      n = s.sd.read( soundBuf, soundSyncLen( SOUND_SYNC_CHUNK ) );
+      if ( n <= 0 )
+      {
+        soundSyncNext();                                                                                          // card error, try again next boot
+        break;
+      }
+      s.crc  = crc32Update( s.crc, soundBuf, n );
+      s.pos += n;
+      if ( s.pos < s.size ) break;
+      s.crc = ~s.crc;
+      soundSyncCompare();
+      break;
+
+    case SYNC_COPY:
+      if ( !SerialFlash.ready() ) break;                                                                          // last page still programming
+      n = s.sd.read( soundBuf, soundSyncLen( SOUND_SYNC_PAGE ) );
+      if ( n <= 0 )
+      {
+        soundSyncNext();                                                                                          // the copy has no CRC, so it is replaced next boot
+        break;
+      }
+      s.flash.write( soundBuf, n );
+      s.pos += n;
+      if ( s.pos < s.size ) break;
+      s.flash.seek( 0 );
+      s.pos   = 0;
+      s.check = 0xFFFFFFFF;
+      s.state = SYNC_VERIFY;
+      break;
+
+    case SYNC_VERIFY:
+      if ( !SerialFlash.ready() ) break;
+      n = s.flash.read( soundBuf, soundSyncLen( SOUND_SYNC_CHUNK ) );
+      s.check = crc32Update( s.check, soundBuf, n );
+      s.pos  += n;
+      if ( s.pos < s.size ) break;
+      if ( ~s.check == s.crc )
+      {
+        byte tail[ 4 ];
+        putLE( tail, s.crc, 4 );
+        s.flash.write( tail, 4 );
+        s.copied ++;
+        soundSyncTrust();
+      }
+      else
+      {
+        Serial.print( "Sound library: flash copy of " );
+        Serial.print( s.name );
+        Serial.println( " does not match" );
+        soundSyncNext();
+      }
+      break;
+
+    case SYNC_ERASE:
+      if ( !s.erasing )
+      {
+        if ( playRaw_flashHeartSound.isPlaying() ) break;                                                         // not under a flash copy that is playing
+        for ( int i = 0; i < SOUND_MAX; i ++ ) sounds[i].inFlash = false;
+        s.sd.close();
+        Serial.println( "Sound library: flash full, erasing" );
+        SerialFlash.eraseAll();
+        s.erasing = true;
+        break;
+      }
+      if ( !SerialFlash.ready() ) break;
+      s.erasing = false;
+      s.erased  = true;
+      s.index   = 0;
+      s.kept    = 0;
+      s.copied  = 0;
+      s.state   = SYNC_OPEN;
+      break;
+
+    default:
+      break;
+  }
+} // End of soundLibrarySync()
+
+// ==============================================================================================================
+// Sound Play
+// Starts a library sound ( or any file on the SD card ) from flash if its copy is trusted, from the card if not
+// ============================================================================================================== //
+boolean soundPlay( const char *name, boolean looping ) {
+  uint32_t  started = micros();
+  int       i       = catalogFind( name );
+  boolean   flash   = i >= 0 && i < SOUND_MAX && sounds[i].inFlash;
+  uint32_t  offset  = i >= 0 ? catalog[i].dataOffset : 0;                                                         // past the WAV header
+  boolean   ok;
+
+  playRaw_sdHeartSound.stop();
+  playRaw_flashHeartSound.stop();
+  if ( flash )
+  {
+    playRaw_flashHeartSound.loop( looping );
+    ok = playRaw_flashHeartSound.play( sounds[i].flash, sounds[i].size, offset );
+  }
+  else
+  {
+    playRaw_sdHeartSound.loop( looping );
+    ok = playRaw_sdHeartSound.play( name, offset );
+  }
+  if ( !ok ) return false;
+
+  uint32_t    elapsed = micros() - started;
+  SoundStats  &st     = soundStats[ flash ? 1 : 0 ];
+  st.count ++;
+  st.last   = elapsed;
+  st.total += elapsed;
+  if ( elapsed > st.max ) st.max = elapsed;
+  Serial.print( ">    " );  Serial.print( name );
+  Serial.print( flash ? " from flash in " : " from SD card in " );
+  Serial.print( elapsed );  Serial.println( " us" );
+  return true;
+}
+
+boolean soundIsPlaying() {
+  return playRaw_sdHeartSound.isPlaying() || playRaw_flashHeartSound.isPlaying();
+}
+
+void soundStop() {
+  playRaw_sdHeartSound.stop();
+  playRaw_flashHeartSound.stop();
+}
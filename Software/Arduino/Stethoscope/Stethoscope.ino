@@ -11,11 +11,18 @@
 // ==============================================================================================================
 // Import libraries and/or modules
 // ============================================================================================================== //
+#include  "FixedString.h"
 #include  "TeensyAudio.h"
 #include  "Config.h"
 #include  "states.h"
 //#include  "protocol.h"
+#include  "RecordCodec.h"
 #include  "FileSD.h"
+#include  "Catalog.h"
+#include  "SoundLibrary.h"
+#include  "Boot.h"
+#include  "HeapMonitor.h"
+#include  "AudioGraph.h"
 #include  "parseBtByte.h"
 
 // ==============================================================================================================
@@ -25,15 +32,24 @@ void setup() {
   // Serial Communication Initialization
   Serial.begin( SPEED );                                                                                          // USB Serial Communication
   BTooth.begin( SPEED );                                                                                          // RF/Bluetooth Serial Communication
+  bootMark( BOOT_SETUP );
 
   // Setup Audio Board
   SetupAudioBoard();
+  graphUpdate();                                                                                                  // only the mic to the speaker, until a mode needs more
+  bootMark( BOOT_AUDIO );
 
-  // Configuration File
+  // Configuration File and the opcodes ( the blend bytes are added once the catalog is loaded )
   SessionInit();
+  commandInit();
 
-  // SD Reader and Card Check
-  sdCheck();
+  // Codec settings, SD card, sound catalog and flash sync: from loop() ( see Boot.h ), or now
+  if ( !FAST_BOOT )
+  {
+    while ( bootPending() ) bootStep();
+    catalogPrint();
+  }
+  bootMark( BOOT_READY );
 
 } // End of setup()
 
@@ -41,14 +57,34 @@ void setup() {
 // MAIN LOOP
 // ============================================================================================================== //
 void loop() {
-  // if we get a valid byte, read analog from BT:
-  if ( BTooth.available() > 0 ) parseBtByte( "RECORD.RAW" );
+  // Finish booting, a phase per pass
+  if ( bootPending() ) bootStep();
+
+  // Consume whatever has arrived over BT ( never blocks )
+  parseBtByte();
 
   // If playing or recording, carry on...
   if ( mode == 1 ) continueRecording();
   if ( mode == 2 ) continuePlaying();
   if ( mode == 3 ) continueHeartBeatMonitoring();
-  if ( mode == 5 ) continueBlending( fileName );
+  if ( mode == 5 ) continueBlending( fileName.c_str() );
+  if ( mode == 6 ) continueTransfer();
+
+  // Keep the playback read-ahead topped up ( the audio interrupt only copies from it )
+  playRaw_sdHeartSound.refill();
+
+  // Bring the flash copies of the catalog sounds up to date, a step at a time
+  soundLibrarySync();
+
+  // Heap use and fragmentation, for HEAPSTATS
+  heapMonitor();
+
+  // Levels, heart rate, gains and state to the tablet, when STARTTELEM asked for them, and the live audio
+  telemetryUpdate();
+  streamUpdate();
+
+  // Steer the analog mic gain while the mic is in use
+  if ( mode == 1 || mode == 3 || mode == 4 || mode == 5 ) adjustMicLevel();
   
   // Clear the input byte variable
   inByte = 0x00;                                // this line of code may be unnecessary
@@ -19,18 +19,27 @@
 // GUItool: begin automatically generated code
 AudioInputI2S            i2s_mic;        //xy=115,238
 AudioPlaySdRaw           playRaw_sdHeartSound; //xy=164,464
+AudioPlaySerialflashRaw  playRaw_flashHeartSound; //xy=172,512
 AudioMixer4              rms_mic_mixer;  //xy=455,186
 AudioMixer4              rms_playRaw_mixer; //xy=457,281
+AudioEffectAutoGain      micAgc;         //xy=560,186
+AudioEffectDecimate      decimate_heart; //xy=600,-4
+AudioEffectRmsMatch      playRawMatch;   //xy=590,281
+AudioEffectCrossfade     blendFader;     //xy=650,233
 AudioAnalyzePeak         mic_peaks;      //xy=631,64
 AudioAnalyzePeak         playRaw_peaks;  //xy=646,386
 AudioAnalyzeRMS          mic_rms;        //xy=660,122
 AudioAnalyzeRMS          playRaw_rms;    //xy=670,331
+AudioAnalyzeHeartBeat    heartBeat;      //xy=664,18
+AudioAnalyzeHeartRate    heartRate;      //xy=668,-26
 AudioMixer4              mixer_mic_Sd;   //xy=723,233
 AudioFilterStateVariable filter_LowPass_2; //xy=746,470
 AudioFilterStateVariable filter_LowPass_1; //xy=935,160
 AudioMixer4              mixer_allToSpk; //xy=1002,490
+AudioEffectDecimate      decimate_recMic; //xy=1060,220
 AudioRecordQueue         queue_recMic;   //xy=1187,220
 AudioRecordQueue         queue_recSpk;         //xy=1191,620
+AudioRecordQueue         queue_stream;   //xy=1187,160
 AudioOutputI2S           i2s_speaker;    //xy=1236,515
 AudioAnalyzePeak         peak_QrsMeter;  //xy=1243,433
 AudioConnection          patchCord1(i2s_mic, 0, filter_LowPass_2, 0);
@@ -38,40 +47,101 @@ AudioConnection          patchCord2(i2s_mic, 0, rms_mic_mixer, 0);
 AudioConnection          patchCord3(i2s_mic, 1, filter_LowPass_2, 1);
 AudioConnection          patchCord4(i2s_mic, 1, rms_mic_mixer, 1);
 AudioConnection          patchCord5(playRaw_sdHeartSound, 0, rms_playRaw_mixer, 0);
-AudioConnection          patchCord6(rms_mic_mixer, 0, mixer_mic_Sd, 0);
-AudioConnection          patchCord7(rms_mic_mixer, mic_peaks);
-AudioConnection          patchCord8(rms_mic_mixer, mic_rms);
-AudioConnection          patchCord9(rms_playRaw_mixer, 0, mixer_mic_Sd, 1);
+AudioConnection          patchCord6(micAgc, 0, blendFader, 0);
+AudioConnection          patchCord7(micAgc, mic_peaks);
+AudioConnection          patchCord8(micAgc, mic_rms);
+AudioConnection          patchCord9(playRawMatch, 0, mixer_mic_Sd, 1);
 AudioConnection          patchCord10(rms_playRaw_mixer, playRaw_rms);
 AudioConnection          patchCord11(rms_playRaw_mixer, playRaw_peaks);
 AudioConnection          patchCord12(mixer_mic_Sd, 0, filter_LowPass_1, 0);
 AudioConnection          patchCord13(filter_LowPass_2, 0, mixer_allToSpk, 1);
-AudioConnection          patchCord14(filter_LowPass_1, 0, queue_recMic, 0);
+AudioConnection          patchCord14(filter_LowPass_1, 0, decimate_recMic, 0);
 AudioConnection          patchCord15(filter_LowPass_1, 0, mixer_allToSpk, 0);
 AudioConnection          patchCord16(mixer_allToSpk, peak_QrsMeter);
 AudioConnection          patchCord17(mixer_allToSpk, 0, i2s_speaker, 0);
 AudioConnection          patchCord18(mixer_allToSpk, 0, i2s_speaker, 1);
 AudioConnection          patchCord19(mixer_allToSpk, queue_recSpk);
+AudioConnection          patchCord20(decimate_heart, heartBeat);
+AudioConnection          patchCord21(decimate_heart, heartRate);
+AudioConnection          patchCord22(rms_mic_mixer, micAgc);
+AudioConnection          patchCord23(rms_playRaw_mixer, 0, playRawMatch, 0);
+AudioConnection          patchCord24(micAgc, 0, playRawMatch, 1);
+AudioConnection          patchCord25(playRawMatch, 0, blendFader, 1);
+AudioConnection          patchCord26(blendFader, 0, mixer_mic_Sd, 0);
+AudioConnection          patchCord27(playRaw_flashHeartSound, 0, rms_playRaw_mixer, 1);
+AudioConnection          patchCord28(filter_LowPass_1, 0, queue_stream, 0);
+AudioConnection          patchCord29(micAgc, decimate_heart);
+AudioConnection          patchCord30(decimate_recMic, 0, queue_recMic, 0);
 AudioControlSGTL5000     sgtl5000_1;     //xy=124,136
 // GUItool: end automatically generated code
+AudioAnalyzeLoad         audioLoad;      // overruns and late passes of the audio interrupt ( no connections )
+
+// ==============================================================================================================
+// Audio Objects
+// Every AudioStream of the graph, in update order, for AUDIOSTATS
+// ============================================================================================================== //
+struct AudioObject {
+  AudioStream   *stream;
+  const char    *name;
+};
+
+const AudioObject audioObjects[] = {
+  { &i2s_mic,                  "i2s_mic"                  },
+  { &playRaw_sdHeartSound,     "playRaw_sdHeartSound"     },
+  { &playRaw_flashHeartSound,  "playRaw_flashHeartSound"  },
+  { &rms_mic_mixer,            "rms_mic_mixer"            },
+  { &rms_playRaw_mixer,        "rms_playRaw_mixer"        },
+  { &micAgc,                   "micAgc"                   },
+  { &decimate_heart,           "decimate_heart"           },
+  { &playRawMatch,             "playRawMatch"             },
+  { &blendFader,               "blendFader"               },
+  { &mic_peaks,                "mic_peaks"                },
+  { &playRaw_peaks,            "playRaw_peaks"            },
+  { &mic_rms,                  "mic_rms"                  },
+  { &playRaw_rms,              "playRaw_rms"              },
+  { &heartBeat,                "heartBeat"                },
+  { &heartRate,                "heartRate"                },
+  { &mixer_mic_Sd,             "mixer_mic_Sd"             },
+  { &filter_LowPass_2,         "filter_LowPass_2"         },
+  { &filter_LowPass_1,         "filter_LowPass_1"         },
+  { &mixer_allToSpk,           "mixer_allToSpk"           },
+  { &decimate_recMic,          "decimate_recMic"          },
+  { &queue_recMic,             "queue_recMic"             },
+  { &queue_recSpk,             "queue_recSpk"             },
+  { &queue_stream,             "queue_stream"             },
+  { &i2s_speaker,              "i2s_speaker"              },
+  { &peak_QrsMeter,            "peak_QrsMeter"            },
+};
+
+const int lenAudioObjects = sizeof( audioObjects )/sizeof( audioObjects[0] );
 
 
 // ==============================================================================================================
 // Variables
 // ============================================================================================================== //
+#define                   AUDIO_BLOCKS          60                              // audio block pool, 128 samples each
 elapsedMillis             fps;
-uint8_t                   cnt             =     0;
 const int                 selectedInput   =     AUDIO_INPUT_MIC;
-int                       microphoneGain  =     25;
+int                       microphoneGain  =     25;                           // [dB] starting point, steered by adjustMicLevel()
+float                     micAgcTarget    =     0.50;                           // AGC envelope target, fraction of full scale
+float                     micAgcAttack    =     10.0;                           // [ms]
+float                     micAgcRelease   =   3000.0;                           // [ms] longer than a beat, so the gain doesn't pump
+float                     micAgcMaxGain   =     24.0;                           // [dB] digital boost / cut limit
+float                     blendMatchWin   =   1000.0;                           // [ms] longer than a beat, so the blend level doesn't pump
+float                     blendMatchMax   =      4.0;                           // largest playback gain while blending
+float                     blendFadeTime   =   2000.0;                           // [ms] mic-to-blend fade in, and back out
+float                     blendFadeTo     =     0.90;                           // crossfade position while blending, 1.0 = playback only
 float                     micInputLvL     =     0.50;
 float                     sampleInputLvL  =     0.50;
 float                     speakerVolume   =     0.65;                           // 2-speaker: 0.50; 1-speaker: 0.60
+int                       heartDecimation =        4;                           // heartBeat / heartRate input, 11.0 kHz ( 1, 4, 8 or 10 )
 
 float                     mixerInputON    =     1.00;
 float                     mixerInputOFF   =     0.00;
 float                     mixerLvL        =     1.00;
 
-String                    fileName        = "";                                 // String with sound file name
+FileName                  fileName;                                             // sound being played or blended ( 8.3 )
+int16_t                   playAhead[ 32 * AUDIO_BLOCK_SAMPLES ];                // SD read-ahead for playback, 93 ms
 
 // ==============================================================================================================
 // Setup
@@ -92,7 +162,8 @@ void setupMicToSpeaker()
 void setupSDToSpeaker()
 {
   // rms play raw mixer ----------------------------------------------------------------------------------------- //
-  rms_playRaw_mixer.gain(   0, mixerInputON  );
+  rms_playRaw_mixer.gain(   0, mixerInputON  );                                                                       // SD card playback
+  rms_playRaw_mixer.gain(   1, mixerInputON  );                                                                       // flash playback ( SoundLibrary.h )
   // mixer mic SD  ---------------------------------------------------------------------------------------------- //
   mixer_mic_Sd.gain(    1, mixerInputOFF  );                                                                      // Set gain of mixer_mic_Sd, channel1 to 0.00 --SD file input
 }
@@ -102,13 +173,31 @@ void SetupAudioBoard()
 {
   // Audio connections require memory, and the record queue
   // uses this memory to buffer incoming audio.
-  AudioMemory( 60 );
+  AudioMemory( AUDIO_BLOCKS );
 
-  // Enable the audio shield, select input, and enable output
-  sgtl5000_1.enable();
-  sgtl5000_1.volume(      speakerVolume  );
-  sgtl5000_1.inputSelect( selectedInput  );
-  sgtl5000_1.micGain(     microphoneGain );
+  // Power up the audio shield; its analog outputs ramp up while the rest boots ( see SetupCodec() )
+  sgtl5000_1.powerUp();
+
+  // Automatic gain: fast digital stage in the graph, slow analog steering in adjustMicLevel()
+  micAgc.target(  micAgcTarget  );
+  micAgc.attack(  micAgcAttack  );
+  micAgc.release( micAgcRelease );
+  micAgc.maxGain( micAgcMaxGain );
+
+  // Blend level matching: playback RMS follows the mic, only switched on while blending
+  playRawMatch.window(  blendMatchWin    );
+  playRawMatch.maxGain( blendMatchMax    );
+  playRawMatch.enable(  false            );
+  blendFader.curve(     CROSSFADE_EQUAL_POWER );
+  blendFader.position(  0.0              );                                     // mic only
+
+  // Heart analysis runs on a decimated copy of the mic; recordings stay at the full rate until RECCODEC asks otherwise
+  decimate_heart.factor(  heartDecimation  );
+  heartBeat.decimation(   heartDecimation  );
+  heartRate.decimation(   heartDecimation  );
+
+  // Playback reads the SD card ahead from loop(), not in the audio interrupt
+  playRaw_sdHeartSound.readAhead( playAhead, sizeof( playAhead ) / sizeof( playAhead[0] ) );
 
   // Configure SPI for the audio shield pins
   SPI.setMOSI( 7 );                                                             // Audio shield has MOSI on pin 7
@@ -122,3 +211,11 @@ void SetupAudioBoard()
   
 } // End of SetupAudioBoard()
 
+// Select input and enable output, once the codec has finished powering up ( sgtl5000_1.isReady() )
+void SetupCodec()
+{
+  sgtl5000_1.volume(      speakerVolume  );
+  sgtl5000_1.inputSelect( selectedInput  );
+  sgtl5000_1.micGain(     microphoneGain );
+} // End of SetupCodec()
+
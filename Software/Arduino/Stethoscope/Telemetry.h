@@ -0,0 +1,230 @@
+/*
+ * Telemetry.h
+ *
+ * Fixed-rate binary telemetry over bluetooth, in place of the ASCII bar graphs: the levels, heart rate, gains and
+ * state are sampled every 1000 / rate ms into a record, and TELEM_BATCH records go out in one frame
+ *
+ * STARTTELEM "rate"                    ->  ACK ( rate in Hz, 1 to TELEM_RATE_MAX, TELEM_RATE when empty )  or  NAK
+ * then, every TELEM_BATCH records      ->  STX, seq (2), time (4), period (2), count (1), length (2), records, CRC32 (4)
+ * STOPTELEM                            ->  the partial batch, then ACK
+ *
+ * All numbers are little-endian; time is the millis() of the first record, period the ms between records. The
+ * CRC32 (IEEE) covers seq to the end of the records. A record is a 2 byte mask of the fields that changed, then
+ * for each of them, in field order, the change as a zigzag varint ( 1 byte for a change of -64 to 63 ). The first
+ * record of a frame is against zero, so every frame decodes on its own. A frame that is still going out when the
+ * next is ready is dropped, and the gap shows in seq; nothing is sent during a file transfer. Live audio packets
+ * ( LiveStream.h ) go out between frames, never inside one ( btFrameOwner ).
+ *
+ * Python/Stethoscope/telemetryViewer.py draws the records.
+ */
+
+// ==============================================================================================================
+// Variables
+// ============================================================================================================== //
+#define   TELEM_RATE          20                                                                                  // [Hz] records per second by default
+#define   TELEM_RATE_MAX      100
+#define   TELEM_BATCH         8                                                                                   // records per frame
+#define   TELEM_HEADER        12                                                                                  // STX to length
+#define   TELEM_RECORD_MAX    ( 2 + TELEM_FIELDS * 3 )                                                            // no field moves by 2^20 or more
+
+enum TelemetryField
+{
+  TELEM_MIC_PEAK,                                                                                                 // [1/255 full scale] since the last record
+  TELEM_MIC_RMS,                                                                                                  // [1/255 full scale]
+  TELEM_PLAY_PEAK,                                                                                                // [1/255 full scale]
+  TELEM_PLAY_RMS,                                                                                                 // [1/255 full scale]
+  TELEM_HR,                                                                                                       // [0.1 bpm] last beat reported
+  TELEM_HR_CONF,                                                                                                  // [%] confidence of the rhythm estimate
+  TELEM_MIC_GAIN,                                                                                                 // [dB] analog ( adjustMicLevel() )
+  TELEM_AGC_GAIN,                                                                                                 // [0.1 dB] digital ( micAgc )
+  TELEM_BLEND,                                                                                                    // [%] crossfade position, 100 = playback only
+  TELEM_STATE,                                                                                                    // deviceState
+  TELEM_MODE,                                                                                                     // mode
+  TELEM_FIELDS,
+};
+
+struct Telemetry {
+  boolean         on;
+  uint16_t        period;                                                                                         // [ms]
+  uint16_t        seq;                                                                                            // of the frame being filled
+  int32_t         last[ TELEM_FIELDS ];                                                                           // previous record of this frame
+  int             count;                                                                                          // records in the frame being filled
+  int             len;                                                                                            // bytes in it, header included
+  int             sendLen;                                                                                        // frame going out
+  int             sent;
+  uint32_t        records;                                                                                        // since STARTTELEM
+  uint32_t        frames;
+  uint32_t        dropped;                                                                                        // frames not sent
+};
+
+Telemetry     telem;
+elapsedMillis telemSinceRecord;
+byte          telemFrame[ TELEM_HEADER + TELEM_BATCH * TELEM_RECORD_MAX + 4 ];                                    // being filled
+byte          telemSend[ sizeof( telemFrame ) ];                                                                  // going out
+
+// ==============================================================================================================
+// Start Telemetry
+// ============================================================================================================== //
+void telemetryFrameBegin() {
+  telem.count = 0;
+  telem.len   = TELEM_HEADER;
+  memset( telem.last, 0, sizeof( telem.last ) );
+}
+
+boolean startTelemetry( const char *payload ) {
+  Serial.println( "EXECUTING startTelemetry()" );
+  int rate = *payload ? atoi( payload ) : TELEM_RATE;
+  if ( rate < 1 || rate > TELEM_RATE_MAX )
+  {
+    Serial.println( "Stethoscope CANNOT START TELEMETRY" );
+    Serial.println( "sending: NAK..." );
+    btReply( NAK );
+    return false;
+  }
+
+  telem.on       = true;
+  graphUse( GRAPH_LEVELS, true );                                                                                 // the peak and RMS meters ( AudioGraph.h )
+  telem.period   = 1000 / rate;
+  telem.seq      = 0;
+  telem.sendLen  = telem.sent = 0;
+  telem.records  = telem.frames = telem.dropped = 0;
+  telemetryFrameBegin();
+  telemSinceRecord = telem.period;                                                                                // first record on the next pass
+  Serial.print( "Telemetry every " );   Serial.print( telem.period );
+  Serial.println( " ms" );
+  Serial.println( "sending: ACK..." );
+  btReply( ACK );
+  return true;
+} // End of startTelemetry()
+
+
+// ==============================================================================================================
+// Telemetry Record
+// Samples the fields and appends them, delta encoded, to the frame being filled
+// ============================================================================================================== //
+int telemetryLevel( float x ) {                                                                                   // 0 to 1 -> 0 to 255
+  return x <= 0.0 ? 0 : x >= 1.0 ? 255 : (int)( x * 255.0 + 0.5 );
+}
+
+void telemetrySample( int32_t *v ) {
+  const int32_t *prev = telem.last;                                                                               // a meter with nothing new keeps its value
+
+  v[ TELEM_MIC_PEAK  ] = mic_peaks.available()     ? telemetryLevel( mic_peaks.read()     ) : prev[ TELEM_MIC_PEAK  ];
+  v[ TELEM_MIC_RMS   ] = mic_rms.available()       ? telemetryLevel( mic_rms.read()       ) : prev[ TELEM_MIC_RMS   ];
+  v[ TELEM_PLAY_PEAK ] = playRaw_peaks.available() ? telemetryLevel( playRaw_peaks.read() ) : prev[ TELEM_PLAY_PEAK ];
+  v[ TELEM_PLAY_RMS  ] = playRaw_rms.available()   ? telemetryLevel( playRaw_rms.read()   ) : prev[ TELEM_PLAY_RMS  ];
+  v[ TELEM_HR        ] = (int32_t)( hr * 10.0 + 0.5 );
+  v[ TELEM_HR_CONF   ] = (int32_t)( heartRate.confidence() * 100.0 + 0.5 );
+  v[ TELEM_MIC_GAIN  ] = microphoneGain;
+  v[ TELEM_AGC_GAIN  ] = (int32_t)lroundf( micAgc.gainDb() * 10.0 );
+  v[ TELEM_BLEND     ] = (int32_t)( blendFader.read() * 100.0 + 0.5 );
+  v[ TELEM_STATE     ] = deviceState;
+  v[ TELEM_MODE      ] = mode;
+}
+
+void telemetryRecord() {
+  int32_t   v[ TELEM_FIELDS ];
+  uint16_t  changed = 0;
+  byte      *p      = telemFrame + telem.len + 2;
+
+  telemetrySample( v );
+  if ( telem.count == 0 ) putLE( telemFrame + 3, millis(), 4 );                                                   // time of the first record
+  for ( int f = 0; f < TELEM_FIELDS; f ++ )
+  {
+    int32_t   d = v[f] - telem.last[f];
+    if ( d == 0 ) continue;
+    uint32_t  z = ( (uint32_t)d << 1 ) ^ (uint32_t)( d >> 31 );                                                   // zigzag: small changes either way stay small
+    changed |= 1 << f;
+    while ( z >= 0x80 ) { *p ++ = (byte)( z | 0x80 ); z >>= 7; }
+    *p ++ = (byte)z;
+    telem.last[f] = v[f];
+  }
+  putLE( telemFrame + telem.len, changed, 2 );
+  telem.len = p - telemFrame;
+  telem.count ++;
+  telem.records ++;
+} // End of telemetryRecord()
+
+// ==============================================================================================================
+// Telemetry Flush
+// Closes the frame being filled and hands it to telemetryUpdate(), unless the last one is still going out
+// ============================================================================================================== //
+void telemetryFlush() {
+  if ( telem.count == 0 ) return;
+  telemFrame[0] = STX;
+  putLE( telemFrame + 1,  telem.seq,                2 );
+  putLE( telemFrame + 7,  telem.period,             2 );
+  putLE( telemFrame + 9,  telem.count,              1 );
+  putLE( telemFrame + 10, telem.len - TELEM_HEADER, 2 );
+  putLE( telemFrame + telem.len, crc32( telemFrame + 1, telem.len - 1 ), 4 );
+  telem.seq ++;
+
+  if ( telem.sent < telem.sendLen || mode == 6 ) telem.dropped ++;                                                // the UART has not kept up, or a transfer owns it
+  else
+  {
+    memcpy( telemSend, telemFrame, telem.len + 4 );
+    telem.sendLen = telem.len + 4;
+    telem.sent    = 0;
+    telem.frames ++;
+  }
+  telemetryFrameBegin();
+} // End of telemetryFlush()
+
+// ==============================================================================================================
+// Telemetry Update
+// Called from loop(); never blocks: a record when one is due, and what the UART transmit buffer can take
+// ============================================================================================================== //
+void telemetryUpdate() {
+  if ( !telem.on ) return;
+
+  if ( telemSinceRecord >= telem.period )
+  {
+    telemSinceRecord -= telem.period;
+    if ( telemSinceRecord > telem.period ) telemSinceRecord = 0;                                                  // a long stall is not caught up
+    telemetryRecord();
+    if ( telem.count == TELEM_BATCH ) telemetryFlush();
+  }
+
+  int room = BTooth.availableForWrite();
+  int left = telem.sendLen - telem.sent;
+  if ( room > left ) room = left;
+  if ( room > 0 && mode != 6 && ( btFrameOwner == 0x00 || btFrameOwner == STX ) )
+  {
+    BTooth.write( telemSend + telem.sent, room );
+    telem.sent  += room;
+    btFrameOwner = telem.sent < telem.sendLen ? STX : 0x00;
+  }
+} // End of telemetryUpdate()
+
+// ==============================================================================================================
+// Stop Telemetry
+// Finishes the frame going out, then sends the partial batch
+// ============================================================================================================== //
+void telemetryFrameFinish() {                                                                                     // the rest of the frame going out ( btFrameFinish() )
+  BTooth.write( telemSend + telem.sent, telem.sendLen - telem.sent );
+  telem.sendLen = telem.sent = 0;
+  if ( btFrameOwner == STX ) btFrameOwner = 0x00;
+}
+
+void stopTelemetry() {
+  Serial.println( "EXECUTING stopTelemetry()" );
+  if ( telem.on )
+  {
+    btFrameFinish();                                                                                              // a stream packet part-way out, or this frame
+    if ( mode != 6 )                                                                                              // a transfer owns the UART
+    {
+      telemetryFrameFinish();                                                                                     // the frame waiting to go out, whole
+      telemetryFlush();                                                                                           // then the partial batch
+      telemetryFrameFinish();
+    }
+    telem.sendLen = telem.sent = 0;
+    telem.on      = false;
+    graphUse( GRAPH_LEVELS, false );
+  }
+  Serial.print( "Telemetry: " );        Serial.print( telem.records );
+  Serial.print( " records, " );         Serial.print( telem.frames );
+  Serial.print( " frames, " );          Serial.print( telem.dropped );
+  Serial.println( " dropped" );
+  Serial.println( "sending: ACK..." );
+  btReply( ACK );
+} // End of stopTelemetry()
@@ -16,6 +16,32 @@
 #include  "DiagnosticFunctions.h"
 #include  "DeviceSpecificFunctions.h"
 #include  "SimulationFunctions.h"
+#include  "FileTransfer.h"
+#include  "Telemetry.h"
+#include  "LiveStream.h"
+
+// ==============================================================================================================
+// Bluetooth Replies
+// Every reply to a command goes out through btReply(), whole, and never inside a telemetry frame, a stream packet
+// or a transfer chunk: the one part-way out ( btFrameOwner ) is finished first
+// ============================================================================================================== //
+void btFrameFinish() {
+  switch( btFrameOwner )
+  {
+    case STX: telemetryFrameFinish(); break;
+    case SYN: streamPacketFinish();   break;
+    case SOH: transferChunkFinish();  break;
+  }
+}
+
+void btReply( const byte *data, int len ) {
+  btFrameFinish();
+  BTooth.write( data, len );
+}
+
+void btReply( byte b ) {
+  btReply( &b, 1 );
+}
 
 // ==============================================================================================================
 // Variables
@@ -23,6 +49,27 @@
 byte      inByte          = 0x00;
 int       blendByteIndex;
 
+#define   CMD_PAYLOAD_MAX     64                                                                                  // longest payload kept ( filename/mode string ), extra bytes are dropped
+#define   CMD_PAYLOAD_GAP     50                                                                                  // [ms] line silence that ends a payload frame
+#define   CMD_BYTES_PER_PASS  32                                                                                  // most bytes consumed per loop() pass
+
+typedef void ( *CommandHandler )( byte opcode );
+
+struct Command {
+  byte            opcode;
+  boolean         payload;                                                                                        // opcode is followed by a string payload
+  boolean         card;                                                                                           // handler needs the SD card mounted ( see bootWait() )
+  CommandHandler  handler;
+};
+
+char          cmdPayload[ CMD_PAYLOAD_MAX + 1 ];                                                                  // payload of the frame being assembled
+int           cmdPayloadLen   = 0;
+byte          cmdOpcode       = 0x00;                                                                             // opcode of the frame being assembled
+boolean       cmdInPayload    = false;
+elapsedMillis cmdSinceByte;                                                                                       // time since the last payload byte
+byte          cmdLookup[ 256 ];                                                                                   // opcode -> commandTable index + 1 ( 0 = no command )
+byte          blendLookup[ 256 ];                                                                                 // blend byte -> catalog index
+
 
 // ==============================================================================================================
 // Display Byte
@@ -57,136 +104,277 @@ void displayStatus() {
 
 
 // ==============================================================================================================
-// Blend Byte
+// Command Handlers
+//
+// One handler per opcode, called by parseBtByte() once the frame is complete
+// ============================================================================================================== //
+
+void cmdNone( byte opcode ) {
+}
+
+void cmdEnquiry( byte opcode ) {
+  statusEnquiry();
+}
+
+void cmdDeviceID( byte opcode ) {
+  deviceID( STE );
+}
+
+void cmdSdCheck( byte opcode ) {
+  sdCheck();
+  catalogBegin();                                                                                                 // a new card, or new sounds on it
+  catalogPrint();
+  commandInit();
+  soundLibraryBegin();
+}
+
+void cmdRecStats( byte opcode ) {
+  recordQueueStats();
+}
+
+void cmdSndStats( byte opcode ) {
+  soundLibraryStats();
+}
+
+void cmdBootStats( byte opcode ) {
+  bootStats();
+}
+
+void cmdHeapStats( byte opcode ) {
+  heapStatistics();
+}
+
+void cmdAudioStats( byte opcode ) {
+  audioStatistics();
+}
+
+void cmdParseString( byte opcode ) {
+  parseString( cmdPayload );
+}
+
+void cmdSetIdle( byte opcode ) {
+  setToIdle();
+}
+
+void cmdRecMode( byte opcode ) {
+  recMode = setRecordingMode( cmdPayload );
+}
+
+void cmdRecCodec( byte opcode ) {
+  setRecordingCodec( cmdPayload );
+}
+
+void cmdStartCustomRec( byte opcode ) {
+  if ( setRecordingFilename( inString, recExtension, recMode ) )                                                  // Create recording string with appropriate extension
+    startRecording( recString.c_str() );                                                                          // Start custom filename recording
+  else
+  {
+    Serial.println( "sending: NAK..." );                                                                          // name does not fit 8.3
+    btReply( NAK );
+  }
+}
+
+void cmdStartMultiRec( byte opcode ) {
+  Serial.println( "received: STARTMREC..." );
+  Serial.println( "recording Mode (recMode): 1..." );
+  recMode = 1;                                                                                                    // Default recording mode (recMode) for the multi-recording is recMode = 1
+  if ( !parseString( cmdPayload ) ) return;                                                                       // Parse input string ( NAK sent )
+  if ( setRecordingFilename( inString, recExtension, recMode ) )                                                  // Create recording string with appropriate extension
+    startMultiChannelRecording( recStrings );                                                                     // Start custom filename recording
+  else
+  {
+    Serial.println( "sending: NAK..." );
+    btReply( NAK );
+  }
+}
+
+void cmdStopRec( byte opcode ) {
+  Serial.println( "received: STOPREC..." );
+  stopRecording();
+}
+
+void cmdStopPlay( byte opcode ) {
+  stopPlaying();
+}
+
+void cmdStartHBMonitor( byte opcode ) {
+  startHeartBeatMonitoring();
+}
+
+void cmdStopHBMonitor( byte opcode ) {
+  stopHeartBeatMonitoring();
+}
+
+void cmdStopBlend( byte opcode ) {
+  stopBlending();
+}
+
+void cmdGetFile( byte opcode ) {
+  startTransfer( cmdPayload );
+}
+
+void cmdFileAck( byte opcode ) {
+  transferAck( cmdPayload );
+}
+
+void cmdFileNak( byte opcode ) {
+  transferNak( cmdPayload );
+}
+
+void cmdStartTelem( byte opcode ) {
+  startTelemetry( cmdPayload );
+}
+
+void cmdStopTelem( byte opcode ) {
+  stopTelemetry();
+}
+
+void cmdStartStream( byte opcode ) {
+  startStream( cmdPayload );
+}
+
+void cmdStopStream( byte opcode ) {
+  stopStream();
+}
+
+void cmdBlendSound( byte opcode ) {
+  audioBlend( cmdPayloadLen > 0 ? atoi( cmdPayload ) : -1 );
+}
+
+void cmdBlend( byte opcode ) {
+  blendByteIndex = blendLookup[ opcode ];
+  audioBlend( blendByteIndex );
+}
+
+// ==============================================================================================================
+// Command Table
+//
+// Opcodes understood over bluetooth and the handler each one dispatches to
+// STARTREC and STARTPLAY are accepted but do nothing for now
+// ============================================================================================================== //
+
+const Command commandTable[] = {
+  { ENQ,            false,  false,  cmdEnquiry          },
+  { ACK,            false,  false,  cmdNone             },
+  { NAK,            false,  false,  cmdNone             },
+  // Diagnostic Functions ===================================================================================== //
+  { DEVICEID,       false,  false,  cmdDeviceID         },
+  { SDCHECK,        false,  true,   cmdSdCheck          },
+  { RECSTATS,       false,  false,  cmdRecStats         },
+  { SNDSTATS,       false,  false,  cmdSndStats         },
+  { BOOTSTATS,      false,  false,  cmdBootStats        },
+  { HEAPSTATS,      false,  false,  cmdHeapStats        },
+  { AUDIOSTATS,     false,  false,  cmdAudioStats       },
+  // Device-Specific Functions ================================================================================ //
+  { PSTRING,        true,   false,  cmdParseString      },
+  { SETIDLE,        false,  false,  cmdSetIdle          },
+  { RECMODE,        true,   false,  cmdRecMode          },
+  { RECCODEC,       true,   false,  cmdRecCodec         },
+  { STARTREC,       false,  false,  cmdNone             },
+  { STARTCREC,      false,  true,   cmdStartCustomRec   },
+  { STARTMREC,      true,   true,   cmdStartMultiRec    },
+  { STOPREC,        false,  false,  cmdStopRec          },
+  { STARTPLAY,      false,  false,  cmdNone             },
+  { STOPPLAY,       false,  false,  cmdStopPlay         },
+  { STARTHBMONITOR, false,  false,  cmdStartHBMonitor   },
+  { STOPHBMONITOR,  false,  false,  cmdStopHBMonitor    },
+  { STARTBLEND,     false,  false,  cmdStopBlend        },
+  { STOPBLEND,      false,  false,  cmdStopBlend        },
+  { GETFILE,        true,   true,   cmdGetFile          },
+  { FILEACK,        true,   true,   cmdFileAck          },
+  { FILENAK,        true,   true,   cmdFileNak          },
+  { BLENDSOUND,     true,   true,   cmdBlendSound       },
+  { STARTTELEM,     true,   false,  cmdStartTelem       },
+  { STOPTELEM,      false,  false,  cmdStopTelem        },
+  { STARTSTREAM,    true,   false,  cmdStartStream      },
+  { STOPSTREAM,     false,  false,  cmdStopStream       },
+  // Blend/playback bytes ( filled in from the catalog by commandInit() ) ===================================== //
+  { 0x00,           false,  true,   cmdBlend            },
+};
+
+const int lenCommandTable = sizeof( commandTable )/sizeof( commandTable[0] );
+
+// ==============================================================================================================
+// Command Initialization
 //
-// This function cross references the input byte with the list of sounds files available for playback
+// Builds the opcode lookup used by parseBtByte(); blend bytes that collide with an opcode are left to the opcode
+// Must run after catalogBegin()
 //
 // Fluvio L Lobo Fenoglietto 07/30/2018
 // ============================================================================================================== //
 
-void blendByteCheck( byte inByte ) {
+void commandInit() {
+  memset( cmdLookup,   0, sizeof( cmdLookup   ) );
+  memset( blendLookup, 0, sizeof( blendLookup ) );
 
-  //Serial.println( ">  Cross-referencing playback/blending bytes" );
-  for( int i = 0; i < ses.lenBlendByteList; i ++ ) {
-    if( ses.blendByteList[i] == inByte ) {
-      blendByteIndex = i;
-      audioBlend( blendByteIndex );
+  for( int i = 0; i < lenCommandTable - 1; i ++ ) {
+    cmdLookup[ commandTable[i].opcode ] = i + 1;
+  }
+  for( int i = 0; i < catalogCount && catalogBlendByte( i ) >= 0; i ++ ) {
+    byte blendByte = catalogBlendByte( i );
+    if( cmdLookup[ blendByte ] == 0 ) {
+      cmdLookup[ blendByte ]   = lenCommandTable;                                                                 // last entry, cmdBlend()
+      blendLookup[ blendByte ] = i;
     }
-  } // Search within playlist
-  
-} // End of blendByte()
+  }
+} // End of commandInit()
+
+// ==============================================================================================================
+// Dispatch Command
+// ============================================================================================================== //
+
+void dispatchCommand( byte opcode ) {
+  const Command &cmd = commandTable[ cmdLookup[ opcode ] - 1 ];
+
+  cmdInPayload = false;
+  cmdPayload[ cmdPayloadLen ] = 0;
+  if ( cmd.card ) bootWait();                                                                                     // still mounting the card
+  cmd.handler( opcode );
+  cmdPayloadLen = 0;
+} // End of dispatchCommand()
 
 // ==============================================================================================================
 // Parse Byte
 //
 // This function parses incoming bytes (or byte sequences) and calls/executes functions associated with such bytes
+// It never waits on the serial port: each call consumes what has already arrived and returns. Opcodes that carry
+// a string (PSTRING, RECMODE, STARTMREC) collect it until a CR/LF/NUL, or until the line has been silent for
+// CMD_PAYLOAD_GAP ms. At most one command is dispatched per call.
 //
 // Michael Xynidis
 // Fluvio L Lobo Fenoglietto 05/02/2018
 // ============================================================================================================== //
-void parseBtByte( String fn ) {
-    char  filename[fn.length()+1];
-    fn.toCharArray( filename, sizeof( filename ) );
+void parseBtByte() {
+  int budget = CMD_BYTES_PER_PASS;
 
-    inByte = BTooth.read();                                                                                       // read incoming byte
+  while ( BTooth.available() > 0 && budget-- > 0 ) {
+    byte b = BTooth.read();                                                                                       // read incoming byte
+
+    if ( cmdInPayload ) {
+      if ( b == '\r' || b == '\n' || b == 0x00 ) {                                                                // terminator ends the payload
+        dispatchCommand( cmdOpcode );
+        return;
+      }
+      if ( cmdPayloadLen < CMD_PAYLOAD_MAX ) cmdPayload[ cmdPayloadLen ++ ] = b;
+      cmdSinceByte = 0;
+      continue;
+    }
+
+    inByte = b;
     displayByte( inByte );
-    //displayStatus();
-
-    // Cross-reference function-specific bytes ================================================================= //
-    Serial.println( ">  Cross-referencing function-specific bytes" );
-    switch ( inByte ) {
-      case ENQ :
-        statusEnquiry();
-      break;
-      case ACK :
-      case NAK :
-      break;
-      
-	    // Diagnostic Functions =======================================================================  //
-      case DEVICEID :
-        // DC1_DEVICEID : Device Identification
-		    deviceID( STE );
-      break;
-      case SDCHECK :
-        // DC1_SDCHECK
-		    sdCheck();
-	    break;
-
-      // Operational Functions ====================================================================== //
-      
-      // Device-Specific Functions ================================================================== //
-      case PSTRING :
-        // PSTRING : Parse String
-        inString = parseString();
-      break;
-      // Recording ---------------------------------------------------------------------------------- //
-      case SETIDLE :
-        // SETIDLE : Set to Idle
-        setToIdle();
-      break;
-      case RECMODE :
-        // RECMODE : Set Recording Mode
-        recMode = setRecordingMode();
-      break;
-	    case STARTREC :
-        // STARTREC : Start Recording
-        //Serial.println( "received: STARTREC..." );
-        //startRecording();
-      break;
-      case STARTCREC :
-        // STARTCREC : Start Custom Recording
-        setRecordingFilename( inString, recExtension, recMode );                                       // Create recording string with appropriate extension
-        startRecording( recString );                                                                   // Start custom filename recording
-      break;
-      case STARTMREC :
-        // STARTMREC : Start Multi Channel, Custom Recording
-        Serial.println( "received: STARTMREC..." );
-        Serial.println( "recording Mode (recMode): 1..." );
-        recMode = 1;                                                                                   // Default recording mode (recMode) for the multi-recording is recMode = 1
-        inString = parseString();                                                                      // Parse input string
-        setRecordingFilename( inString, recExtension, recMode );                                       // Create recording string with appropriate extension
-        startMultiChannelRecording( recStrings );                                                      // Start custom filename recording
-      break;
-	    case STOPREC :
-  	    // STOPREC : Stop Recording
-        Serial.println( "received: STOPREC..." );
-  	    stopRecording();
-  	  break;
-  	  case STARTPLAY :
-  	    // STARTPLAY : Start Playing
-  	    //startPlaying( ses.filePly1 );
-  	  break;
-  	  case STOPPLAY :
-  	    // STOPPLAY : Stop Playing
-  	    stopPlaying();
-  	  break;
-  	  //case STARTPASSTHRU :
-  	    // STARTPASSTHRU : Start Audio Passthrough from Mic
-  	    //startAudioPassThrough();
-  	  //break;
-  	  case STARTHBMONITOR :
-  	    // STARTTRACKING : Start Heart Rate monitoring
-  	    startHeartBeatMonitoring();
-  	  break;
-  	  case STOPHBMONITOR :
-  	    // STOPTRACKING : Stop Heart Rate monitoring
-  	    stopHeartBeatMonitoring();
-  	  break;
-      case STARTBLEND :
-        // STARTBLEND : Start Blending default audio file
-      case STOPBLEND :
-        // STOPBLEND : Stop Blending default audio file
-        stopBlending();
-      break;
-      default :
-        //Serial.print( (char)inByte );
-      break;
+    if ( cmdLookup[ inByte ] == 0 && bootNext <= BOOT_CATALOG ) bootWait();                                      // may be a blend byte of the catalog
+    if ( cmdLookup[ inByte ] == 0 ) continue;                                                                     // not a command
+
+    if ( commandTable[ cmdLookup[ inByte ] - 1 ].payload ) {
+      cmdOpcode     = inByte;
+      cmdPayloadLen = 0;
+      cmdInPayload  = true;
+      cmdSinceByte  = 0;
+      continue;
     }
+    dispatchCommand( inByte );
+    return;
+  }
 
-    // Cross-reference blend/playback bytes ==================================================================== //
-    blendByteCheck( inByte );
-    
-    //displayStatus();
-    delay( 10 );
+  if ( cmdInPayload && cmdSinceByte >= CMD_PAYLOAD_GAP ) dispatchCommand( cmdOpcode );                            // line went quiet, payload complete
 }
-
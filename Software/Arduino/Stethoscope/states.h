@@ -29,6 +29,7 @@ enum State
   MONITORING,                                                                                                     // MONITORING heart beat ( may be paired with recording )
   BLENDING,                                                                                                       // BLENDING microphone input with audio file from SD card
   CONTINUING,
+  TRANSFERRING,                                                                                                   // TRANSFERRING a file from the SD card over bluetooth
 };
 
 State     deviceState     = READY;                                                                                // Single state variable...
@@ -44,9 +45,9 @@ State     blendState      = READY;
 // Fluvio L Lobo Fenoglietto 05/07/2018
 // ============================================================================================================== //
 
-String stateToText( int state )
+const char * stateToText( int state )
 {
-  String value = "";
+  const char * value = "";
   switch ( state )
   {
     case READY :
@@ -67,6 +68,9 @@ String stateToText( int state )
     case BLENDING :
       value = "BLENDING";
       break;
+    case TRANSFERRING :
+      value = "TRANSFERRING";
+      break;
     default:
       value = "unknown state";
       break;
@@ -94,6 +98,7 @@ String stateToText( int state )
  *          = 3   Continue Tracking Mic Stream
  *          = 4   Continue Audio Pass-through
  *          = 5   Continue Blending
+ *          = 6   Continue File Transfer
  *
  */
 int			mode	= 0;
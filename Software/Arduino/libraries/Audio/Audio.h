@@ -64,7 +64,10 @@
 #include "analyze_tonedetect.h"
 #include "analyze_notefreq.h"
 #include "analyze_peak.h"
+#include "analyze_heartbeat.h"
+#include "analyze_heartrate.h"
 #include "analyze_rms.h"
+#include "analyze_load.h"
 #include "control_sgtl5000.h"
 #include "control_wm8731.h"
 #include "control_ak4558.h"
@@ -81,6 +84,10 @@
 #include "effect_midside.h"
 #include "effect_reverb.h"
 #include "effect_waveshaper.h"
+#include "effect_autogain.h"
+#include "effect_crossfade.h"
+#include "effect_decimate.h"
+#include "effect_rmsmatch.h"
 #include "filter_biquad.h"
 #include "filter_fir.h"
 #include "filter_variable.h"
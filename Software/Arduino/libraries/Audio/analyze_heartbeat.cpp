@@ -0,0 +1,208 @@
+/* Audio Library for Teensy 3.X
+ * Copyright (c) 2014, Paul Stoffregen, paul@pjrc.com
+ *
+ * Development of this audio library was funded by PJRC.COM, LLC by sales of
+ * Teensy and Audio Adaptor boards.  Please support PJRC's efforts to develop
+ * open source software by purchasing Teensy or other PJRC products.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice, development funding notice, and this permission
+ * notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "analyze_heartbeat.h"
+
+// Shannon energy -x^2 ln(x^2) of a normalised magnitude x = (i + 0.5) / 256,
+// scaled so that its maximum (at x = 1 / sqrt(e)) is 65535
+static const uint16_t shannon_energy[256] = {
+	    8,    63,   157,   286,   445,   632,   844,  1080,  1337,  1616,  1914,  2231,
+	 2565,  2915,  3282,  3663,  4058,  4467,  4889,  5323,  5768,  6225,  6692,  7170,
+	 7657,  8154,  8659,  9172,  9694, 10223, 10759, 11302, 11852, 12407, 12969, 13536,
+	14108, 14685, 15266, 15852, 16442, 17036, 17633, 18233, 18836, 19442, 20051, 20662,
+	21274, 21889, 22505, 23122, 23741, 24360, 24980, 25601, 26222, 26843, 27464, 28085,
+	28705, 29324, 29943, 30561, 31178, 31793, 32407, 33020, 33630, 34239, 34845, 35449,
+	36051, 36650, 37246, 37839, 38430, 39017, 39601, 40181, 40758, 41331, 41900, 42466,
+	43027, 43584, 44136, 44684, 45227, 45766, 46300, 46828, 47352, 47870, 48383, 48890,
+	49392, 49889, 50379, 50863, 51342, 51814, 52280, 52740, 53193, 53640, 54080, 54513,
+	54939, 55358, 55771, 56176, 56574, 56964, 57347, 57722, 58090, 58450, 58802, 59147,
+	59483, 59811, 60131, 60442, 60746, 61040, 61326, 61604, 61873, 62133, 62384, 62626,
+	62859, 63083, 63298, 63503, 63699, 63885, 64062, 64230, 64387, 64535, 64673, 64801,
+	64919, 65027, 65125, 65212, 65289, 65356, 65412, 65458, 65493, 65518, 65532, 65535,
+	65527, 65508, 65478, 65437, 65385, 65321, 65247, 65161, 65063, 64954, 64833, 64701,
+	64557, 64402, 64234, 64055, 63863, 63660, 63444, 63217, 62977, 62725, 62461, 62184,
+	61895, 61593, 61279, 60952, 60612, 60260, 59894, 59516, 59125, 58722, 58305, 57874,
+	57431, 56975, 56505, 56022, 55526, 55016, 54492, 53956, 53405, 52841, 52263, 51671,
+	51066, 50447, 49814, 49166, 48505, 47830, 47141, 46437, 45719, 44987, 44241, 43480,
+	42705, 41915, 41110, 40292, 39458, 38610, 37747, 36869, 35977, 35069, 34147, 33210,
+	32257, 31290, 30307, 29309, 28296, 27268, 26225, 25166, 24092, 23002, 21897, 20776,
+	19640, 18488, 17320, 16137, 14937, 13722, 12492, 11245,  9982,  8704,  7409,  6098,
+	 4771,  3428,  2069,   694,
+};
+
+// keeps the compiler from moving the copy of 'published' across seq updates
+#define COMPILER_BARRIER() __asm__ volatile("" ::: "memory")
+
+#define SEGMENT          32      // samples per envelope point, at the full rate
+#define PEAK_SHIFT       10      // peak decay per block, at the full rate
+#define PEAK_FLOOR       64      // don't normalise silence up to full scale
+#define REFRACTORY       0.060   // seconds
+#define S2_MIN           0.100
+#define S2_MAX           0.450
+#define INTERVAL_MIN     (60.0 / 220)
+#define INTERVAL_MAX     (60.0 / 30)
+
+// Envelope points and the peak decay follow the power of two nearest below
+// the ratio: at 10 the points come 20% further apart than at the full rate,
+// which only lengthens the envelope's time constants a little
+void AudioAnalyzeHeartBeat::decimation(int n)
+{
+	if (n < 1) n = 1;
+	int log2n = 0;
+	while ((2 << log2n) <= n) log2n++;
+	__disable_irq();
+	ratio = n;
+	rate = AUDIO_SAMPLE_RATE_EXACT / n;
+	segment = SEGMENT >> log2n;
+	peak_shift = PEAK_SHIFT - log2n;
+	refractory = REFRACTORY * rate;
+	s2_min = S2_MIN * rate;
+	s2_max = S2_MAX * rate;
+	interval_min = INTERVAL_MIN * rate;
+	interval_max = INTERVAL_MAX * rate;
+	__enable_irq();
+	reset();
+}
+
+void AudioAnalyzeHeartBeat::reset(void)
+{
+	__disable_irq();
+	sample_count = 0;
+	peak = PEAK_FLOOR;
+	smooth = mean = env_peak = 0;
+	armed = true;
+	have_s1 = have_s2 = false;
+	last_onset = last_s1 = last_s2 = last_interval = 0;
+	seq = 0;
+	beat_count = read_count = 0;
+	memset(&published, 0, sizeof(published));
+	memset(&latest, 0, sizeof(latest));
+	__enable_irq();
+}
+
+float AudioAnalyzeHeartBeat::read(void)
+{
+	uint32_t s;
+	Beat copy;
+	do {
+		s = seq;
+		COMPILER_BARRIER();
+		copy = published;
+		COMPILER_BARRIER();
+	} while ((s & 1) || s != seq);      // update() ran meanwhile: take it again
+	latest = copy;
+	read_count = copy.count;
+	if (!copy.interval) return 0.0f;
+	return 60.0f * rate / copy.interval;
+}
+
+void AudioAnalyzeHeartBeat::onset(uint32_t when)
+{
+	uint32_t since = when - last_s1;
+	if (have_s1) {
+		uint32_t s2_last = s2_max;
+		if (last_interval && last_interval * 3 / 5 < s2_last) s2_last = last_interval * 3 / 5;
+		if (since < s2_min) return;                     // still inside S1
+		if (!have_s2 && since <= s2_last) {
+			have_s2 = true;
+			last_s2 = when;
+			return;
+		}
+		if (since < interval_min) return;               // S3, S4 or a click
+		if (since <= interval_max) {
+			seq = seq + 1;
+			COMPILER_BARRIER();
+			published.s1 = last_s1;
+			published.s2 = have_s2 ? last_s2 : 0;
+			published.interval = since;
+			published.count = beat_count + 1;
+			COMPILER_BARRIER();
+			seq = seq + 1;
+			beat_count = beat_count + 1;
+			last_interval = since;
+		} else {
+			last_interval = 0;                      // lost track, start over
+		}
+	}
+	have_s1 = true;
+	have_s2 = false;
+	last_s1 = when;
+}
+
+void AudioAnalyzeHeartBeat::envelopePoint(uint32_t energy, uint32_t when)
+{
+	smooth += (int32_t)((energy << 8) - smooth) >> 4;               // ~12 ms
+	mean += (smooth - mean) >> 11;                                   // ~1.5 s
+	if (smooth > env_peak) env_peak = smooth;
+	else env_peak -= (env_peak - mean) >> 11;
+
+	int32_t span = (env_peak - mean) >> 8;
+	if (armed) {
+		if (smooth > mean + span * thresh_hi && when - last_onset > refractory) {
+			armed = false;
+			last_onset = when;
+			onset(when);
+		}
+	} else if (smooth < mean + span * thresh_lo) {
+		armed = true;
+	}
+}
+
+void AudioAnalyzeHeartBeat::update(void)
+{
+	audio_block_t *block;
+	const int16_t *p;
+	int32_t max = 0;
+
+	block = receiveReadOnly();
+	if (!block) {
+		if (ratio == 1) sample_count += AUDIO_BLOCK_SAMPLES;    // a decimated block is just not due yet
+		return;
+	}
+
+	// normalise to the recent peak, which decays over a few seconds
+	p = block->data;
+	for (int i = 0; i < AUDIO_BLOCK_SAMPLES; i++) {
+		int32_t d = abs(p[i]);
+		if (d > max) max = d;
+	}
+	peak -= peak >> peak_shift;
+	if (max > peak) peak = max;
+	if (peak < PEAK_FLOOR) peak = PEAK_FLOOR;
+	uint32_t scale = (256u << 16) / (uint32_t)peak;
+
+	for (int seg = 0; seg < AUDIO_BLOCK_SAMPLES; seg += segment) {
+		uint32_t sum = 0;
+		for (int i = seg; i < seg + segment; i++) {
+			uint32_t index = ((uint32_t)abs(p[i]) * scale) >> 16;
+			if (index > 255) index = 255;
+			sum += shannon_energy[index];
+		}
+		envelopePoint(sum / segment, sample_count + seg);
+	}
+	sample_count += AUDIO_BLOCK_SAMPLES;
+	release(block);
+}
@@ -0,0 +1,106 @@
+/* Audio Library for Teensy 3.X
+ * Copyright (c) 2014, Paul Stoffregen, paul@pjrc.com
+ *
+ * Development of this audio library was funded by PJRC.COM, LLC by sales of
+ * Teensy and Audio Adaptor boards.  Please support PJRC's efforts to develop
+ * open source software by purchasing Teensy or other PJRC products.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice, development funding notice, and this permission
+ * notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef analyze_heartbeat_h_
+#define analyze_heartbeat_h_
+
+#include "Arduino.h"
+#include "AudioStream.h"
+
+// Heart sound onset detector.  Every update() turns the block into a Shannon
+// energy envelope (4 points per block, after normalising to the recent peak),
+// compares it with an adaptive threshold and labels the onsets S1 or S2.  Each
+// S1 that follows another S1 by a plausible interval (30 to 220 BPM) publishes
+// a beat.  Beats are handed to loop() through a sequence counter, so read()
+// never disables interrupts and update() never waits for the reader.  Behind
+// an AudioEffectDecimate, decimation() keeps the envelope points and time
+// limits where they were; the work per input sample drops by the ratio.
+
+class AudioAnalyzeHeartBeat : public AudioStream
+{
+public:
+	AudioAnalyzeHeartBeat(void) : AudioStream(1, inputQueueArray) {
+		sensitivity(0.4);
+		decimation(1);
+	}
+	// true when a beat was detected since the last read()
+	bool available(void) {
+		return beat_count != read_count;
+	}
+	// BPM of the latest beat; also latches the interval, systole and onset
+	// accessors below to that same beat
+	float read(void);
+	float intervalMs(void) { return latest.interval * 1000.0f / rate; }
+	float systoleMs(void) { return latest.s2 ? (latest.s2 - latest.s1) * 1000.0f / rate : 0.0f; }
+	uint32_t onsetSample(void) { return latest.s1; }      // S1 onset, in input samples since begin
+	uint32_t beats(void) { return latest.count; }
+	// smoothed envelope, 0 to 1
+	float envelope(void) { return smooth / (65535.0f * 256.0f); }
+	// fraction of the way from the envelope mean to its recent peak that
+	// counts as an onset (0.1 to 0.9)
+	void sensitivity(float level) {
+		if (level < 0.1f) level = 0.1f;
+		else if (level > 0.9f) level = 0.9f;
+		thresh_hi = level * 256.0f;
+		thresh_lo = thresh_hi / 2;
+	}
+	// the input comes from an AudioEffectDecimate of ratio n (1, 4, 8 or
+	// 10); starts afresh, as reset() does
+	void decimation(int n);
+	void reset(void);
+	virtual void update(void);
+private:
+	struct Beat {
+		uint32_t s1;          // onset of S1, sample number
+		uint32_t s2;          // onset of the S2 that followed, 0 if none
+		uint32_t interval;    // S1 to S1, samples
+		uint32_t count;       // beats since reset()
+	};
+	void envelopePoint(uint32_t energy, uint32_t when);
+	void onset(uint32_t when);
+	audio_block_t *inputQueueArray[1];
+	float    rate;                // input sample rate
+	uint8_t  ratio;               // of the decimation before this
+	uint8_t  segment;             // samples per envelope point
+	uint8_t  peak_shift;          // decay of 'peak' per block
+	uint32_t refractory, s2_min, s2_max, interval_min, interval_max;  // samples
+	uint32_t sample_count;        // samples seen since reset()
+	int32_t  peak;                // recent absolute peak, for normalising
+	int32_t  smooth;              // envelope, Q8
+	int32_t  mean;                // slow average of the envelope, Q8
+	int32_t  env_peak;            // recent envelope peak, Q8
+	int32_t  thresh_hi, thresh_lo;  // Q8 fractions of env_peak - mean
+	bool     armed;
+	bool     have_s1, have_s2;
+	uint32_t last_onset, last_s1, last_s2, last_interval;
+	volatile uint32_t seq;        // odd while update() writes published
+	volatile uint32_t beat_count;
+	uint32_t read_count;
+	Beat published;
+	Beat latest;
+};
+
+#endif
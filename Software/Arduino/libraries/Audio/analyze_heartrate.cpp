@@ -0,0 +1,213 @@
+/* Audio Library for Teensy 3.X
+ * Copyright (c) 2014, Paul Stoffregen, paul@pjrc.com
+ *
+ * Development of this audio library was funded by PJRC.COM, LLC by sales of
+ * Teensy and Audio Adaptor boards.  Please support PJRC's efforts to develop
+ * open source software by purchasing Teensy or other PJRC products.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice, development funding notice, and this permission
+ * notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "analyze_heartrate.h"
+#include "utility/dspinst.h"
+
+#define ENV_SAMPLES      512     // samples per envelope point, at the full rate (86 Hz)
+#define HOP              64      // envelope points between estimates
+#define RANGE_FLOOR      4       // a flatter envelope is silence, not rhythm
+
+// at 10 a point is 51 samples, so the envelope rate is 0.4% off 86 Hz; the
+// lags and the reported rate use the actual one
+void AudioAnalyzeHeartRate::decimation(int n)
+{
+	if (n < 1) n = 1;
+	__disable_irq();
+	ratio = n;
+	point_samples = ENV_SAMPLES / n;
+	env_rate = AUDIO_SAMPLE_RATE_EXACT / n / point_samples;
+	lag_min = (int)(60.0f * env_rate / 220);
+	lag_max = (int)(60.0f * env_rate / 30) + 1;
+	__enable_irq();
+	reset();
+}
+
+void AudioAnalyzeHeartRate::reset(void)
+{
+	__disable_irq();
+	head = filled = since = 0;
+	sum = 0;
+	samples = 0;
+	state = 0;
+	lag_q8 = 0;
+	conf_q15 = 0;
+	latest_lag = latest_conf = 0;
+	outputflag = false;
+	__enable_irq();
+}
+
+// mean-removed envelope, oldest first, smoothed by [1 2 1] / 4 (a beat that
+// falls between two lags still gives one clear peak), scaled to half of full
+// scale and zero padded to twice its length so the correlation doesn't wrap
+bool AudioAnalyzeHeartRate::prepare(void)
+{
+	int n = filled;
+	int start = head - n;
+	if (start < 0) start += HEARTRATE_HISTORY;
+
+	uint32_t total = 0;
+	for (int k = 0, i = start; k < n; k++) {
+		total += history[i];
+		if (++i == HEARTRATE_HISTORY) i = 0;
+	}
+	int32_t mean = total / n;
+	for (int k = 0, i = start; k < n; k++) {
+		buffer[2 * k] = (int32_t)history[i] - mean;
+		if (++i == HEARTRATE_HISTORY) i = 0;
+	}
+
+	// smoothed values go to the (still unused) imaginary slots
+	int32_t range = 0;
+	int32_t prev = buffer[0];
+	for (int k = 0; k < n; k++) {
+		int32_t cur = buffer[2 * k];
+		int32_t next = k + 1 < n ? buffer[2 * k + 2] : cur;
+		int32_t y = (prev + 2 * cur + next) >> 2;
+		buffer[2 * k + 1] = y;
+		if (abs(y) > range) range = abs(y);
+		prev = cur;
+	}
+	if (range < RANGE_FLOOR) return false;
+
+	int32_t scale = (16384u << 16) / (uint32_t)range;
+	for (int k = 0; k < n; k++) {
+		buffer[2 * k] = (buffer[2 * k + 1] * scale) >> 16;
+		buffer[2 * k + 1] = 0;
+	}
+	memset(buffer + 2 * n, 0, (2048 - 2 * n) * sizeof(int16_t));
+	return true;
+}
+
+// |X|^2, renormalised so the largest bin is full scale (the forward FFT
+// divides by 1024, so the raw powers are small)
+void AudioAnalyzeHeartRate::powerSpectrum(void)
+{
+	uint32_t *bins = (uint32_t *)buffer;
+	uint32_t max = 1;
+	for (int i = 0; i < 1024; i++) {
+		uint32_t tmp = bins[i]; // real & imag
+		uint32_t magsq = multiply_16tx16t_add_16bx16b(tmp, tmp);
+		if (magsq > max) max = magsq;
+	}
+	int shift = 0;
+	while ((max >> shift) > 32767) shift++;
+	for (int i = 0; i < 1024; i++) {
+		uint32_t tmp = bins[i];
+		uint32_t magsq = multiply_16tx16t_add_16bx16b(tmp, tmp);
+		bins[i] = magsq >> shift;       // imaginary part zero
+	}
+}
+
+// strongest local maximum of the autocorrelation inside the lag window,
+// refined by fitting a parabola through it and its neighbours
+void AudioAnalyzeHeartRate::pickPeriod(void)
+{
+	int32_t r0 = buffer[0];
+	int best = 0;
+	int32_t best_r = 0;
+	for (int k = lag_min; k <= lag_max; k++) {
+		int32_t r = buffer[2 * k];
+		if (r > best_r && r > buffer[2 * k - 2] && r >= buffer[2 * k + 2]) {
+			best = k;
+			best_r = r;
+		}
+	}
+	if (!best || r0 <= 0) return;
+
+	int32_t a = buffer[2 * best - 2];
+	int32_t c = buffer[2 * best + 2];
+	int32_t den = a - 2 * best_r + c;
+	int32_t offset = den ? (a - c) * 128 / den : 0;
+	if (offset > 128) offset = 128;
+	else if (offset < -128) offset = -128;
+
+	uint32_t conf = ((uint32_t)best_r << 15) / (uint32_t)r0;
+	lag_q8 = (best << 8) + offset;
+	conf_q15 = conf > 32767 ? 32767 : conf;
+	outputflag = true;
+}
+
+void AudioAnalyzeHeartRate::update(void)
+{
+	audio_block_t *block;
+
+	// a missing block is silence at the full rate; a decimated one is just
+	// not due yet
+	block = receiveReadOnly();
+	if (block || ratio == 1) {
+		const int16_t *p = block ? block->data : NULL;
+		int i = 0;
+		while (i < AUDIO_BLOCK_SAMPLES) {
+			int end = i + point_samples - samples;
+			if (end > AUDIO_BLOCK_SAMPLES) end = AUDIO_BLOCK_SAMPLES;
+			uint32_t s = 0;
+			if (p) {
+				for (int k = i; k < end; k++) s += abs(p[k]);
+			}
+			sum += s;
+			samples += end - i;
+			i = end;
+			if (samples == point_samples) {
+				history[head] = sum / point_samples;
+				if (++head == HEARTRATE_HISTORY) head = 0;
+				if (filled < HEARTRATE_HISTORY) filled++;
+				since++;
+				sum = 0;
+				samples = 0;
+			}
+		}
+		if (block) release(block);
+	}
+
+#if defined(KINETISK)
+	// one step of an estimate per update, none more than one FFT
+	switch (state) {
+	case 0:
+		if (filled >= HEARTRATE_HISTORY / 2 && since >= HOP) {
+			since = 0;
+			if (prepare()) state = 1;
+		}
+		break;
+	case 1:
+		arm_cfft_radix4_q15(&fft_inst, buffer);
+		state = 2;
+		break;
+	case 2:
+		powerSpectrum();
+		state = 3;
+		break;
+	case 3:
+		arm_cfft_radix4_q15(&ifft_inst, buffer);
+		state = 4;
+		break;
+	case 4:
+		pickPeriod();
+		state = 0;
+		break;
+	}
+#endif
+}
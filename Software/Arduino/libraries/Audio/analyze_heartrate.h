@@ -0,0 +1,105 @@
+/* Audio Library for Teensy 3.X
+ * Copyright (c) 2014, Paul Stoffregen, paul@pjrc.com
+ *
+ * Development of this audio library was funded by PJRC.COM, LLC by sales of
+ * Teensy and Audio Adaptor boards.  Please support PJRC's efforts to develop
+ * open source software by purchasing Teensy or other PJRC products.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice, development funding notice, and this permission
+ * notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef analyze_heartrate_h_
+#define analyze_heartrate_h_
+
+#include "Arduino.h"
+#include "AudioStream.h"
+#include "arm_math.h"
+
+// Heart rate from the periodicity of the sound envelope rather than from
+// individual peaks, so murmurs and contact noise that confuse a threshold
+// only lower the confidence.  The envelope (mean magnitude of every 4 blocks,
+// 86 Hz) is kept for the last 5.9 seconds; about every 0.75 s its
+// autocorrelation is computed as the inverse FFT of its power spectrum, and
+// the strongest period between 30 and 220 BPM is reported.  The two 1024
+// point FFTs and the steps around them run one per update().  Behind an
+// AudioEffectDecimate, decimation() keeps the envelope at 86 Hz; only the
+// magnitude sum, the part that grows with the sample rate, gets cheaper.
+
+#define HEARTRATE_HISTORY 512
+
+class AudioAnalyzeHeartRate : public AudioStream
+{
+public:
+	AudioAnalyzeHeartRate(void) : AudioStream(1, inputQueueArray) {
+		arm_cfft_radix4_init_q15(&fft_inst, 1024, 0, 1);
+		arm_cfft_radix4_init_q15(&ifft_inst, 1024, 1, 1);
+		decimation(1);
+	}
+	bool available(void) {
+		if (outputflag == true) {
+			outputflag = false;
+			return true;
+		}
+		return false;
+	}
+	// BPM of the latest estimate (0 before the first one); also latches the
+	// confidence of that same estimate
+	float read(void) {
+		__disable_irq();
+		latest_lag = lag_q8;
+		latest_conf = conf_q15;
+		__enable_irq();
+		if (!latest_lag) return 0.0f;
+		return 60.0f * 256.0f * env_rate / latest_lag;
+	}
+	// normalised autocorrelation at the chosen period, 0 to 1: near 1 for a
+	// steady rhythm, below about 0.3 the estimate is not worth showing
+	float confidence(void) { return latest_conf / 32768.0f; }
+	// the input comes from an AudioEffectDecimate of ratio n (1, 4, 8 or
+	// 10); starts afresh, as reset() does
+	void decimation(int n);
+	void reset(void);
+	virtual void update(void);
+private:
+	bool prepare(void);
+	void powerSpectrum(void);
+	void pickPeriod(void);
+	audio_block_t *inputQueueArray[1];
+	uint16_t history[HEARTRATE_HISTORY];    // envelope, oldest at 'head'
+	uint16_t head;
+	uint16_t filled;                        // envelope points in history
+	uint16_t since;                         // points since the last estimate
+	uint32_t sum;                           // magnitudes of the current point
+	uint16_t samples;                       // samples in the current point
+	uint16_t point_samples;                 // samples per point
+	uint8_t  ratio;                         // of the decimation before this
+	uint8_t  lag_min, lag_max;              // envelope points, 220 and 30 BPM
+	float    env_rate;                      // envelope points per second
+	uint8_t  state;                         // 0 idle, 1..4 estimate in progress
+	volatile uint32_t lag_q8;               // period, envelope points Q8
+	volatile uint16_t conf_q15;
+	uint32_t latest_lag;
+	uint16_t latest_conf;
+	volatile bool outputflag;
+	int16_t buffer[2048] __attribute__ ((aligned (4)));
+	arm_cfft_radix4_instance_q15 fft_inst;
+	arm_cfft_radix4_instance_q15 ifft_inst;
+};
+
+#endif
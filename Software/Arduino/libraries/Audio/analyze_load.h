@@ -0,0 +1,68 @@
+/* Audio Library for Teensy 3.X
+ * Copyright (c) 2014, Paul Stoffregen, paul@pjrc.com
+ *
+ * Development of this audio library was funded by PJRC.COM, LLC by sales of
+ * Teensy and Audio Adaptor boards.  Please support PJRC's efforts to develop
+ * open source software by purchasing Teensy or other PJRC products.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice, development funding notice, and this permission
+ * notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#ifndef analyze_load_h_
+#define analyze_load_h_
+
+#include "Arduino.h"
+#include "AudioStream.h"
+
+// Watches the audio interrupt itself rather than a signal.  It needs no
+// connections: once per update pass it checks how long the previous pass
+// took (AudioStream::cpu_cycles_total) against the time one block lasts, and
+// how long it has been since the pass before.  A pass that took longer than
+// a block is an overrun; one that started more than half a block late was
+// held off, by interrupts left disabled or by an overrun before it.
+
+class AudioAnalyzeLoad : public AudioStream
+{
+public:
+	AudioAnalyzeLoad(void) : AudioStream(0, NULL) {
+		active = true;          // no connections, update anyway
+		reset();
+	}
+	uint32_t passes(void) { return count; }
+	uint32_t overruns(void) { return overrun_count; }
+	uint32_t late(void) { return late_count; }
+	// longest time between two passes, in microseconds
+	uint32_t longestGap(void) { return longest_us; }
+	void reset(void) {
+		__disable_irq();
+		count = overrun_count = late_count = 0;
+		longest_us = 0;
+		__enable_irq();
+	}
+	virtual void update(void);
+private:
+	volatile uint32_t count;
+	volatile uint32_t overrun_count;
+	volatile uint32_t late_count;
+	volatile uint32_t longest_us;
+	uint32_t last_us;
+};
+
+#endif
@@ -508,9 +508,19 @@ void AudioControlSGTL5000::setAddress(uint8_t level)
 	}
 }
 
+#define RAMP_MS  400   // VAG and the analog outputs settle after power up
+
 bool AudioControlSGTL5000::enable(void)
+{
+	if (!powerUp()) return false;
+	delay(RAMP_MS);
+	return isReady();
+}
+
+bool AudioControlSGTL5000::powerUp(void)
 {
 	muted = true;
+	ready = false;
 	Wire.begin();
 	delay(5);
 	//Serial.print("chip ID = ");
@@ -526,7 +536,16 @@ bool AudioControlSGTL5000::enable(void)
 	write(CHIP_ANA_CTRL, 0x0137);  // enable zero cross detectors
 	write(CHIP_ANA_POWER, 0x40FF); // power up: lineout, hp, adc, dac
 	write(CHIP_DIG_POWER, 0x0073); // power up all digital stuff
-	delay(400);
+	ramp_start = millis();
+	ramping = true;
+	return true;
+}
+
+bool AudioControlSGTL5000::isReady(void)
+{
+	if (ready) return true;
+	if (!ramping || millis() - ramp_start < RAMP_MS) return false;
+	ramping = false;
 	write(CHIP_LINE_OUT_VOL, 0x1D1D); // default approx 1.3 volts peak-to-peak
 	write(CHIP_CLK_CTRL, 0x0004);  // 44.1 kHz, 256*Fs
 	write(CHIP_I2S_CTRL, 0x0130); // SCLK=32*Fs, 16bit, I2S format
@@ -538,6 +557,7 @@ bool AudioControlSGTL5000::enable(void)
 	write(CHIP_ANA_CTRL, 0x0036);  // enable zero cross detectors
 	//mute = false;
 	semi_automated = true;
+	ready = true;
 	return true;
 }
 
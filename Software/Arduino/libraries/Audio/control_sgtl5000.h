@@ -32,9 +32,14 @@
 class AudioControlSGTL5000 : public AudioControl
 {
 public:
-	AudioControlSGTL5000(void) : i2c_addr(0x0A) { }
+	AudioControlSGTL5000(void) : i2c_addr(0x0A), ramping(false), ready(false) { }
 	void setAddress(uint8_t level);
 	bool enable(void);
+	// enable() in two halves, so the 400 ms analog ramp doesn't block:
+	// powerUp() returns at once, isReady() finishes the enable when the
+	// ramp is done.  Other settings must wait for isReady().
+	bool powerUp(void);
+	bool isReady(void);
 	bool disable(void) { return false; }
 	bool volume(float n) { return volumeInteger(n * 129 + 0.499); }
 	bool inputLevel(float n) {return false;}
@@ -102,6 +107,9 @@ protected:
 	unsigned short dap_audio_eq_band(uint8_t bandNum, float n);
 private:
 	bool semi_automated;
+	bool ramping;
+	bool ready;
+	uint32_t ramp_start;
 	void automate(uint8_t dap, uint8_t eq);
 	void automate(uint8_t dap, uint8_t eq, uint8_t filterCount);
 };
@@ -0,0 +1,111 @@
+/* Audio Library for Teensy 3.X
+ * Copyright (c) 2014, Paul Stoffregen, paul@pjrc.com
+ *
+ * Development of this audio library was funded by PJRC.COM, LLC by sales of
+ * Teensy and Audio Adaptor boards.  Please support PJRC's efforts to develop
+ * open source software by purchasing Teensy or other PJRC products.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice, development funding notice, and this permission
+ * notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "effect_autogain.h"
+#include "utility/dspinst.h"
+
+#define CLIP_LEVEL       32700   // an input this close to full scale was clipped by the ADC
+#define GATE_LEVEL       64      // don't chase an envelope below this (about -54 dBFS)
+
+// one-pole smoothing coefficient per block for a time constant in ms
+int32_t AudioEffectAutoGain::coefficient(float milliseconds)
+{
+	float blocks = milliseconds * (AUDIO_SAMPLE_RATE_EXACT / 1000.0f) / AUDIO_BLOCK_SAMPLES;
+	if (blocks < 1.0f) return 65536;
+	return (1.0f - expf(-1.0f / blocks)) * 65536.0f;
+}
+
+void AudioEffectAutoGain::compensate(float dB)
+{
+	float ratio = powf(10.0f, dB / 20.0f);
+	__disable_irq();
+	envelope = envelope * ratio;
+	int32_t g = gain_q16 / ratio;
+	if (g > max_q16) g = max_q16;
+	else if (g < min_q16) g = min_q16;
+	gain_q16 = g;
+	__enable_irq();
+}
+
+void AudioEffectAutoGain::update(void)
+{
+	audio_block_t *block;
+	int16_t *p;
+	int32_t peak = 0;
+	uint32_t clips = 0;
+
+	block = receiveWritable();
+	if (!block) return;
+
+	p = block->data;
+	for (int i = 0; i < AUDIO_BLOCK_SAMPLES; i++) {
+		int32_t d = abs(p[i]);
+		if (d > peak) peak = d;
+		if (d >= CLIP_LEVEL) clips++;
+	}
+	if (peak > in_peak) in_peak = peak;
+	in_clips += clips;
+
+	// peak envelope, attack and release
+	int32_t level = peak << 8;
+	int32_t coef = level > envelope ? attack_coef : release_coef;
+	envelope += (int32_t)(((int64_t)(level - envelope) * coef) >> 16);
+
+	if (!enabled) {
+		transmit(block);
+		AudioStream::release(block);
+		return;
+	}
+
+	int32_t start = gain_q16;
+	int32_t want = start;
+	if (envelope >= (GATE_LEVEL << 8)) {
+		want = ((int64_t)target_level << 24) / envelope;
+		if (want > max_q16) want = max_q16;
+		else if (want < min_q16) want = min_q16;
+	}
+	if (peak) {
+		int32_t limit = (32767 << 16) / peak;           // largest gain this block takes unclipped
+		if (want > limit) want = limit < min_q16 ? min_q16 : limit;
+		if (start > limit) start = want;            // don't ramp down from a clipping gain
+	}
+	gain_q16 = want;
+
+	// ramp from the old gain to the new one across the block
+	int32_t step = (want - start) / AUDIO_BLOCK_SAMPLES;
+	int32_t g = start;
+	uint32_t saturated = 0;
+	for (int i = 0; i < AUDIO_BLOCK_SAMPLES; i++) {
+		int32_t val = signed_multiply_32x16b(g, (uint32_t)p[i]);
+		if (val > 32767 || val < -32768) saturated++;
+		p[i] = saturate16(val);
+		g += step;
+	}
+	out_clips += saturated;
+
+	transmit(block);
+	AudioStream::release(block);
+}
@@ -0,0 +1,111 @@
+/* Audio Library for Teensy 3.X
+ * Copyright (c) 2014, Paul Stoffregen, paul@pjrc.com
+ *
+ * Development of this audio library was funded by PJRC.COM, LLC by sales of
+ * Teensy and Audio Adaptor boards.  Please support PJRC's efforts to develop
+ * open source software by purchasing Teensy or other PJRC products.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice, development funding notice, and this permission
+ * notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef effect_autogain_h_
+#define effect_autogain_h_
+
+#include "Arduino.h"
+#include "AudioStream.h"
+
+// Digital automatic gain control.  The input's peak envelope rises with the
+// attack time and falls with the release time; the gain is target / envelope,
+// within +/- maxGain dB, ramped across each block.  The block's own peak is
+// known before the gain is applied, so a gain that would clip is cut at once.
+// Below a noise gate the gain is held rather than raised.  The input peak and
+// clip counters are for steering an analog gain (the codec's mic preamp)
+// slowly from loop(); compensate() keeps the output level steady across such
+// a step.
+
+class AudioEffectAutoGain : public AudioStream
+{
+public:
+	AudioEffectAutoGain(void) : AudioStream(1, inputQueueArray) {
+		enabled = true;
+		target(0.5);
+		attack(10.0);
+		release(3000.0);
+		maxGain(24.0);
+		envelope = 0;
+		gain_q16 = 65536;
+		in_peak = 0;
+		in_clips = out_clips = 0;
+	}
+	// false passes the audio unchanged (peak and clips are still counted)
+	void enable(bool on) { enabled = on; }
+	// envelope level the gain aims for, fraction of full scale
+	void target(float level) {
+		if (level < 0.05f) level = 0.05f;
+		else if (level > 0.9f) level = 0.9f;
+		target_level = level * 32767.0f;
+	}
+	void attack(float milliseconds) { attack_coef = coefficient(milliseconds); }
+	void release(float milliseconds) { release_coef = coefficient(milliseconds); }
+	// largest boost, and largest cut, 0 to 24 dB
+	void maxGain(float dB) {
+		if (dB < 0.0f) dB = 0.0f;
+		else if (dB > 24.0f) dB = 24.0f;
+		max_q16 = powf(10.0f, dB / 20.0f) * 65536.0f;
+		min_q16 = 65536.0f * 65536.0f / max_q16;
+	}
+	// the input level is about to change by dB (analog gain step): scale
+	// the envelope and the gain to match, so the output stays level
+	void compensate(float dB);
+	// current gain, dB
+	float gainDb(void) { return 20.0f * log10f(gain_q16 / 65536.0f); }
+	// largest input magnitude since the last call, 0 to 1
+	float inputPeak(void) {
+		__disable_irq();
+		int32_t p = in_peak;
+		in_peak = 0;
+		__enable_irq();
+		return p / 32767.0f;
+	}
+	// input samples at full scale (the analog gain is too high), and output
+	// samples the digital gain had to saturate, since clearClips()
+	uint32_t inputClips(void) { return in_clips; }
+	uint32_t outputClips(void) { return out_clips; }
+	void clearClips(void) {
+		__disable_irq();
+		in_clips = out_clips = 0;
+		__enable_irq();
+	}
+	virtual void update(void);
+private:
+	static int32_t coefficient(float milliseconds);
+	audio_block_t *inputQueueArray[1];
+	bool enabled;
+	int32_t target_level;           // samples
+	int32_t attack_coef;            // per block, Q16
+	int32_t release_coef;
+	int32_t max_q16, min_q16;
+	int32_t envelope;               // samples, Q8
+	int32_t gain_q16;
+	volatile int32_t in_peak;
+	volatile uint32_t in_clips;
+	volatile uint32_t out_clips;
+};
+
+#endif
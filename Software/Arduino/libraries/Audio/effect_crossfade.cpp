@@ -0,0 +1,126 @@
+/* Audio Library for Teensy 3.X
+ * Copyright (c) 2014, Paul Stoffregen, paul@pjrc.com
+ *
+ * Development of this audio library was funded by PJRC.COM, LLC by sales of
+ * Teensy and Audio Adaptor boards.  Please support PJRC's efforts to develop
+ * open source software by purchasing Teensy or other PJRC products.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice, development funding notice, and this permission
+ * notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "effect_crossfade.h"
+#include "utility/dspinst.h"
+
+extern "C" {
+extern const int16_t AudioWaveformSine[257];
+}
+
+#define FULL  (1u << 30)
+
+void AudioEffectCrossfade::fade(float n, float milliseconds)
+{
+	uint32_t p = toFixed(n);
+	float blocks = milliseconds * (AUDIO_SAMPLE_RATE_EXACT / 1000.0f) / AUDIO_BLOCK_SAMPLES;
+	__disable_irq();
+	int32_t distance = (int32_t)p - (int32_t)pos;
+	int32_t s = blocks > 1.0f ? distance / blocks : distance;
+	if (s == 0 && distance != 0) s = distance > 0 ? 1 : -1;
+	target = p;
+	step = s;
+	__enable_irq();
+}
+
+// Q16 gains of both inputs at a position
+void AudioEffectCrossfade::gains(uint32_t p, int32_t *g0, int32_t *g1)
+{
+	if (shape == CROSSFADE_LINEAR) {
+		*g1 = p >> 14;
+		*g0 = 65536 - *g1;
+		return;
+	}
+	// sin and cos of p * 90 degrees: Q30 is a quarter of the sine table's phase
+	uint32_t q = FULL - p;
+	uint32_t i = p >> 24, j = q >> 24;
+	uint32_t s = (p >> 8) & 0xFFFF, t = (q >> 8) & 0xFFFF;
+	int32_t v1 = AudioWaveformSine[i] * (0x10000 - s) + AudioWaveformSine[i + 1] * s;
+	int32_t v0 = AudioWaveformSine[j] * (0x10000 - t) + AudioWaveformSine[j + 1] * t;
+	*g1 = p >= FULL ? 65536 : v1 >> 15;
+	*g0 = p == 0 ? 65536 : v0 >> 15;
+}
+
+void AudioEffectCrossfade::update(void)
+{
+	audio_block_t *block, *other;
+	uint32_t start = pos;
+	uint32_t end = start;
+
+	if (step) {
+		end = start + step;
+		if ((step > 0 && (end >= target || end < start)) ||
+		    (step < 0 && (end <= target || end > start))) {
+			end = target;
+			step = 0;
+		}
+		pos = end;
+	}
+
+	// resting at one end: pass that input on
+	if (start == end && (end == 0 || end == FULL)) {
+		int keep = end ? 1 : 0;
+		block = receiveReadOnly(keep);
+		other = receiveReadOnly(1 - keep);
+		if (other) release(other);
+		if (block) {
+			transmit(block);
+			release(block);
+		}
+		return;
+	}
+
+	block = receiveWritable(0);
+	other = receiveReadOnly(1);
+	if (!block) {
+		if (!other) return;
+		block = allocate();
+		if (!block) {
+			release(other);
+			return;
+		}
+		memset(block->data, 0, sizeof(block->data));
+	}
+
+	int32_t a0, a1, b0, b1;
+	gains(start, &a0, &a1);
+	gains(end, &b0, &b1);
+	int32_t g0 = a0, g1 = a1;
+	int32_t d0 = (b0 - a0) / AUDIO_BLOCK_SAMPLES;
+	int32_t d1 = (b1 - a1) / AUDIO_BLOCK_SAMPLES;
+	int16_t *p = block->data;
+	const int16_t *q = other ? other->data : NULL;
+	for (int i = 0; i < AUDIO_BLOCK_SAMPLES; i++) {
+		int32_t val = signed_multiply_32x16b(g0, (uint32_t)p[i]);
+		if (q) val += signed_multiply_32x16b(g1, (uint32_t)q[i]);
+		p[i] = saturate16(val);
+		g0 += d0;
+		g1 += d1;
+	}
+	if (other) release(other);
+	transmit(block);
+	release(block);
+}
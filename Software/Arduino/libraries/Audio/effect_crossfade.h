@@ -0,0 +1,80 @@
+/* Audio Library for Teensy 3.X
+ * Copyright (c) 2014, Paul Stoffregen, paul@pjrc.com
+ *
+ * Development of this audio library was funded by PJRC.COM, LLC by sales of
+ * Teensy and Audio Adaptor boards.  Please support PJRC's efforts to develop
+ * open source software by purchasing Teensy or other PJRC products.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice, development funding notice, and this permission
+ * notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef effect_crossfade_h_
+#define effect_crossfade_h_
+
+#include "Arduino.h"
+#include "AudioStream.h"
+
+// Two inputs into one output, weighted by a position from 0 (all input 0) to
+// 1 (all input 1).  fade() moves the position over a set time; the gains are
+// interpolated sample by sample inside update(), so the fade takes the same
+// time however often loop() runs.  Resting at either end, the selected input
+// is passed on without being copied.
+
+#define CROSSFADE_LINEAR       0
+#define CROSSFADE_EQUAL_POWER  1
+
+class AudioEffectCrossfade : public AudioStream
+{
+public:
+	AudioEffectCrossfade(void) : AudioStream(2, inputQueueArray) {
+		shape = CROSSFADE_EQUAL_POWER;
+		pos = target = 0;
+		step = 0;
+	}
+	// gain curve: LINEAR gains add up to 1 (for related signals), EQUAL_POWER
+	// gains' squares add up to 1 (for unrelated signals, no dip mid-fade)
+	void curve(int type) { shape = type; }
+	// jump to a position
+	void position(float n) {
+		uint32_t p = toFixed(n);
+		__disable_irq();
+		pos = target = p;
+		step = 0;
+		__enable_irq();
+	}
+	// move to a position over a time
+	void fade(float n, float milliseconds);
+	bool isFading(void) { return step != 0; }
+	float read(void) { return pos / 1073741824.0f; }
+	virtual void update(void);
+private:
+	static uint32_t toFixed(float n) {
+		if (n < 0.0f) n = 0.0f;
+		else if (n > 1.0f) n = 1.0f;
+		return n * 1073741824.0f;
+	}
+	void gains(uint32_t p, int32_t *g0, int32_t *g1);
+	audio_block_t *inputQueueArray[2];
+	uint8_t shape;
+	volatile uint32_t pos;          // Q30, 1.0 = input 1
+	uint32_t target;
+	volatile int32_t step;          // per block, 0 when not fading
+};
+
+#endif
@@ -0,0 +1,131 @@
+/* Audio Library for Teensy 3.X
+ * Copyright (c) 2014, Paul Stoffregen, paul@pjrc.com
+ *
+ * Development of this audio library was funded by PJRC.COM, LLC by sales of
+ * Teensy and Audio Adaptor boards.  Please support PJRC's efforts to develop
+ * open source software by purchasing Teensy or other PJRC products.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice, development funding notice, and this permission
+ * notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "effect_decimate.h"
+#include "utility/dspinst.h"
+
+#define CUTOFF           0.40f   // of the output sample rate
+
+void AudioEffectDecimate::factor(int n)
+{
+	if (n <= 1) n = 1;
+	else if (n <= 4) n = 4;
+	else if (n <= 8) n = 8;
+	else n = 10;
+
+	// windowed sinc (Blackman), unity gain at DC; the taps are symmetric,
+	// so only the first half is kept
+	int16_t h[DECIMATE_TAPS_MAX / 2];
+	int len = n > 1 ? DECIMATE_TAPS_PER_RATIO * n : 0;
+	if (len) {
+		float w[DECIMATE_TAPS_MAX / 2];
+		float fc = CUTOFF / n;  // of the input rate
+		float sum = 0.0f;
+		for (int i = 0; i < len / 2; i++) {
+			float x = i - (len - 1) / 2.0f;
+			float a = 2.0f * PI * i / (len - 1);
+			w[i] = sinf(2.0f * PI * fc * x) / (PI * x)
+				* (0.42f - 0.5f * cosf(a) + 0.08f * cosf(2.0f * a));
+			sum += 2.0f * w[i];
+		}
+		int total = 0;
+		for (int i = 0; i < len / 2; i++) {
+			h[i] = lroundf(w[i] * 32768.0f / sum);
+			total += 2 * h[i];
+		}
+		h[len / 2 - 1] += (32768 - total) / 2;  // rounding, so DC is exact
+	}
+
+	__disable_irq();
+	if (out) {
+		release(out);
+		out = NULL;
+	}
+	ratio = n;
+	taps = len;
+	phase = 0;
+	filled = 0;
+	memcpy(coef, h, len / 2 * sizeof(int16_t));
+	memset(history, 0, sizeof(history));
+	__enable_irq();
+}
+
+void AudioEffectDecimate::update(void)
+{
+	audio_block_t *block;
+
+	if (ratio == 1) {
+		block = receiveReadOnly();
+		if (!block) return;
+		transmit(block);
+		release(block);
+		return;
+	}
+	block = receiveReadOnly();
+	if (!block) return;
+
+	// the last taps - 1 samples of the previous block, then this one
+	int keep = taps - 1;
+	memcpy(history + keep, block->data, sizeof(block->data));
+	release(block);
+
+	int i;
+	for (i = phase; i < AUDIO_BLOCK_SAMPLES; i += ratio) {
+		if (!out) {
+			out = allocate();
+			// silence stands in for what was lost while none was free
+			if (out) memset(out->data, 0, filled * sizeof(int16_t));
+		}
+		if (!out) {
+			// the sample is lost but its place is counted, so what
+			// follows stays in time; a whole lost block is not sent
+			if (++filled == AUDIO_BLOCK_SAMPLES) filled = 0;
+			continue;
+		}
+		// output aligned with input sample i: taps samples ending there,
+		// folded about the middle, where the taps mirror each other
+		const int16_t *x = history + i;
+		const int16_t *y = x + taps - 1;
+		const int16_t *c = coef;
+		const int16_t *end = coef + taps / 2;
+		int32_t sum = 0;
+		do {
+			sum += (x[0] + y[0]) * c[0] + (x[1] + y[-1]) * c[1];
+			x += 2;
+			y -= 2;
+			c += 2;
+		} while (c < end);
+		out->data[filled] = saturate16((sum + 16384) >> 15);
+		if (++filled == AUDIO_BLOCK_SAMPLES) {
+			transmit(out);
+			release(out);
+			out = NULL;
+			filled = 0;
+		}
+	}
+	phase = i - AUDIO_BLOCK_SAMPLES;
+	memmove(history, history + AUDIO_BLOCK_SAMPLES, keep * sizeof(int16_t));
+}
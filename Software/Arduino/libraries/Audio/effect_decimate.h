@@ -0,0 +1,73 @@
+/* Audio Library for Teensy 3.X
+ * Copyright (c) 2014, Paul Stoffregen, paul@pjrc.com
+ *
+ * Development of this audio library was funded by PJRC.COM, LLC by sales of
+ * Teensy and Audio Adaptor boards.  Please support PJRC's efforts to develop
+ * open source software by purchasing Teensy or other PJRC products.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice, development funding notice, and this permission
+ * notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef effect_decimate_h_
+#define effect_decimate_h_
+
+#include "Arduino.h"
+#include "AudioStream.h"
+
+// Lowers the sample rate by 4, 8 or 10 (11.0, 5.5 or 4.4 kHz) for the parts of
+// a graph that only need heart and lung sounds, which sit below 1 kHz.  A
+// windowed-sinc FIR of 12 taps per step of the ratio, cut off at 40% of the
+// new rate, removes what would alias; only the outputs that are kept are
+// computed (the polyphase form), and the taps are symmetric, so each output
+// adds mirrored pairs of samples first: 6 multiplies per input sample whatever
+// the ratio.  The output is packed into full blocks: one leaves every
+// 4, 8 or 10 updates, and holds that many block periods of sound.  Objects
+// downstream must expect that -- AudioRecordQueue, AudioAnalyzeHeartBeat and
+// AudioAnalyzeHeartRate are told the ratio with decimation().  A ratio of 1
+// passes the input through untouched.
+
+#define DECIMATE_TAPS_PER_RATIO 12      // even, so each half is whole pairs
+#define DECIMATE_RATIO_MAX      10
+#define DECIMATE_TAPS_MAX       (DECIMATE_TAPS_PER_RATIO * DECIMATE_RATIO_MAX)
+
+class AudioEffectDecimate : public AudioStream
+{
+public:
+	AudioEffectDecimate(void) : AudioStream(1, inputQueueArray) {
+		out = NULL;
+		factor(1);
+	}
+	// 1, 4, 8 or 10; any other ratio takes the next of these up (10 at
+	// most).  Starts afresh: the partly filled output block is dropped.
+	void factor(int n);
+	int factor(void) { return ratio; }
+	float sampleRate(void) { return AUDIO_SAMPLE_RATE_EXACT / ratio; }
+	virtual void update(void);
+private:
+	audio_block_t *inputQueueArray[1];
+	audio_block_t *out;             // being filled
+	uint8_t ratio;
+	uint8_t taps;
+	uint8_t phase;                  // first input sample of the block that gives an output
+	uint8_t filled;                 // samples in 'out'
+	int16_t coef[DECIMATE_TAPS_MAX / 2];    // first half, the rest mirrors it
+	int16_t history[DECIMATE_TAPS_MAX - 1 + AUDIO_BLOCK_SAMPLES];
+};
+
+#endif
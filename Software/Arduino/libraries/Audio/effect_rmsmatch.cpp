@@ -0,0 +1,144 @@
+/* Audio Library for Teensy 3.X
+ * Copyright (c) 2014, Paul Stoffregen, paul@pjrc.com
+ *
+ * Development of this audio library was funded by PJRC.COM, LLC by sales of
+ * Teensy and Audio Adaptor boards.  Please support PJRC's efforts to develop
+ * open source software by purchasing Teensy or other PJRC products.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice, development funding notice, and this permission
+ * notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "effect_rmsmatch.h"
+#include "utility/dspinst.h"
+#include "utility/sqrt_integer.h"
+
+#define SLOT_BLOCKS      16      // blocks per slot of the window, 46 ms
+#define GLIDE_COEF       3695    // per block, Q16: 50 ms time constant
+#define GATE_POWER       4096    // hold the gain below this mean square (about -54 dBFS)
+
+void AudioEffectRmsMatch::enable(bool on)
+{
+	__disable_irq();
+	if (on && !enabled) {
+		memset(main_max, 0, sizeof(main_max));
+		memset(side_max, 0, sizeof(side_max));
+		main_level = side_level = 0;
+		slot = blocks = 0;
+		target_q16 = gain_q16 = 0;
+	} else if (!on) {
+		gain_q16 = 65536;
+	}
+	enabled = on;
+	__enable_irq();
+}
+
+void AudioEffectRmsMatch::window(float milliseconds)
+{
+	int n = milliseconds * (AUDIO_SAMPLE_RATE_EXACT / 1000.0f) / (AUDIO_BLOCK_SAMPLES * SLOT_BLOCKS) + 0.5f;
+	if (n < 2) n = 2;
+	else if (n > RMSMATCH_SLOTS) n = RMSMATCH_SLOTS;
+	__disable_irq();
+	slots = n;
+	if (slot >= n) slot = 0;
+	__enable_irq();
+}
+
+// mean square of one block
+static uint32_t power(const audio_block_t *block)
+{
+	int64_t sum = 0;
+#if defined(KINETISK)
+	const uint32_t *p = (const uint32_t *)(block->data);
+	const uint32_t *end = p + AUDIO_BLOCK_SAMPLES/2;
+	do {
+		uint32_t n1 = *p++;
+		uint32_t n2 = *p++;
+		sum = multiply_accumulate_16tx16t_add_16bx16b(sum, n1, n1);
+		sum = multiply_accumulate_16tx16t_add_16bx16b(sum, n2, n2);
+	} while (p < end);
+#else
+	const int16_t *p = block->data;
+	const int16_t *end = p + AUDIO_BLOCK_SAMPLES;
+	do {
+		int32_t n = *p++;
+		sum += n * n;
+	} while (p < end);
+#endif
+	return sum / AUDIO_BLOCK_SAMPLES;
+}
+
+void AudioEffectRmsMatch::update(void)
+{
+	audio_block_t *block, *side;
+
+	side = receiveReadOnly(1);
+	if (!enabled) {
+		if (side) AudioStream::release(side);
+		block = receiveReadOnly(0);
+		if (!block) return;
+		transmit(block);
+		AudioStream::release(block);
+		return;
+	}
+	block = receiveWritable(0);
+
+	// a missing block is silence, it still ages the window
+	uint32_t p = side ? power(side) : 0;
+	if (side) AudioStream::release(side);
+	if (p > side_max[slot]) side_max[slot] = p;
+	p = block ? power(block) : 0;
+	if (p > main_max[slot]) main_max[slot] = p;
+
+	uint32_t main_peak = 0, side_peak = 0;
+	for (int i = 0; i < slots; i++) {
+		if (main_max[i] > main_peak) main_peak = main_max[i];
+		if (side_max[i] > side_peak) side_peak = side_max[i];
+	}
+	main_level = main_peak;
+	side_level = side_peak;
+	if (++blocks == SLOT_BLOCKS) {
+		blocks = 0;
+		if (++slot >= slots) slot = 0;
+		main_max[slot] = side_max[slot] = 0;
+	}
+
+	if (main_peak >= GATE_POWER) {
+		// side / main in Q24, capped where the gain would pass 8
+		uint64_t q = ((uint64_t)side_peak << 24) / main_peak;
+		uint32_t g2 = q > (64u << 24) - 1 ? (64u << 24) - 1 : q;
+		int64_t g = g2 ? ((int64_t)sqrt_uint32(g2) * ratio_q16) >> 12 : 0;   // sqrt is Q12
+		target_q16 = g > max_q16 ? max_q16 : g;
+	}
+	int32_t start = gain_q16;
+	int32_t want = start + (int32_t)(((int64_t)(target_q16 - start) * GLIDE_COEF) >> 16);
+	gain_q16 = want;
+	if (!block) return;
+
+	// ramp from the old gain to the new one across the block
+	int32_t step = (want - start) / AUDIO_BLOCK_SAMPLES;
+	int32_t g = start;
+	int16_t *d = block->data;
+	for (int i = 0; i < AUDIO_BLOCK_SAMPLES; i++) {
+		d[i] = saturate16(signed_multiply_32x16b(g, (uint32_t)d[i]));
+		g += step;
+	}
+
+	transmit(block);
+	AudioStream::release(block);
+}
@@ -0,0 +1,96 @@
+/* Audio Library for Teensy 3.X
+ * Copyright (c) 2014, Paul Stoffregen, paul@pjrc.com
+ *
+ * Development of this audio library was funded by PJRC.COM, LLC by sales of
+ * Teensy and Audio Adaptor boards.  Please support PJRC's efforts to develop
+ * open source software by purchasing Teensy or other PJRC products.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice, development funding notice, and this permission
+ * notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef effect_rmsmatch_h_
+#define effect_rmsmatch_h_
+
+#include "Arduino.h"
+#include "AudioStream.h"
+
+// Gain stage that makes input 0 as loud as input 1.  The mean square of each
+// block of both inputs is measured, and the loudest block of the last window
+// (about a second, so it holds a heart beat of each) is taken as that input's
+// level.  Comparing peak levels over the same window, rather than averages,
+// keeps the gain steady when the beats of the two inputs don't line up.  The
+// gain, ratio * sqrt(side / main) up to maxGain, glides to each new value
+// with a 50 ms time constant and is ramped sample by sample across each block.
+// Only input 0 is passed to the output; input 1 is a side-chain.  While input
+// 0 is near silence the gain is held rather than raised.
+
+#define RMSMATCH_SLOTS 32
+
+class AudioEffectRmsMatch : public AudioStream
+{
+public:
+	AudioEffectRmsMatch(void) : AudioStream(2, inputQueueArray) {
+		enabled = false;
+		slot = blocks = 0;
+		ratio(1.0);
+		maxGain(4.0);
+		window(1000.0);
+		enable(true);
+	}
+	// false passes input 0 unchanged; true starts matching afresh, with the
+	// gain rising from zero as the first levels are measured
+	void enable(bool on);
+	// output RMS as a fraction of the side-chain RMS
+	void ratio(float n) {
+		if (n < 0.0f) n = 0.0f;
+		else if (n > 4.0f) n = 4.0f;
+		ratio_q16 = n * 65536.0f;
+	}
+	// how far back the levels look, 93 to 1486 ms; longer than a beat gives
+	// a steady gain, a drop in level is followed after this long
+	void window(float milliseconds);
+	// largest gain, 1 to 8
+	void maxGain(float n) {
+		if (n < 1.0f) n = 1.0f;
+		else if (n > 8.0f) n = 8.0f;
+		max_q16 = n * 65536.0f;
+	}
+	// current gain, linear
+	float gain(void) { return gain_q16 / 65536.0f; }
+	// RMS of the loudest block in the window of each input, 0 to 1
+	float mainRms(void) { return sqrtf(main_level) / 32767.0f; }
+	float sideRms(void) { return sqrtf(side_level) / 32767.0f; }
+	virtual void update(void);
+private:
+	audio_block_t *inputQueueArray[2];
+	bool enabled;
+	uint8_t slots;                  // slots in the window
+	uint8_t slot;                   // slot being filled
+	uint8_t blocks;                 // blocks in that slot so far
+	int32_t ratio_q16;
+	int32_t max_q16;
+	uint32_t main_max[RMSMATCH_SLOTS];      // loudest block mean square per slot
+	uint32_t side_max[RMSMATCH_SLOTS];
+	volatile uint32_t main_level;
+	volatile uint32_t side_level;
+	int32_t target_q16;
+	volatile int32_t gain_q16;
+};
+
+#endif
@@ -33,10 +33,20 @@ void AudioPlaySdRaw::begin(void)
 	playing = false;
 	file_offset = 0;
 	file_size = 0;
+	data_start = 0;
+	looping = false;
+	file_open = false;
+	file_done = false;
+	loop_start = 0;
+	loop_end = 0;
+	ring = NULL;
+	ring_size = 0;
+	ring_in = ring_out = 0;
+	underrun_count = 0;
 }
 
 
-bool AudioPlaySdRaw::play(const char *filename)
+bool AudioPlaySdRaw::play(const char *filename, uint32_t offset)
 {
 	stop();
 #if defined(HAS_KINETIS_SDHC)
@@ -57,7 +67,14 @@ bool AudioPlaySdRaw::play(const char *filename)
 		return false;
 	}
 	file_size = rawfile.size();
-	file_offset = 0;
+	if (offset > file_size) offset = file_size;
+	if (offset) rawfile.seek(offset);
+	data_start = offset;
+	file_offset = offset;
+	file_open = true;
+	file_done = false;
+	ring_in = ring_out = 0;
+	if (ring) refill();             // start with a full ring
 	//Serial.println("able to open file");
 	playing = true;
 	return true;
@@ -66,17 +83,64 @@ bool AudioPlaySdRaw::play(const char *filename)
 void AudioPlaySdRaw::stop(void)
 {
 	__disable_irq();
-	if (playing) {
-		playing = false;
-		__enable_irq();
+	bool open = file_open;
+	playing = false;
+	file_open = false;
+	__enable_irq();
+	if (open) {
 		rawfile.close();
 		#if defined(HAS_KINETIS_SDHC)
 			if (!(SIM_SCGC3 & SIM_SCGC3_SDHC)) AudioStopUsingSPI();
 		#else
 			AudioStopUsingSPI();
 		#endif
-	} else {
-		__enable_irq();
+	}
+}
+
+// byte offset where reading stops, or wraps to the loop start
+static inline uint32_t endOffset(bool looping, uint32_t loop_end, uint32_t data_start, uint32_t file_size)
+{
+	if (looping && loop_end && data_start + loop_end * 2 < file_size) return data_start + loop_end * 2;
+	return file_size;
+}
+
+bool AudioPlaySdRaw::rewind(void)
+{
+	uint32_t end = endOffset(looping, loop_end, data_start, file_size);
+	uint32_t start = data_start + loop_start * 2;
+	if (end < data_start + 2) return false;
+	if (start + 2 > end) start = data_start;
+	return rawfile.seek(start);
+}
+
+void AudioPlaySdRaw::refill(void)
+{
+	if (!ring || !file_open) return;
+	if (file_done) {
+		if (!playing) stop();   // the ring has played out
+		return;
+	}
+	uint32_t end = endOffset(looping, loop_end, data_start, file_size);
+	while (1) {
+		uint32_t space = ring_size - (ring_in - ring_out);
+		if (space < AUDIO_BLOCK_SAMPLES) break;
+		uint32_t pos = rawfile.position();
+		if (pos + 2 > end) {
+			if (looping && rewind()) continue;
+			file_done = true;
+			break;
+		}
+		uint32_t at = ring_in % ring_size;
+		uint32_t n = ring_size - at;    // contiguous free samples
+		if (n > space) n = space;
+		if (n > (end - pos) / 2) n = (end - pos) / 2;
+		if (n > 16384) n = 16384;
+		int got = rawfile.read(ring + at, n * 2);
+		if (got < 2) {
+			file_done = true;
+			break;
+		}
+		ring_in += got / 2;
 	}
 }
 
@@ -93,11 +157,47 @@ void AudioPlaySdRaw::update(void)
 	block = allocate();
 	if (block == NULL) return;
 
-	if (rawfile.available()) {
+	if (ring) {
+		// copy from the read-ahead ring, the file is left to refill()
+		uint32_t out = ring_out;
+		uint32_t avail = ring_in - out;
+		n = avail < AUDIO_BLOCK_SAMPLES ? avail : AUDIO_BLOCK_SAMPLES;
+		uint32_t at = out % ring_size;
+		uint32_t first = ring_size - at < n ? ring_size - at : n;
+		memcpy(block->data, ring + at, first * 2);
+		memcpy(block->data + first, ring, (n - first) * 2);
+		for (i=n; i < AUDIO_BLOCK_SAMPLES; i++) {
+			block->data[i] = 0;
+		}
+		ring_out = out + n;
+		if (n < AUDIO_BLOCK_SAMPLES) {
+			if (file_done) playing = false;
+			else underrun_count++;
+		}
+		if (n) transmit(block);
+		release(block);
+		return;
+	}
+
+	// read straight from the file, wrapping at the loop end
+	uint32_t end = endOffset(looping, loop_end, data_start, file_size);
+	uint32_t got = 0;
+	while (got < AUDIO_BLOCK_SAMPLES*2) {
+		uint32_t pos = rawfile.position();
+		if (pos + 2 > end) {
+			if (looping && rewind()) continue;
+			break;
+		}
+		uint32_t want = AUDIO_BLOCK_SAMPLES*2 - got;
+		if (want > end - pos) want = end - pos;
+		int r = rawfile.read((uint8_t *)block->data + got, want);
+		if (r <= 0) break;
+		got += r;
+		file_offset = pos + r;
+	}
+	if (got) {
 		// we can read more data from the file...
-		n = rawfile.read(block->data, AUDIO_BLOCK_SAMPLES*2);
-		file_offset += n;
-		for (i=n/2; i < AUDIO_BLOCK_SAMPLES; i++) {
+		for (i=got/2; i < AUDIO_BLOCK_SAMPLES; i++) {
 			block->data[i] = 0;
 		}
 		transmit(block);
@@ -108,6 +208,7 @@ void AudioPlaySdRaw::update(void)
 		#else
 			AudioStopUsingSPI();
 		#endif
+		file_open = false;
 		playing = false;
 	}
 	release(block);
@@ -117,10 +218,21 @@ void AudioPlaySdRaw::update(void)
 
 uint32_t AudioPlaySdRaw::positionMillis(void)
 {
-	return ((uint64_t)file_offset * B2M) >> 32;
+	uint32_t offset = file_offset - data_start;
+	if (ring) {
+		// bytes played since the start, folded back into the loop
+		offset = ring_out * 2;
+		uint32_t end = endOffset(looping, loop_end, data_start, file_size) - data_start;
+		uint32_t start = loop_start * 2;
+		if (start + 2 > end) start = 0;
+		if (looping && offset >= end && end > start) {
+			offset = start + (offset - end) % (end - start);
+		}
+	}
+	return ((uint64_t)offset * B2M) >> 32;
 }
 
 uint32_t AudioPlaySdRaw::lengthMillis(void)
 {
-	return ((uint64_t)file_size * B2M) >> 32;
+	return ((uint64_t)(file_size - data_start) * B2M) >> 32;
 }
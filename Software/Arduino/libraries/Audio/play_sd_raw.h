@@ -31,22 +31,60 @@
 #include "AudioStream.h"
 #include "SD.h"
 
+// Plays 16 bit mono samples straight from a file.  By default each update()
+// reads its block from the card.  Given a buffer with readAhead(), the file
+// is read ahead into it by refill(), to be called from loop(), and update()
+// only copies from RAM, so card latency stays out of the audio interrupt.
+// loop(true) repeats the file, or the part between loopPoints(), seamlessly.
+// The samples can start past a header: give their byte offset to play().
+
 class AudioPlaySdRaw : public AudioStream
 {
 public:
 	AudioPlaySdRaw(void) : AudioStream(0, NULL) { begin(); }
 	void begin(void);
-	bool play(const char *filename);
+	bool play(const char *filename, uint32_t offset = 0);
 	void stop(void);
 	bool isPlaying(void) { return playing; }
 	uint32_t positionMillis(void);
 	uint32_t lengthMillis(void);
+	// repeat from the loop start when the loop end is reached
+	void loop(bool on) { looping = on; }
+	// loop start and end, in samples from the first one; an end of 0 is the
+	// end of the file
+	void loopPoints(uint32_t start, uint32_t end) {
+		loop_start = start;
+		loop_end = end;
+	}
+	// read-ahead ring, in samples (rounded down to whole blocks); NULL
+	// goes back to reading in update().  Set it while not playing.
+	void readAhead(int16_t *buffer, uint32_t samples) {
+		ring = buffer;
+		ring_size = buffer ? samples - samples % AUDIO_BLOCK_SAMPLES : 0;
+		if (!ring_size) ring = NULL;
+	}
+	// top up the read-ahead ring from the file; call often from loop()
+	void refill(void);
+	// blocks played short because the ring ran dry
+	uint32_t underruns(void) { return underrun_count; }
 	virtual void update(void);
 private:
+	bool rewind(void);
 	File rawfile;
 	uint32_t file_size;
+	uint32_t data_start;            // bytes before the first sample
 	volatile uint32_t file_offset;
 	volatile bool playing;
+	bool looping;
+	bool file_open;                 // still to be closed (read-ahead)
+	volatile bool file_done;        // everything to be played is in the ring
+	uint32_t loop_start;            // samples
+	uint32_t loop_end;
+	int16_t *ring;
+	uint32_t ring_size;             // samples
+	volatile uint32_t ring_in;      // samples written, free running
+	volatile uint32_t ring_out;     // samples played, free running
+	volatile uint32_t underrun_count;
 };
 
 #endif
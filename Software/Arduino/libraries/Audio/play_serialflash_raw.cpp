@@ -34,6 +34,8 @@ void AudioPlaySerialflashRaw::begin(void)
 	playing = false;
 	file_offset = 0;
 	file_size = 0;
+	data_start = 0;
+	looping = false;
 }
 
 
@@ -48,12 +50,29 @@ bool AudioPlaySerialflashRaw::play(const char *filename)
 		return false;
 	}
 	file_size = rawfile.size();
+	data_start = 0;
 	file_offset = 0;
 	//Serial.println("able to open file");
 	playing = true;
 	return true;
 }
 
+bool AudioPlaySerialflashRaw::play(const SerialFlashFile &file, uint32_t length, uint32_t offset)
+{
+	stop();
+	rawfile = file;
+	if (!rawfile) return false;
+	AudioStartUsingSPI();
+	file_size = rawfile.size();
+	if (length && length < file_size) file_size = length;
+	if (offset > file_size) offset = file_size;
+	data_start = offset;
+	file_offset = offset;
+	rawfile.seek(offset);
+	playing = true;
+	return true;
+}
+
 void AudioPlaySerialflashRaw::stop(void)
 {
 	__disable_irq();
@@ -80,10 +99,24 @@ void AudioPlaySerialflashRaw::update(void)
 	block = allocate();
 	if (block == NULL) return;
 
-	if (rawfile.available()) {
+	n = 0;
+	while (n < AUDIO_BLOCK_SAMPLES*2) {
+		uint32_t pos = file_offset;
+		if (pos + 2 > file_size) {
+			if (!looping || file_size < data_start + 2) break;
+			rawfile.seek(data_start);
+			file_offset = data_start;
+			continue;
+		}
+		uint32_t want = AUDIO_BLOCK_SAMPLES*2 - n;
+		if (want > file_size - pos) want = file_size - pos;
+		uint32_t r = rawfile.read((uint8_t *)block->data + n, want);
+		if (r == 0) break;
+		n += r;
+		file_offset = pos + r;
+	}
+	if (n) {
 		// we can read more data from the file...
-		n = rawfile.read(block->data, AUDIO_BLOCK_SAMPLES*2);
-		file_offset += n;
 		for (i=n/2; i < AUDIO_BLOCK_SAMPLES; i++) {
 			block->data[i] = 0;
 		}
@@ -101,12 +134,12 @@ void AudioPlaySerialflashRaw::update(void)
 
 uint32_t AudioPlaySerialflashRaw::positionMillis(void)
 {
-	return ((uint64_t)file_offset * B2M) >> 32;
+	return ((uint64_t)(file_offset - data_start) * B2M) >> 32;
 }
 
 uint32_t AudioPlaySerialflashRaw::lengthMillis(void)
 {
-	return ((uint64_t)file_size * B2M) >> 32;
+	return ((uint64_t)(file_size - data_start) * B2M) >> 32;
 }
 
 
@@ -32,22 +32,34 @@
 #include <AudioStream.h>
 #include <SerialFlash.h>
 
+// Plays 16 bit mono samples from a file in SPI flash.  A flash read has no
+// seek or cluster latency, so a file opened once and kept can be started at
+// any time by play(file), which skips the directory search of play(name).
+// The samples can start past a header: give their byte offset to play(file).
+
 class AudioPlaySerialflashRaw : public AudioStream
 {
 public:
 	AudioPlaySerialflashRaw(void) : AudioStream(0, NULL) { begin(); }
 	void begin(void);
 	bool play(const char *filename);
+	// play an already open file, only its first length bytes if not 0, from
+	// byte offset on (looping goes back there too)
+	bool play(const SerialFlashFile &file, uint32_t length = 0, uint32_t offset = 0);
 	void stop(void);
 	bool isPlaying(void) { return playing; }
 	uint32_t positionMillis(void);
 	uint32_t lengthMillis(void);
+	// repeat from the start when the end is reached
+	void loop(bool on) { looping = on; }
 	virtual void update(void);
 private:
 	SerialFlashFile rawfile;
 	uint32_t file_size;
+	uint32_t data_start;            // bytes before the first sample
 	volatile uint32_t file_offset;
 	volatile bool playing;
+	bool looping;
 };
 
 #endif
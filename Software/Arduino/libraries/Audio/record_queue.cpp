@@ -34,6 +34,7 @@ int AudioRecordQueue::available(void)
 
 	h = head;
 	t = tail;
+	if (h == t) unread = 0;
 	if (h >= t) return h - t;
 	return 53 + h - t;
 }
@@ -64,6 +65,7 @@ int16_t * AudioRecordQueue::readBuffer(void)
 	if (++t >= 53) t = 0;
 	userblock = queue[t];
 	tail = t;
+	unread = 0;
 	return userblock->data;
 }
 
@@ -89,10 +91,15 @@ void AudioRecordQueue::update(void)
 	if (h >= 53) h = 0;
 	if (h == tail) {
 		release(block);
+		dropped++;
 	} else {
 		queue[h] = block;
 		head = h;
+		queued++;
+		h = (h >= tail) ? h - tail : 53 + h - tail;
+		if (h > highwater) highwater = h;
 	}
+	if (head != tail && ++unread > unreadMax) unreadMax = unread;
 }
 
 
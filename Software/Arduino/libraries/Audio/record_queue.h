@@ -34,9 +34,10 @@ class AudioRecordQueue : public AudioStream
 {
 public:
 	AudioRecordQueue(void) : AudioStream(1, inputQueueArray),
-		userblock(NULL), head(0), tail(0), enabled(0) { }
+		userblock(NULL), head(0), tail(0), enabled(0), ratio(1) { statisticsReset(); }
 	void begin(void) {
 		clear();
+		statisticsReset();
 		enabled = 1;
 	}
 	int available(void);
@@ -46,12 +47,31 @@ public:
 	void end(void) {
 		enabled = 0;
 	}
+	// fed by an AudioEffectDecimate of ratio n: each block then holds n
+	// block periods of sound, and the queue n times as long
+	void decimation(int n) { ratio = n < 1 ? 1 : n; }
+	int decimation(void) { return ratio; }
+	// statistics since begin(): blocks queued, blocks lost because the
+	// queue was full, most blocks waiting at once, and the longest time
+	// (in blocks, 2.9 ms each times decimation()) the queue held data
+	// without being read
+	uint32_t blocksQueued(void) { return queued; }
+	uint32_t blocksDropped(void) { return dropped; }
+	int highWaterMark(void) { return highwater; }
+	uint32_t drainIntervalMax(void) { return unreadMax; }
+	void statisticsReset(void) {
+		queued = dropped = unread = unreadMax = 0;
+		highwater = 0;
+	}
 	virtual void update(void);
 private:
 	audio_block_t *inputQueueArray[1];
 	audio_block_t * volatile queue[53];
 	audio_block_t *userblock;
 	volatile uint8_t head, tail, enabled;
+	uint8_t ratio;
+	volatile uint8_t highwater;
+	volatile uint32_t queued, dropped, unread, unreadMax;
 };
 
 #endif
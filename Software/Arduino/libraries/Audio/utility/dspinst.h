@@ -29,6 +29,11 @@
 
 #include <stdint.h>
 
+#if defined(AUDIO_HOST_SIMULATION)
+// host (Linux) builds of the sketch use portable equivalents
+#include "dspinst_host.h"
+#else
+
 // computes limit((val >> rshift), 2**bits)
 static inline int32_t signed_saturate_rshift(int32_t val, int bits, int rshift) __attribute__((always_inline, unused));
 static inline int32_t signed_saturate_rshift(int32_t val, int bits, int rshift)
@@ -351,4 +356,6 @@ static inline void clr_q_psr(void)
        "msr APSR_nzcvq,%0\n" : [t] "=&r" (t)::"cc"); 
 }
 
+#endif // AUDIO_HOST_SIMULATION
+
 #endif
@@ -143,6 +143,21 @@ void File::close() {
   }
 }
 
+boolean File::contiguousRange(uint32_t *bgnBlock, uint32_t *endBlock) {
+  if (! _file) return false;
+  return _file->contiguousRange(bgnBlock, endBlock);
+}
+
+boolean File::truncate(uint32_t length) {
+  if (! _file) return false;
+  return _file->truncate(length);
+}
+
+uint32_t File::firstCluster(void) {
+  if (! _file) return 0;
+  return _file->firstCluster();
+}
+
 File::operator bool() {
   if (_file) 
     return  _file->isOpen();
@@ -556,6 +556,42 @@ boolean SDClass::remove(const char *filepath) {
   return walkPath(filepath, root, callback_remove);
 }
 
+File SDClass::createContiguous(const char *filepath, uint32_t size) {
+  /*
+
+     Create a file of `size` bytes whose clusters are consecutive on the
+     card, so it can be filled with `writeBlocks` without any FAT or
+     directory updates.  The file is left open for writing; its length is
+     `size` until it is truncated.
+
+   */
+  int pathidx;
+
+  SdFile parentdir = getParentDir(filepath, &pathidx);
+  filepath += pathidx;
+
+  if (! filepath[0] || !parentdir.isOpen())
+    return File();
+
+  SdFile file;
+  if ( ! file.createContiguous(&parentdir, filepath, size)) {
+    return File();
+  }
+  parentdir.close();
+  return File(file, filepath);
+}
+
+boolean SDClass::writeBlocks(uint32_t block, const uint8_t *src, uint16_t count) {
+  if (!card.writeStart(block, count)) return false;
+  for (uint16_t i = 0; i < count; i++) {
+    if (!card.writeData(src + 512 * i)) {
+      card.writeStop();     // take the card out of the write before giving up
+      return false;
+    }
+  }
+  return card.writeStop();
+}
+
 
 // allows you to recurse into a directory
 File File::openNextFile(uint8_t mode) {
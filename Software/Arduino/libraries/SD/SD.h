@@ -52,6 +52,15 @@ public:
   boolean isDirectory(void);
   File openNextFile(uint8_t mode = O_RDONLY);
   void rewindDirectory(void);
+
+  // For files made by SD.createContiguous(): the raw block range the
+  // file occupies, and shrinking it to the length actually used.
+  boolean contiguousRange(uint32_t *bgnBlock, uint32_t *endBlock);
+  boolean truncate(uint32_t length);
+
+  // First cluster of the file's data, 0 for an empty file.  A file that
+  // is rewritten usually moves, so this tells a changed file from its name.
+  uint32_t firstCluster(void);
   
   using Print::write;
 };
@@ -88,6 +97,15 @@ public:
   
   boolean rmdir(const char *filepath);
 
+  // Create a new file of `size` bytes in consecutive clusters, opened for
+  // writing.  Fails if the file exists or no contiguous space is free.
+  File createContiguous(const char *filepath, uint32_t size);
+
+  // Write `count` 512 byte blocks starting at raw card block `block` in
+  // one multiple block transfer.  Bypasses the FAT and block cache: only
+  // use it inside a range from File::contiguousRange().
+  boolean writeBlocks(uint32_t block, const uint8_t *src, uint16_t count);
+
 private:
 
   // This is used to determine the mode used to open a file
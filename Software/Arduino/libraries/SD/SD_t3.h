@@ -27,10 +27,11 @@
 // This Teensy 3.x optimized version is a work-in-progress.
 //
 // Uncomment this line to use the Teensy version, which completely replaces
-// all of the normal Arduino SD library code.  The optimized version is
-// currently read-only.  It CAN NOT WRITE ANYTHING TO YOUR SD CARD.  However,
-// it is *much* faster for reading more than 1 file at a time, especially for
-// the Teensy Audio Library to play and mix multiple sound files.
+// all of the normal Arduino SD library code.  It is *much* faster for
+// accessing more than 1 file at a time, especially for the Teensy Audio
+// Library to play and mix multiple sound files while recording.  Writing
+// supports 8.3 filenames only (no long names are created), and files can
+// not yet be created in a FAT16 root directory which is already full.
 //
 //#define USE_TEENSY3_OPTIMIZED_CODE
 
@@ -70,16 +71,32 @@ public:
 	static bool mkdir(const char *path);
 	static bool remove(const char *path);
 	static bool rmdir(const char *path);
+	// new file of size bytes in consecutive clusters, open for writing,
+	// which writeBlocks() may fill without any FAT or directory updates
+	static File createContiguous(const char *path, uint32_t size);
+	// multiple block write, bypassing the FAT (cached copies are dropped)
+	static bool writeBlocks(uint32_t lba, const uint8_t *src, uint16_t count);
 private:
 	static uint8_t sd_cmd0();
 	static uint32_t sd_cmd8();
 	static uint8_t sd_acmd41(uint32_t hcs);
 	static uint32_t sd_cmd58();
 	static bool sd_read(uint32_t addr, void * data);
+	static bool sd_write(uint32_t addr, const void * data);
+	static bool sd_write_start(uint32_t addr, uint32_t count);
+	static bool sd_write_data(const void * data);
+	static bool sd_write_stop();
+	static bool send_data(uint8_t token, const void * data);
+	static bool wait_ready();
 	static void send_cmd(uint16_t cmd, uint32_t arg);
 	static uint8_t recv_r1();
 	static uint32_t recv_r3_or_r7();
 	static void end_cmd();
+	static void fat_time(uint16_t *date, uint16_t *time);
+	static uint32_t fat_read(uint32_t cluster);
+	static bool fat_write(uint32_t cluster, uint32_t value);
+	static uint32_t alloc_clusters(uint32_t prev, uint32_t count);
+	static bool free_chain(uint32_t cluster);
 	static volatile IO_REG_TYPE * csreg;
 	static IO_REG_TYPE csmask;
 	static uint8_t card_type; // 1=SDv1, 2=SDv2, 3=SDHC
@@ -90,6 +107,8 @@ private:
 	static uint32_t max_cluster;
 	static uint8_t sector2cluster;
 	static uint8_t fat_type;
+	static uint32_t fsinfo_lba;     // FAT32 free cluster info, 0 if none
+	static uint32_t free_hint;      // where to start looking for free clusters
 	friend class SDCache;
 	friend class File;
 	typedef struct {
@@ -137,6 +156,8 @@ private:
 #define ATTR_ARCHIVE    0x20
 #define ATTR_LONG_NAME  0x0F
 
+#define FAT_END_OF_CHAIN  0x0FFFFFFF  // also 0xFFFF when stored in FAT16
+
 class File : public Stream
 {
 public:
@@ -166,6 +187,14 @@ public:
 	char * name() {
 		return namestr;
 	}
+	bool truncate(uint32_t size);
+	// for files made by SD.createContiguous(): first & last sector
+	bool contiguousRange(uint32_t *first_lba, uint32_t *last_lba);
+	// first cluster of the data, 0 for an empty file
+	uint32_t firstCluster() {
+		if (type <= FILE_WRITE) return start_cluster;
+		return 0;
+	}
 	bool isDirectory() {
 		return (type == FILE_DIR) || (type == FILE_DIR_ROOT16);
 	}
@@ -179,16 +208,20 @@ public:
 		current_cluster = start_cluster;
 	};
 private:
-	bool find(const char *filename, File *found);
+	bool find(const char *filename, File *found, char *name83 = NULL);
+	bool create(const char *name83, File *found);
 	void init(SDClass::fatdir_t *dirent);
 	bool next_cluster();
+	bool update_dirent();
 	uint32_t offset;          // position within file (EOF = length)
 	uint32_t length;          // total size of file
 	uint32_t start_cluster;   // first cluster for the file
-	uint32_t current_cluster; // position (must agree w/ offset)
+	uint32_t current_cluster; // position (must agree w/ offset, which at
+	                          //  a cluster boundary means the prior cluster)
 	uint32_t dirent_lba;      // dir sector for this file
 	uint8_t  dirent_index;    // dir index within sector (0 to 15)
 	uint8_t type;             // file vs dir
+	bool modified;            // size or first cluster not yet in dirent
 	char namestr[13];
 	friend class SDClass;
 	static inline uint32_t cluster_number(uint32_t n) {
@@ -204,6 +237,10 @@ private:
 	static inline bool is_new_cluster(uint32_t lba) {
 		return (lba & ((1 << SDClass::sector2cluster) - 1)) == 0;
 	}
+	// index of the cluster current_cluster refers to at position n
+	static inline uint32_t cluster_index(uint32_t n) {
+		return n ? cluster_number(n - 1) : 0;
+	}
 };
 
 class SDCache
@@ -227,10 +264,15 @@ private:
 	} cache_t;
 	SDClass::sector_t * read(uint32_t lba, bool is_fat=false);
 	bool read(uint32_t lba, void *buffer);
+	SDClass::sector_t * alloc(uint32_t lba);
+	bool write(uint32_t lba, const void *buffer);
 	cache_t * get(uint32_t lba, bool allocate=true);
 	void dirty(void);
-	void flush(void);
+	bool flush(void);
 	void release(void);
+	static bool flush_all(void);
+	static void invalidate(uint32_t lba, uint32_t count);
+	static bool write_back(cache_t *c);
 	cache_t * item;
 	static cache_t *cache_list;
 	static cache_t cache[SD_CACHE_SIZE];
@@ -38,6 +38,11 @@ cache_t SDCache::cache[SD_CACHE_SIZE];
 #define CACHE_FLAG_IS_DIRTY  2
 #define CACHE_FLAG_IS_FAT    4
 
+// Dirty sectors are written back when evicted, but that's slow inside an
+// interrupt.  Writers keep this many or fewer dirty, so readers (the audio
+// library playing files) always find clean entries to reuse.
+#define SD_CACHE_DIRTY_MAX  (SD_CACHE_SIZE - 4)
+
 //#define PRINT_SECTORS
 
 #ifdef PRINT_SECTORS
@@ -131,10 +136,12 @@ bool SDCache::read(uint32_t lba, void *buffer)
 }
 
 
-// locate a sector in the cache.
+// locate a sector in the cache.  A dirty entry is only reused after
+// it has been written back; if that fails it stays dirty, and NULL is
+// returned.  Must be called within an SPI transaction.
 cache_t * SDCache::get(uint32_t lba, bool allocate)
 {
-	cache_t *c, *p=NULL, *last=NULL, *plast=NULL;
+	cache_t *c, *p, *last, *plast, *dlast;
 
 	// TODO: move initialization to a function called when the SD card is initialized
 	if (cache_list == NULL) init();
@@ -145,6 +152,8 @@ cache_t * SDCache::get(uint32_t lba, bool allocate)
 		// if not, release our hold on it
 		release();
 	}
+retry:
+	p = last = plast = dlast = NULL;
 	__disable_irq();
 	c = cache_list;
 	do {
@@ -160,12 +169,24 @@ cache_t * SDCache::get(uint32_t lba, bool allocate)
 			return item;
 		}
 		if (c->usagecount == 0) {
-			plast = p;
-			last = c;
+			if (c->flags & CACHE_FLAG_IS_DIRTY) {
+				dlast = c;
+			} else {
+				plast = p;
+				last = c;
+			}
 		}
 		p = c;
 		c = c->next;
 	} while (c);
+	if (allocate && !last && dlast) {
+		// only dirty sectors are free: write the oldest back while it
+		// still holds its own sector, then look again, as interrupts
+		// may have used the cache meanwhile
+		__enable_irq();
+		if (!write_back(dlast)) return NULL;
+		goto retry;
+	}
 	if (allocate && last) {
 		if (plast) {
 			plast->next = last->next;
@@ -173,15 +194,101 @@ cache_t * SDCache::get(uint32_t lba, bool allocate)
 			cache_list = last;
 		}
 		last->usagecount = 1;
-		// TODO: flush if dirty
+		item = last;
 		last->lba = lba;
 		last->flags = 0;
-		item = last;
 	}
 	__enable_irq();
 	return item;
 }
 
+// Get a sector which is about to be completely overwritten.  No
+// read is needed if it isn't already cached.  Use dirty() after
+// writing to it.
+//
+sector_t * SDCache::alloc(uint32_t lba)
+{
+	SPI.beginTransaction(SD_SPI_SPEED);
+	cache_t *c = get(lba);
+	if (c && !(c->flags & CACHE_FLAG_HAS_DATA)) {
+		memset(&c->data, 0, 512);
+		c->flags = CACHE_FLAG_HAS_DATA;
+	}
+	SPI.endTransaction();
+	return c ? &c->data : NULL;
+}
+
+// Write a whole 512 byte sector directly to the card.  A cached
+// copy is updated (and is no longer dirty), otherwise the cache
+// is bypassed.
+//
+bool SDCache::write(uint32_t lba, const void *buffer)
+{
+	SPI.beginTransaction(SD_SPI_SPEED);
+	cache_t *c = get(lba, false);
+	if (c) {
+		memcpy(&c->data, buffer, 512);
+		c->flags = (c->flags & CACHE_FLAG_IS_FAT) | CACHE_FLAG_HAS_DATA;
+	}
+	bool ret = SDClass::sd_write(lba, buffer);
+	SPI.endTransaction();
+	release();
+	return ret;
+}
+
+// Write a dirty sector to the card, and to the second FAT if it's
+// part of the first.  Must be called within an SPI transaction.
+//
+bool SDCache::write_back(cache_t *c)
+{
+	__disable_irq();
+	if (!(c->flags & CACHE_FLAG_IS_DIRTY)) {
+		__enable_irq();
+		return true;
+	}
+	c->usagecount++;
+	c->flags &= ~CACHE_FLAG_IS_DIRTY;
+	__enable_irq();
+	//Serial.printf("write back, lba=%u\n", c->lba);
+	bool ret = SDClass::sd_write(c->lba, &c->data);
+	if (ret && (c->flags & CACHE_FLAG_IS_FAT)) {
+		ret = SDClass::sd_write(c->lba - SDClass::fat1_begin_lba
+			+ SDClass::fat2_begin_lba, &c->data);
+	}
+	__disable_irq();
+	if (!ret) c->flags |= CACHE_FLAG_IS_DIRTY;
+	c->usagecount--;
+	__enable_irq();
+	return ret;
+}
+
+// Write all dirty sectors to the card.
+bool SDCache::flush_all(void)
+{
+	bool ret = true;
+	if (cache_list == NULL) return true;
+	SPI.beginTransaction(SD_SPI_SPEED);
+	for (cache_t *c = cache; c < cache + SD_CACHE_SIZE; c++) {
+		if (!write_back(c)) ret = false;
+	}
+	SPI.endTransaction();
+	return ret;
+}
+
+// Forget cached copies of sectors written without the cache.
+void SDCache::invalidate(uint32_t lba, uint32_t count)
+{
+	if (cache_list == NULL) return;
+	__disable_irq();
+	for (cache_t *c = cache; c < cache + SD_CACHE_SIZE; c++) {
+		if (c->lba - lba < count && c->usagecount == 0) {
+			c->lba = 0xFFFFFFFF;
+			c->flags = 0;
+		}
+	}
+	__enable_irq();
+}
+
 
 void SDCache::init(void)
 {
@@ -203,11 +310,43 @@ void SDCache::init(void)
 }
 
 
+// Mark our sector as modified.  If too many others are already
+// dirty, the oldest of them are written back.
 void SDCache::dirty(void)
 {
+	cache_t *c, *oldest;
+	uint32_t count;
+
 	__disable_irq();
 	item->flags |= CACHE_FLAG_IS_DIRTY;
 	__enable_irq();
+	while (1) {
+		count = 0;
+		oldest = NULL;
+		__disable_irq();
+		for (c = cache_list; c; c = c->next) {
+			if (c != item && (c->flags & CACHE_FLAG_IS_DIRTY)) {
+				count++;
+				if (c->usagecount == 0) oldest = c;
+			}
+		}
+		__enable_irq();
+		if (count < SD_CACHE_DIRTY_MAX || !oldest) return;
+		SPI.beginTransaction(SD_SPI_SPEED);
+		bool ok = write_back(oldest);
+		SPI.endTransaction();
+		if (!ok) return;
+	}
+}
+
+// Write our sector now, if it's dirty.
+bool SDCache::flush(void)
+{
+	if (!item) return true;
+	SPI.beginTransaction(SD_SPI_SPEED);
+	bool ret = write_back(item);
+	SPI.endTransaction();
+	return ret;
 }
 
 void SDCache::release(void)
@@ -41,6 +41,12 @@ uint8_t SDClass::card_type;
 #define CMD58_READ_OCR            0x7AFF
 #define CMD17_READ_SINGLE_BLOCK   0x51FF
 #define CMD24_WRITE_BLOCK         0x58FF
+#define CMD25_WRITE_MULTIPLE      0x59FF
+#define ACMD23_SET_WR_BLK_ERASE   0x57FF
+
+#define TOKEN_WRITE_SINGLE        0xFE
+#define TOKEN_WRITE_MULTIPLE      0xFC
+#define TOKEN_STOP_TRANSMISSION   0xFD
 
 
 uint8_t SDClass::sd_cmd0()
@@ -133,6 +139,108 @@ bool SDClass::sd_read(uint32_t addr, void * data)
 	// crc, 2 bytes
 }
 
+// All writes are called with the SPI transaction already begun, so
+// an audio library interrupt using SPI.usingInterrupt() can not read
+// (from the cache or the card) in the middle of one.
+
+bool SDClass::sd_write(uint32_t addr, const void * data)
+{
+	//Serial.printf("sd_write %ld\n", addr);
+	if (card_type < 2) addr = addr << 9;
+	send_cmd(CMD24_WRITE_BLOCK, addr);
+	uint8_t r1 = recv_r1();
+	if (r1 != 0) {
+		end_cmd();
+		return false;
+	}
+	bool ret = send_data(TOKEN_WRITE_SINGLE, data) && wait_ready();
+	end_cmd();
+	return ret;
+}
+
+// Multiple block write.  The count lets the card pre-erase, but
+// sd_write_stop() may be called after fewer blocks, and must be
+// called (ending the transfer) even if sd_write_data() failed.
+bool SDClass::sd_write_start(uint32_t addr, uint32_t count)
+{
+	if (card_type < 2) {
+		addr = addr << 9;
+	} else {
+		send_cmd(CMD55_APP_CMD, 0);
+		recv_r1();
+		end_cmd();
+		send_cmd(ACMD23_SET_WR_BLK_ERASE, count);
+		recv_r1();
+		end_cmd();
+	}
+	send_cmd(CMD25_WRITE_MULTIPLE, addr);
+	uint8_t r1 = recv_r1();
+	if (r1 != 0) {
+		end_cmd();
+		return false;
+	}
+	return true;
+}
+
+bool SDClass::sd_write_data(const void * data)
+{
+	return wait_ready() && send_data(TOKEN_WRITE_MULTIPLE, data);
+}
+
+bool SDClass::sd_write_stop(void)
+{
+	bool ret = wait_ready();
+	SPI.transfer(TOKEN_STOP_TRANSMISSION);
+	SPI.transfer(0xFF);
+	ret = wait_ready() && ret;
+	end_cmd();
+	return ret;
+}
+
+bool SDClass::writeBlocks(uint32_t lba, const uint8_t *src, uint16_t count)
+{
+	SDCache::invalidate(lba, count);
+	SPI.beginTransaction(SD_SPI_SPEED);
+	bool ret = sd_write_start(lba, count);
+	if (ret) {
+		for (uint16_t i=0; i < count; i++) {
+			if (!sd_write_data(src)) {
+				ret = false;
+				break;
+			}
+			src += 512;
+		}
+		ret = sd_write_stop() && ret;
+	}
+	SPI.endTransaction();
+	return ret;
+}
+
+bool SDClass::send_data(uint8_t token, const void * data)
+{
+	const uint8_t *p = (const uint8_t *)data;
+	const uint8_t *end = p + 512;
+	SPI.transfer(token);
+	while (p < end) {
+		SPI.transfer16((p[0] << 8) | p[1]);
+		p += 2;
+	}
+	SPI.transfer16(0xFFFF); // dummy crc
+	uint8_t response = SPI.transfer(0xFF);
+	//Serial.printf("data response = %02X\n", response);
+	return (response & 0x1F) == 0x05; // data accepted
+}
+
+// the card holds its data out low while busy programming
+bool SDClass::wait_ready(void)
+{
+	elapsedMillis msec = 0;
+	while (SPI.transfer(0xFF) != 0xFF) {
+		if (msec > 500) return false;
+	}
+	return true;
+}
+
 
 void SDClass::send_cmd(uint16_t cmd, uint32_t arg)
 {
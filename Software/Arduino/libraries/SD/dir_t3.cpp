@@ -34,6 +34,7 @@
 File SDClass::open(const char *path, uint8_t mode)
 {
 	File ret, parent = rootDir;
+	char name83[11];
 
 	//Serial.print("SD.open: ");
 	//Serial.println(path);
@@ -45,7 +46,7 @@ File SDClass::open(const char *path, uint8_t mode)
 			break;
 		}
 		File next;
-		bool found = parent.find(path, &next);
+		bool found = parent.find(path, &next, name83);
 		const char *p = path;
 		do p++; while (*p != '/' && *p != 0);
 		if (found) {
@@ -64,13 +65,80 @@ File SDClass::open(const char *path, uint8_t mode)
 			if (*p == '/') break; // subdir doesn't exist
 			// file doesn't exist
 			if (mode == FILE_READ) break;
-			// TODO: for writing, create the file
+			// for writing, create the file
+			if (parent.create(name83, &next)) ret = next;
 			break;
 		}
 	}
+	if (mode == FILE_WRITE && ret.type == FILE_READ) {
+		// existing files are appended
+		ret.type = FILE_WRITE;
+		ret.seek(ret.length);
+	}
 	return ret;
 }
 
+File SDClass::createContiguous(const char *path, uint32_t size)
+{
+	if (exists(path)) return File();
+	File f = open(path, FILE_WRITE);
+	if (!f || size == 0) return f;
+	uint32_t cluster = alloc_clusters(0, File::cluster_number(size - 1) + 1);
+	if (!cluster) {
+		f.close();
+		remove(path);
+		return File();
+	}
+	f.start_cluster = f.current_cluster = cluster;
+	f.length = size;
+	f.modified = true;
+	f.flush();
+	return f;
+}
+
+bool SDClass::remove(const char *path)
+{
+	File f = open(path);
+	if (f.type != FILE_READ) return false; // directories not removed
+	if (!free_chain(f.start_cluster)) return false;
+	do {
+		SDCache dir;
+		sector_t *s = dir.read(f.dirent_lba);
+		if (!s) return false;
+		s->dir[f.dirent_index].name[0] = 0xE5;
+		dir.dirty();
+	} while (0);
+	return SDCache::flush_all();
+}
+
+// Current RTC time, in FAT directory format
+void SDClass::fat_time(uint16_t *date, uint16_t *time)
+{
+#if defined(KINETISK)
+	uint32_t t = rtc_get();
+#else
+	uint32_t t = 0; // no RTC on Teensy-LC
+#endif
+	uint32_t secs = t % 86400;
+	// days since 1970 to year, month, day
+	uint32_t z = t / 86400 + 719468;
+	uint32_t era = z / 146097;
+	uint32_t doe = z - era * 146097;
+	uint32_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+	uint32_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+	uint32_t mp = (5 * doy + 2) / 153;
+	uint32_t day = doy - (153 * mp + 2) / 5 + 1;
+	uint32_t month = mp < 10 ? mp + 3 : mp - 9;
+	uint32_t year = yoe + era * 400 + (month <= 2);
+	if (year < 1980) {
+		year = 1980;
+		month = 1;
+		day = 1;
+	}
+	*date = ((year - 1980) << 9) | (month << 5) | day;
+	*time = ((secs / 3600) << 11) | (((secs / 60) % 60) << 5) | ((secs % 60) >> 1);
+}
+
 bool SDClass::exists(const char *path)
 {
 	File f = open(path);
@@ -123,6 +191,8 @@ File File::openNextFile(uint8_t mode)
 				if (b0 != 0xE5 && memcmp(dirent->name, ".          ", 11) != 0
 				    && memcmp(dirent->name, "..         ", 11) != 0) {
 					f.init(dirent);
+					f.dirent_lba = lba;
+					f.dirent_index = sector_index;
 					sector.release();
 					offset += 32;
 					if (cluster_offset(offset) == 0) {
@@ -151,16 +221,20 @@ File File::openNextFile(uint8_t mode)
 }
 
 
-bool File::find(const char *filename, File *found)
+// Search a directory for a file.  If it's not found, the first unused
+// entry (dirent_lba = 0 if none) is left in found, for creating it.
+bool File::find(const char *filename, File *found, char *name83)
 {
 	bool find_unused = true;
-	char name83[11];
+	char buf83[11];
 	uint32_t lba, sector_count;
 
 	//Serial.println("File::open");
 
 	const char *f = filename;
 	if (*f == 0) return false;
+	if (!name83) name83 = buf83;
+	found->dirent_lba = 0;
 	char *p = name83;
 	while (p < name83 + 11) {
 		char c = *f++;
@@ -205,6 +279,8 @@ bool File::find(const char *filename, File *found)
 				if (memcmp(dirent->name, name83, 11) == 0) {
 					//Serial.printf("found 8.3, j=%d\n", j);
 					found->init(dirent);
+					found->dirent_lba = lba;
+					found->dirent_index = j;
 					return true;
 				}
 				uint8_t b0 = dirent->name[0];
@@ -227,6 +303,43 @@ bool File::find(const char *filename, File *found)
 	return false;
 }
 
+// Add a new, empty file to this directory, at the unused entry
+// which find() left in found.
+bool File::create(const char *name83, File *found)
+{
+	if (found->dirent_lba == 0) {
+		// directory full, give it another cluster
+		if (type != FILE_DIR) return false;
+		uint32_t cluster = SDClass::alloc_clusters(current_cluster, 1);
+		if (!cluster) return false;
+		sector_t zero;
+		memset(&zero, 0, 512);
+		uint32_t lba = custer_to_sector(cluster);
+		for (uint32_t i=0; i < (1u << SDClass::sector2cluster); i++) {
+			SDCache sector;
+			if (!sector.write(lba + i, &zero)) return false;
+		}
+		found->dirent_lba = lba;
+		found->dirent_index = 0;
+	}
+	do {
+		SDCache sector;
+		sector_t *s = sector.read(found->dirent_lba);
+		if (!s) return false;
+		fatdir_t *dirent = s->dir + found->dirent_index;
+		memset(dirent, 0, sizeof(fatdir_t));
+		memcpy(dirent->name, name83, 11);
+		dirent->attrib = ATTR_ARCHIVE;
+		SDClass::fat_time(&dirent->cdate, &dirent->ctime);
+		dirent->wdate = dirent->adate = dirent->cdate;
+		dirent->wtime = dirent->ctime;
+		found->init(dirent);
+		found->type = FILE_WRITE;
+		sector.dirty();
+	} while (0);
+	return SDCache::flush_all();
+}
+
 void File::init(fatdir_t *dirent)
 {
 	offset = 0;
@@ -234,6 +347,7 @@ void File::init(fatdir_t *dirent)
 	start_cluster = (dirent->cluster_high << 16) | dirent->cluster_low;
 	current_cluster = start_cluster;
 	type = (dirent->attrib & ATTR_DIRECTORY) ? FILE_DIR : FILE_READ;
+	modified = false;
 	char *p = namestr;
 	const char *s = dirent->name;
 	for (int i=0; i < 8; i++) {
@@ -28,6 +28,13 @@
 #include "SD_t3.h"
 #ifdef USE_TEENSY3_OPTIMIZED_CODE
 
+#define sector_t SDClass::sector_t
+
+#define FAT_READ_ERROR    0xFFFFFFFF
+
+// Advance to the next cluster of the chain.  At the end of the
+// chain (or on error) false is returned and current_cluster is
+// left unchanged, so writing can add a new cluster after it.
 bool File::next_cluster()
 {
 	SDCache fat;
@@ -54,8 +61,118 @@ bool File::next_cluster()
 	//Serial.println();
 	//Serial.println("****************************************");
 	//Serial.println();
+	if (cluster < 2 || cluster > SDClass::max_cluster) return false;
 	current_cluster = cluster;
-	if (cluster > SDClass::max_cluster) return false;
+	return true;
+}
+
+uint32_t SDClass::fat_read(uint32_t cluster)
+{
+	SDCache fat;
+
+	if (fat_type == 16) {
+		sector_t *s = fat.read(fat1_begin_lba + (cluster >> 8), true);
+		if (!s) return FAT_READ_ERROR;
+		return s->u16[cluster & 255];
+	} else {
+		sector_t *s = fat.read(fat1_begin_lba + (cluster >> 7), true);
+		if (!s) return FAT_READ_ERROR;
+		return s->u32[cluster & 127] & 0x0FFFFFFF;
+	}
+}
+
+// Change a FAT entry.  Only the first FAT is cached; both copies
+// are written when the sector is written back.  A single 16 or 32
+// bit store updates the entry, so interrupts reading files see
+// either the old or new chain, never a partial one.
+bool SDClass::fat_write(uint32_t cluster, uint32_t value)
+{
+	SDCache fat;
+
+	//Serial.printf("fat_write %u = %u\n", cluster, value);
+	if (fat_type == 16) {
+		sector_t *s = fat.read(fat1_begin_lba + (cluster >> 8), true);
+		if (!s) return false;
+		s->u16[cluster & 255] = value;
+	} else {
+		sector_t *s = fat.read(fat1_begin_lba + (cluster >> 7), true);
+		if (!s) return false;
+		uint32_t *p = s->u32 + (cluster & 127);
+		*p = (*p & 0xF0000000) | (value & 0x0FFFFFFF);
+	}
+	fat.dirty();
+	return true;
+}
+
+// Allocate count consecutive free clusters, linked as a chain and
+// appended to the prev cluster (0 for a new chain).  Returns the
+// first new cluster, or 0 if the card is full (or too fragmented).
+uint32_t SDClass::alloc_clusters(uint32_t prev, uint32_t count)
+{
+	uint32_t cluster, first=0, run=0, remaining, mask;
+
+	if (count == 0) return 0;
+	mask = (fat_type == 16) ? 255 : 127;
+	cluster = (count == 1) ? free_hint : 2;
+	if (cluster < 2 || cluster > max_cluster) cluster = 2;
+	remaining = max_cluster - 1;
+	while (1) {
+		if (remaining == 0) return 0;
+		if (cluster > max_cluster) {
+			cluster = 2;
+			run = 0;
+		}
+		SDCache fat;
+		sector_t *s = fat.read(fat1_begin_lba + (cluster >> (fat_type == 16 ? 8 : 7)), true);
+		if (!s) return 0;
+		do {
+			uint32_t entry;
+			if (fat_type == 16) {
+				entry = s->u16[cluster & mask];
+			} else {
+				entry = s->u32[cluster & mask] & 0x0FFFFFFF;
+			}
+			if (entry == 0) {
+				if (run++ == 0) first = cluster;
+				if (run == count) goto found;
+			} else {
+				run = 0;
+			}
+			cluster++;
+			remaining--;
+		} while (remaining > 0 && (cluster & mask) != 0 && cluster <= max_cluster);
+	}
+found:
+	//Serial.printf("alloc %u clusters at %u\n", count, first);
+	for (cluster = first; cluster < first + count - 1; cluster++) {
+		if (!fat_write(cluster, cluster + 1)) return 0;
+	}
+	if (!fat_write(cluster, FAT_END_OF_CHAIN)) return 0;
+	if (prev && !fat_write(prev, first)) return 0;
+	free_hint = first + count;
+	if (fsinfo_lba) {
+		// the free cluster count is now unknown, rather than wrong
+		SDCache info;
+		sector_t *s = info.read(fsinfo_lba);
+		if (s && s->u32[0] == 0x41615252 && s->u32[121] == 0x61417272) {
+			s->u32[122] = 0xFFFFFFFF;
+			s->u32[123] = 0xFFFFFFFF;
+			info.dirty();
+		}
+		fsinfo_lba = 0;
+	}
+	return first;
+}
+
+// Return a whole chain of clusters to the free pool.
+bool SDClass::free_chain(uint32_t cluster)
+{
+	while (cluster >= 2 && cluster <= max_cluster) {
+		uint32_t next = fat_read(cluster);
+		if (!fat_write(cluster, 0)) return false;
+		if (cluster < free_hint) free_hint = cluster;
+		cluster = next;
+	}
 	return true;
 }
 
@@ -29,10 +29,12 @@
 #ifdef USE_TEENSY3_OPTIMIZED_CODE
 
 #define sector_t SDClass::sector_t
+#define fatdir_t SDClass::fatdir_t
 
 File::File()
 {
 	type = FILE_INVALID;
+	modified = false;
 	namestr[0] = 0;
 }
 
@@ -52,8 +54,63 @@ size_t File::write(const uint8_t *buf, size_t size)
 		setWriteError();
 		return 0;
 	}
-	// TODO: a lot of work....
-	return 0;
+	size_t count = 0;
+	bool ok = true;
+
+	//Serial.printf(" write %u at %u  (%X)\n", size, offset, offset);
+	while (count < size) {
+		if (start_cluster == 0) {
+			// first data written to an empty file
+			uint32_t cluster = SDClass::alloc_clusters(0, 1);
+			if (!cluster) break;
+			start_cluster = current_cluster = cluster;
+			modified = true;
+		} else if (offset > 0 && cluster_offset(offset) == 0) {
+			if (!next_cluster()) {
+				// end of the chain, add another cluster
+				uint32_t cluster = SDClass::alloc_clusters(current_cluster, 1);
+				if (!cluster) break;
+				current_cluster = cluster;
+			}
+		}
+		uint32_t lba = custer_to_sector(current_cluster) + (cluster_offset(offset) >> 9);
+		uint32_t sindex = offset & 511;
+		uint32_t n = 512 - sindex;
+		if (n > size - count) n = size - count;
+		do {
+			SDCache cache;
+			if (n == 512) {
+				// a full sector goes directly to the card
+				if (!cache.write(lba, buf)) ok = false;
+			} else {
+				sector_t *sector;
+				if (sindex == 0 && offset >= length) {
+					// nothing beyond the end of the file to preserve
+					sector = cache.alloc(lba);
+				} else {
+					sector = cache.read(lba);
+				}
+				if (!sector) {
+					ok = false;
+					break;
+				}
+				memcpy(sector->u8 + sindex, buf, n);
+				cache.dirty();
+				// a completed sector won't change again, write it now
+				if (sindex + n == 512) ok = cache.flush();
+			}
+		} while (0);
+		if (!ok) break;
+		buf += n;
+		offset += n;
+		count += n;
+		if (offset > length) {
+			length = offset;
+			modified = true;
+		}
+	}
+	if (count < size) setWriteError();
+	return count;
 }
 
 int File::read()
@@ -84,9 +141,77 @@ int File::available()
 	return maxsize;
 }
 
+// Write the new size to the directory, and all modified sectors
+// (including the FAT) to the card.
 void File::flush()
 {
+	if (type != FILE_WRITE) return;
+	if (modified) update_dirent();
+	SDCache::flush_all();
+}
+
+bool File::update_dirent()
+{
+	SDCache dir;
+	sector_t *s = dir.read(dirent_lba);
+	if (!s) return false;
+	fatdir_t *dirent = s->dir + dirent_index;
+	dirent->size = length;
+	dirent->cluster_high = start_cluster >> 16;
+	dirent->cluster_low = start_cluster;
+	dirent->attrib |= ATTR_ARCHIVE;
+	SDClass::fat_time(&dirent->wdate, &dirent->wtime);
+	dirent->adate = dirent->wdate;
+	dir.dirty();
+	modified = false;
+	return true;
+}
+
+bool File::truncate(uint32_t size)
+{
+	if (type != FILE_WRITE) return false;
+	if (size > length) return false;
+	// clusters the shorter file still needs
+	uint32_t keep = size ? cluster_number(size - 1) + 1 : 0;
+	if (keep == 0) {
+		if (!SDClass::free_chain(start_cluster)) return false;
+		start_cluster = 0;
+	} else {
+		uint32_t cluster = start_cluster;
+		for (uint32_t i=1; i < keep; i++) {
+			cluster = SDClass::fat_read(cluster);
+			if (cluster < 2 || cluster > SDClass::max_cluster) return false;
+		}
+		uint32_t next = SDClass::fat_read(cluster);
+		if (next >= 2 && next <= SDClass::max_cluster) {
+			if (!SDClass::fat_write(cluster, FAT_END_OF_CHAIN)) return false;
+			if (!SDClass::free_chain(next)) return false;
+		}
+	}
+	length = size;
+	modified = true;
+	if (offset > size) offset = size;
+	uint32_t pos = offset;
+	rewind();
+	seek(pos);
+	flush();
+	return true;
+}
 
+bool File::contiguousRange(uint32_t *first_lba, uint32_t *last_lba)
+{
+	if (type > FILE_WRITE || start_cluster == 0) return false;
+	uint32_t cluster = start_cluster;
+	uint32_t count = cluster_number(length - 1) + 1;
+	if (length == 0) count = 1;
+	for (uint32_t i=1; i < count; i++) {
+		uint32_t next = SDClass::fat_read(cluster);
+		if (next != cluster + 1) return false;
+		cluster = next;
+	}
+	*first_lba = custer_to_sector(start_cluster);
+	*last_lba = custer_to_sector(cluster) + (1 << SDClass::sector2cluster) - 1;
+	return true;
 }
 
 int File::read(void *buf, uint32_t size)
@@ -94,82 +219,43 @@ int File::read(void *buf, uint32_t size)
 	if (type > FILE_WRITE) return 0;
 	uint32_t maxsize = length - offset;
 	if (size > maxsize) size = maxsize;
-	if (size == 0) return 0;
 	uint32_t count = 0;
 	uint8_t *dest = (uint8_t *)buf;
-	uint32_t lba = custer_to_sector(current_cluster);
-	uint32_t sindex = cluster_offset(offset);
 
 	//Serial.printf(" read %u at %u  (%X)\n", size, offset, offset);
 
-	lba += sindex >> 9;
-	sindex &= 511;
-	if (sindex) {
-		// first read starts in the middle of a sector
-		do {
-			SDCache cache;
-			sector_t *sector = cache.read(lba);
-			if (!sector) {
-				//Serial.println(" read err1, unable to read");
-				return 0;
-			}
-			uint32_t n = 512 - sindex;
-			if (size < n) {
-				// read does not consume all of the sector
-				memcpy(dest, sector->u8 + sindex, size);
-				offset += size;
-				//cache.priority(+1);
-				return size;
-			} else {
-				// read fully consumes this sector
-				memcpy(dest, sector->u8 + sindex, n);
-				dest += n;
-				count = n;
-				offset += n;
-				//cache.priority(-1);
-			}
-		} while (0);
-		if (is_new_cluster(++lba)) {
+	while (count < size) {
+		// move to the next cluster only when its data is needed
+		if (offset > 0 && cluster_offset(offset) == 0) {
 			if (!next_cluster()) {
-				//Serial.print(" read err1, next cluster");
+				//Serial.print(" read err, next cluster");
 				return count;
 			}
 		}
-		if (count >= size) return count;
-	}
-	while (1) {
-		// every read starts from the beginning of a sector
+		uint32_t lba = custer_to_sector(current_cluster) + (cluster_offset(offset) >> 9);
+		uint32_t sindex = offset & 511;
+		uint32_t n = 512 - sindex;
+		if (n > size - count) n = size - count;
 		do {
 			SDCache cache;
-			uint32_t n = size - count;
-			if (n < 512) {
+			if (n == 512) {
+				// a full sector is required
+				if (!cache.read(lba, dest)) return count;
+			} else {
 				// only part of a sector is needed
 				sector_t *sector = cache.read(lba);
 				if (!sector) {
-					//Serial.println(" read err2, unable to read");
+					//Serial.println(" read err, unable to read");
 					return count;
 				}
-				memcpy(dest, sector->u8, n);
-				offset += n;
-				count += n;
-				//cache.priority(+1);
-				return count;
-			} else {
-				// a full sector is required
-				if (!cache.read(lba, dest)) return count;
-				dest += 512;
-				offset += 512;
-				count += 512;
+				memcpy(dest, sector->u8 + sindex, n);
 			}
 		} while (0);
-		if (is_new_cluster(++lba)) {
-			if (!next_cluster()) {
-				//Serial.print(" read err2, next cluster");
-				return count;
-			}
-		}
-		if (count >= size) return count;
+		dest += n;
+		offset += n;
+		count += n;
 	}
+	return count;
 }
 
 bool File::seek(uint32_t pos)
@@ -181,14 +267,14 @@ bool File::seek(uint32_t pos)
 	uint32_t save_cluster = current_cluster;
 	uint32_t count;
 	// TODO: if moving to a new lba, lower cache priority
-	signed int diff = (int)cluster_number(pos) - (int)cluster_number(offset);
+	signed int diff = (int)cluster_index(pos) - (int)cluster_index(offset);
 	if (diff >= 0) {
 		// seek fowards, 0 or more clusters from current position
 		count = diff;
 	} else {
 		// seek backwards, need to start from beginning of file
 		current_cluster = start_cluster;
-		count = cluster_number(pos);
+		count = cluster_index(pos);
 	}
 	while (count > 0) {
 		if (!next_cluster()) {
@@ -203,6 +289,7 @@ bool File::seek(uint32_t pos)
 
 void File::close()
 {
+	if (type == FILE_WRITE) flush();
 	type = FILE_INVALID;
 	namestr[0] = 0;
 }
@@ -34,6 +34,8 @@ uint32_t SDClass::fat2_begin_lba;
 uint32_t SDClass::data_begin_lba;
 uint32_t SDClass::max_cluster;
 uint8_t  SDClass::sector2cluster;
+uint32_t SDClass::fsinfo_lba;
+uint32_t SDClass::free_hint;
 File SDClass::rootDir;
 
 static uint32_t unaligned_read32_align16(const void *p)
@@ -63,6 +65,7 @@ static uint32_t unaligned_read16_align8(const void *p)
 #define BPB_TotSec32   32   // 4 bytes
 #define BPB_FATSz32    36   // 4 bytes
 #define BPB_RootClus   44   // 4 bytes
+#define BPB_FSInfo     48   // 2 bytes
 
 bool SDClass::begin(uint8_t csPin)
 {
@@ -179,6 +182,8 @@ bool SDClass::begin(uint8_t csPin)
 		- root_dir_sectors - (sectors_per_fat << 1)) >> s2c;
 	//Serial.printf(" cluster_count = %d\n", cluster_count);
 	max_cluster = cluster_count + 1;
+	free_hint = 2;
+	fsinfo_lba = 0;
 	if (cluster_count < 4085) {
 		return false; // FAT12
 	} else if (cluster_count < 65525) {
@@ -192,6 +197,10 @@ bool SDClass::begin(uint8_t csPin)
 		rootDir.start_cluster = vol->u32[BPB_RootClus/4];
 		//Serial.printf(" root cluster = %d\n", rootDir.start_cluster);
 		rootDir.type = FILE_DIR;
+		uint32_t fsinfo = vol->u16[BPB_FSInfo/2];
+		if (fsinfo > 0 && fsinfo < reserved_sectors) {
+			fsinfo_lba = partition_lba + fsinfo;
+		}
 	}
 	rootDir.current_cluster = rootDir.start_cluster;
 	rootDir.offset = 0;
@@ -466,6 +466,87 @@ uint8_t Sd2Card::SD_writeBlock(uint32_t blockNumber, const uint8_t* src) {
   return false;
 }
 //------------------------------------------------------------------------------
+/** Start a write multiple blocks sequence.
+ *
+ * \param[in] blockNumber Address of first block in sequence.
+ * \param[in] eraseCount The number of blocks to be pre-erased.
+ *
+ * \note This function is used with writeData() and writeStop()
+ * for optimized multiple block writes.
+ *
+ * \return The value one, true, is returned for success and
+ * the value zero, false, is returned for failure.
+ */
+uint8_t Sd2Card::writeStart(uint32_t blockNumber, uint32_t eraseCount) {
+#if defined(__MK64FX512__) || defined(__MK66FX1M0__)
+  if (chipSelectPin_ == BUILTIN_SDCARD) {
+    writeBlock_ = blockNumber;
+    return true;
+  }
+#endif
+#if SD_PROTECT_BLOCK_ZERO
+  // don't allow write to first block
+  if (blockNumber == 0) return false; // SD_CARD_ERROR_WRITE_BLOCK_ZERO
+#endif  // SD_PROTECT_BLOCK_ZERO
+
+  chipSelectLow();
+  // send pre-erase count
+  if (cardAcmd(ACMD23, eraseCount)) {
+    goto fail; // SD_CARD_ERROR_ACMD23
+  }
+  // use address if not SDHC card
+  if (type_ != SD_CARD_TYPE_SDHC) blockNumber <<= 9;
+  if (cardCommand(CMD25, blockNumber)) {
+    goto fail; // SD_CARD_ERROR_CMD25
+  }
+  return true;
+
+ fail:
+  chipSelectHigh();
+  return false;
+}
+//------------------------------------------------------------------------------
+/** Write one data block in a multiple block write sequence */
+uint8_t Sd2Card::writeData(const uint8_t* src) {
+#if defined(__MK64FX512__) || defined(__MK66FX1M0__)
+  if (chipSelectPin_ == BUILTIN_SDCARD) {
+    return (KinetisSDHC_WriteBlock(src, writeBlock_++) == 0) ? true : false;
+  }
+#endif
+  // wait for previous write to finish
+  if (!waitNotBusy(SD_WRITE_TIMEOUT)) goto fail; // SD_CARD_ERROR_WRITE_MULTIPLE
+  if (!writeData(WRITE_MULTIPLE_TOKEN, src)) goto fail;
+  return true;
+
+ fail:
+  chipSelectHigh();
+  return false;
+}
+//------------------------------------------------------------------------------
+/** End a write multiple blocks sequence.
+ *
+ * Also ends one whose writeData() failed: that deselected the card, which is
+ * still in the write until it gets the stop token.
+ *
+ * \return The value one, true, is returned for success and
+ * the value zero, false, is returned for failure.
+ */
+uint8_t Sd2Card::writeStop(void) {
+#if defined(__MK64FX512__) || defined(__MK66FX1M0__)
+  if (chipSelectPin_ == BUILTIN_SDCARD) return true;
+#endif
+  chipSelectLow();
+  if (!waitNotBusy(SD_WRITE_TIMEOUT)) goto fail;
+  spiSend(STOP_TRAN_TOKEN);
+  if (!waitNotBusy(SD_WRITE_TIMEOUT)) goto fail;
+  chipSelectHigh();
+  return true;
+
+ fail:
+  chipSelectHigh();
+  return false; // SD_CARD_ERROR_STOP_TRAN
+}
+//------------------------------------------------------------------------------
 // send one block of data for write block or write multiple blocks
 uint8_t Sd2Card::writeData(uint8_t token, const uint8_t* src) {
 #ifdef OPTIMIZE_HARDWARE_SPI
@@ -125,10 +125,19 @@ class Sd2Card {
     #endif
     return SD_writeBlock(block, src);
   }
+  /* Multiple block write: writeStart(), one writeData() per 512 byte block,
+   * then writeStop().  The card stays selected (and the SPI transaction
+   * open) until writeStop(), so finish the sequence before returning to
+   * code that may touch the card from an interrupt.  Call writeStop() even
+   * when writeData() failed, or the card stays in the write. */
+  uint8_t writeStart(uint32_t blockNumber, uint32_t eraseCount);
+  uint8_t writeData(const uint8_t* src);
+  uint8_t writeStop(void);
  private:
   uint8_t chipSelectPin_;
   uint8_t status_;
   uint8_t type_;
+  uint32_t writeBlock_;  // next block of a builtin SDHC multiple block write
   // private functions
   uint8_t SD_init(uint8_t sckRateID, uint8_t chipSelectPin);
   uint8_t SD_readBlock(uint32_t block, uint8_t* dst);
@@ -0,0 +1,163 @@
+"""
+decodeRecording.py
+
+Decodes a compressed stethoscope recording (*.WAV written with RECCODEC 1, 2 or 3)
+into a 16-bit PCM WAV file that any player or analysis script can read.
+
+    format 1      16-bit PCM        copied as is
+    format 7      8-bit mu-law      G.711, 2:1
+    format 0x11   4-bit IMA-ADPCM   512 byte blocks of 1017 samples, ~4:1
+    format 0x5243 lossless          fixed predictor + Rice-coded residuals per 128 samples
+
+The decoders mirror the encoders in Arduino/Stethoscope/RecordCodec.h.
+
+usage: python decodeRecording.py RBENCH.WAV [output.wav]
+       -> RBENCH_PCM.WAV by default
+"""
+
+# Import Libraries and/or Modules
+import  struct, sys, os, wave
+
+ADPCM_STEP  = [     7,     8,     9,    10,    11,    12,    13,    14,    16,    17,    19,    21,    23,    25,    28,
+                   31,    34,    37,    41,    45,    50,    55,    60,    66,    73,    80,    88,    97,   107,   118,
+                  130,   143,   157,   173,   190,   209,   230,   253,   279,   307,   337,   371,   408,   449,   494,
+                  544,   598,   658,   724,   796,   876,   963,  1060,  1166,  1282,  1411,  1552,  1707,  1878,  2066,
+                 2272,  2499,  2749,  3024,  3327,  3660,  4026,  4428,  4871,  5358,  5894,  6484,  7132,  7845,  8630,
+                 9493, 10442, 11487, 12635, 13899, 15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767 ]
+ADPCM_INDEX = [ -1, -1, -1, -1, 2, 4, 6, 8 ]
+
+# Read the chunks of a RIFF/WAVE file
+def readWav( inputName ):
+    with open( inputName, "rb" ) as f:
+        data = f.read()
+    if data[ 0:4 ] != b"RIFF" or data[ 8:12 ] != b"WAVE":
+        raise ValueError( "%s is not a WAV file" % inputName )
+    chunks  = {}
+    pos     = 12
+    while pos + 8 <= len( data ):
+        name, size = struct.unpack( "<4sI", data[ pos : pos + 8 ] )
+        chunks[ name ] = data[ pos + 8 : pos + 8 + size ]
+        pos += 8 + size + ( size & 1 )
+    return chunks
+
+# G.711 mu-law
+def ulawDecode( code ):
+    code  = ~code & 0xFF
+    seg   = ( code >> 4 ) & 0x07
+    mag   = ( ( ( code & 0x0F ) << 3 ) + 0x84 ) << seg
+    mag  -= 0x84
+    return -mag if code & 0x80 else mag
+
+ULAW_TABLE = [ ulawDecode( c ) for c in range( 256 ) ]
+
+def decodeUlaw( data ):
+    return [ ULAW_TABLE[ b ] for b in bytearray( data ) ]
+
+# IMA-ADPCM, mono blocks
+def decodeAdpcm( data, blockAlign, samples ):
+    out = []
+    for start in range( 0, len( data ), blockAlign ):
+        block = bytearray( data[ start : start + blockAlign ] )
+        if len( block ) < 4:
+            break
+        predictor, index = struct.unpack( "<hB", bytes( block[ 0:3 ] ) )
+        out.append( predictor )
+        for b in block[ 4: ]:
+            for code in ( b & 0x0F, b >> 4 ):
+                step  = ADPCM_STEP[ index ]
+                delta = step >> 3
+                if code & 4: delta += step
+                if code & 2: delta += step >> 1
+                if code & 1: delta += step >> 2
+                predictor += -delta if code & 8 else delta
+                predictor  = max( -32768, min( 32767, predictor ) )
+                index      = max( 0, min( 88, index + ADPCM_INDEX[ code & 7 ] ) )
+                out.append( predictor )
+    return out[ :samples ] if samples else out
+
+# Lossless Rice blocks: order/parameter byte, then residuals ( or 128 verbatim samples when k = 31 )
+RICE_ESCAPE = 31
+
+def decodeRice( data, blockSamples, samples ):
+    out   = []
+    hist  = [ 0, 0, 0 ]                                                 # newest first
+    pos   = 0
+    total = samples if samples else None
+    while pos < len( data ) and ( total is None or len( out ) < total ):
+        n     = blockSamples if total is None else min( blockSamples, total - len( out ) )
+        order = data[ pos ] >> 5
+        k     = data[ pos ] & 0x1F
+        pos  += 1
+        if k == RICE_ESCAPE:
+            block = list( struct.unpack( "<%dh" % n, data[ pos : pos + 2 * n ] ) )
+            pos  += 2 * n
+        else:
+            coded = data[ pos : pos + 2 * n ]                                 # a coded block is always shorter than verbatim
+            bits  = int.from_bytes( bytes( coded ), "big" )
+            width = len( coded ) * 8
+            used  = 0
+            block = []
+            for i in range( n ):
+                q = 0
+                while not ( bits >> ( width - used - 1 ) ) & 1:
+                    q    += 1
+                    used += 1
+                used += 1
+                low   = ( bits >> ( width - used - k ) ) & ( ( 1 << k ) - 1 ) if k else 0
+                used += k
+                u     = ( q << k ) | low
+                e     = ( u >> 1 ) ^ -( u & 1 )
+                if   order == 0: x = e
+                elif order == 1: x = e + hist[0]
+                elif order == 2: x = e + 2 * hist[0] - hist[1]
+                else:            x = e + 3 * hist[0] - 3 * hist[1] + hist[2]
+                hist  = [ x, hist[0], hist[1] ]
+                block.append( x )
+            pos += ( used + 7 ) // 8
+        if k == RICE_ESCAPE:
+            for x in block:
+                hist = [ x, hist[0], hist[1] ]
+        out.extend( block )
+    return out
+
+# Decode file
+def decodeRecording( inputName, outputName ):
+    chunks = readWav( inputName )
+    fmt    = chunks[ b"fmt " ]
+    audioFormat, channels, rate, byteRate, blockAlign, bits = struct.unpack( "<HHIIHH", fmt[ :16 ] )
+    data   = chunks[ b"data" ]
+    if channels != 1:
+        raise ValueError( "only mono recordings are supported" )
+
+    samples = struct.unpack( "<I", chunks[ b"fact" ] )[0] if b"fact" in chunks else 0
+    if audioFormat == 1:
+        pcm = list( struct.unpack( "<%dh" % ( len( data ) // 2 ), data[ : len( data ) // 2 * 2 ] ) )
+    elif audioFormat == 7:
+        pcm = decodeUlaw( data )
+    elif audioFormat == 0x11:
+        pcm = decodeAdpcm( data, blockAlign, samples )
+    elif audioFormat == 0x5243:
+        blockSamples = struct.unpack( "<H", fmt[ 18:20 ] )[0]
+        pcm = decodeRice( bytearray( data ), blockSamples, samples )
+    else:
+        raise ValueError( "unsupported WAV format 0x%X" % audioFormat )
+
+    out = wave.open( outputName, "wb" )
+    out.setnchannels( 1 )
+    out.setsampwidth( 2 )
+    out.setframerate( rate )
+    out.writeframes( struct.pack( "<%dh" % len( pcm ), *pcm ) )
+    out.close()
+
+    print( "format 0x%X: %d bytes -> %d samples, %.2f s (%.1f:1)" %
+           ( audioFormat, len( data ), len( pcm ), len( pcm ) / float( rate ),
+             2.0 * len( pcm ) / max( 1, len( data ) ) ) )
+    return pcm
+
+if __name__ == "__main__":
+    if len( sys.argv ) < 2:
+        print( __doc__ )
+        sys.exit( 1 )
+    inputName  = sys.argv[1]
+    outputName = sys.argv[2] if len( sys.argv ) > 2 else os.path.splitext( inputName )[0] + "_PCM.WAV"
+    decodeRecording( inputName, outputName )
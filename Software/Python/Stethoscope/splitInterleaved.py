@@ -0,0 +1,77 @@
+"""
+splitInterleaved.py
+
+Splits a multi-channel stethoscope recording made in recording mode 2 (*.ILV)
+into one 16-bit, 44.1 kHz mono PCM .WAV file per channel, written the same
+way decodeRecording.py writes its output.
+
+File layout: a sequence of 520 byte frames, one per audio block
+    [0..1]    'I','L'
+    [2]       channel count (2)
+    [3]       flags - bit 0/1: microphone/speaker block missing (written as silence)
+    [4..7]    frame number, little-endian
+    [8..263]  microphone block, 128 x int16
+    [264..519] speaker block, 128 x int16
+
+usage: python splitInterleaved.py RIBENCH.ILV [outputPrefix]
+       -> outputPrefix_MIC.WAV, outputPrefix_SPK.WAV
+"""
+
+# Import Libraries and/or Modules
+import  struct, sys, os, wave
+
+FRAME_SIZE      = 520
+HEADER_SIZE     = 8
+BLOCK_SIZE      = 256
+MISSING_MIC     = 0x01
+MISSING_SPK     = 0x02
+SAMPLE_RATE     = 44100
+
+# Open a mono 16-bit PCM .WAV for writing
+def openWav( outputName ):
+    out = wave.open( outputName, "wb" )
+    out.setnchannels( 1 )
+    out.setsampwidth( 2 )
+    out.setframerate( SAMPLE_RATE )
+    return out
+
+# Split file
+def splitInterleaved( inputName, outputPrefix ):
+    frames  = 0
+    missing = [ 0, 0 ]
+    gaps    = 0
+    expect  = 0
+
+    mic = openWav( outputPrefix + "_MIC.WAV" )
+    spk = openWav( outputPrefix + "_SPK.WAV" )
+    with open( inputName, "rb" ) as ilv:
+        while True:
+            frame = ilv.read( FRAME_SIZE )
+            if len( frame ) < FRAME_SIZE:
+                break
+            magic, channels, flags, number = struct.unpack( "<2sBBI", frame[ :HEADER_SIZE ] )
+            if magic != b"IL" or channels != 2:
+                raise ValueError( "bad frame header at offset %d" % ( frames * FRAME_SIZE ) )
+            if number != expect:
+                gaps += 1
+            expect = number + 1
+
+            mic.writeframes( frame[ HEADER_SIZE : HEADER_SIZE + BLOCK_SIZE ] )
+            spk.writeframes( frame[ HEADER_SIZE + BLOCK_SIZE : ] )
+            if flags & MISSING_MIC: missing[0] += 1
+            if flags & MISSING_SPK: missing[1] += 1
+            frames += 1
+    mic.close()
+    spk.close()
+
+    print( "%d frames, %.2f s per channel" % ( frames, frames * 128 / float( SAMPLE_RATE ) ) )
+    print( "padded blocks: mic %d, spk %d; frame number gaps: %d" % ( missing[0], missing[1], gaps ) )
+    return frames
+
+if __name__ == "__main__":
+    if len( sys.argv ) < 2:
+        print( __doc__ )
+        sys.exit( 1 )
+    inputName    = sys.argv[1]
+    outputPrefix = sys.argv[2] if len( sys.argv ) > 2 else os.path.splitext( inputName )[0]
+    splitInterleaved( inputName, outputPrefix )
@@ -0,0 +1,278 @@
+"""
+streamReceiver.py
+
+Plays the live audio of the stethoscope (STARTSTREAM, see
+Arduino/Stethoscope/LiveStream.h) through a jitter buffer, and saves it as a
+16-bit WAV file. Packets are played in sequence once JITTER_MS of audio is
+waiting; a packet that is lost, corrupt or too late is replaced by the last
+one, at half the level, then by silence.
+
+Packet layout, little-endian
+    [0]       SYN (0x16)
+    [1..2]    packet number
+    [3]       codec - 1 mu-law, 2 IMA-ADPCM
+    [4]       decimation factor, the rate is 44117.6 Hz / factor
+    [5..6]    samples
+    [7..8]    length of the data
+    data      mu-law: a byte a sample
+              ADPCM: predictor (2), step index (1), two samples a byte, the
+              first in the low nibble
+    CRC32     IEEE, of the packet number to the end of the data
+
+usage: python streamReceiver.py PORT [codec[:factor]] [output.wav]
+       e.g. /dev/rfcomm0 2:8 live.wav ( needs pyserial; raw samples also go
+       to stdout when it is not a terminal, e.g. | aplay -f S16_LE -r 5515 )
+"""
+
+# Import Libraries and/or Modules
+import  struct, sys, time, wave, zlib
+
+SYN             = 0x16
+STX             = 0x02
+ACK             = 0x06
+NAK             = 0x15
+STARTSTREAM     = 0x24
+STOPSTREAM      = 0x25
+HEADER_SIZE     = 9
+TELEM_HEADER    = 12                        # Arduino/Stethoscope/Telemetry.h
+CODEC_ULAW      = 1
+CODEC_ADPCM     = 2
+SAMPLE_RATE     = 44117.64706               # Teensy audio library
+JITTER_MS       = 150                       # audio held back before playing
+LATE_MS         = 600                       # most audio held; older is skipped
+
+# Decoders, the inverse of the encoders in Arduino/Stethoscope/RecordCodec.h
+ADPCM_STEP  = [     7,     8,     9,    10,    11,    12,    13,    14,    16,    17,    19,    21,    23,    25,    28,
+                   31,    34,    37,    41,    45,    50,    55,    60,    66,    73,    80,    88,    97,   107,   118,
+                  130,   143,   157,   173,   190,   209,   230,   253,   279,   307,   337,   371,   408,   449,   494,
+                  544,   598,   658,   724,   796,   876,   963,  1060,  1166,  1282,  1411,  1552,  1707,  1878,  2066,
+                 2272,  2499,  2749,  3024,  3327,  3660,  4026,  4428,  4871,  5358,  5894,  6484,  7132,  7845,  8630,
+                 9493, 10442, 11487, 12635, 13899, 15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767 ]
+ADPCM_INDEX = [ -1, -1, -1, -1, 2, 4, 6, 8 ]
+
+def ulawDecode( code ):
+    code  = ~code & 0xFF
+    seg   = ( code >> 4 ) & 0x07
+    mag   = ( ( ( code & 0x0F ) << 3 ) + 0x84 ) << seg
+    mag  -= 0x84
+    return -mag if code & 0x80 else mag
+
+ULAW_TABLE = [ ulawDecode( c ) for c in range( 256 ) ]
+
+def decodeAdpcm( data, samples ):
+    predictor, index = struct.unpack( "<hB", bytes( data[ :3 ] ) )
+    out = []
+    for i in range( samples ):
+        code   = ( data[ 3 + i // 2 ] >> ( 4 * ( i & 1 ) ) ) & 0x0F
+        step   = ADPCM_STEP[ index ]
+        delta  = step >> 3
+        if code & 4: delta += step
+        if code & 2: delta += step >> 1
+        if code & 1: delta += step >> 2
+        predictor += -delta if code & 8 else delta
+        predictor  = max( -32768, min( 32767, predictor ) )
+        index      = max( 0, min( 88, index + ADPCM_INDEX[ code & 7 ] ) )
+        out.append( predictor )
+    return out
+
+# One decoded packet
+class Packet:
+    def __init__( self, seq, codec, factor, samples ):
+        self.seq     = seq
+        self.codec   = codec
+        self.factor  = factor
+        self.samples = samples
+
+    def rate( self ):
+        return SAMPLE_RATE / self.factor
+
+# Finds the packets in a byte stream; keeps what may be the start of an unfinished one
+class PacketReader:
+    def __init__( self ):
+        self.buf        = bytearray()
+        self.crcErrors  = 0
+
+    def feed( self, data ):
+        self.buf   += data
+        packets     = []
+        while True:
+            start = self.buf.find( bytes( [ SYN ] ) )
+            if start < 0:
+                del self.buf[:]
+                break
+            del self.buf[ :start ]
+            if len( self.buf ) < HEADER_SIZE:
+                break
+            seq, codec, factor, samples, length = struct.unpack( "<HBBHH", bytes( self.buf[ 1:HEADER_SIZE ] ) )
+            end = HEADER_SIZE + length + 4
+            if codec not in ( CODEC_ULAW, CODEC_ADPCM ) or length > 1024:
+                del self.buf[ :1 ]                                      # not a packet after all
+                continue
+            if len( self.buf ) < end:
+                break
+            crc, = struct.unpack( "<I", bytes( self.buf[ end - 4:end ] ) )
+            if zlib.crc32( bytes( self.buf[ 1:end - 4 ] ) ) & 0xFFFFFFFF != crc:
+                self.crcErrors += 1                                     # or a SYN inside other data: resynchronise
+                del self.buf[ :1 ]
+                continue
+            data = self.buf[ HEADER_SIZE:end - 4 ]
+            if codec == CODEC_ULAW:
+                pcm = [ ULAW_TABLE[ b ] for b in data ]
+            else:
+                pcm = decodeAdpcm( data, samples )
+            packets.append( Packet( seq, codec, factor, pcm ) )
+            del self.buf[ :end ]
+        return packets
+
+# Holds packets until their turn to play, in packet number order, on the receiver's own clock
+class JitterBuffer:
+    def __init__( self, jitterMs = JITTER_MS, lateMs = LATE_MS ):
+        self.jitterMs   = jitterMs
+        self.lateMs     = lateMs
+        self.reset()
+        self.concealed  = 0                                             # packets lost, replaced
+        self.underruns  = 0                                             # packets not there yet, replaced
+        self.late       = 0                                             # arrived after their turn
+        self.skipped    = 0                                             # dropped to catch up
+
+    def reset( self ):
+        self.packets    = {}
+        self.next       = None                                          # packet number to play next
+        self.rate       = None
+        self.size       = None                                          # samples a packet
+        self.started    = None                                          # receiver time playing began
+        self.played     = 0                                             # samples played since
+        self.last       = None
+        self.arrived    = None                                          # receiver time of the last packet
+
+    def push( self, packet, now ):
+        if self.rate is not None and ( packet.rate() != self.rate or len( packet.samples ) != self.size ):
+            self.reset()                                                # a new stream
+        if self.arrived is not None and now - self.arrived > 1.0:
+            self.reset()                                                # after a pause, a new stream
+        if self.next is not None and ( ( self.next - packet.seq ) & 0xFFFF ) < 0x8000 and packet.seq != self.next:
+            if ( ( self.next - packet.seq ) & 0xFFFF ) < 64:
+                self.late += 1                                          # its turn has passed
+                return
+            self.reset()                                                # numbered from 0 again: a new stream
+        self.arrived = now
+        if self.rate is None:
+            self.rate = packet.rate()
+            self.size = len( packet.samples )
+        if self.next is None:
+            self.next = packet.seq
+        self.packets[ packet.seq ] = packet
+        waiting = len( self.packets ) * self.size * 1000.0 / self.rate
+        if self.started is None and waiting >= self.jitterMs:
+            self.started = now
+        while waiting > self.lateMs:                                    # fell behind: drop the oldest
+            oldest = min( self.packets, key = lambda s: ( s - self.next ) & 0xFFFF )
+            del self.packets[ oldest ]
+            self.skipped += 1
+            self.next     = ( oldest + 1 ) & 0xFFFF
+            waiting      -= self.size * 1000.0 / self.rate
+
+    # Samples due by <now>, whole packets at a time
+    def pull( self, now ):
+        out = []
+        if self.started is None:
+            return out
+        if not self.packets and now - self.arrived > 2 * self.jitterMs / 1000.0:
+            self.started = None                                         # the stream has stopped: wait for the buffer to fill again
+            self.played  = 0
+            return out
+        due = int( ( now - self.started ) * self.rate )
+        while self.played + self.size <= due:
+            packet = self.packets.pop( self.next, None )
+            if packet is not None:
+                samples   = packet.samples
+                self.last = samples
+            else:
+                if self.packets: self.concealed += 1
+                else:            self.underruns += 1
+                samples   = [ s // 2 for s in self.last ] if self.last else [ 0 ] * self.size
+                self.last = None                                        # the next loss is silent
+            out          += samples
+            self.played  += self.size
+            self.next     = ( self.next + 1 ) & 0xFFFF
+        return out
+
+# The reply to STARTSTREAM: the rate, and the bytes read after it, or None for NAK or no reply. A reply never goes
+# out inside a telemetry frame ( btReply() ), but whole frames can come before it, and so can the tail of one that
+# was part-way out when the link was opened; both are skipped
+def startReply( link, timeout = 2.0 ):
+    data     = b""
+    deadline = time.time() + timeout
+    while time.time() < deadline:
+        data += link.read( 64 )
+        while data:
+            if data[0] == STX:
+                if len( data ) < TELEM_HEADER:
+                    break
+                length, = struct.unpack_from( "<H", data, 10 )
+                end     = TELEM_HEADER + length + 4
+                if len( data ) < end:
+                    break
+                if zlib.crc32( data[ 1:end - 4 ] ) == struct.unpack_from( "<I", data, end - 4 )[0]:
+                    data = data[ end: ]
+                    continue
+            elif data[0] == NAK:
+                return None
+            elif data[0] == ACK:
+                if len( data ) < 3:
+                    break
+                rate, = struct.unpack_from( "<H", data, 1 )
+                if SAMPLE_RATE / 12 < rate < SAMPLE_RATE / 5:               # factors 6 to 11
+                    return rate, data[ 3: ]
+            data = data[ 1: ]
+    return None
+
+# Reads <link> ( a pyserial port or anything with read() ) until <stop>() is true
+def receive( link, reader, jitter, stop, sink ):
+    while not stop():
+        for packet in reader.feed( link.read( 256 ) ):
+            jitter.push( packet, time.time() )
+        sink( jitter.pull( time.time() ) )
+
+if __name__ == "__main__":
+    if len( sys.argv ) < 2:
+        print( __doc__ )
+        sys.exit( 1 )
+    import serial
+    payload = sys.argv[2] if len( sys.argv ) > 2 else "2"
+    output  = sys.argv[3] if len( sys.argv ) > 3 else "live.wav"
+    link    = serial.Serial( sys.argv[1], 115200, timeout = 0.02 )
+    link.reset_input_buffer()
+    link.write( bytes( [ STARTSTREAM ] ) + payload.encode() + b"\n" )
+    reply   = startReply( link )
+    if not reply:
+        sys.exit( "the stethoscope did not start streaming" )
+    rate, rest = reply
+    wav     = wave.open( output, "wb" )
+    wav.setnchannels( 1 )
+    wav.setsampwidth( 2 )
+    wav.setframerate( rate )
+    pipe    = not sys.stdout.isatty()
+
+    def sink( samples ):
+        if not samples:
+            return
+        data = struct.pack( "<%dh" % len( samples ), *samples )
+        wav.writeframes( data )
+        if pipe:
+            sys.stdout.buffer.write( data )
+            sys.stdout.buffer.flush()
+
+    reader = PacketReader()
+    jitter = JitterBuffer()
+    for packet in reader.feed( rest ):
+        jitter.push( packet, time.time() )
+    sys.stderr.write( "receiving at %d Hz, ctrl-c to stop\n" % rate )
+    try:
+        receive( link, reader, jitter, lambda: False, sink )
+    except KeyboardInterrupt:
+        link.write( bytes( [ STOPSTREAM ] ) )
+    wav.close()
+    link.close()
+    sys.stderr.write( "crc errors %d, concealed %d, underruns %d, late %d, skipped %d\n" %
+                      ( reader.crcErrors, jitter.concealed, jitter.underruns, jitter.late, jitter.skipped ) )
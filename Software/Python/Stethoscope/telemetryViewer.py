@@ -0,0 +1,147 @@
+"""
+telemetryViewer.py
+
+Draws the binary telemetry of the stethoscope (STARTTELEM, see
+Arduino/Stethoscope/Telemetry.h) as the text bar graphs the firmware used to
+print itself: one line per record, microphone level to the left of the bars,
+playback level to the right, then heart rate, gains and state.
+
+Frame layout, little-endian
+    [0]       STX (0x02)
+    [1..2]    frame number
+    [3..6]    millis() of the first record
+    [7..8]    period between records [ms]
+    [9]       record count
+    [10..11]  length of the records
+    records   per record: 2 byte mask of the fields that changed, then the
+              change of each, in field order, as a zigzag varint; the first
+              record of a frame is against zero
+    CRC32     IEEE, of the frame number to the end of the records
+
+usage: python telemetryViewer.py PORT [rate]     e.g. /dev/rfcomm0 20 ( needs pyserial )
+       python telemetryViewer.py -f capture.bin  bytes saved from the BT link
+"""
+
+# Import Libraries and/or Modules
+import  struct, sys, zlib
+
+STX         = 0x02
+STARTTELEM  = 0x22
+STOPTELEM   = 0x23
+HEADER_SIZE = 12
+FIELDS      = [ "micPeak", "micRms", "playPeak", "playRms", "hr", "hrConf",
+                "micGain", "agcGain", "blend", "state", "mode" ]
+STATES      = [ "READY", "NOTREADY", "RECORDING", "PLAYING", "MONITORING",
+                "BLENDING", "CONTINUING", "TRANSFERRING" ]
+BAR         = 30
+
+# Records of one frame, as dictionaries with a time [ms]
+def decodeRecords( data, count, start, period ):
+    records = []
+    values  = [ 0 ] * len( FIELDS )
+    pos     = 0
+    for k in range( count ):
+        mask = data[ pos ] | ( data[ pos + 1 ] << 8 )
+        pos += 2
+        for f in range( len( FIELDS ) ):
+            if not mask & ( 1 << f ):
+                continue
+            z = shift = 0
+            while True:
+                b      = data[ pos ]
+                pos   += 1
+                z     |= ( b & 0x7F ) << shift
+                shift += 7
+                if b < 0x80:
+                    break
+            values[ f ] += ( z >> 1 ) ^ -( z & 1 )
+        record          = dict( zip( FIELDS, values ) )
+        record[ "ms" ]  = start + k * period
+        records.append( record )
+    if pos != len( data ):
+        raise ValueError( "frame length does not match its records" )
+    return records
+
+# Finds the frames in a byte stream; keeps what may be the start of an unfinished one
+class TelemetryReader:
+    def __init__( self ):
+        self.buf        = bytearray()
+        self.expect     = None
+        self.crcErrors  = 0
+        self.gaps       = 0
+
+    def feed( self, data ):
+        self.buf   += data
+        records     = []
+        while True:
+            start = self.buf.find( bytes( [ STX ] ) )
+            if start < 0:
+                del self.buf[:]
+                break
+            del self.buf[ :start ]
+            if len( self.buf ) < HEADER_SIZE:
+                break
+            seq, ms, period, count, length = struct.unpack( "<HIHBH", bytes( self.buf[ 1:HEADER_SIZE ] ) )
+            end = HEADER_SIZE + length + 4
+            if len( self.buf ) < end:
+                if length > 2048:                                       # not a frame after all
+                    del self.buf[ :1 ]
+                    continue
+                break
+            crc, = struct.unpack( "<I", bytes( self.buf[ end - 4:end ] ) )
+            if zlib.crc32( bytes( self.buf[ 1:end - 4 ] ) ) & 0xFFFFFFFF != crc:
+                self.crcErrors += 1                                     # or an STX inside other data: resynchronise
+                del self.buf[ :1 ]
+                continue
+            if self.expect is not None and seq != self.expect:
+                self.gaps += 1
+            self.expect = ( seq + 1 ) & 0xFFFF
+            records    += decodeRecords( self.buf[ HEADER_SIZE:end - 4 ], count, ms, period )
+            del self.buf[ :end ]
+        return records
+
+# One line per record
+def bars( level, rms, right ):
+    n   = level * BAR // 255
+    r   = rms   * BAR // 255
+    bar = "=" * min( r, n ) + ( ">" if right else "<" ) * max( n - r, 0 )
+    return bar.ljust( BAR ) if right else bar[ ::-1 ].rjust( BAR )
+
+def render( r ):
+    state = STATES[ r[ "state" ] ] if 0 <= r[ "state" ] < len( STATES ) else str( r[ "state" ] )
+    return "%9.2f %s||%s | HR %5.1f (%3d%%) | mic %2d dB, agc %+5.1f dB | blend %3d%% | %s, mode %d" % (
+        r[ "ms" ] / 1000.0,
+        bars( r[ "micPeak" ],  r[ "micRms" ],  False ),
+        bars( r[ "playPeak" ], r[ "playRms" ], True  ),
+        r[ "hr" ] / 10.0, r[ "hrConf" ], r[ "micGain" ], r[ "agcGain" ] / 10.0, r[ "blend" ], state, r[ "mode" ] )
+
+def viewFile( name ):
+    reader = TelemetryReader()
+    with open( name, "rb" ) as f:
+        records = reader.feed( f.read() )
+    for r in records:
+        print( render( r ) )
+    print( "%d records, crc errors %d, frame gaps %d" % ( len( records ), reader.crcErrors, reader.gaps ) )
+
+def viewPort( port, rate ):
+    import serial
+    reader = TelemetryReader()
+    link   = serial.Serial( port, 115200, timeout = 0.1 )
+    link.write( bytes( [ STARTTELEM ] ) + str( rate ).encode() + b"\n" )
+    try:
+        while True:
+            for r in reader.feed( link.read( 256 ) ):
+                print( render( r ) )
+    except KeyboardInterrupt:
+        link.write( bytes( [ STOPTELEM ] ) )
+        print( "crc errors %d, frame gaps %d" % ( reader.crcErrors, reader.gaps ) )
+    link.close()
+
+if __name__ == "__main__":
+    if len( sys.argv ) < 2:
+        print( __doc__ )
+        sys.exit( 1 )
+    if sys.argv[1] == "-f":
+        viewFile( sys.argv[2] )
+    else:
+        viewPort( sys.argv[1], int( sys.argv[2] ) if len( sys.argv ) > 2 else 20 )